@@ -17,9 +17,17 @@
  */
 #include "dmod_types.h"
 
+/*
+ * Magic number of the ring header. It also identifies the layout of the
+ * header and of the protocol between the firmware and the host, so it
+ * changes with them - a monitor refuses a ring with another magic number:
+ * - 0x444D4C4F ("DMLO") - version 1, the host wrote to the ring header
+ * - 0x444D4C32 ("DML2") - version 2, the host writes only to dmlog_host_t
+ */
 #ifndef DMLOG_MAGIC_NUMBER
-#   define DMLOG_MAGIC_NUMBER      0x444D4C4F 
+#   define DMLOG_MAGIC_NUMBER      0x444D4C32
 #endif
+#define DMLOG_MAGIC_NUMBER_V1       0x444D4C4F
 
 /* Maximum size of a single log message */
 #ifndef DMOD_LOG_MAX_ENTRY_SIZE
@@ -30,6 +38,16 @@
 #   define DMLOG_FILE_TRANSFER_CHUNK_SIZE  512
 #endif
 
+/*
+ * Size of the window of a received file that the target keeps to decode
+ * compressed chunks (see DMLOG_FILE_TRANSFER_FLAG_COMPRESSED). It is
+ * allocated for the time of a transfer. Must be a power of two, at most
+ * 32768 - 0 disables compression.
+ */
+#ifndef DMLOG_FILE_COMPRESSION_WINDOW
+#   define DMLOG_FILE_COMPRESSION_WINDOW 1024
+#endif
+
 #ifndef DMLOG_MAX_FILE_PATH_LENGTH
 #   define DMLOG_MAX_FILE_PATH_LENGTH 255
 #endif
@@ -38,18 +56,109 @@
 #   define DMLOG_PACKED __attribute__((packed))
 #endif
 
+/* Maximum number of frames recorded by dmlog_backtrace() */
+#ifndef DMLOG_BACKTRACE_MAX_DEPTH
+#   define DMLOG_BACKTRACE_MAX_DEPTH 16
+#endif
+
+/*
+ * Size of the data cache line of the target. The ring header, the host
+ * control block and the input buffer are kept on lines of their own, so the
+ * firmware and the debug probe never write to the same line (see
+ * dmlog_set_cache_ops()). The monitor must
+ * be built with the same value to use snapshot mode.
+ */
+#ifndef DMLOG_CACHE_LINE_SIZE
+#   define DMLOG_CACHE_LINE_SIZE 64
+#endif
+
+/*
+ * Longest time a logging call waits for the host to read the output ring
+ * with flow control (see dmlog_host_t) - in microseconds when a clock is set
+ * with dmlog_set_clock(), otherwise in polls of the host control block. The
+ * wait starts over whenever the host reads. When it expires, the firmware
+ * sets DMLOG_FLAG_FLOW_CONTROL_LOST and overwrites unread entries again.
+ */
+#ifndef DMLOG_FLOW_CONTROL_TIMEOUT
+#   define DMLOG_FLOW_CONTROL_TIMEOUT 100000
+#endif
+
+/* Size of a module name in the logging overhead table (including '\0') */
+#ifndef DMLOG_OVERHEAD_NAME_SIZE
+#   define DMLOG_OVERHEAD_NAME_SIZE 16
+#endif
+
+/* Size of a tag set - the formatted prefix of the pushed tags (including '\0') */
+#ifndef DMLOG_TAG_SET_SIZE
+#   define DMLOG_TAG_SET_SIZE 64
+#endif
+
+/* Maximum number of tags pushed at the same time */
+#ifndef DMLOG_TAG_MAX_DEPTH
+#   define DMLOG_TAG_MAX_DEPTH 8
+#endif
+
+/*
+ * Storage class of the tag stack. Define it as _Thread_local (or the
+ * equivalent of the RTOS) when building the library to give every thread a
+ * tag stack of its own. By default the stack is shared, like the module set
+ * with dmlog_set_module().
+ */
+#ifndef DMLOG_TAG_STORAGE
+#   define DMLOG_TAG_STORAGE
+#endif
+
+/*
+ * Name the logging overhead of the current translation unit is accounted to
+ * by DMLOG_SET_MODULE(): the DMOD module name when built as a DMOD module.
+ */
+#ifndef DMLOG_MODULE_NAME
+#   ifdef DMOD_MODULE_NAME
+#       define DMLOG_MODULE_NAME DMOD_MODULE_NAME
+#   else
+#       define DMLOG_MODULE_NAME "main"
+#   endif
+#endif
+
+/*
+ * Binary records
+ *
+ * Raw values (addresses, backtraces, ...) are embedded in log entries as
+ * compact binary records that the monitor decodes and formats on the host:
+ *
+ *     DMLOG_RECORD_MARKER, type, value...
+ *
+ * Each value is split into 6-bit groups, least significant first. Every group
+ * but the last is stored as 0x80|group, the last one as 0xC0|group. Encoded
+ * bytes are therefore never '\0' or '\n', so records can be mixed with text
+ * in the same entry. The number of values is given by the record type.
+ */
+#define DMLOG_RECORD_MARKER         0x1E    /* ASCII record separator */
+#define DMLOG_RECORD_MAX_VALUE_SIZE 11      /* Encoded size of a 64-bit value */
+#define DMLOG_RECORD_MAX_SIZE       (2 + DMLOG_RECORD_MAX_VALUE_SIZE * (DMLOG_BACKTRACE_MAX_DEPTH + 1))
+
 /* Flag bits for commands/status */
-#define DMLOG_FLAG_CLEAR_BUFFER     0x00000001  /* Set to clear buffer, cleared after execution */
-#define DMLOG_FLAG_BUSY             0x00000002  /* Buffer busy flag - set during write operations */
-#define DMLOG_FLAG_INPUT_AVAILABLE  0x00000004  /* Input data available flag */
+#define DMLOG_FLAG_BUSY             0x00000002  /* Buffer busy flag - set during write operations (host flags: held by the host) */
 #define DMLOG_FLAG_INPUT_REQUESTED  0x00000008  /* Firmware requests input from user */
 #define DMLOG_FLAG_INPUT_ECHO_OFF   0x00000010  /* Disable echoing of input characters */
 #define DMLOG_FLAG_INPUT_LINE_MODE  0x00000020  /* Input line mode (vs. character mode) */
 #define DMLOG_FLAG_FILE_SEND_REQ    0x00000040  /* FW requests sending a file to the host */
 #define DMLOG_FLAG_FILE_RECV_REQ    0x00000080  /* FW requests receiving a file from the host */
-#define DMLOG_FLAG_FILE_CHUNK_ACK   0x00000100  /* ACK flag set by host to acknowledge processing of the chunk */
+#define DMLOG_FLAG_FLOW_CONTROL     0x00000200  /* Host flags: wait until the host has read old entries instead of overwriting them */
+#define DMLOG_FLAG_FLOW_CONTROL_LOST 0x00000400 /* The host did not read within DMLOG_FLOW_CONTROL_TIMEOUT - flow control is suspended */
 #define DMLOG_FLAG_EXIT_REQUESTED   0x80000000  /* Monitor exit requested */
 
+/*
+ * Deprecated flags of the version 1 ring header, not used by the protocol
+ * any more - they will be removed in the next release. The host clears the
+ * buffers with dmlog_host_t.clear_request, publishes input by moving
+ * dmlog_host_t.input_head_offset and acknowledges file chunks with
+ * dmlog_host_t.file_serviced.
+ */
+#define DMLOG_FLAG_CLEAR_BUFFER     0x00000001  /* Deprecated - use dmlog_host_t.clear_request */
+#define DMLOG_FLAG_INPUT_AVAILABLE  0x00000004  /* Deprecated - compare dmlog_host_t.input_head_offset with input_tail_offset */
+#define DMLOG_FLAG_FILE_CHUNK_ACK   0x00000100  /* Deprecated - use dmlog_host_t.file_serviced */
+
 /**
  * @brief Input request flags
  * Used when requesting input from the user via dmlog_input_request().
@@ -62,6 +171,59 @@ typedef enum
     DMLOG_INPUT_REQUEST_MASK             = DMLOG_FLAG_INPUT_ECHO_OFF | DMLOG_FLAG_INPUT_LINE_MODE
 } dmlog_input_request_flags_t;
 
+/**
+ * @brief Binary record types
+ */
+typedef enum
+{
+    DMLOG_RECORD_ADDRESS    = 'A',  //!< One value: raw address (function pointer, fault PC, ...)
+    DMLOG_RECORD_BACKTRACE  = 'B',  //!< Frame count, first return address, then zigzag deltas to the previous frame
+    DMLOG_RECORD_HEAP_ALLOC = 'M',  //!< Four values: pointer, size, caller address, timestamp
+    DMLOG_RECORD_HEAP_FREE  = 'F',  //!< Three values: pointer, caller address, timestamp
+    DMLOG_RECORD_TAG_SET    = 'T',  //!< One value: index of the tag set in the tag dictionary
+} dmlog_record_type_t;
+
+/**
+ * @brief Stack unwinder hook used by dmlog_backtrace()
+ * 
+ * @param pcs Array to store the return addresses in (innermost first)
+ * @param max_depth Maximum number of addresses to store
+ * @param user_data User data passed to dmlog_set_unwinder()
+ * @return size_t Number of addresses stored
+ */
+typedef size_t (*dmlog_unwinder_t)(uintptr_t* pcs, size_t max_depth, void* user_data);
+
+/**
+ * @brief Clock hook used to timestamp trace records
+ * 
+ * Called inside a critical section - it must be fast and must not allocate.
+ * 
+ * @return uint64_t Current time in microseconds
+ */
+typedef uint64_t (*dmlog_clock_t)(void);
+
+/**
+ * @brief Data cache maintenance hook
+ * 
+ * Cleans (writes back) or invalidates every cache line overlapping the given
+ * range, e.g. SCB_CleanDCache_by_Addr()/SCB_InvalidateDCache_by_Addr() on
+ * Cortex-M7. Called inside a critical section.
+ * 
+ * @param address Start of the range
+ * @param size Size of the range in bytes
+ */
+typedef void (*dmlog_cache_op_t)(volatile void* address, size_t size);
+
+/**
+ * @brief Cycle counter hook used to measure the logging overhead
+ * 
+ * E.g. DWT->CYCCNT on Cortex-M. The counter may wrap around. Called inside a
+ * critical section - it must be fast.
+ * 
+ * @return uint32_t Current value of the cycle counter
+ */
+typedef uint32_t (*dmlog_cycle_counter_t)(void);
+
 /* Type definition for log entry indices */
 typedef uint32_t dmlog_index_t;
 
@@ -77,23 +239,82 @@ typedef struct
     volatile uint32_t total_size;                                   //!< Total size of the file
     volatile uint32_t offset;                                       //!< Current offset in the file
     volatile int32_t  status;                                       //!< Status of the file transfer (errno)
+    volatile uint64_t manifest_address;                             //!< Batch: host paths of the files, each '\0' terminated
+    volatile uint64_t status_address;                               //!< Batch: int32_t per file, set by the host to a negative errno when the file fails on its side
+    volatile uint32_t manifest_size;                                //!< Batch: size of the manifest in bytes
+    volatile uint32_t file_count;                                   //!< Batch: number of files
+    volatile uint32_t flags;                                        //!< DMLOG_FILE_TRANSFER_FLAG_* flags
+    volatile uint32_t window_size;                                  //!< Window of the target for compressed chunks (0 - chunks are never compressed)
     char host_file_name[DMLOG_MAX_FILE_PATH_LENGTH];   //!< File name on the host (source or destination)
 } dmlog_file_transfer_t;
 
+/* Flag bits of dmlog_file_transfer_t */
+#define DMLOG_FILE_TRANSFER_FLAG_BATCH       0x00000001  /* The chunks carry a stream of the files of a batch */
+#define DMLOG_FILE_TRANSFER_FLAG_COMPRESSED  0x00000002  /* Set by the host when it compressed the received chunk */
+
+/*
+ * A compressed chunk is a sequence of tokens, each one a byte:
+ * - 0x00-0x7F: (token + 1) literal bytes, which follow the token
+ * - 0x80-0xFF: copy of (token & 0x7F) + DMLOG_COMPRESSION_MIN_MATCH bytes
+ *   from the data already received, from a distance given by the next 2
+ *   bytes (little endian, 1..window_size). The copy may overlap itself.
+ *
+ * The window of the target spans chunks, so the host compresses every chunk
+ * with the window_size bytes of the file that precede it as the dictionary.
+ * The offset and the total size count the decoded bytes.
+ */
+#define DMLOG_COMPRESSION_MAX_LITERALS  0x80
+#define DMLOG_COMPRESSION_MIN_MATCH     4
+#define DMLOG_COMPRESSION_MAX_MATCH     (0x7F + DMLOG_COMPRESSION_MIN_MATCH)
+
+/**
+ * @brief Header of a file in the stream of a batch transfer
+ * 
+ * The files of a batch are streamed back to back in the order of the
+ * manifest, each one as a header followed by its data, so a chunk may hold
+ * the end of one file and the start of the next.
+ */
+typedef struct
+{
+    uint32_t size;      //!< Size of the file data following the header
+    int32_t  status;    //!< 0, or negative errno if the sender cannot read the file (the size is 0 then)
+} DMLOG_PACKED dmlog_file_batch_header_t;
+
+/**
+ * @brief File of a batch transfer (see dmlog_file_batch_send_start())
+ */
+typedef struct
+{
+    const char* src_file_path;      //!< Path to the source file
+    const char* dst_file_path;      //!< Path to the destination file (NULL - name of the source file in the destination directory)
+    int32_t     status;             //!< Set when the batch ends: 0 if the file was transferred, negative errno otherwise
+} dmlog_file_batch_entry_t;
+
 /**
  * @brief Ring buffer control structure
  * 
  * Contains:
- * - magic: Magic number for validation (0x444D4C4F = "DMLO")
- * - flags: Command/status flags (bit 0: clear buffer, bit 1: busy flag, bit 2: input available)
+ * - magic: Magic number for validation (DMLOG_MAGIC_NUMBER, 0x444D4C32 = "DML2")
+ * - flags: Status and request flags of the firmware (DMLOG_FLAG_*)
  * - head_offset: Offset to the write position in the output buffer
  * - tail_offset: Offset to the read position in the output buffer
  * - buffer_size: Total size of the output buffer in bytes
  * - buffer: Raw log data stored here
- * - input_head_offset: Offset to the write position in the input buffer (written by PC)
  * - input_tail_offset: Offset to the read position in the input buffer (read by firmware)
  * - input_buffer_size: Total size of the input buffer in bytes
  * - input_buffer: Raw input data from PC stored here
+ * - file_transfer: Address of the current dmlog_file_transfer_t (0 - none)
+ * - overhead: Address of the logging overhead table (0 - accounting disabled)
+ * - segments: Address of the dmlog_segment_t table of a segmented output ring
+ * - segment_count: Number of segments (0 - the output ring is contiguous at buffer)
+ * - tags: Address of the tag dictionary (0 - tag sets are logged as text)
+ * - host: Address of the dmlog_host_t written by the host
+ * - input_request: Number of input requests (DMLOG_FLAG_INPUT_REQUESTED)
+ * - file_request: Number of file transfer chunk requests (DMLOG_FLAG_FILE_SEND_REQ/RECV_REQ)
+ * - clear_count: Number of clear requests of the host carried out
+ * 
+ * The header is written only by the firmware, everything the host writes is
+ * in dmlog_host_t, on cache lines of its own (see dmlog_set_cache_ops()).
  * 
  * Buffer layout: Raw bytes are stored directly without entry headers.
  * Entries are delimited by newline characters ('\n').
@@ -107,20 +328,143 @@ typedef struct
     volatile dmlog_index_t      tail_offset;
     volatile dmlog_index_t      buffer_size;
     volatile uint64_t           buffer;
-    volatile dmlog_index_t      input_head_offset;
     volatile dmlog_index_t      input_tail_offset;
     volatile dmlog_index_t      input_buffer_size;
     volatile uint64_t           input_buffer;
     volatile uint64_t           file_transfer; /* dmlog_file_transfer_t structure address */
+    volatile uint64_t           overhead;      /* dmlog_overhead_t structure address */
+    volatile uint64_t           segments;      /* dmlog_segment_t array address */
+    volatile uint32_t           segment_count;
+    volatile uint64_t           tags;          /* dmlog_tag_dictionary_t structure address */
+    volatile uint64_t           host;          /* dmlog_host_t structure address */
+    volatile uint32_t           input_request;
+    volatile uint32_t           file_request;
+    volatile uint32_t           clear_count;
 } DMLOG_PACKED dmlog_ring_t;
 
+/**
+ * @brief Control block written by the host, read by the firmware
+ * 
+ * A request of the firmware is pending while its flag is set in the ring
+ * header and its counter there differs from the serviced counter here. The
+ * host services it by copying the counter, and the firmware clears the flag
+ * the next time it locks the context. The host clears the buffers by
+ * incrementing clear_request - the firmware copies it to clear_count once
+ * done.
+ * 
+ * With DMLOG_FLAG_FLOW_CONTROL set, the host publishes its read position in
+ * tail_offset, and the firmware waits for the host to read the ring when an
+ * entry does not fit, instead of discarding entries the host has not read.
+ * A host that does not read for DMLOG_FLOW_CONTROL_TIMEOUT is considered
+ * gone: the firmware sets DMLOG_FLAG_FLOW_CONTROL_LOST in the ring header
+ * and overwrites unread entries. It clears it once the host has dropped
+ * DMLOG_FLAG_FLOW_CONTROL, so the host can turn flow control on again.
+ */
+typedef struct
+{
+    volatile uint32_t           flags;              //!< DMLOG_FLAG_BUSY while the host holds the buffer
+    volatile dmlog_index_t      input_head_offset;  //!< Offset to the write position in the input buffer
+    volatile uint32_t           input_serviced;     //!< input_request of the ring header serviced last
+    volatile uint32_t           file_serviced;      //!< file_request of the ring header serviced last
+    volatile uint32_t           clear_request;      //!< Number of clear requests
+    volatile dmlog_index_t      tail_offset;        //!< Read position of the host in the output ring (DMLOG_FLAG_FLOW_CONTROL)
+} DMLOG_PACKED dmlog_host_t;
+
+/**
+ * @brief Memory region of a segmented ring (see dmlog_create_segmented())
+ */
+typedef struct
+{
+    void*           address;    //!< Start of the region
+    dmlog_index_t   size;       //!< Size of the region in bytes
+} dmlog_region_t;
+
+/**
+ * @brief Segment of a segmented output ring, read by the monitor
+ * 
+ * The segments are listed in ring order. Offset N of the output ring is at
+ * address + (N - offset) of the segment with offset <= N < offset + size.
+ */
+typedef struct
+{
+    volatile uint64_t       address;    //!< Address of the segment
+    volatile dmlog_index_t  offset;     //!< Offset of the segment in the output ring
+    volatile dmlog_index_t  size;       //!< Size of the segment in bytes
+} DMLOG_PACKED dmlog_segment_t;
+
+/**
+ * @brief Logging overhead of a single module
+ */
+typedef struct
+{
+    char                name[DMLOG_OVERHEAD_NAME_SIZE]; //!< Module name ('\0' terminated, truncated if too long)
+    volatile uint64_t   cycles;                         //!< Cycles spent in the write path
+    volatile uint64_t   bytes;                          //!< Bytes written to the ring buffer
+    volatile uint32_t   calls;                          //!< Write calls (dmlog_puts(), Dmod_Printf(), ...)
+    volatile uint32_t   flushes;                        //!< Writes to the ring buffer
+} DMLOG_PACKED dmlog_overhead_entry_t;
+
+/**
+ * @brief Logging overhead table, read by the monitor
+ * 
+ * Modules are added in the order they first log. When the table is full, the
+ * last entry is named "(other)" and collects every module that did not fit.
+ */
+typedef struct
+{
+    volatile uint32_t       cycles_per_second;          //!< Frequency of the cycle counter (0 - unknown)
+    volatile uint32_t       capacity;                   //!< Number of entries
+    volatile uint32_t       count;                      //!< Number of entries in use
+    volatile uint32_t       reserved;
+    dmlog_overhead_entry_t  entries[];
+} DMLOG_PACKED dmlog_overhead_t;
+
+/* Size of a logging overhead table for the given number of modules */
+#define DMLOG_OVERHEAD_TABLE_SIZE(modules)  (sizeof(dmlog_overhead_t) + (size_t)(modules) * sizeof(dmlog_overhead_entry_t))
+
+/**
+ * @brief Tag dictionary, read by the monitor
+ * 
+ * Every distinct combination of pushed tags (a tag set, e.g.
+ * "[net][conn 17] ") is stored once. Lines logged while the tags are pushed
+ * start with a DMLOG_RECORD_TAG_SET record holding the index of the set, and
+ * the monitor replaces it with the text. Sets are never removed or moved, so
+ * an index stays valid for as long as the dictionary is enabled.
+ */
+typedef struct
+{
+    volatile uint32_t       capacity;                   //!< Number of sets
+    volatile uint32_t       count;                      //!< Number of sets in use
+    char                    sets[][DMLOG_TAG_SET_SIZE]; //!< '\0' terminated tag sets
+} DMLOG_PACKED dmlog_tag_dictionary_t;
+
+/* Size of a tag dictionary for the given number of tag sets */
+#define DMLOG_TAG_DICTIONARY_SIZE(sets)     (sizeof(dmlog_tag_dictionary_t) + (size_t)(sets) * DMLOG_TAG_SET_SIZE)
+
 typedef struct dmlog_ctx* dmlog_ctx_t;
 
+/**
+ * @brief Handle of a file transfer started with dmlog_file_send_start(),
+ * dmlog_file_receive_start() or one of their batch variants
+ */
+typedef struct dmlog_transfer* dmlog_transfer_t;
+
+/**
+ * @brief State of a file transfer
+ */
+typedef enum
+{
+    DMLOG_TRANSFER_PENDING = 0,     //!< Waiting for the host
+    DMLOG_TRANSFER_DONE,            //!< The whole file was transferred
+    DMLOG_TRANSFER_FAILED,          //!< The transfer failed
+} dmlog_transfer_state_t;
+
 /* Output (firmware to PC) API */
 DMOD_BUILTIN_API(dmlog, 1.0, size_t,           _get_required_size, (dmlog_index_t buffer_size) );
 DMOD_BUILTIN_API(dmlog, 1.0, void,             _set_as_default,    (dmlog_ctx_t ctx) );
 DMOD_BUILTIN_API(dmlog, 1.0, dmlog_ctx_t,      _get_default,       (void) );
 DMOD_BUILTIN_API(dmlog, 1.0, dmlog_ctx_t,      _create,            (void* buffer, dmlog_index_t buffer_size) );
+DMOD_BUILTIN_API(dmlog, 1.0, dmlog_ctx_t,      _create_segmented,  (const dmlog_region_t* regions, size_t region_count) );
 DMOD_BUILTIN_API(dmlog, 1.0, void,             _destroy,           (dmlog_ctx_t ctx) );
 DMOD_BUILTIN_API(dmlog, 1.0, bool,             _is_valid,          (dmlog_ctx_t ctx) );
 DMOD_BUILTIN_API(dmlog, 1.0, dmlog_index_t,    _left_entry_space,  (dmlog_ctx_t ctx) );
@@ -146,5 +490,49 @@ DMOD_BUILTIN_API(dmlog, 1.0, void,             _input_request,     (dmlog_ctx_t
 /* File transfer API */
 DMOD_BUILTIN_API(dmlog, 1.0, bool,             _file_send,         (dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path) );
 DMOD_BUILTIN_API(dmlog, 1.0, bool,             _file_receive,      (dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path) );
+DMOD_BUILTIN_API(dmlog, 1.0, dmlog_transfer_t, _file_send_start,   (dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path) );
+DMOD_BUILTIN_API(dmlog, 1.0, dmlog_transfer_t, _file_receive_start, (dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path) );
+DMOD_BUILTIN_API(dmlog, 1.0, dmlog_transfer_state_t, _file_transfer_poll, (dmlog_transfer_t transfer) );
+DMOD_BUILTIN_API(dmlog, 1.0, bool,             _file_transfer_finish, (dmlog_transfer_t transfer) );
+DMOD_BUILTIN_API(dmlog, 1.0, dmlog_transfer_t, _file_batch_send_start, (dmlog_ctx_t ctx, dmlog_file_batch_entry_t* files, size_t count, const char* dst_dir_path) );
+DMOD_BUILTIN_API(dmlog, 1.0, dmlog_transfer_t, _file_batch_receive_start, (dmlog_ctx_t ctx, dmlog_file_batch_entry_t* files, size_t count, const char* dst_dir_path) );
+
+/* Binary record API */
+DMOD_BUILTIN_API(dmlog, 1.0, bool,             _put_address,       (dmlog_ctx_t ctx, uintptr_t address) );
+DMOD_BUILTIN_API(dmlog, 1.0, bool,             _put_backtrace,     (dmlog_ctx_t ctx, const uintptr_t* pcs, size_t count) );
+DMOD_BUILTIN_API(dmlog, 1.0, size_t,           _backtrace,         (dmlog_ctx_t ctx, size_t skip) );
+DMOD_BUILTIN_API(dmlog, 1.0, void,             _set_unwinder,      (dmlog_unwinder_t unwinder, void* user_data) );
+DMOD_BUILTIN_API(dmlog, 1.0, size_t,           _record_encode_value, (uint8_t* out, uint64_t value) );
+DMOD_BUILTIN_API(dmlog, 1.0, size_t,           _record_decode_value, (const uint8_t* in, size_t length, uint64_t* value) );
+
+/* Heap trace API */
+DMOD_BUILTIN_API(dmlog, 1.0, void,             _set_clock,         (dmlog_clock_t clock) );
+DMOD_BUILTIN_API(dmlog, 1.0, void,             _heap_trace_enable, (dmlog_ctx_t ctx) );
+DMOD_BUILTIN_API(dmlog, 1.0, void,             _heap_trace_disable, (void) );
+DMOD_BUILTIN_API(dmlog, 1.0, bool,             _heap_trace_alloc,  (void* ptr, size_t size, uintptr_t caller) );
+DMOD_BUILTIN_API(dmlog, 1.0, bool,             _heap_trace_free,   (void* ptr, uintptr_t caller) );
+
+/* Cache maintenance API */
+DMOD_BUILTIN_API(dmlog, 1.0, void,             _set_cache_ops,     (dmlog_cache_op_t clean, dmlog_cache_op_t invalidate) );
+
+/* Logging overhead API */
+DMOD_BUILTIN_API(dmlog, 1.0, size_t,           _overhead_get_required_size, (uint32_t modules) );
+DMOD_BUILTIN_API(dmlog, 1.0, bool,             _overhead_enable,   (dmlog_ctx_t ctx, void* buffer, size_t size, dmlog_cycle_counter_t counter, uint32_t cycles_per_second) );
+DMOD_BUILTIN_API(dmlog, 1.0, void,             _overhead_disable,  (void) );
+DMOD_BUILTIN_API(dmlog, 1.0, const char*,      _set_module,        (const char* module) );
+
+/* Context tag API */
+DMOD_BUILTIN_API(dmlog, 1.0, size_t,           _tags_get_required_size, (uint32_t sets) );
+DMOD_BUILTIN_API(dmlog, 1.0, bool,             _tags_enable,       (dmlog_ctx_t ctx, void* buffer, size_t size) );
+DMOD_BUILTIN_API(dmlog, 1.0, void,             _tags_disable,      (void) );
+DMOD_BUILTIN_API(dmlog, 1.0, bool,             _tag_push,          (const char* key, const char* value) );
+DMOD_BUILTIN_API(dmlog, 1.0, void,             _tag_pop,           (void) );
+DMOD_BUILTIN_API(dmlog, 1.0, void,             _tag_clear,         (void) );
+
+/* Records the address the current function returns to */
+#define DMLOG_PUT_CALLER(ctx)   dmlog_put_address((ctx), (uintptr_t)__builtin_return_address(0))
+
+/* Accounts the following logs to DMLOG_MODULE_NAME, returns the previous module */
+#define DMLOG_SET_MODULE()      dmlog_set_module(DMLOG_MODULE_NAME)
 
 #endif // DMLOG_H
\ No newline at end of file
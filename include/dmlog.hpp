@@ -0,0 +1,327 @@
+#ifndef DMLOG_HPP
+#define DMLOG_HPP
+
+#if !defined(__cpp_impl_coroutine)
+#   error "dmlog.hpp requires C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+extern "C"
+{
+#include "dmlog.h"
+}
+
+/*
+ * Awaitable input and file transfer for cooperative schedulers.
+ *
+ * A coroutine awaiting a request of the host is suspended instead of
+ * spinning, and is resumed by dmlog::poll() once the host serviced the
+ * request. Call dmlog::poll() from the idle loop of the thread that runs the
+ * coroutines - the awaitables are not thread safe.
+ *
+ *     task console(dmlog_ctx_t ctx)
+ *     {
+ *         for(;;)
+ *         {
+ *             dmlog::line command = co_await dmlog::read_line(ctx);
+ *             if(command.view() == "dump\n")
+ *             {
+ *                 bool sent = co_await dmlog::send_file(ctx, "/log/trace.bin", "trace.bin");
+ *                 ...
+ *             }
+ *         }
+ *     }
+ */
+namespace dmlog
+{
+
+inline std::size_t poll();
+
+/**
+ * @brief Coroutine suspended until a request is serviced by the host
+ *
+ * The waiter is a part of the awaitable, so it lives in the frame of the
+ * suspended coroutine and suspending does not allocate.
+ */
+class waiter
+{
+public:
+    waiter(const waiter&) = delete;
+    waiter& operator=(const waiter&) = delete;
+
+protected:
+    waiter() = default;
+
+    /**
+     * @brief Remove the waiter of a coroutine destroyed while suspended
+     */
+    ~waiter()
+    {
+        unlink();
+    }
+
+    /**
+     * @brief Suspend the coroutine until ready() returns true
+     *
+     * @param handle Handle of the suspended coroutine.
+     */
+    void suspend(std::coroutine_handle<> handle)
+    {
+        handle_ = handle;
+        next_ = nullptr;
+        *tail_ = this;
+        tail_ = &next_;
+        linked_ = true;
+    }
+
+    /**
+     * @brief Check whether the coroutine can be resumed
+     *
+     * Called by dmlog::poll() in the order the coroutines were suspended.
+     */
+    virtual bool ready() = 0;
+
+private:
+    friend std::size_t poll();
+
+    void unlink()
+    {
+        if(!linked_)
+        {
+            return;
+        }
+        for(waiter** link = &head_; *link != nullptr; link = &(*link)->next_)
+        {
+            if(*link == this)
+            {
+                *link = next_;
+                if(tail_ == &next_)
+                {
+                    tail_ = link;
+                }
+                break;
+            }
+        }
+        next_ = nullptr;
+        linked_ = false;
+    }
+
+    static inline waiter*  head_ = nullptr;
+    static inline waiter** tail_ = &head_;
+
+    waiter*                 next_ = nullptr;
+    bool                    linked_ = false;
+    std::coroutine_handle<> handle_;
+};
+
+/**
+ * @brief Resume the coroutines whose requests were serviced by the host
+ *
+ * Every resumed coroutine runs until it is suspended again. A coroutine that
+ * awaits again is checked within the same call.
+ *
+ * @return Number of resumed coroutines.
+ */
+inline std::size_t poll()
+{
+    std::size_t resumed = 0;
+    waiter* w = waiter::head_;
+    while(w != nullptr)
+    {
+        if(!w->ready())
+        {
+            w = w->next_;
+            continue;
+        }
+        w->unlink();
+        w->handle_.resume();
+        resumed++;
+
+        // The resumed coroutine may have destroyed other waiters
+        w = waiter::head_;
+    }
+    return resumed;
+}
+
+/**
+ * @brief Line of input read by dmlog::read_line()
+ */
+struct line
+{
+    char        text[DMOD_LOG_MAX_ENTRY_SIZE];  //!< '\0' terminated line (with the '\n' if it was received)
+    std::size_t length;                         //!< Length of the line
+
+    std::string_view view() const
+    {
+        return std::string_view(text, length);
+    }
+};
+
+/**
+ * @brief Awaitable reading a line of input
+ *
+ * Requests input from the host (see dmlog_input_request()) for as long as
+ * the coroutine waits. Coroutines waiting for input on the same context get
+ * the lines in the order they started waiting.
+ */
+class read_line : public waiter
+{
+public:
+    explicit read_line(dmlog_ctx_t ctx, dmlog_input_request_flags_t flags = DMLOG_INPUT_REQUEST_FLAG_LINE_MODE)
+        : ctx_(ctx)
+        , flags_(flags)
+    {
+    }
+
+    bool await_ready()
+    {
+        return dmlog_input_available(ctx_);
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        dmlog_input_request(ctx_, flags_);
+        suspend(handle);
+    }
+
+    line await_resume()
+    {
+        line result;
+        result.length = 0;
+        if(dmlog_input_gets(ctx_, result.text, sizeof(result.text)))
+        {
+            result.length = std::strlen(result.text);
+        }
+        else
+        {
+            result.text[0] = '\0';
+        }
+        return result;
+    }
+
+protected:
+    bool ready() override
+    {
+        if(dmlog_input_available(ctx_))
+        {
+            return true;
+        }
+        // The host clears the request when it sends a line, which may have
+        // been taken by another coroutine
+        dmlog_input_request(ctx_, flags_);
+        return false;
+    }
+
+private:
+    dmlog_ctx_t                 ctx_;
+    dmlog_input_request_flags_t flags_;
+};
+
+/**
+ * @brief Awaitable file transfer, resumed with true if the whole file was
+ * transferred
+ *
+ * The transfer starts when the awaitable is created. Transfers are serviced
+ * by the host one at a time, in the order they were started.
+ */
+class transfer : public waiter
+{
+public:
+    ~transfer()
+    {
+        // Cancels a transfer of a coroutine destroyed while suspended
+        dmlog_file_transfer_finish(transfer_);
+    }
+
+    bool await_ready()
+    {
+        return dmlog_file_transfer_poll(transfer_) != DMLOG_TRANSFER_PENDING;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        suspend(handle);
+    }
+
+    bool await_resume()
+    {
+        bool result = dmlog_file_transfer_finish(transfer_);
+        transfer_ = nullptr;
+        return result;
+    }
+
+protected:
+    explicit transfer(dmlog_transfer_t transfer)
+        : transfer_(transfer)
+    {
+    }
+
+    bool ready() override
+    {
+        return dmlog_file_transfer_poll(transfer_) != DMLOG_TRANSFER_PENDING;
+    }
+
+private:
+    dmlog_transfer_t transfer_;
+};
+
+/**
+ * @brief Awaitable sending a file from the target to the host
+ */
+class send_file : public transfer
+{
+public:
+    send_file(dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path)
+        : transfer(dmlog_file_send_start(ctx, src_file_path, dst_file_path))
+    {
+    }
+};
+
+/**
+ * @brief Awaitable receiving a file from the host to the target
+ */
+class receive_file : public transfer
+{
+public:
+    receive_file(dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path)
+        : transfer(dmlog_file_receive_start(ctx, src_file_path, dst_file_path))
+    {
+    }
+};
+
+/**
+ * @brief Awaitable sending a batch of files from the target to the host
+ *
+ * Resumed with true if every file was sent. The status of every file is set
+ * in the batch entries, which must outlive the awaitable.
+ */
+class send_files : public transfer
+{
+public:
+    send_files(dmlog_ctx_t ctx, dmlog_file_batch_entry_t* files, std::size_t count, const char* dst_dir_path = nullptr)
+        : transfer(dmlog_file_batch_send_start(ctx, files, count, dst_dir_path))
+    {
+    }
+};
+
+/**
+ * @brief Awaitable receiving a batch of files from the host to the target
+ *
+ * See dmlog::send_files.
+ */
+class receive_files : public transfer
+{
+public:
+    receive_files(dmlog_ctx_t ctx, dmlog_file_batch_entry_t* files, std::size_t count, const char* dst_dir_path = nullptr)
+        : transfer(dmlog_file_batch_receive_start(ctx, files, count, dst_dir_path))
+    {
+    }
+};
+
+} // namespace dmlog
+
+#endif // DMLOG_HPP
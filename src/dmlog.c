@@ -1,16 +1,37 @@
 #include "dmlog.h"
 #include "dmod.h"
 #include <string.h>
+#include <errno.h>
 
 #ifndef DMLOG_VERSION_STRING
 #   define DMLOG_VERSION_STRING "== dmlog ver. unknown ==\n"
 #endif
 
+/* Maximum size of a single stack frame accepted when following frame pointers */
+#ifndef DMLOG_BACKTRACE_MAX_FRAME_SIZE
+#   define DMLOG_BACKTRACE_MAX_FRAME_SIZE (64 * 1024)
+#endif
+
+/* The window wraps with a mask and its distances must fit the 2 byte field of a match */
+#if DMLOG_FILE_COMPRESSION_WINDOW > 32768 || (DMLOG_FILE_COMPRESSION_WINDOW & (DMLOG_FILE_COMPRESSION_WINDOW - 1)) != 0
+#   error "DMLOG_FILE_COMPRESSION_WINDOW must be a power of two, at most 32768"
+#endif
+
+/* Padding that moves the data after the ring header to the next cache line */
+#define DMLOG_RING_PADDING_SIZE (DMLOG_CACHE_LINE_SIZE - sizeof(dmlog_ring_t) % DMLOG_CACHE_LINE_SIZE)
+
+/* Padding that keeps the control block written by the host on cache lines of its own */
+#define DMLOG_HOST_PADDING_SIZE (DMLOG_CACHE_LINE_SIZE - sizeof(dmlog_host_t) % DMLOG_CACHE_LINE_SIZE)
+
 struct dmlog_ctx
 {
     dmlog_ring_t ring;
+    uint8_t ring_padding[DMLOG_RING_PADDING_SIZE];
+    dmlog_host_t host;
+    uint8_t host_padding[DMLOG_HOST_PADDING_SIZE];
     char write_buffer[DMOD_LOG_MAX_ENTRY_SIZE];
     dmlog_index_t write_entry_offset;
+    bool line_start;
     char read_buffer[DMOD_LOG_MAX_ENTRY_SIZE];
     dmlog_index_t read_entry_offset;
     char input_read_buffer[DMOD_LOG_MAX_ENTRY_SIZE];
@@ -25,6 +46,147 @@ static dmlog_ctx_t default_ctx = NULL;
 /* Global stdin flags for Dmod API stored in dmlog format */
 static dmlog_input_request_flags_t g_stdin_flags = DMLOG_INPUT_REQUEST_FLAG_LINE_MODE;
 
+/* Stack unwinder used by dmlog_backtrace() (NULL - follow frame pointers) */
+static dmlog_unwinder_t g_unwinder = NULL;
+static void* g_unwinder_user_data = NULL;
+
+/* Clock used to timestamp trace records (NULL - no timestamps) */
+static dmlog_clock_t g_clock = NULL;
+
+/* Context heap events are logged to (NULL - heap tracing disabled) */
+static dmlog_ctx_t g_heap_trace_ctx = NULL;
+static volatile bool g_heap_trace_busy = false;
+
+/* Data cache maintenance hooks (NULL - the ring is not cached) */
+static dmlog_cache_op_t g_cache_clean = NULL;
+static dmlog_cache_op_t g_cache_invalidate = NULL;
+
+/* Logging overhead accounting (NULL table - disabled) */
+static dmlog_ctx_t g_overhead_ctx = NULL;
+static dmlog_overhead_t* g_overhead = NULL;
+static dmlog_cycle_counter_t g_cycle_counter = NULL;
+static uint32_t g_overhead_depth = 0;
+
+/* Module the writes are accounted to and its cached table entry */
+static const char* g_module = DMLOG_MODULE_NAME;
+static dmlog_overhead_entry_t* g_module_entry = NULL;
+
+/**
+ * @brief Tags pushed with dmlog_tag_push()
+ */
+typedef struct
+{
+    char        text[DMLOG_TAG_SET_SIZE];       //!< Formatted tags followed by a space ("" - no tags)
+    uint16_t    ends[DMLOG_TAG_MAX_DEPTH];      //!< Length of the text up to the end of each tag
+    uint32_t    depth;                          //!< Number of pushed tags
+    uint32_t    generation;                     //!< g_tags_generation the index was looked up in (0 - not looked up)
+    int32_t     index;                          //!< Index of the set in the dictionary, -1 if it is not stored there
+} tag_stack_t;
+
+/* Tag dictionary (NULL table - tag sets are logged as text) */
+static dmlog_ctx_t g_tags_ctx = NULL;
+static dmlog_tag_dictionary_t* g_tags = NULL;
+static uint32_t g_tags_generation = 1;
+static DMLOG_TAG_STORAGE tag_stack_t g_tag_stack;
+
+/**
+ * @brief Write back the cached copy of a range shared with the debug probe.
+ * 
+ * @param address Start of the range.
+ * @param size Size of the range in bytes.
+ */
+static void cache_clean(volatile void* address, size_t size)
+{
+    if(g_cache_clean != NULL && size > 0)
+    {
+        g_cache_clean(address, size);
+    }
+}
+
+/**
+ * @brief Drop the cached copy of a range written by the debug probe.
+ * 
+ * @param address Start of the range.
+ * @param size Size of the range in bytes.
+ */
+static void cache_invalidate(volatile void* address, size_t size)
+{
+    if(g_cache_invalidate != NULL && size > 0)
+    {
+        g_cache_invalidate(address, size);
+    }
+}
+
+/**
+ * @brief Load the control block written by the monitor.
+ * 
+ * The firmware never writes the control block, so its cached copy is always
+ * clean and can be dropped at any time.
+ * 
+ * @param ctx DMLoG context.
+ */
+static void sync_host_block(dmlog_ctx_t ctx)
+{
+    cache_invalidate(&ctx->host, sizeof(ctx->host));
+}
+
+/**
+ * @brief Publish changes of the ring header to the monitor.
+ * 
+ * Only the lines of the ring header are written back - they are never
+ * written by the monitor.
+ * 
+ * @param ctx DMLoG context.
+ */
+static void publish_ring_header(dmlog_ctx_t ctx)
+{
+    cache_clean(&ctx->ring, sizeof(ctx->ring));
+}
+
+/**
+ * @brief Drop the cached copy of a range of a ring buffer, handling wrap-around.
+ * 
+ * @param buffer Start of the ring buffer.
+ * @param buffer_size Size of the ring buffer.
+ * @param offset Offset of the range in the ring buffer.
+ * @param length Length of the range.
+ */
+static void cache_invalidate_ring(uint8_t* buffer, dmlog_index_t buffer_size, dmlog_index_t offset, dmlog_index_t length)
+{
+    dmlog_index_t first = length < buffer_size - offset ? length : buffer_size - offset;
+    cache_invalidate(&buffer[offset], first);
+    cache_invalidate(buffer, length - first);
+}
+
+/**
+ * @brief Get the contiguous part of the output ring starting at an offset.
+ * 
+ * The output ring is either the buffer of the context or, for a segmented
+ * ring, the segments listed in the ring header.
+ * 
+ * @param ctx DMLoG context.
+ * @param offset Offset in the output ring.
+ * @param length Pointer to store the number of contiguous bytes from the offset.
+ * @return uint8_t* Address of the offset.
+ */
+static uint8_t* get_ring_span(dmlog_ctx_t ctx, dmlog_index_t offset, dmlog_index_t* length)
+{
+    uint32_t segment_count = ctx->ring.segment_count;
+    if(segment_count == 0)
+    {
+        *length = ctx->ring.buffer_size - offset;
+        return &ctx->buffer[offset];
+    }
+    const dmlog_segment_t* segments = (const dmlog_segment_t*)((uintptr_t)ctx->ring.segments);
+    uint32_t i = 0;
+    while(i + 1 < segment_count && offset - segments[i].offset >= segments[i].size)
+    {
+        i++;
+    }
+    *length = segments[i].size - (offset - segments[i].offset);
+    return (uint8_t*)((uintptr_t)segments[i].address) + (offset - segments[i].offset);
+}
+
 /**
  * @brief Lock the DMLoG context for exclusive access.
  * 
@@ -33,11 +195,31 @@ static dmlog_input_request_flags_t g_stdin_flags = DMLOG_INPUT_REQUEST_FLAG_LINE
 static void context_lock(dmlog_ctx_t ctx)
 {
     volatile uint32_t timeout = 10000;
-    while(ctx->lock_recursion == 0 && (ctx->ring.flags & DMLOG_FLAG_BUSY) && timeout > 0)
+    sync_host_block(ctx);
+    while(ctx->lock_recursion == 0 && (ctx->host.flags & DMLOG_FLAG_BUSY) && timeout > 0)
     {
         timeout--;
+        sync_host_block(ctx);
     }
     ctx->ring.flags |= DMLOG_FLAG_BUSY;
+    if(ctx->lock_recursion == 0)
+    {
+        // Retire the requests serviced by the monitor
+        if(ctx->host.input_serviced == ctx->ring.input_request)
+        {
+            ctx->ring.flags &= ~DMLOG_FLAG_INPUT_REQUESTED;
+        }
+        if(ctx->host.file_serviced == ctx->ring.file_request)
+        {
+            ctx->ring.flags &= ~(DMLOG_FLAG_FILE_SEND_REQ | DMLOG_FLAG_FILE_RECV_REQ);
+        }
+        // The host has seen that the flow control was lost
+        if((ctx->host.flags & DMLOG_FLAG_FLOW_CONTROL) == 0)
+        {
+            ctx->ring.flags &= ~DMLOG_FLAG_FLOW_CONTROL_LOST;
+        }
+        publish_ring_header(ctx);
+    }
     ctx->lock_recursion++;
 }
 
@@ -55,6 +237,7 @@ static void context_unlock(dmlog_ctx_t ctx)
     if(ctx->lock_recursion == 0)
     {
         ctx->ring.flags &= ~DMLOG_FLAG_BUSY;
+        publish_ring_header(ctx);
     }
 }
 
@@ -69,9 +252,11 @@ static void wait_for_unlock(dmlog_ctx_t ctx)
     {
         return; // Already locked by this context
     }
-    while(ctx->ring.flags & DMLOG_FLAG_BUSY)
+    sync_host_block(ctx);
+    while(ctx->host.flags & DMLOG_FLAG_BUSY)
     {
         // Busy wait
+        sync_host_block(ctx);
     }
 }
 
@@ -96,949 +281,2770 @@ static dmlog_index_t get_free_space(dmlog_ctx_t ctx)
 }
 
 /**
- * @brief Read a single byte from the tail of the ring buffer.
+ * @brief Get the overhead table entry of the current module, adding it if needed.
  * 
- * @param ctx DMLoG context.
- * @param out_byte Pointer to store the read byte.
- * @param out_offset Pointer to store the updated tail offset.
- * @return true if the buffer is empty, false otherwise.
+ * @return dmlog_overhead_entry_t* Entry of the current module.
  */
-static bool read_byte_from_tail(dmlog_ctx_t ctx, void* out_byte)
+static dmlog_overhead_entry_t* get_module_entry(void)
 {
-    bool empty = (ctx->ring.tail_offset == ctx->ring.head_offset);
-    if(!empty)
+    if(g_module_entry != NULL)
     {
-        if(out_byte != NULL)
+        return g_module_entry;
+    }
+    uint32_t count = g_overhead->count;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(strncmp(g_overhead->entries[i].name, g_module, DMLOG_OVERHEAD_NAME_SIZE - 1) == 0)
         {
-            *((uint8_t*)out_byte) = ctx->buffer[ctx->ring.tail_offset];
+            g_module_entry = &g_overhead->entries[i];
+            return g_module_entry;
         }
-        ctx->ring.tail_offset = (ctx->ring.tail_offset + 1) % ctx->ring.buffer_size;
     }
-    return empty;
+
+    // The last entry collects the modules that do not fit in the table
+    uint32_t capacity = g_overhead->capacity;
+    const char* name = count + 1 < capacity ? g_module : "(other)";
+    dmlog_overhead_entry_t* entry = &g_overhead->entries[count < capacity ? count : capacity - 1];
+    if(count < capacity)
+    {
+        strncpy(entry->name, name, DMLOG_OVERHEAD_NAME_SIZE - 1);
+        entry->name[DMLOG_OVERHEAD_NAME_SIZE - 1] = '\0';
+
+        // Publish the entry only after its name
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        g_overhead->count = count + 1;
+        cache_clean(entry, sizeof(*entry));
+        cache_clean(g_overhead, sizeof(dmlog_overhead_t));
+    }
+    g_module_entry = entry;
+    return entry;
 }
 
 /**
- * @brief Write a single byte to the head of the ring buffer.
+ * @brief Start measuring a write call.
  * 
- * @param ctx DMLoG context.
- * @param byte Byte to write.
- * @return true on success, false if the buffer is full.
+ * Only the outermost write call is measured, so the cycles of nested calls
+ * (dmlog_puts() calling dmlog_putc(), ...) are counted once.
+ * 
+ * @param ctx DMLoG context written to.
+ * @param start Pointer to store the cycle counter in.
+ * @return true if the call is accounted, false otherwise.
  */
-static bool write_byte_to_tail(dmlog_ctx_t ctx, uint8_t byte)
+static bool overhead_begin(dmlog_ctx_t ctx, uint32_t* start)
 {
-    dmlog_index_t next_head = (ctx->ring.head_offset + 1) % ctx->ring.buffer_size;
-    if(next_head == ctx->ring.tail_offset)
+    *start = 0;
+    if(g_overhead == NULL || ctx != g_overhead_ctx)
     {
-        // Buffer full
         return false;
     }
-    ctx->buffer[ctx->ring.head_offset] = byte;
-    ctx->ring.head_offset = next_head;
+    if(g_overhead_depth++ == 0 && g_cycle_counter != NULL)
+    {
+        *start = g_cycle_counter();
+    }
     return true;
 }
 
 /**
- * @brief Calculate the required size for a DMLoG context with the given buffer size.
+ * @brief Finish measuring a write call.
  * 
- * @param buffer_size Size of the log buffer in bytes.
- * @return size_t Required size for the DMLoG context.
+ * @param accounted Value returned by overhead_begin().
+ * @param start Cycle counter stored by overhead_begin().
  */
-size_t dmlog_get_required_size(dmlog_index_t buffer_size)
+static void overhead_end(bool accounted, uint32_t start)
 {
-    return sizeof(struct dmlog_ctx) + buffer_size - sizeof(((dmlog_ctx_t)0)->buffer);
+    if(!accounted || g_overhead_depth == 0 || --g_overhead_depth > 0 || g_overhead == NULL)
+    {
+        return;
+    }
+    dmlog_overhead_entry_t* entry = get_module_entry();
+    if(g_cycle_counter != NULL)
+    {
+        entry->cycles += (uint32_t)(g_cycle_counter() - start);
+    }
+    entry->calls++;
+    cache_clean(entry, sizeof(*entry));
 }
 
 /**
- * @brief Set the provided DMLoG context as the default context.
+ * @brief Account bytes written to the ring buffer to the current module.
  * 
- * @param ctx DMLoG context to set as default.
+ * @param ctx DMLoG context written to.
+ * @param length Number of bytes written.
  */
-void dmlog_set_as_default(dmlog_ctx_t ctx)
+static void overhead_add_bytes(dmlog_ctx_t ctx, dmlog_index_t length)
 {
-    Dmod_EnterCritical();
-    default_ctx = ctx;
-    Dmod_ExitCritical();
+    if(g_overhead == NULL || ctx != g_overhead_ctx || length == 0)
+    {
+        return;
+    }
+    dmlog_overhead_entry_t* entry = get_module_entry();
+    entry->bytes += length;
+    entry->flushes++;
+    cache_clean(entry, sizeof(*entry));
 }
 
-/**
- * @brief Get the current default DMLoG context.
+/*
+ * Internal unlocked layer.
  * 
- * @return dmlog_ctx_t Current default DMLoG context.
+ * The functions below assume a validated context that is locked by the
+ * caller (inside a critical section, see context_lock()). Every public call
+ * validates and locks the context once, and then works only through them.
  */
-dmlog_ctx_t dmlog_get_default(void)
-{
-    Dmod_EnterCritical();
-    dmlog_ctx_t ctx = default_ctx;
-    Dmod_ExitCritical();
-    return ctx;
-}
 
 /**
- * @brief Create and initialize a DMLoG context with the provided buffer.
+ * @brief Check the magic number of a context.
  * 
- * @param buffer Pointer to the memory buffer to use for the log ring.
- * @param buffer_size Size of the provided buffer in bytes.
- * @return dmlog_ctx_t Initialized DMLoG context, or NULL on failure.
+ * @param ctx DMLoG context.
+ * @return true if valid, false otherwise.
  */
-dmlog_ctx_t dmlog_create(void *buffer, dmlog_index_t buffer_size)
+static inline bool is_valid(dmlog_ctx_t ctx)
 {
-    if (buffer_size < sizeof(dmlog_ring_t))
-    {
-        DMOD_ASSERT_MSG(false, "Buffer size too small for dmlog_ring_t");
-        return NULL;
-    }
-    Dmod_EnterCritical();
-    dmlog_ctx_t ctx = buffer;
-    if(dmlog_is_valid(ctx))
-    {
-        DMOD_ASSERT_MSG(false, "DMLoG context already initialized");
-        return NULL;
-    }
-    memset(buffer, 0, buffer_size);
-    dmlog_index_t control_size  = (dmlog_index_t)((uintptr_t)ctx->buffer - (uintptr_t)ctx);
-    DMOD_ASSERT_MSG(buffer_size > control_size, "Buffer size too small for control structure");
-    
-    // Split buffer: use configurable input buffer size
-    dmlog_index_t total_buffer_size = buffer_size - control_size;
-#ifndef DMLOG_INPUT_BUFFER_SIZE
-#define DMLOG_INPUT_BUFFER_SIZE 512
-#endif
-    dmlog_index_t input_buffer_size = DMLOG_INPUT_BUFFER_SIZE;
-    if (input_buffer_size >= total_buffer_size) {
-        // Ensure we have at least some space for output
-        input_buffer_size = total_buffer_size / 5;  // Fallback to 20% if configured size is too large
-    }
-    dmlog_index_t output_buffer_size = total_buffer_size - input_buffer_size;
-    
-    ctx->ring.magic             = DMLOG_MAGIC_NUMBER;
-    ctx->ring.buffer_size       = output_buffer_size;
-    ctx->ring.buffer            = (uint64_t)((uintptr_t)ctx->buffer);
-    ctx->ring.head_offset       = 0;
-    ctx->ring.tail_offset       = 0;
-    ctx->ring.input_buffer_size = input_buffer_size;
-    ctx->ring.input_buffer      = (uint64_t)((uintptr_t)ctx->buffer + output_buffer_size);
-    ctx->ring.input_head_offset = 0;
-    ctx->ring.input_tail_offset = 0;
-    ctx->ring.flags             = 0;
-    ctx->write_entry_offset     = 0;
-    ctx->read_entry_offset      = 0;
-    ctx->input_read_entry_offset = 0;
-    ctx->lock_recursion         = 0;
-    Dmod_ExitCritical();
-
-    // Log dmlog version string (prepared at compile time)
-    dmlog_puts(ctx, DMLOG_VERSION_STRING);
-
-    return ctx;
+    return ctx != NULL && ctx->ring.magic == DMLOG_MAGIC_NUMBER;
 }
 
 /**
- * @brief Destroy the DMLoG context, invalidating the ring buffer.
+ * @brief Get the amount of space left in the current log entry.
  * 
- * @param ctx DMLoG context to destroy.
+ * @param ctx DMLoG context (validated and locked).
+ * @return dmlog_index_t Number of bytes left in the current entry.
  */
-void dmlog_destroy(dmlog_ctx_t ctx)
+static inline dmlog_index_t left_entry_space(dmlog_ctx_t ctx)
 {
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
-    {
-        context_lock(ctx);
-        dmlog_clear(ctx);
-        ctx->ring.magic = 0;
-        context_unlock(ctx);
-    }
-    Dmod_ExitCritical();
+    return DMOD_LOG_MAX_ENTRY_SIZE - ctx->write_entry_offset;
 }
 
 /**
- * @brief Check if the DMLoG context is valid.
+ * @brief Check whether the firmware waits for the host to read the output ring.
  * 
- * @param ctx DMLoG context to check.
- * @return true if valid, false otherwise.
+ * @param ctx DMLoG context (validated and locked).
+ * @return true if the host holds DMLOG_FLAG_FLOW_CONTROL and did not time out.
  */
-bool dmlog_is_valid(dmlog_ctx_t ctx)
+static inline bool is_flow_controlled(dmlog_ctx_t ctx)
 {
-    Dmod_EnterCritical();
-    bool result = ctx != NULL && ctx->ring.magic == DMLOG_MAGIC_NUMBER;
-    Dmod_ExitCritical();
-    return result;
+    return (ctx->host.flags & DMLOG_FLAG_FLOW_CONTROL) && !(ctx->ring.flags & DMLOG_FLAG_FLOW_CONTROL_LOST);
 }
 
 /**
- * @brief Get the amount of space left in the current log entry.
+ * @brief Wait until the host has read enough of the output ring for an entry.
  * 
- * @param ctx DMLoG context.
- * @return dmlog_index_t Number of bytes left in the current entry.
- */
-dmlog_index_t dmlog_left_entry_space(dmlog_ctx_t ctx)
-{
-    dmlog_index_t left_space = 0;
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
-    {
-        left_space = DMOD_LOG_MAX_ENTRY_SIZE - ctx->write_entry_offset;
-    }
-    Dmod_ExitCritical();
-    return left_space;
-}
-
-/**
- * @brief Add a single character to the log.
+ * Used while the host holds DMLOG_FLAG_FLOW_CONTROL. The ring is not busy
+ * while waiting, so the host can read it. The wait is bounded by
+ * DMLOG_FLOW_CONTROL_TIMEOUT, counted from the last read of the host - a host
+ * that is gone must not stop the logging calls.
  * 
- * @param ctx DMLoG context.
- * @param c Character to add.
- * @return true on success, false on failure.
+ * @param ctx DMLoG context (validated and locked).
+ * @param head Write position of the entry.
+ * @param length Length of the entry.
+ * @return dmlog_index_t Read position of the host, or the tail of the ring if the flow control ended.
  */
-bool dmlog_putc(dmlog_ctx_t ctx, char c)
+static dmlog_index_t wait_for_host_room(dmlog_ctx_t ctx, dmlog_index_t head, dmlog_index_t length)
 {
-    bool result = false;
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    dmlog_index_t buffer_size = ctx->ring.buffer_size;
+    dmlog_index_t capacity = buffer_size - 1;
+    dmlog_index_t tail = ctx->host.tail_offset;
+    uint64_t start = g_clock != NULL ? g_clock() : 0;
+    uint64_t polls = 0;
+    bool waiting = false;
+    while(is_flow_controlled(ctx) && tail < buffer_size)
     {
-        context_lock(ctx);
-        if(ctx->ring.flags & DMLOG_FLAG_CLEAR_BUFFER)
+        dmlog_index_t used = head >= tail ? head - tail : buffer_size - (tail - head);
+        if(used + length <= capacity)
         {
-            dmlog_clear(ctx);
-            ctx->ring.flags &= ~DMLOG_FLAG_CLEAR_BUFFER;
+            break;
         }
-        if(dmlog_left_entry_space(ctx) == 0)
+        uint64_t elapsed = g_clock != NULL ? g_clock() - start : polls;
+        if(elapsed >= DMLOG_FLOW_CONTROL_TIMEOUT)
         {
-            dmlog_flush(ctx);
+            ctx->ring.flags |= DMLOG_FLAG_FLOW_CONTROL_LOST;
+            break;
         }
-        if(dmlog_left_entry_space(ctx) > 0)
+        if(!waiting)
         {
-            ctx->write_buffer[ctx->write_entry_offset++] = c;
-            result = true;
+            waiting = true;
+            ctx->ring.flags &= ~DMLOG_FLAG_BUSY;
+            publish_ring_header(ctx);
         }
-        if(c == '\n')
+        sync_host_block(ctx);
+        polls++;
+        if(ctx->host.tail_offset != tail)
         {
-            result = dmlog_flush(ctx);
+            // The host reads - wait for it as long as it makes progress
+            tail = ctx->host.tail_offset;
+            start = g_clock != NULL ? g_clock() : 0;
+            polls = 0;
         }
-        context_unlock(ctx);
     }
-    Dmod_ExitCritical();
-    return result;
+    if(waiting || (ctx->ring.flags & DMLOG_FLAG_FLOW_CONTROL_LOST))
+    {
+        ctx->ring.flags |= DMLOG_FLAG_BUSY;
+        publish_ring_header(ctx);
+    }
+    return is_flow_controlled(ctx) && tail < buffer_size ? tail : ctx->ring.tail_offset;
 }
 
 /**
- * @brief Add a string to the log.
+ * @brief Copy an entry to the ring buffer.
  * 
- * @param ctx DMLoG context.
- * @param s String to add.
- * @return true on success, false on failure.
+ * @param ctx DMLoG context (validated and locked).
+ * @param data Data of the entry.
+ * @param length Length of the entry.
  */
-bool dmlog_puts(dmlog_ctx_t ctx, const char *s)
+static void write_entry(dmlog_ctx_t ctx, const uint8_t* data, dmlog_index_t length)
 {
-    bool result = false;
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    // Work on local copies - the header is shared with the monitor
+    dmlog_index_t buffer_size = ctx->ring.buffer_size;
+    dmlog_index_t head = ctx->ring.head_offset;
+    dmlog_index_t tail = ctx->ring.tail_offset;
+    dmlog_index_t capacity = buffer_size > 0 ? buffer_size - 1 : 0; // One byte distinguishes full/empty
+    if(length > capacity)
     {
-        context_lock(ctx);
-        size_t len = strlen(s);
-        result = true; // Initialize as success (empty string is valid)
-        for(size_t i = 0; i < len; i++)
-        {
-            if(!dmlog_putc(ctx, s[i]))
-            {
-                result = false; // Failed
-                break;
-            }
-        }
-        if(result && len > 0 && s[len - 1] != '\n')
+        // Only the end of the entry fits in the buffer
+        data += length - capacity;
+        length = capacity;
+    }
+    if(is_flow_controlled(ctx))
+    {
+        tail = wait_for_host_room(ctx, head, length);
+    }
+
+    // Discard the oldest bytes to make room for the entry
+    dmlog_index_t used = head >= tail ? head - tail : buffer_size - (tail - head);
+    if(used + length > capacity)
+    {
+        tail = (tail + (used + length - capacity)) % buffer_size;
+    }
+
+    dmlog_index_t offset = head;
+    for(dmlog_index_t left = length; left > 0; )
+    {
+        dmlog_index_t span;
+        uint8_t* destination = get_ring_span(ctx, offset, &span);
+        if(span > left)
         {
-            result = dmlog_flush(ctx);
+            span = left;
         }
-        context_unlock(ctx);
+        memcpy(destination, data, span);
+        cache_clean(destination, span);
+        data += span;
+        left -= span;
+        offset = (offset + span) % buffer_size;
     }
-    Dmod_ExitCritical();
-    return result;
+
+    // Publish the entry only after its data
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    ctx->ring.tail_offset = tail;
+    ctx->ring.head_offset = length > 0 ? (head + length) % buffer_size : head;
+    publish_ring_header(ctx);
+    overhead_add_bytes(ctx, length);
 }
 
 /**
- * @brief Add a string with specified length to the log.
+ * @brief Copy the current log entry to the ring buffer.
  * 
- * @param ctx DMLoG context.
- * @param s String to add.
- * @param n Maximum number of characters to add.
- * @return true on success, false on failure.
+ * @param ctx DMLoG context (validated and locked).
+ * @return true on success.
  */
-bool dmlog_putsn(dmlog_ctx_t ctx, const char *s, size_t n)
+static bool flush_entry(dmlog_ctx_t ctx)
 {
-    bool result = false;
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
-    {
-        for(size_t i = 0; i < n; i++)
-        {
-            if(s[i] == '\0')
-            {
-                break;
+    write_entry(ctx, (const uint8_t*)ctx->write_buffer, ctx->write_entry_offset);
+    ctx->write_entry_offset = 0;
+    return true;
+}
+
+/**
+ * @brief Clear the ring buffers and the entry buffers.
+ * 
+ * @param ctx DMLoG context (validated and locked).
+ */
+static void clear_buffers(dmlog_ctx_t ctx)
+{
+    ctx->ring.head_offset = 0;
+    ctx->ring.tail_offset = 0;
+    ctx->ring.input_tail_offset = ctx->host.input_head_offset;
+    ctx->write_entry_offset = 0;
+    ctx->read_entry_offset = 0;
+    ctx->input_read_entry_offset = 0;
+    memset(ctx->write_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
+    memset(ctx->read_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
+    memset(ctx->input_read_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
+    for(dmlog_index_t offset = 0; offset < ctx->ring.buffer_size; )
+    {
+        dmlog_index_t span;
+        uint8_t* data = get_ring_span(ctx, offset, &span);
+        memset(data, 0, span);
+        cache_clean(data, span);
+        offset += span;
+    }
+    // The pending input is dropped - the input buffer itself belongs to the monitor
+    ctx->ring.flags &= ~DMLOG_FLAG_INPUT_REQUESTED;
+}
+
+/**
+ * @brief Clear the buffers if the monitor requested it.
+ * 
+ * @param ctx DMLoG context (validated and locked).
+ */
+static void handle_clear_request(dmlog_ctx_t ctx)
+{
+    if(ctx->ring.clear_count != ctx->host.clear_request)
+    {
+        clear_buffers(ctx);
+        ctx->ring.clear_count = ctx->host.clear_request;
+    }
+}
+
+/**
+ * @brief Get the index of the current tag set in the dictionary, adding it if needed.
+ * 
+ * @param stack Tag stack.
+ * @return int32_t Index of the set, -1 if the dictionary is full.
+ */
+static int32_t get_tag_set_index(tag_stack_t* stack)
+{
+    if(stack->generation == g_tags_generation)
+    {
+        return stack->index;
+    }
+    uint32_t count = g_tags->count;
+    int32_t index = -1;
+    for(uint32_t i = 0; i < count && index < 0; i++)
+    {
+        if(strcmp(g_tags->sets[i], stack->text) == 0)
+        {
+            index = (int32_t)i;
+        }
+    }
+    if(index < 0 && count < g_tags->capacity)
+    {
+        strcpy(g_tags->sets[count], stack->text);
+        cache_clean(g_tags->sets[count], DMLOG_TAG_SET_SIZE);
+
+        // Publish the set only after its text
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        g_tags->count = count + 1;
+        cache_clean(g_tags, sizeof(dmlog_tag_dictionary_t));
+        index = (int32_t)count;
+    }
+    stack->index = index;
+    stack->generation = g_tags_generation;
+    return index;
+}
+
+/**
+ * @brief Start a line of the current entry with the pushed tags.
+ * 
+ * The tags are written as a tag set record when the context has a tag
+ * dictionary with room for the set, and as plain text otherwise.
+ * 
+ * @param ctx DMLoG context (locked).
+ */
+static void put_tag_set(dmlog_ctx_t ctx)
+{
+    tag_stack_t* stack = &g_tag_stack;
+    uint8_t record[2 + DMLOG_RECORD_MAX_VALUE_SIZE];
+    const void* data = stack->text;
+    size_t length = strlen(stack->text);
+    int32_t index = ctx == g_tags_ctx && g_tags != NULL ? get_tag_set_index(stack) : -1;
+    if(index >= 0)
+    {
+        length = 0;
+        record[length++] = DMLOG_RECORD_MARKER;
+        record[length++] = DMLOG_RECORD_TAG_SET;
+        length += dmlog_record_encode_value(&record[length], (uint64_t)index);
+        data = record;
+    }
+
+    // Keep the character that follows in the same entry
+    if(left_entry_space(ctx) < length + 1)
+    {
+        flush_entry(ctx);
+    }
+    if(left_entry_space(ctx) >= length + 1)
+    {
+        memcpy(&ctx->write_buffer[ctx->write_entry_offset], data, length);
+        ctx->write_entry_offset += length;
+    }
+}
+
+/**
+ * @brief Add characters to the current entry.
+ * 
+ * Copies the characters up to the end of every line at once, and flushes
+ * the entry at the end of the line or when it is full.
+ * 
+ * @param ctx DMLoG context (validated and locked).
+ * @param s Characters to add.
+ * @param length Number of characters.
+ * @return true on success, false on failure.
+ */
+static bool put_text(dmlog_ctx_t ctx, const char* s, size_t length)
+{
+    bool result = true;
+    while(length > 0 && result)
+    {
+        if(ctx->line_start && s[0] != '\n' && g_tag_stack.depth > 0)
+        {
+            put_tag_set(ctx);
+        }
+        const char* newline = memchr(s, '\n', length);
+        size_t span = newline != NULL ? (size_t)(newline - s) + 1 : length;
+        length -= span;
+        while(span > 0)
+        {
+            if(left_entry_space(ctx) == 0)
+            {
+                flush_entry(ctx);
+            }
+            size_t count = left_entry_space(ctx);
+            if(count > span)
+            {
+                count = span;
+            }
+            memcpy(&ctx->write_buffer[ctx->write_entry_offset], s, count);
+            ctx->write_entry_offset += count;
+            s += count;
+            span -= count;
+        }
+        ctx->line_start = newline != NULL;
+        if(newline != NULL)
+        {
+            result = flush_entry(ctx);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Read the next log entry from the ring buffer into the read buffer.
+ * 
+ * @param ctx DMLoG context (validated and locked).
+ * @return true if an entry was read, false if the ring is empty.
+ */
+static bool read_entry(dmlog_ctx_t ctx)
+{
+    dmlog_index_t buffer_size = ctx->ring.buffer_size;
+    dmlog_index_t head = ctx->ring.head_offset;
+    dmlog_index_t tail = ctx->ring.tail_offset;
+    dmlog_index_t length = 0;
+    bool end_of_entry = false;
+    while(!end_of_entry && tail != head && length < DMOD_LOG_MAX_ENTRY_SIZE - 1)
+    {
+        // Copy the contiguous part up to the head or the end of the buffer (or segment)
+        dmlog_index_t span;
+        const uint8_t* source = get_ring_span(ctx, tail, &span);
+        dmlog_index_t chunk = (head > tail ? head : buffer_size) - tail;
+        if(chunk > span)
+        {
+            chunk = span;
+        }
+        if(chunk > DMOD_LOG_MAX_ENTRY_SIZE - 1 - length)
+        {
+            chunk = DMOD_LOG_MAX_ENTRY_SIZE - 1 - length;
+        }
+        const uint8_t* newline = memchr(source, '\n', chunk);
+        if(newline != NULL)
+        {
+            // Stop reading at newline (end of entry), including it
+            chunk = (dmlog_index_t)(newline - source) + 1;
+            end_of_entry = true;
+        }
+        memcpy(&ctx->read_buffer[length], source, chunk);
+        length += chunk;
+        tail = (tail + chunk) % buffer_size;
+    }
+    ctx->read_buffer[length] = '\0';
+    ctx->ring.tail_offset = tail;
+    ctx->read_entry_offset = 0;
+    return length > 0;
+}
+
+/**
+ * @brief Calculate the required size for a DMLoG context with the given buffer size.
+ * 
+ * @param buffer_size Size of the log buffer in bytes.
+ * @return size_t Required size for the DMLoG context.
+ */
+size_t dmlog_get_required_size(dmlog_index_t buffer_size)
+{
+    return sizeof(struct dmlog_ctx) + buffer_size - sizeof(((dmlog_ctx_t)0)->buffer);
+}
+
+/**
+ * @brief Set the provided DMLoG context as the default context.
+ * 
+ * @param ctx DMLoG context to set as default.
+ */
+void dmlog_set_as_default(dmlog_ctx_t ctx)
+{
+    Dmod_EnterCritical();
+    default_ctx = ctx;
+    Dmod_ExitCritical();
+}
+
+/**
+ * @brief Get the current default DMLoG context.
+ * 
+ * @return dmlog_ctx_t Current default DMLoG context.
+ */
+dmlog_ctx_t dmlog_get_default(void)
+{
+    Dmod_EnterCritical();
+    dmlog_ctx_t ctx = default_ctx;
+    Dmod_ExitCritical();
+    return ctx;
+}
+
+/**
+ * @brief Initialize a DMLoG context in a buffer, optionally extending the
+ *        output ring with further memory regions.
+ * 
+ * @param buffer Pointer to the memory buffer holding the context.
+ * @param buffer_size Size of the provided buffer in bytes.
+ * @param regions Further regions of the output ring, or NULL.
+ * @param region_count Number of further regions.
+ * @return dmlog_ctx_t Initialized DMLoG context, or NULL on failure.
+ */
+static dmlog_ctx_t create_context(void *buffer, dmlog_index_t buffer_size, const dmlog_region_t* regions, size_t region_count)
+{
+    if (buffer_size < sizeof(dmlog_ring_t))
+    {
+        DMOD_ASSERT_MSG(false, "Buffer size too small for dmlog_ring_t");
+        return NULL;
+    }
+    Dmod_EnterCritical();
+    dmlog_ctx_t ctx = buffer;
+    if(is_valid(ctx))
+    {
+        DMOD_ASSERT_MSG(false, "DMLoG context already initialized");
+        Dmod_ExitCritical();
+        return NULL;
+    }
+    if(g_cache_clean != NULL && ((uintptr_t)buffer % DMLOG_CACHE_LINE_SIZE) != 0)
+    {
+        // The header and the host control block would share lines with other data
+        DMOD_ASSERT_MSG(false, "Buffer in cached memory must be aligned to DMLOG_CACHE_LINE_SIZE");
+        Dmod_ExitCritical();
+        return NULL;
+    }
+    memset(buffer, 0, buffer_size);
+    dmlog_index_t control_size  = (dmlog_index_t)((uintptr_t)ctx->buffer - (uintptr_t)ctx);
+    DMOD_ASSERT_MSG(buffer_size > control_size, "Buffer size too small for control structure");
+
+    // The segment table of a segmented ring is stored in front of the data
+    dmlog_segment_t* segments = (dmlog_segment_t*)ctx->buffer;
+    dmlog_index_t table_size = regions != NULL ? (dmlog_index_t)((region_count + 1) * sizeof(dmlog_segment_t)) : 0;
+    uint8_t* data = ctx->buffer + table_size;
+    if(buffer_size < control_size + table_size + 2)
+    {
+        DMOD_ASSERT_MSG(false, "Buffer size too small for the segment table");
+        Dmod_ExitCritical();
+        return NULL;
+    }
+    
+    // Split buffer: use configurable input buffer size
+    dmlog_index_t total_buffer_size = buffer_size - control_size - table_size;
+#ifndef DMLOG_INPUT_BUFFER_SIZE
+#define DMLOG_INPUT_BUFFER_SIZE 512
+#endif
+    dmlog_index_t input_buffer_size = DMLOG_INPUT_BUFFER_SIZE;
+    if (input_buffer_size >= total_buffer_size) {
+        // Ensure we have at least some space for output
+        input_buffer_size = total_buffer_size / 5;  // Fallback to 20% if configured size is too large
+    }
+    dmlog_index_t output_buffer_size = total_buffer_size - input_buffer_size;
+
+    // Start the input buffer (written by the monitor) on a cache line of its own
+    if(output_buffer_size > DMLOG_CACHE_LINE_SIZE)
+    {
+        output_buffer_size -= (dmlog_index_t)(((uintptr_t)data + output_buffer_size) % DMLOG_CACHE_LINE_SIZE);
+        input_buffer_size   = total_buffer_size - output_buffer_size;
+    }
+
+    // Stitch the rest of the first buffer and the further regions into one output ring
+    dmlog_index_t ring_size = output_buffer_size;
+    uint32_t segment_count = 0;
+    if(regions != NULL)
+    {
+        uint64_t offset = 0;
+        for(size_t i = 0; i <= region_count; i++)
+        {
+            uint8_t* address = i == 0 ? data : regions[i - 1].address;
+            dmlog_index_t size = i == 0 ? output_buffer_size : regions[i - 1].size;
+            if(address == NULL || size == 0)
+            {
+                continue;
+            }
+            if(offset + size > (dmlog_index_t)-1)
+            {
+                DMOD_ASSERT_MSG(false, "Segmented ring too large");
+                Dmod_ExitCritical();
+                return NULL;
+            }
+            segments[segment_count].address = (uint64_t)((uintptr_t)address);
+            segments[segment_count].offset  = (dmlog_index_t)offset;
+            segments[segment_count].size    = size;
+            segment_count++;
+            offset += size;
+            if(i > 0)
+            {
+                memset(address, 0, size);
+                cache_clean(address, size);
+            }
+        }
+        ring_size = (dmlog_index_t)offset;
+    }
+    
+    ctx->ring.magic             = DMLOG_MAGIC_NUMBER;
+    ctx->ring.buffer_size       = ring_size;
+    ctx->ring.buffer            = segment_count > 0 ? segments[0].address : (uint64_t)((uintptr_t)data);
+    ctx->ring.head_offset       = 0;
+    ctx->ring.tail_offset       = 0;
+    ctx->ring.input_buffer_size = input_buffer_size;
+    ctx->ring.input_buffer      = (uint64_t)((uintptr_t)data + output_buffer_size);
+    ctx->ring.input_tail_offset = 0;
+    ctx->ring.segments          = segment_count > 0 ? (uint64_t)((uintptr_t)segments) : 0;
+    ctx->ring.segment_count     = segment_count;
+    ctx->ring.flags             = 0;
+    ctx->ring.host              = (uint64_t)((uintptr_t)&ctx->host);
+    ctx->write_entry_offset     = 0;
+    ctx->line_start             = true;
+    ctx->read_entry_offset      = 0;
+    ctx->input_read_entry_offset = 0;
+    ctx->lock_recursion         = 0;
+    cache_clean(buffer, buffer_size);
+    Dmod_ExitCritical();
+
+    // Log dmlog version string (prepared at compile time)
+    dmlog_puts(ctx, DMLOG_VERSION_STRING);
+
+    return ctx;
+}
+
+/**
+ * @brief Create and initialize a DMLoG context with the provided buffer.
+ * 
+ * @param buffer Pointer to the memory buffer to use for the log ring.
+ * @param buffer_size Size of the provided buffer in bytes.
+ * @return dmlog_ctx_t Initialized DMLoG context, or NULL on failure.
+ */
+dmlog_ctx_t dmlog_create(void *buffer, dmlog_index_t buffer_size)
+{
+    return create_context(buffer, buffer_size, NULL, 0);
+}
+
+/**
+ * @brief Create a DMLoG context whose output ring spans several memory regions.
+ * 
+ * The first region holds the context, the segment table and the input
+ * buffer, and the rest of it is the first segment of the output ring. The
+ * further regions follow it in the ring in the given order. Entries are
+ * split between segments where needed, so the regions do not have to be
+ * contiguous (e.g. DTCM, SRAM banks and backup SRAM of one part).
+ * 
+ * @param regions Memory regions, the first one holds the context.
+ * @param region_count Number of regions.
+ * @return dmlog_ctx_t Initialized DMLoG context, or NULL on failure.
+ */
+dmlog_ctx_t dmlog_create_segmented(const dmlog_region_t* regions, size_t region_count)
+{
+    if(regions == NULL || region_count == 0 || regions[0].address == NULL)
+    {
+        return NULL;
+    }
+    return create_context(regions[0].address, regions[0].size, &regions[1], region_count - 1);
+}
+
+/**
+ * @brief Destroy the DMLoG context, invalidating the ring buffer.
+ * 
+ * @param ctx DMLoG context to destroy.
+ */
+void dmlog_destroy(dmlog_ctx_t ctx)
+{
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        clear_buffers(ctx);
+        ctx->ring.magic = 0;
+        context_unlock(ctx);
+    }
+    if(g_overhead_ctx == ctx)
+    {
+        g_overhead_ctx = NULL;
+        g_overhead = NULL;
+        g_module_entry = NULL;
+    }
+    if(g_tags_ctx == ctx)
+    {
+        g_tags_ctx = NULL;
+        g_tags = NULL;
+    }
+    Dmod_ExitCritical();
+}
+
+/**
+ * @brief Check if the DMLoG context is valid.
+ * 
+ * @param ctx DMLoG context to check.
+ * @return true if valid, false otherwise.
+ */
+bool dmlog_is_valid(dmlog_ctx_t ctx)
+{
+    Dmod_EnterCritical();
+    bool result = is_valid(ctx);
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Get the amount of space left in the current log entry.
+ * 
+ * @param ctx DMLoG context.
+ * @return dmlog_index_t Number of bytes left in the current entry.
+ */
+dmlog_index_t dmlog_left_entry_space(dmlog_ctx_t ctx)
+{
+    dmlog_index_t left_space = 0;
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        left_space = left_entry_space(ctx);
+    }
+    Dmod_ExitCritical();
+    return left_space;
+}
+
+/**
+ * @brief Add a single character to the log.
+ * 
+ * @param ctx DMLoG context.
+ * @param c Character to add.
+ * @return true on success, false on failure.
+ */
+bool dmlog_putc(dmlog_ctx_t ctx, char c)
+{
+    bool result = false;
+    uint32_t start;
+    Dmod_EnterCritical();
+    bool accounted = overhead_begin(ctx, &start);
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        handle_clear_request(ctx);
+        result = put_text(ctx, &c, 1);
+        context_unlock(ctx);
+    }
+    overhead_end(accounted, start);
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Add a string to the log.
+ * 
+ * @param ctx DMLoG context.
+ * @param s String to add.
+ * @return true on success, false on failure.
+ */
+bool dmlog_puts(dmlog_ctx_t ctx, const char *s)
+{
+    bool result = false;
+    uint32_t start;
+    Dmod_EnterCritical();
+    bool accounted = overhead_begin(ctx, &start);
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        handle_clear_request(ctx);
+        size_t len = strlen(s);
+        result = put_text(ctx, s, len); // An empty string is valid
+        if(result && len > 0 && s[len - 1] != '\n')
+        {
+            result = flush_entry(ctx);
+        }
+        context_unlock(ctx);
+    }
+    overhead_end(accounted, start);
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Add a string with specified length to the log.
+ * 
+ * @param ctx DMLoG context.
+ * @param s String to add.
+ * @param n Maximum number of characters to add.
+ * @return true on success, false on failure.
+ */
+bool dmlog_putsn(dmlog_ctx_t ctx, const char *s, size_t n)
+{
+    bool result = false;
+    uint32_t start;
+    Dmod_EnterCritical();
+    bool accounted = overhead_begin(ctx, &start);
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        handle_clear_request(ctx);
+        const char* end = memchr(s, '\0', n);
+        put_text(ctx, s, end != NULL ? (size_t)(end - s) : n);
+        result = flush_entry(ctx);
+        context_unlock(ctx);
+    }
+    overhead_end(accounted, start);
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Get the amount of free space in the log buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @return dmlog_index_t Number of free bytes in the log buffer.
+ */
+dmlog_index_t dmlog_get_free_space(dmlog_ctx_t ctx)
+{
+    dmlog_index_t free_space = 0;
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        sync_host_block(ctx);
+        free_space = get_free_space(ctx);
+    }
+    Dmod_ExitCritical();
+    return free_space;  
+}
+
+/**
+ * @brief Flush the current log entry to the ring buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @return true on success, false on failure.
+ */
+bool dmlog_flush(dmlog_ctx_t ctx)
+{
+    bool result = false;
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        result = flush_entry(ctx);
+        context_unlock(ctx);
+    }
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Read the next log entry from the ring buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @return true on success, false on failure.
+ */
+bool dmlog_read_next(dmlog_ctx_t ctx)
+{
+    bool result = false;
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        wait_for_unlock(ctx);
+        context_lock(ctx);
+        result = read_entry(ctx);
+        context_unlock(ctx);
+    }
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Get a reference to the current log entry buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @return const char* Pointer to the current log entry buffer.
+ */
+const char *dmlog_get_ref_buffer(dmlog_ctx_t ctx)
+{
+    const char* result = NULL;
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        result = ctx->read_buffer;
+    }
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Get a single character from the current log entry.
+ * 
+ * @param ctx DMLoG context.
+ * @return char The next character, or '\0' if none available.
+ */
+char dmlog_getc(dmlog_ctx_t ctx)
+{
+    char c = '\0';
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);  
+        if(ctx->read_entry_offset >= DMOD_LOG_MAX_ENTRY_SIZE || ctx->read_buffer[ctx->read_entry_offset] == '\0')
+        {
+            // Need to read next entry (leaves the buffer empty if there is none)
+            read_entry(ctx);
+        }
+        if(ctx->read_buffer[ctx->read_entry_offset] != '\0')
+        {
+            c = ctx->read_buffer[ctx->read_entry_offset++];
+        }
+        context_unlock(ctx);
+    }
+    Dmod_ExitCritical();
+    return c;
+}
+
+/**
+ * @brief Get a string from the current log entry.
+ * 
+ * @param ctx DMLoG context.
+ * @param s Buffer to store the string.
+ * @param max_len Maximum length of the buffer.
+ * @return true on success, false on failure.
+ */
+bool dmlog_gets(dmlog_ctx_t ctx, char *s, size_t max_len)
+{
+    bool result = false;
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        size_t i = 0;
+        size_t read_len = strlen(ctx->read_buffer);
+        
+        // Copy from read_buffer starting from current offset
+        while(i < max_len - 1 && ctx->read_entry_offset < read_len)
+        {
+            char c = ctx->read_buffer[ctx->read_entry_offset++];
+            s[i++] = c;
+            if(c == '\n')
+            {
+                break; // End of line
+            }
+        }
+        s[i] = '\0'; // Null-terminate
+        result = (i > 0);
+        context_unlock(ctx);
+    }
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Clear the entire log buffer.
+ * 
+ * @param ctx DMLoG context.
+ */
+void dmlog_clear(dmlog_ctx_t ctx)
+{
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        clear_buffers(ctx);
+        context_unlock(ctx);
+    }
+    Dmod_ExitCritical();
+}
+
+/**
+ * @brief Signal the monitor to exit.
+ * 
+ * @param ctx DMLoG context.
+ */
+void dmlog_exit_monitor(dmlog_ctx_t ctx)
+{
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        ctx->ring.flags |= DMLOG_FLAG_EXIT_REQUESTED;
+        context_unlock(ctx);
+    }
+    Dmod_ExitCritical();
+}
+
+/**
+ * @brief Get the amount of free space in the input ring buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @return dmlog_index_t Number of free bytes in the input ring buffer.
+ */
+static dmlog_index_t get_input_free_space(dmlog_ctx_t ctx)
+{
+    dmlog_index_t free_space = 0;
+    if(ctx->host.input_head_offset >= ctx->ring.input_tail_offset)
+    {
+        free_space = ctx->ring.input_buffer_size - (ctx->host.input_head_offset - ctx->ring.input_tail_offset);
+    }
+    else
+    {
+        free_space = ctx->ring.input_tail_offset - ctx->host.input_head_offset;
+    }
+    return free_space > 0 ? free_space - 1 : 0; // Leave one byte empty to distinguish full/empty
+}
+
+/**
+ * @brief Read a single byte from the input buffer tail.
+ * 
+ * @param ctx DMLoG context.
+ * @param out_byte Pointer to store the read byte.
+ * @return true if the buffer is empty, false otherwise.
+ */
+static bool read_byte_from_input_tail(dmlog_ctx_t ctx, void* out_byte)
+{
+    bool empty = (ctx->ring.input_tail_offset == ctx->host.input_head_offset);
+    if(!empty)
+    {
+        if(out_byte != NULL)
+        {
+            uint8_t* input_buffer = (uint8_t*)((uintptr_t)ctx->ring.input_buffer);
+            *((uint8_t*)out_byte) = input_buffer[ctx->ring.input_tail_offset];
+        }
+        ctx->ring.input_tail_offset = (ctx->ring.input_tail_offset + 1) % ctx->ring.input_buffer_size;
+    }
+    return empty;
+}
+
+/**
+ * @brief Check if input data is available.
+ * 
+ * @param ctx DMLoG context (validated, synchronized with the monitor).
+ * @return true if input data is available, false otherwise.
+ */
+static bool input_available(dmlog_ctx_t ctx)
+{
+    // Check both the ring buffer AND the internal read buffer
+    return (ctx->ring.input_tail_offset != ctx->host.input_head_offset) ||
+           (ctx->input_read_entry_offset < DMOD_LOG_MAX_ENTRY_SIZE && 
+            ctx->input_read_buffer[ctx->input_read_entry_offset] != '\0');
+}
+
+/**
+ * @brief Read a single character from the input buffer.
+ * 
+ * @param ctx DMLoG context (validated and locked).
+ * @return char The next character from input, or '\0' if none available.
+ */
+static char input_getc(dmlog_ctx_t ctx)
+{
+    char c = '\0';
+
+    // Check if we need to read the next entry
+    if(ctx->input_read_entry_offset >= DMOD_LOG_MAX_ENTRY_SIZE || 
+       ctx->input_read_buffer[ctx->input_read_entry_offset] == '\0')
+    {
+        // Clear input read buffer
+        memset(ctx->input_read_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
+
+        // Drop stale cached copies of the data written by the monitor
+        dmlog_index_t input_tail = ctx->ring.input_tail_offset;
+        dmlog_index_t input_head = ctx->host.input_head_offset;
+        dmlog_index_t input_size = ctx->ring.input_buffer_size;
+        cache_invalidate_ring((uint8_t*)((uintptr_t)ctx->ring.input_buffer), input_size, input_tail,
+                              input_head >= input_tail ? input_head - input_tail : input_size - (input_tail - input_head));
+
+        // Read next entry from input buffer
+        dmlog_index_t i = 0;
+        for(i = 0; i < DMOD_LOG_MAX_ENTRY_SIZE - 1; i++)
+        {
+            uint8_t byte;
+            if(read_byte_from_input_tail(ctx, &byte))
+            {
+                // Buffer empty
+                break;
+            }
+            ctx->input_read_buffer[i] = (char)byte;
+
+            // Stop reading at newline (end of entry)
+            if(byte == '\n')
+            {
+                i++; // Include the newline in the entry
+                break;
+            }
+        }
+
+        // Null-terminate the read buffer
+        if(i < DMOD_LOG_MAX_ENTRY_SIZE)
+        {
+            ctx->input_read_buffer[i] = '\0';
+        }
+
+        ctx->input_read_entry_offset = 0;
+    }
+
+    if(ctx->input_read_buffer[ctx->input_read_entry_offset] != '\0')
+    {
+        c = ctx->input_read_buffer[ctx->input_read_entry_offset++];
+    }
+    return c;
+}
+
+/**
+ * @brief Check if input data is available in the buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @return true if input data is available, false otherwise.
+ */
+bool dmlog_input_available(dmlog_ctx_t ctx)
+{
+    bool result = false;
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        sync_host_block(ctx);
+        result = input_available(ctx);
+    }
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Get the amount of free space in the input buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @return dmlog_index_t Number of free bytes in the input buffer.
+ */
+dmlog_index_t dmlog_input_get_free_space(dmlog_ctx_t ctx)
+{
+    dmlog_index_t free_space = 0;
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        sync_host_block(ctx);
+        free_space = get_input_free_space(ctx);
+    }
+    Dmod_ExitCritical();
+    return free_space;
+}
+
+/**
+ * @brief Read a single character from the input buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @return char The next character from input, or '\0' if none available.
+ */
+char dmlog_input_getc(dmlog_ctx_t ctx)
+{
+    char c = '\0';
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        c = input_getc(ctx);
+        context_unlock(ctx);
+    }
+    Dmod_ExitCritical();
+    return c;
+}
+
+/**
+ * @brief Read a line from the input buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @param s Buffer to store the string.
+ * @param max_len Maximum length of the buffer.
+ * @return true on success, false on failure.
+ */
+bool dmlog_input_gets(dmlog_ctx_t ctx, char *s, size_t max_len)
+{
+    bool result = false;
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        size_t i = 0;
+        
+        while(i < max_len - 1)
+        {
+            char c = input_getc(ctx);
+            if(c == '\0')
+            {
+                break; // No more data
+            }
+            s[i++] = c;
+            if(c == '\n')
+            {
+                break; // End of line
+            }
+        }
+        
+        s[i] = '\0'; // Null-terminate
+        result = (i > 0);
+        context_unlock(ctx);
+    }
+    Dmod_ExitCritical();
+    return result;
+}
+
+/**
+ * @brief Request input from the user (sets INPUT_REQUESTED flag).
+ * 
+ * This function sets a flag that the monitor can detect to prompt the user for input.
+ * 
+ * @param ctx DMLoG context.
+ * @param flags Input request flags (e.g., echo off, line mode).
+ */
+void dmlog_input_request(dmlog_ctx_t ctx, dmlog_input_request_flags_t flags)
+{
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
+    {
+        context_lock(ctx);
+        if((ctx->ring.flags & DMLOG_FLAG_INPUT_REQUESTED) == 0)
+        {
+            ctx->ring.input_request++;
+        }
+        ctx->ring.flags &= ~DMLOG_INPUT_REQUEST_MASK;
+        ctx->ring.flags |= DMLOG_FLAG_INPUT_REQUESTED | (flags & DMLOG_INPUT_REQUEST_MASK);
+        context_unlock(ctx);
+    }
+    Dmod_ExitCritical();
+}
+
+/**
+ * @brief State of a file transfer started by dmlog_file_send_start() or
+ * dmlog_file_receive_start().
+ * 
+ * The structure shared with the host is the first member, so the whole
+ * transfer is a single allocation. It cannot be on the stack due to x86
+ * (virtual memory access via gdb).
+ * 
+ * A batch streams its files through the chunks of a single transfer. The
+ * host paths are read by the host once, from the manifest.
+ * 
+ * A received file passes through the window, which keeps its last
+ * DMLOG_FILE_COMPRESSION_WINDOW bytes for the copies of compressed chunks.
+ */
+struct dmlog_transfer
+{
+    dmlog_file_transfer_t info;
+    dmlog_ctx_t ctx;
+    void* file;
+    void* buffer;
+    bool send;
+    bool requested;
+    dmlog_transfer_state_t state;
+    dmlog_file_batch_entry_t* files;    //!< Files of a batch (NULL - single file)
+    const char* dir_path;               //!< Destination directory of a received batch
+    int32_t* host_status;               //!< Per file status set by the host (followed by the manifest)
+    uint32_t file_index;                //!< File of a batch being streamed
+    uint32_t record_offset;             //!< Position in the header and data of that file
+    dmlog_file_batch_header_t header;   //!< Header of that file
+    uint8_t* window;                    //!< Last bytes of a received file (NULL - no compression)
+    uint32_t window_position;           //!< Bytes passed through the window
+    uint32_t window_flushed;            //!< Bytes of them written to the file
+};
+
+/**
+ * @brief Allocate a file transfer and its chunk buffer.
+ * 
+ * @param ctx DMLoG context.
+ * @param send true to send to the host, false to receive from it.
+ * @return dmlog_transfer_t New transfer, or NULL on failure.
+ */
+static dmlog_transfer_t allocate_transfer(dmlog_ctx_t ctx, bool send)
+{
+    dmlog_transfer_t transfer = Dmod_Malloc(sizeof(struct dmlog_transfer));
+    if(transfer == NULL)
+    {
+        DMOD_LOG_ERROR("Cannot allocate file transfer structure\n");
+        return NULL;
+    }
+    memset(transfer, 0, sizeof(*transfer));
+    transfer->ctx = ctx;
+    transfer->send = send;
+    transfer->state = DMLOG_TRANSFER_PENDING;
+    transfer->buffer = Dmod_Malloc(DMLOG_FILE_TRANSFER_CHUNK_SIZE);
+    if(transfer->buffer == NULL)
+    {
+        DMOD_LOG_ERROR("Cannot allocate file transfer buffer\n");
+        Dmod_Free(transfer);
+        return NULL;
+    }
+    transfer->info.buffer_address = (uint64_t)(uintptr_t)transfer->buffer;
+    transfer->info.chunk_size = DMLOG_FILE_TRANSFER_CHUNK_SIZE;
+    return transfer;
+}
+
+/**
+ * @brief Allocate a file transfer and open the file on the target.
+ * 
+ * @param ctx DMLoG context.
+ * @param host_file_name Path to the file on the host.
+ * @param file_path Path to the file on the target.
+ * @param send true to send the file to the host, false to receive it.
+ * @return dmlog_transfer_t New transfer, or NULL on failure.
+ */
+static dmlog_transfer_t create_transfer(dmlog_ctx_t ctx, const char* host_file_name, const char* file_path, bool send)
+{
+    if(strlen(host_file_name) >= DMLOG_MAX_FILE_PATH_LENGTH)
+    {
+        DMOD_LOG_ERROR("Host file path too long: %s\n", host_file_name);
+        return NULL;
+    }
+    dmlog_transfer_t transfer = allocate_transfer(ctx, send);
+    if(transfer == NULL)
+    {
+        return NULL;
+    }
+    strncpy(transfer->info.host_file_name, host_file_name, sizeof(transfer->info.host_file_name) - 1);
+
+    transfer->file = Dmod_FileOpen(file_path, send ? "rb" : "wb");
+    if(transfer->file == NULL)
+    {
+        DMOD_LOG_ERROR(send ? "Cannot open file: %s\n" : "Cannot open file for writing: %s\n", file_path);
+        Dmod_Free(transfer->buffer);
+        Dmod_Free(transfer);
+        return NULL;
+    }
+#if DMLOG_FILE_COMPRESSION_WINDOW > 0
+    // Without the window the file is received uncompressed
+    if(!send)
+    {
+        transfer->window = Dmod_Malloc(DMLOG_FILE_COMPRESSION_WINDOW);
+        transfer->info.window_size = (transfer->window != NULL) ? DMLOG_FILE_COMPRESSION_WINDOW : 0;
+    }
+#endif
+    return transfer;
+}
+
+/**
+ * @brief Get the destination path of a file of a batch.
+ * 
+ * @param path Buffer for the path (DMLOG_MAX_FILE_PATH_LENGTH bytes).
+ * @param file File of the batch.
+ * @param dir_path Destination directory for files without a destination path (may be NULL).
+ * @return true on success, false if there is no destination or it is too long.
+ */
+static bool get_batch_destination(char* path, const dmlog_file_batch_entry_t* file, const char* dir_path)
+{
+    if(file->dst_file_path != NULL)
+    {
+        if(strlen(file->dst_file_path) >= DMLOG_MAX_FILE_PATH_LENGTH)
+        {
+            return false;
+        }
+        strcpy(path, file->dst_file_path);
+        return true;
+    }
+    if(dir_path == NULL)
+    {
+        return false;
+    }
+    const char* name = strrchr(file->src_file_path, '/');
+    name = (name != NULL) ? name + 1 : file->src_file_path;
+    size_t dir_length = strlen(dir_path);
+    bool separator = dir_length > 0 && dir_path[dir_length - 1] != '/';
+    if(dir_length + separator + strlen(name) >= DMLOG_MAX_FILE_PATH_LENGTH)
+    {
+        return false;
+    }
+    strcpy(path, dir_path);
+    if(separator)
+    {
+        path[dir_length++] = '/';
+    }
+    strcpy(&path[dir_length], name);
+    return true;
+}
+
+/**
+ * @brief Allocate a batch transfer and its manifest.
+ * 
+ * The manifest lists the host path of every file, so the host reads all of
+ * them with the first chunk. The per file status set by the host is
+ * allocated together with it.
+ * 
+ * @param ctx DMLoG context.
+ * @param files Files of the batch.
+ * @param count Number of files.
+ * @param dir_path Destination directory for files without a destination path (may be NULL).
+ * @param send true to send the files to the host, false to receive them.
+ * @return dmlog_transfer_t New transfer, or NULL on failure.
+ */
+static dmlog_transfer_t create_batch(dmlog_ctx_t ctx, dmlog_file_batch_entry_t* files, size_t count, const char* dir_path, bool send)
+{
+    char path[DMLOG_MAX_FILE_PATH_LENGTH];
+    size_t manifest_size = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        if(files[i].src_file_path == NULL || !get_batch_destination(path, &files[i], dir_path))
+        {
+            DMOD_LOG_ERROR("Invalid destination of batch file %u\n", (unsigned)i);
+            return NULL;
+        }
+        const char* host_path = send ? path : files[i].src_file_path;
+        if(strlen(host_path) >= DMLOG_MAX_FILE_PATH_LENGTH)
+        {
+            DMOD_LOG_ERROR("Host file path too long: %s\n", host_path);
+            return NULL;
+        }
+        manifest_size += strlen(host_path) + 1;
+        files[i].status = 0;
+    }
+
+    dmlog_transfer_t transfer = allocate_transfer(ctx, send);
+    if(transfer == NULL)
+    {
+        return NULL;
+    }
+    transfer->host_status = Dmod_Malloc(count * sizeof(int32_t) + manifest_size);
+    if(transfer->host_status == NULL)
+    {
+        DMOD_LOG_ERROR("Cannot allocate file batch manifest\n");
+        Dmod_Free(transfer->buffer);
+        Dmod_Free(transfer);
+        return NULL;
+    }
+    memset(transfer->host_status, 0, count * sizeof(int32_t));
+    char* manifest = (char*)&transfer->host_status[count];
+    size_t offset = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        const char* host_path = files[i].src_file_path;
+        if(send)
+        {
+            get_batch_destination(path, &files[i], dir_path);
+            host_path = path;
+        }
+        size_t length = strlen(host_path) + 1;
+        memcpy(&manifest[offset], host_path, length);
+        offset += length;
+    }
+    cache_clean(transfer->host_status, count * sizeof(int32_t) + manifest_size);
+
+    transfer->files = files;
+    transfer->dir_path = dir_path;
+    transfer->info.flags = DMLOG_FILE_TRANSFER_FLAG_BATCH;
+    transfer->info.file_count = (uint32_t)count;
+    transfer->info.manifest_address = (uint64_t)(uintptr_t)manifest;
+    transfer->info.manifest_size = (uint32_t)manifest_size;
+    transfer->info.status_address = (uint64_t)(uintptr_t)transfer->host_status;
+    return transfer;
+}
+
+/**
+ * @brief Move to the next file of a batch.
+ * 
+ * @param transfer Batch transfer.
+ */
+static void next_batch_file(dmlog_transfer_t transfer)
+{
+    if(transfer->file != NULL)
+    {
+        Dmod_FileClose(transfer->file);
+        transfer->file = NULL;
+    }
+    transfer->file_index++;
+    transfer->record_offset = 0;
+}
+
+/**
+ * @brief Fill the chunk buffer with the next part of the stream of a sent batch.
+ * 
+ * @param transfer Batch transfer.
+ * @return uint32_t Number of bytes in the chunk.
+ */
+static uint32_t fill_batch_chunk(dmlog_transfer_t transfer)
+{
+    uint8_t* chunk = transfer->buffer;
+    uint32_t length = 0;
+    while(length < DMLOG_FILE_TRANSFER_CHUNK_SIZE && transfer->file_index < transfer->info.file_count)
+    {
+        dmlog_file_batch_entry_t* file = &transfer->files[transfer->file_index];
+        uint32_t space = DMLOG_FILE_TRANSFER_CHUNK_SIZE - length;
+        uint32_t count;
+        if(transfer->record_offset == 0)
+        {
+            transfer->file = Dmod_FileOpen(file->src_file_path, "rb");
+            transfer->header.size = (transfer->file != NULL) ? (uint32_t)Dmod_FileSize(transfer->file) : 0;
+            transfer->header.status = (transfer->file != NULL) ? 0 : -ENOENT;
+            if(transfer->file == NULL)
+            {
+                DMOD_LOG_ERROR("Cannot open file: %s\n", file->src_file_path);
+                file->status = -ENOENT;
             }
-            if(!dmlog_putc(ctx, s[i]))
+        }
+        if(transfer->record_offset < sizeof(dmlog_file_batch_header_t))
+        {
+            uint32_t left = sizeof(dmlog_file_batch_header_t) - transfer->record_offset;
+            count = (left < space) ? left : space;
+            memcpy(&chunk[length], (uint8_t*)&transfer->header + transfer->record_offset, count);
+        }
+        else
+        {
+            uint32_t left = sizeof(dmlog_file_batch_header_t) + transfer->header.size - transfer->record_offset;
+            count = (left < space) ? left : space;
+            uint32_t read_bytes = Dmod_FileRead(&chunk[length], 1, count, transfer->file);
+            if(read_bytes != count)
             {
-                break;
+                // The size is already sent, so the rest of the file is padded
+                if(file->status == 0)
+                {
+                    DMOD_LOG_ERROR("Cannot read file: %s\n", file->src_file_path);
+                    file->status = -EIO;
+                }
+                memset(&chunk[length + read_bytes], 0, count - read_bytes);
+            }
+        }
+        length += count;
+        transfer->record_offset += count;
+        if(transfer->record_offset == sizeof(dmlog_file_batch_header_t) + transfer->header.size)
+        {
+            next_batch_file(transfer);
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief Open the destination of a received file of a batch.
+ * 
+ * Called once the header of the file is received.
+ * 
+ * @param transfer Batch transfer.
+ */
+static void open_batch_file(dmlog_transfer_t transfer)
+{
+    dmlog_file_batch_entry_t* file = &transfer->files[transfer->file_index];
+    char path[DMLOG_MAX_FILE_PATH_LENGTH];
+    if(transfer->header.status != 0)
+    {
+        DMOD_LOG_ERROR("Cannot receive file %s - host reported error %d\n", file->src_file_path, (int)transfer->header.status);
+        file->status = transfer->header.status;
+        return;
+    }
+    get_batch_destination(path, file, transfer->dir_path);
+    transfer->file = Dmod_FileOpen(path, "wb");
+    if(transfer->file == NULL)
+    {
+        DMOD_LOG_ERROR("Cannot open file for writing: %s\n", path);
+        file->status = -EIO;
+    }
+}
+
+/**
+ * @brief Store the part of the stream of a received batch held by the chunk buffer.
+ * 
+ * @param transfer Batch transfer.
+ * @param length Number of bytes in the chunk.
+ */
+static void store_batch_chunk(dmlog_transfer_t transfer, uint32_t length)
+{
+    const uint8_t* chunk = transfer->buffer;
+    uint32_t position = 0;
+    while(position < length && transfer->file_index < transfer->info.file_count)
+    {
+        dmlog_file_batch_entry_t* file = &transfer->files[transfer->file_index];
+        uint32_t available = length - position;
+        uint32_t count;
+        if(transfer->record_offset < sizeof(dmlog_file_batch_header_t))
+        {
+            uint32_t left = sizeof(dmlog_file_batch_header_t) - transfer->record_offset;
+            count = (left < available) ? left : available;
+            memcpy((uint8_t*)&transfer->header + transfer->record_offset, &chunk[position], count);
+            if(count == left)
+            {
+                open_batch_file(transfer);
+            }
+        }
+        else
+        {
+            uint32_t left = sizeof(dmlog_file_batch_header_t) + transfer->header.size - transfer->record_offset;
+            count = (left < available) ? left : available;
+            if(transfer->file != NULL && Dmod_FileWrite(&chunk[position], 1, count, transfer->file) != count)
+            {
+                DMOD_LOG_ERROR("Cannot write data of batch file %s\n", file->src_file_path);
+                file->status = -EIO;
+                Dmod_FileClose(transfer->file);
+                transfer->file = NULL;
+            }
+        }
+        position += count;
+        transfer->record_offset += count;
+        bool header_done = transfer->record_offset >= sizeof(dmlog_file_batch_header_t);
+        if(header_done && transfer->record_offset == sizeof(dmlog_file_batch_header_t) + transfer->header.size)
+        {
+            next_batch_file(transfer);
+        }
+    }
+}
+
+/**
+ * @brief Release the ring for other transfers.
+ * 
+ * @param transfer File transfer.
+ */
+static void release_transfer(dmlog_transfer_t transfer)
+{
+    dmlog_ctx_t ctx = transfer->ctx;
+    Dmod_EnterCritical();
+    context_lock(ctx);
+    if(ctx->ring.file_transfer == (uint64_t)(uintptr_t)&transfer->info)
+    {
+        ctx->ring.file_transfer = 0;
+        ctx->ring.flags &= ~(DMLOG_FLAG_FILE_SEND_REQ | DMLOG_FLAG_FILE_RECV_REQ);
+    }
+    context_unlock(ctx);
+    Dmod_ExitCritical();
+    transfer->requested = false;
+}
+
+#if DMLOG_FILE_COMPRESSION_WINDOW > 0
+/**
+ * @brief Write the bytes of the window that are not in the file yet.
+ * 
+ * The window is flushed whenever it wraps, so the bytes are contiguous.
+ * 
+ * @param transfer Receive transfer with a window.
+ * @return true on success, false if the file cannot be written.
+ */
+static bool flush_window(dmlog_transfer_t transfer)
+{
+    uint32_t length = transfer->window_position - transfer->window_flushed;
+    uint8_t* data = &transfer->window[transfer->window_flushed % DMLOG_FILE_COMPRESSION_WINDOW];
+    transfer->window_flushed = transfer->window_position;
+    return length == 0 || Dmod_FileWrite(data, 1, length, transfer->file) == length;
+}
+
+/**
+ * @brief Put a received byte to the window.
+ * 
+ * @param transfer Receive transfer with a window.
+ * @param byte Received byte.
+ * @return true on success, false if the file cannot be written.
+ */
+static inline bool put_window_byte(dmlog_transfer_t transfer, uint8_t byte)
+{
+    transfer->window[transfer->window_position % DMLOG_FILE_COMPRESSION_WINDOW] = byte;
+    transfer->window_position++;
+    return (transfer->window_position % DMLOG_FILE_COMPRESSION_WINDOW) != 0 || flush_window(transfer);
+}
+
+/**
+ * @brief Write a received chunk to the file through the window.
+ * 
+ * Decodes the chunk if the host compressed it (see
+ * DMLOG_FILE_TRANSFER_FLAG_COMPRESSED).
+ * 
+ * @param transfer Receive transfer with a window.
+ * @param length Number of bytes of the file in the chunk, set on success.
+ * @return 0 on success, -EIO if the file cannot be written, -EPROTO if the chunk is invalid.
+ */
+static int decode_chunk(dmlog_transfer_t transfer, uint32_t* length)
+{
+    const dmlog_file_transfer_t* info = &transfer->info;
+    const uint8_t* data = transfer->buffer;
+    uint32_t start = transfer->window_position;
+    uint32_t i = 0;
+
+    while(i < info->chunk_size)
+    {
+        uint32_t count = info->chunk_size - i;
+        uint32_t distance = 0;
+        if((info->flags & DMLOG_FILE_TRANSFER_FLAG_COMPRESSED) != 0)
+        {
+            uint8_t token = data[i++];
+            if(token < DMLOG_COMPRESSION_MAX_LITERALS)
+            {
+                count = token + 1;
+            }
+            else if(i + 2 <= info->chunk_size)
+            {
+                count = (token & 0x7F) + DMLOG_COMPRESSION_MIN_MATCH;
+                distance = data[i] | ((uint32_t)data[i + 1] << 8);
+                i += 2;
+                if(distance == 0 || distance > DMLOG_FILE_COMPRESSION_WINDOW || distance > transfer->window_position)
+                {
+                    return -EPROTO;
+                }
+            }
+            else
+            {
+                return -EPROTO;
+            }
+        }
+        if(count > info->total_size - transfer->window_position || (distance == 0 && count > info->chunk_size - i))
+        {
+            return -EPROTO;
+        }
+        for(uint32_t n = 0; n < count; n++)
+        {
+            uint8_t byte = (distance != 0) ? transfer->window[(transfer->window_position - distance) % DMLOG_FILE_COMPRESSION_WINDOW] : data[i++];
+            if(!put_window_byte(transfer, byte))
+            {
+                return -EIO;
+            }
+        }
+    }
+    *length = transfer->window_position - start;
+    return flush_window(transfer) ? 0 : -EIO;
+}
+#endif
+
+/**
+ * @brief Handle a chunk serviced by the host.
+ * 
+ * @param transfer File transfer.
+ * @return dmlog_transfer_state_t DMLOG_TRANSFER_PENDING if there is more to transfer.
+ */
+static dmlog_transfer_state_t complete_chunk(dmlog_transfer_t transfer)
+{
+    dmlog_file_transfer_t* info = &transfer->info;
+    cache_invalidate(info, sizeof(*info));
+    if(info->status != 0)
+    {
+        DMOD_LOG_ERROR("Cannot %s file - host reported error %s\n", transfer->send ? "send" : "receive", strerror(info->status));
+        return DMLOG_TRANSFER_FAILED;
+    }
+    if(transfer->files != NULL)
+    {
+        if(!transfer->send)
+        {
+            if(info->chunk_size == 0 || info->chunk_size > DMLOG_FILE_TRANSFER_CHUNK_SIZE)
+            {
+                DMOD_LOG_ERROR("Cannot receive file batch - invalid chunk of %u bytes\n", (unsigned)info->chunk_size);
+                return DMLOG_TRANSFER_FAILED;
+            }
+            cache_invalidate(transfer->buffer, info->chunk_size);
+            store_batch_chunk(transfer, info->chunk_size);
+        }
+        info->offset += info->chunk_size;
+        return DMLOG_TRANSFER_PENDING;
+    }
+    if(!transfer->send)
+    {
+        if(info->chunk_size == 0 || info->total_size == 0)
+        {
+            DMOD_LOG_WARN("Empty file received: %s\n", info->host_file_name);
+            return DMLOG_TRANSFER_DONE;
+        }
+        if(info->chunk_size > DMLOG_FILE_TRANSFER_CHUNK_SIZE)
+        {
+            DMOD_LOG_ERROR("Cannot receive file - invalid chunk of %u bytes\n", (unsigned)info->chunk_size);
+            return DMLOG_TRANSFER_FAILED;
+        }
+        cache_invalidate(transfer->buffer, info->chunk_size);
+#if DMLOG_FILE_COMPRESSION_WINDOW > 0
+        if(transfer->window != NULL)
+        {
+            uint32_t length = 0;
+            int error = decode_chunk(transfer, &length);
+            if(error != 0)
+            {
+                DMOD_LOG_ERROR("Cannot receive file - %s of %s\n", error == -EIO ? "cannot write data" : "invalid compressed chunk", info->host_file_name);
+                return DMLOG_TRANSFER_FAILED;
             }
+            info->offset += length;
+            return DMLOG_TRANSFER_PENDING;
+        }
+#endif
+        size_t written_bytes = Dmod_FileWrite(transfer->buffer, 1, info->chunk_size, transfer->file);
+        if(written_bytes != info->chunk_size)
+        {
+            DMOD_LOG_ERROR("Cannot receive file - cannot write data of %s\n", info->host_file_name);
+            return DMLOG_TRANSFER_FAILED;
+        }
+    }
+    info->offset += info->chunk_size;
+    return DMLOG_TRANSFER_PENDING;
+}
+
+/**
+ * @brief Take the ring for a file transfer.
+ * 
+ * Only one transfer at a time can be serviced by the host. The ring is kept
+ * by the transfer until it ends.
+ * 
+ * @param transfer File transfer.
+ * @return true if the ring is taken by the transfer, false if it is used by another one.
+ */
+static bool acquire_transfer(dmlog_transfer_t transfer)
+{
+    dmlog_ctx_t ctx = transfer->ctx;
+    uint64_t address = (uint64_t)(uintptr_t)&transfer->info;
+    bool acquired = false;
+    Dmod_EnterCritical();
+    context_lock(ctx);
+    if(ctx->ring.file_transfer == 0 || ctx->ring.file_transfer == address)
+    {
+        ctx->ring.file_transfer = address;
+        acquired = true;
+    }
+    context_unlock(ctx);
+    Dmod_ExitCritical();
+    return acquired;
+}
+
+/**
+ * @brief Prepare the next chunk and request the host to service it.
+ * 
+ * @param transfer File transfer.
+ * @return dmlog_transfer_state_t DMLOG_TRANSFER_PENDING if the chunk is requested or waits for the ring.
+ */
+static dmlog_transfer_state_t request_chunk(dmlog_transfer_t transfer)
+{
+    dmlog_ctx_t ctx = transfer->ctx;
+    dmlog_file_transfer_t* info = &transfer->info;
+
+    if(transfer->files != NULL)
+    {
+        if(transfer->file_index >= info->file_count)
+        {
+            return DMLOG_TRANSFER_DONE;
+        }
+    }
+    // The host sets the total size of a received file with the first chunk
+    else if(info->offset >= info->total_size && (transfer->send || info->total_size != 0))
+    {
+        return DMLOG_TRANSFER_DONE;
+    }
+    if(!acquire_transfer(transfer))
+    {
+        return DMLOG_TRANSFER_PENDING;
+    }
+
+    if(transfer->send && transfer->files != NULL)
+    {
+        info->chunk_size = fill_batch_chunk(transfer);
+        cache_clean(transfer->buffer, info->chunk_size);
+    }
+    else if(transfer->send)
+    {
+        uint32_t left_bytes = info->total_size - info->offset;
+        info->chunk_size = (left_bytes < DMLOG_FILE_TRANSFER_CHUNK_SIZE) ? left_bytes : DMLOG_FILE_TRANSFER_CHUNK_SIZE;
+        uint32_t read_bytes = Dmod_FileRead(transfer->buffer, 1, info->chunk_size, transfer->file);
+        if(read_bytes != info->chunk_size)
+        {
+            DMOD_LOG_ERROR("Cannot read file sent to: %s\n", info->host_file_name);
+            return DMLOG_TRANSFER_FAILED;
+        }
+        cache_clean(transfer->buffer, info->chunk_size);
+    }
+    else
+    {
+        info->chunk_size = DMLOG_FILE_TRANSFER_CHUNK_SIZE;
+        info->flags &= ~DMLOG_FILE_TRANSFER_FLAG_COMPRESSED;
+    }
+    cache_clean(info, sizeof(*info));
+
+    Dmod_EnterCritical();
+    context_lock(ctx);
+    ctx->ring.file_request++;
+    ctx->ring.flags |= transfer->send ? DMLOG_FLAG_FILE_SEND_REQ : DMLOG_FLAG_FILE_RECV_REQ;
+    context_unlock(ctx);
+    Dmod_ExitCritical();
+    transfer->requested = true;
+    return DMLOG_TRANSFER_PENDING;
+}
+
+/**
+ * @brief Start sending a file from the target to the host.
+ * 
+ * The transfer does not block - it advances every time
+ * dmlog_file_transfer_poll() is called, and must be released with
+ * dmlog_file_transfer_finish().
+ * 
+ * @param ctx DMLoG context.
+ * @param src_file_path Path to the source file on the target.
+ * @param dst_file_path Path to the destination file on the host.
+ * @return dmlog_transfer_t Transfer handle, or NULL on failure.
+ */
+dmlog_transfer_t dmlog_file_send_start(dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path)
+{
+    if(!dmlog_is_valid(ctx) || src_file_path == NULL || dst_file_path == NULL)
+    {
+        DMOD_LOG_ERROR("Invalid parameters for dmlog_file_send\n");
+        return NULL;
+    }
+    dmlog_transfer_t transfer = create_transfer(ctx, dst_file_path, src_file_path, true);
+    if(transfer != NULL)
+    {
+        DMOD_LOG_INFO("transfer struct addr: %p\n", (void*)&transfer->info);
+        transfer->info.total_size = Dmod_FileSize(transfer->file);
+    }
+    return transfer;
+}
+
+/**
+ * @brief Start receiving a file from the host to the target.
+ * 
+ * The transfer does not block - it advances every time
+ * dmlog_file_transfer_poll() is called, and must be released with
+ * dmlog_file_transfer_finish().
+ * 
+ * @param ctx DMLoG context.
+ * @param src_file_path Path to the source file on the host.
+ * @param dst_file_path Path to the destination file on the target.
+ * @return dmlog_transfer_t Transfer handle, or NULL on failure.
+ */
+dmlog_transfer_t dmlog_file_receive_start(dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path)
+{
+    if(!dmlog_is_valid(ctx) || src_file_path == NULL || dst_file_path == NULL)
+    {
+        DMOD_LOG_ERROR("Invalid parameters for dmlog_file_receive\n");
+        return NULL;
+    }
+    // The total size is set by the host
+    return create_transfer(ctx, src_file_path, dst_file_path, false);
+}
+
+/**
+ * @brief Advance a file transfer without blocking.
+ * 
+ * Checks whether the host serviced the requested chunk, and if so requests
+ * the next one. Call it until it returns something else than
+ * DMLOG_TRANSFER_PENDING.
+ * 
+ * @param transfer Transfer handle.
+ * @return dmlog_transfer_state_t State of the transfer.
+ */
+dmlog_transfer_state_t dmlog_file_transfer_poll(dmlog_transfer_t transfer)
+{
+    if(transfer == NULL)
+    {
+        return DMLOG_TRANSFER_FAILED;
+    }
+    if(transfer->state != DMLOG_TRANSFER_PENDING)
+    {
+        return transfer->state;
+    }
+
+    dmlog_ctx_t ctx = transfer->ctx;
+    Dmod_EnterCritical();
+    sync_host_block(ctx);
+    bool serviced = transfer->requested && ctx->host.file_serviced == ctx->ring.file_request;
+    Dmod_ExitCritical();
+
+    if(serviced)
+    {
+        transfer->requested = false;
+        transfer->state = complete_chunk(transfer);
+    }
+    if(transfer->state == DMLOG_TRANSFER_PENDING && !transfer->requested)
+    {
+        transfer->state = request_chunk(transfer);
+    }
+    if(transfer->state != DMLOG_TRANSFER_PENDING)
+    {
+        release_transfer(transfer);
+    }
+    return transfer->state;
+}
+
+/**
+ * @brief Set the status of every file of a batch.
+ * 
+ * Files the host failed to handle get the error it reported, files the
+ * stream did not reach get -ECANCELED.
+ * 
+ * @param transfer Batch transfer.
+ * @return true if every file was transferred, false otherwise.
+ */
+static bool finish_batch(dmlog_transfer_t transfer)
+{
+    bool result = true;
+    uint32_t count = transfer->info.file_count;
+    cache_invalidate(transfer->host_status, count * sizeof(int32_t));
+    for(uint32_t i = 0; i < count; i++)
+    {
+        dmlog_file_batch_entry_t* file = &transfer->files[i];
+        if(file->status == 0 && transfer->host_status[i] != 0)
+        {
+            file->status = transfer->host_status[i];
+        }
+        if(file->status == 0 && i >= transfer->file_index)
+        {
+            file->status = -ECANCELED;
         }
-        result = dmlog_flush(ctx);
+        result = result && file->status == 0;
     }
-    Dmod_ExitCritical();
+    Dmod_Free(transfer->host_status);
     return result;
 }
 
 /**
- * @brief Get the amount of free space in the log buffer.
+ * @brief Release a file transfer.
+ * 
+ * A transfer that is still pending is cancelled.
+ * 
+ * @param transfer Transfer handle (NULL is allowed).
+ * @return true if the whole file was transferred, false otherwise.
+ */
+bool dmlog_file_transfer_finish(dmlog_transfer_t transfer)
+{
+    if(transfer == NULL)
+    {
+        return false;
+    }
+    release_transfer(transfer);
+    bool result = transfer->state == DMLOG_TRANSFER_DONE;
+
+    if(transfer->files != NULL)
+    {
+        result = finish_batch(transfer) && result;
+    }
+    if(transfer->file != NULL)
+    {
+        Dmod_FileClose(transfer->file);
+    }
+    if(transfer->window != NULL)
+    {
+        Dmod_Free(transfer->window);
+    }
+    Dmod_Free(transfer->buffer);
+    Dmod_Free(transfer);
+    return result;
+}
+
+/**
+ * @brief Send a file from the target to the host.
  * 
  * @param ctx DMLoG context.
- * @return dmlog_index_t Number of free bytes in the log buffer.
+ * @param src_file_path Path to the source file on the target.
+ * @param dst_file_path Path to the destination file on the host.
+ * @return true on success, false on failure.
  */
-dmlog_index_t dmlog_get_free_space(dmlog_ctx_t ctx)
+bool dmlog_file_send(dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path)
 {
-    dmlog_index_t free_space = 0;
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    dmlog_transfer_t transfer = dmlog_file_send_start(ctx, src_file_path, dst_file_path);
+
+    // TODO: Add timeout mechanism - currently it is not possible
+    // due to gdb synchronization issues.
+    while(dmlog_file_transfer_poll(transfer) == DMLOG_TRANSFER_PENDING)
     {
-        free_space = get_free_space(ctx);
     }
-    Dmod_ExitCritical();
-    return free_space;  
+    return dmlog_file_transfer_finish(transfer);
 }
 
 /**
- * @brief Flush the current log entry to the ring buffer.
+ * @brief Receive a file from the host to the target.
  * 
  * @param ctx DMLoG context.
+ * @param src_file_path Path to the source file on the host.
+ * @param dst_file_path Path to the destination file on the target.
  * @return true on success, false on failure.
  */
-bool dmlog_flush(dmlog_ctx_t ctx)
+bool dmlog_file_receive(dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path)
 {
-    bool result = false;
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    dmlog_transfer_t transfer = dmlog_file_receive_start(ctx, src_file_path, dst_file_path);
+
+    // TODO: Add timeout mechanism - currently it is not possible due to gdb synchronization issues.
+    while(dmlog_file_transfer_poll(transfer) == DMLOG_TRANSFER_PENDING)
     {
-        context_lock(ctx);
-        result = true; // Initialize as success
-        for(dmlog_index_t i = 0; i < ctx->write_entry_offset; i++)
-        {
-            if(get_free_space(ctx) == 0)
-            {
-                read_byte_from_tail(ctx, NULL); // Discard oldest byte
-            }
-            if(!write_byte_to_tail(ctx, (uint8_t)ctx->write_buffer[i]))
-            {
-                result = false; // Buffer full
-                break;
-            }
-        }
-        memset(ctx->write_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
-        ctx->write_entry_offset = 0;
+    }
+    return dmlog_file_transfer_finish(transfer);
+}
 
-        context_unlock(ctx);
+/**
+ * @brief Start sending a batch of files from the target to the host.
+ * 
+ * The files are streamed back to back through the chunks of a single
+ * transfer, so small files do not cost a transfer each. The transfer
+ * advances with dmlog_file_transfer_poll() and is released with
+ * dmlog_file_transfer_finish(), which sets the status of every file. The
+ * files must stay valid until then.
+ * 
+ * @param ctx DMLoG context.
+ * @param files Files to send (source paths on the target, destination paths on the host).
+ * @param count Number of files.
+ * @param dst_dir_path Directory on the host for files without a destination path (may be NULL).
+ * @return dmlog_transfer_t Transfer handle, or NULL on failure.
+ */
+dmlog_transfer_t dmlog_file_batch_send_start(dmlog_ctx_t ctx, dmlog_file_batch_entry_t* files, size_t count, const char* dst_dir_path)
+{
+    if(!dmlog_is_valid(ctx) || files == NULL || count == 0)
+    {
+        DMOD_LOG_ERROR("Invalid parameters for dmlog_file_batch_send_start\n");
+        return NULL;
     }
-    Dmod_ExitCritical();
-    return result;
+    return create_batch(ctx, files, count, dst_dir_path, true);
 }
 
 /**
- * @brief Read the next log entry from the ring buffer.
+ * @brief Start receiving a batch of files from the host to the target.
+ * 
+ * See dmlog_file_batch_send_start().
  * 
  * @param ctx DMLoG context.
- * @return true on success, false on failure.
+ * @param files Files to receive (source paths on the host, destination paths on the target).
+ * @param count Number of files.
+ * @param dst_dir_path Directory on the target for files without a destination path (may be NULL).
+ * @return dmlog_transfer_t Transfer handle, or NULL on failure.
  */
-bool dmlog_read_next(dmlog_ctx_t ctx)
+dmlog_transfer_t dmlog_file_batch_receive_start(dmlog_ctx_t ctx, dmlog_file_batch_entry_t* files, size_t count, const char* dst_dir_path)
 {
-    bool result = false;
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    if(!dmlog_is_valid(ctx) || files == NULL || count == 0)
     {
-        wait_for_unlock(ctx);
-        context_lock(ctx);
-        
-        // Clear read buffer
-        memset(ctx->read_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
-        
-        dmlog_index_t i = 0;
-        for(i = 0; i < DMOD_LOG_MAX_ENTRY_SIZE - 1; i++)
+        DMOD_LOG_ERROR("Invalid parameters for dmlog_file_batch_receive_start\n");
+        return NULL;
+    }
+    return create_batch(ctx, files, count, dst_dir_path, false);
+}
+
+/**
+ * @brief Encode a value of a binary record.
+ * 
+ * @param out Output buffer (at least DMLOG_RECORD_MAX_VALUE_SIZE bytes).
+ * @param value Value to encode.
+ * @return size_t Number of bytes written.
+ */
+size_t dmlog_record_encode_value(uint8_t* out, uint64_t value)
+{
+    size_t length = 0;
+    while(value >= 0x40)
+    {
+        out[length++] = (uint8_t)(0x80 | (value & 0x3F));
+        value >>= 6;
+    }
+    out[length++] = (uint8_t)(0xC0 | value);
+    return length;
+}
+
+/**
+ * @brief Decode a value of a binary record.
+ * 
+ * @param in Encoded bytes.
+ * @param length Number of bytes available.
+ * @param value Pointer to store the decoded value.
+ * @return size_t Number of bytes consumed, 0 if the value is invalid or incomplete.
+ */
+size_t dmlog_record_decode_value(const uint8_t* in, size_t length, uint64_t* value)
+{
+    uint64_t result = 0;
+    for(size_t i = 0; i < length && i < DMLOG_RECORD_MAX_VALUE_SIZE; i++)
+    {
+        if(in[i] < 0x80)
         {
-            uint8_t byte;
-            if(read_byte_from_tail(ctx, &byte))
-            {
-                // Buffer empty
-                break;
-            }
-            ctx->read_buffer[i] = (char)byte;
-            result = true; // Successfully read at least one byte
-            
-            // Stop reading at newline (end of entry)
-            if(byte == '\n')
-            {
-                i++; // Include the newline in the entry
-                break;
-            }
+            return 0; // Not a value byte
         }
-        
-        // Null-terminate the read buffer
-        if(i < DMOD_LOG_MAX_ENTRY_SIZE)
+        result |= (uint64_t)(in[i] & 0x3F) << (6 * i);
+        if(in[i] >= 0xC0)
         {
-            ctx->read_buffer[i] = '\0';
+            *value = result;
+            return i + 1;
         }
-        
-        ctx->read_entry_offset = 0;
-        context_unlock(ctx);
     }
-    Dmod_ExitCritical();
-    return result;
+    return 0;
 }
 
 /**
- * @brief Get a reference to the current log entry buffer.
+ * @brief Append a binary record to the current log entry and flush it.
+ * 
+ * The record is never split between entries.
+ * 
+ * @param ctx DMLoG context (validated and locked).
+ * @param record Encoded record.
+ * @param length Length of the record.
+ * @return true on success, false on failure.
+ */
+static bool put_record(dmlog_ctx_t ctx, const uint8_t* record, size_t length)
+{
+    if(left_entry_space(ctx) < length)
+    {
+        flush_entry(ctx);
+    }
+    memcpy(&ctx->write_buffer[ctx->write_entry_offset], record, length);
+    ctx->write_entry_offset += length;
+    return flush_entry(ctx);
+}
+
+/**
+ * @brief Write a binary record to the log.
  * 
  * @param ctx DMLoG context.
- * @return const char* Pointer to the current log entry buffer.
+ * @param record Encoded record.
+ * @param length Length of the record.
+ * @return true on success, false on failure.
  */
-const char *dmlog_get_ref_buffer(dmlog_ctx_t ctx)
+static bool write_record(dmlog_ctx_t ctx, const uint8_t* record, size_t length)
 {
-    const char* result = NULL;
+    bool result = false;
+    uint32_t start;
     Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    bool accounted = overhead_begin(ctx, &start);
+    if(is_valid(ctx))
     {
-        result = ctx->read_buffer;
+        context_lock(ctx);
+        handle_clear_request(ctx);
+        result = put_record(ctx, record, length);
+        context_unlock(ctx);
     }
+    overhead_end(accounted, start);
     Dmod_ExitCritical();
     return result;
 }
 
 /**
- * @brief Get a single character from the current log entry.
+ * @brief Log a raw address (function pointer, fault PC, ...).
+ * 
+ * The address is stored as a binary record and symbolized by the monitor.
  * 
  * @param ctx DMLoG context.
- * @return char The next character, or '\0' if none available.
+ * @param address Address to log.
+ * @return true on success, false on failure.
  */
-char dmlog_getc(dmlog_ctx_t ctx)
+bool dmlog_put_address(dmlog_ctx_t ctx, uintptr_t address)
 {
-    char c = '\0';
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    uint8_t record[2 + DMLOG_RECORD_MAX_VALUE_SIZE];
+    size_t length = 0;
+    record[length++] = DMLOG_RECORD_MARKER;
+    record[length++] = DMLOG_RECORD_ADDRESS;
+    length += dmlog_record_encode_value(&record[length], address);
+    return write_record(ctx, record, length);
+}
+
+/**
+ * @brief Log a list of return addresses as a backtrace.
+ * 
+ * At most DMLOG_BACKTRACE_MAX_DEPTH addresses are logged.
+ * 
+ * @param ctx DMLoG context.
+ * @param pcs Return addresses (innermost first).
+ * @param count Number of addresses.
+ * @return true on success, false on failure.
+ */
+bool dmlog_put_backtrace(dmlog_ctx_t ctx, const uintptr_t* pcs, size_t count)
+{
+    if(pcs == NULL && count > 0)
     {
-        context_lock(ctx);  
-        if(ctx->read_entry_offset >= DMOD_LOG_MAX_ENTRY_SIZE || ctx->read_buffer[ctx->read_entry_offset] == '\0')
+        return false;
+    }
+    if(count > DMLOG_BACKTRACE_MAX_DEPTH)
+    {
+        count = DMLOG_BACKTRACE_MAX_DEPTH;
+    }
+
+    uint8_t record[DMLOG_RECORD_MAX_SIZE];
+    size_t length = 0;
+    record[length++] = DMLOG_RECORD_MARKER;
+    record[length++] = DMLOG_RECORD_BACKTRACE;
+    length += dmlog_record_encode_value(&record[length], count);
+    for(size_t i = 0; i < count; i++)
+    {
+        if(i == 0)
         {
-            // Need to read next entry
-            if(!dmlog_read_next(ctx))
-            {
-                Dmod_ExitCritical();
-                return '\0'; // No more entries
-            }
-            ctx->read_entry_offset = 0;
+            length += dmlog_record_encode_value(&record[length], pcs[0]);
+        }
+        else
+        {
+            // Frames are usually close to each other - store zigzag deltas
+            int64_t delta = (int64_t)((uint64_t)pcs[i] - (uint64_t)pcs[i - 1]);
+            length += dmlog_record_encode_value(&record[length], ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
         }
-        c = ctx->read_buffer[ctx->read_entry_offset++];
-        context_unlock(ctx);
     }
+    return write_record(ctx, record, length);
+}
+
+/**
+ * @brief Set the stack unwinder used by dmlog_backtrace().
+ * 
+ * Without an unwinder dmlog_backtrace() follows the frame pointer chain, which
+ * is supported on x86, AArch64 and RISC-V and requires the code to be built
+ * with -fno-omit-frame-pointer. Other targets (e.g. Cortex-M) need an unwinder.
+ * 
+ * @param unwinder Unwinder hook, or NULL to use the frame pointer chain.
+ * @param user_data User data passed to the unwinder.
+ */
+void dmlog_set_unwinder(dmlog_unwinder_t unwinder, void* user_data)
+{
+    Dmod_EnterCritical();
+    g_unwinder = unwinder;
+    g_unwinder_user_data = user_data;
     Dmod_ExitCritical();
-    return c;
 }
 
 /**
- * @brief Get a string from the current log entry.
+ * @brief Capture the current call stack and log it as a backtrace record.
+ * 
+ * Only the raw return addresses are logged - formatting is done on the host,
+ * so this is cheap enough to be used in production code.
  * 
  * @param ctx DMLoG context.
- * @param s Buffer to store the string.
- * @param max_len Maximum length of the buffer.
- * @return true on success, false on failure.
+ * @param skip Number of innermost frames to skip (0 starts with the caller of this function).
+ * @return size_t Number of frames logged.
  */
-bool dmlog_gets(dmlog_ctx_t ctx, char *s, size_t max_len)
+size_t dmlog_backtrace(dmlog_ctx_t ctx, size_t skip)
 {
-    bool result = false;
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    uintptr_t pcs[DMLOG_BACKTRACE_MAX_DEPTH];
+    size_t count = 0;
+
+    if(g_unwinder != NULL)
     {
-        context_lock(ctx);
-        size_t i = 0;
-        size_t read_len = strlen(ctx->read_buffer);
-        
-        // Copy from read_buffer starting from current offset
-        while(i < max_len - 1 && ctx->read_entry_offset < read_len)
+        uintptr_t all_pcs[DMLOG_BACKTRACE_MAX_DEPTH * 2];
+        size_t max_depth = skip + DMLOG_BACKTRACE_MAX_DEPTH;
+        if(max_depth > DMLOG_BACKTRACE_MAX_DEPTH * 2)
         {
-            char c = ctx->read_buffer[ctx->read_entry_offset++];
-            s[i++] = c;
-            if(c == '\n')
+            max_depth = DMLOG_BACKTRACE_MAX_DEPTH * 2;
+        }
+        size_t total = g_unwinder(all_pcs, max_depth, g_unwinder_user_data);
+        for(size_t i = skip; i < total && count < DMLOG_BACKTRACE_MAX_DEPTH; i++)
+        {
+            pcs[count++] = all_pcs[i];
+        }
+    }
+    else
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__riscv)
+        // Frame record: previous frame pointer and return address
+#   if defined(__riscv)
+        const ptrdiff_t fp_index = -2;
+        const ptrdiff_t ra_index = -1;
+#   else
+        const ptrdiff_t fp_index = 0;
+        const ptrdiff_t ra_index = 1;
+#   endif
+        uintptr_t* fp = (uintptr_t*)__builtin_frame_address(0);
+        for(size_t depth = 0; fp != NULL && count < DMLOG_BACKTRACE_MAX_DEPTH; depth++)
+        {
+            uintptr_t pc = fp[ra_index];
+            uintptr_t* next_fp = (uintptr_t*)fp[fp_index];
+            if(pc == 0)
             {
-                break; // End of line
+                break;
+            }
+            if(depth >= skip)
+            {
+                pcs[count++] = pc;
+            }
+            // The stack grows down - stop on anything that does not look like a caller frame
+            if(next_fp <= fp || ((uintptr_t)next_fp & (sizeof(uintptr_t) - 1)) != 0 ||
+               (uintptr_t)next_fp - (uintptr_t)fp > DMLOG_BACKTRACE_MAX_FRAME_SIZE)
+            {
+                break;
             }
+            fp = next_fp;
         }
-        s[i] = '\0'; // Null-terminate
-        result = (i > 0);
-        context_unlock(ctx);
+#endif
     }
+
+    return dmlog_put_backtrace(ctx, pcs, count) ? count : 0;
+}
+
+/**
+ * @brief Set the data cache maintenance hooks.
+ * 
+ * With the hooks the ring can live in write-back cached RAM: the log data and
+ * the ring header are cleaned when an entry is published, and the control
+ * block of the host and the input data are invalidated before reading what
+ * the monitor wrote. The firmware never writes back a line the monitor
+ * writes to, so nothing the monitor wrote in the meantime is lost. Only the
+ * affected lines are passed to the hooks.
+ * 
+ * This relies on the padding of the context, so the buffer passed to
+ * dmlog_create() must start on a DMLOG_CACHE_LINE_SIZE boundary and its size
+ * should be a multiple of it. Set the hooks before creating the context -
+ * dmlog_create() then refuses a buffer that is not aligned.
+ * 
+ * @param clean Hook writing back cache lines, or NULL.
+ * @param invalidate Hook invalidating cache lines, or NULL.
+ */
+void dmlog_set_cache_ops(dmlog_cache_op_t clean, dmlog_cache_op_t invalidate)
+{
+    Dmod_EnterCritical();
+    g_cache_clean = clean;
+    g_cache_invalidate = invalidate;
     Dmod_ExitCritical();
-    return result;
 }
 
 /**
- * @brief Clear the entire log buffer.
+ * @brief Set the clock used to timestamp trace records.
  * 
- * @param ctx DMLoG context.
+ * @param clock Clock hook returning microseconds, or NULL to log 0 (the
+ *              monitor then uses the time the record was received).
  */
-void dmlog_clear(dmlog_ctx_t ctx)
+void dmlog_set_clock(dmlog_clock_t clock)
 {
     Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
-    {
-        context_lock(ctx);
-        ctx->ring.head_offset = 0;
-        ctx->ring.tail_offset = 0;
-        ctx->ring.buffer = (uint64_t)((uintptr_t)ctx->buffer);
-        ctx->ring.input_head_offset = 0;
-        ctx->ring.input_tail_offset = 0;
-        ctx->write_entry_offset = 0;
-        ctx->read_entry_offset = 0;
-        ctx->input_read_entry_offset = 0;
-        memset(ctx->write_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
-        memset(ctx->read_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
-        memset(ctx->input_read_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
-        memset(ctx->buffer, 0, ctx->ring.buffer_size + ctx->ring.input_buffer_size);
-        ctx->ring.flags &= ~(DMLOG_FLAG_CLEAR_BUFFER | DMLOG_FLAG_INPUT_AVAILABLE | DMLOG_FLAG_INPUT_REQUESTED);
-        context_unlock(ctx);
-    }
+    g_clock = clock;
     Dmod_ExitCritical();
 }
 
 /**
- * @brief Signal the monitor to exit.
+ * @brief Calculate the required size of a logging overhead table.
  * 
- * @param ctx DMLoG context.
+ * @param modules Number of modules the table can hold (including "(other)").
+ * @return size_t Required size of the table in bytes.
  */
-void dmlog_exit_monitor(dmlog_ctx_t ctx)
+size_t dmlog_overhead_get_required_size(uint32_t modules)
+{
+    return DMLOG_OVERHEAD_TABLE_SIZE(modules);
+}
+
+/**
+ * @brief Start accounting the logging overhead of each module.
+ * 
+ * Every write call to the context is measured with the cycle counter and
+ * accounted, together with the bytes it wrote, to the module set with
+ * dmlog_set_module(). The table is published in the ring header, so the
+ * monitor can read and report it.
+ * 
+ * @param ctx DMLoG context to account the writes of.
+ * @param buffer Buffer for the table (see dmlog_overhead_get_required_size()).
+ * @param size Size of the buffer in bytes.
+ * @param counter Cycle counter hook, or NULL to account only calls and bytes.
+ * @param cycles_per_second Frequency of the cycle counter (0 - unknown).
+ * @return true on success, false on failure.
+ */
+bool dmlog_overhead_enable(dmlog_ctx_t ctx, void* buffer, size_t size, dmlog_cycle_counter_t counter, uint32_t cycles_per_second)
 {
+    bool result = false;
     Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    if(is_valid(ctx) && buffer != NULL && size >= dmlog_overhead_get_required_size(1))
     {
+        dmlog_overhead_t* table = buffer;
+        memset(buffer, 0, size);
+        table->cycles_per_second = cycles_per_second;
+        table->capacity = (uint32_t)((size - sizeof(dmlog_overhead_t)) / sizeof(dmlog_overhead_entry_t));
+        cache_clean(buffer, size);
+
+        g_overhead_ctx = ctx;
+        g_overhead = table;
+        g_cycle_counter = counter;
+        g_overhead_depth = 0;
+        g_module_entry = NULL;
+
         context_lock(ctx);
-        ctx->ring.flags |= DMLOG_FLAG_EXIT_REQUESTED;
+        ctx->ring.overhead = (uint64_t)(uintptr_t)table;
         context_unlock(ctx);
+        result = true;
     }
     Dmod_ExitCritical();
+    return result;
 }
 
 /**
- * @brief Get the amount of free space in the input ring buffer.
+ * @brief Stop accounting the logging overhead.
  * 
- * @param ctx DMLoG context.
- * @return dmlog_index_t Number of free bytes in the input ring buffer.
+ * The table is left as it is, but the monitor no longer reads it.
  */
-static dmlog_index_t get_input_free_space(dmlog_ctx_t ctx)
+void dmlog_overhead_disable(void)
 {
-    dmlog_index_t free_space = 0;
-    if(ctx->ring.input_head_offset >= ctx->ring.input_tail_offset)
-    {
-        free_space = ctx->ring.input_buffer_size - (ctx->ring.input_head_offset - ctx->ring.input_tail_offset);
-    }
-    else
+    Dmod_EnterCritical();
+    if(is_valid(g_overhead_ctx))
     {
-        free_space = ctx->ring.input_tail_offset - ctx->ring.input_head_offset;
+        context_lock(g_overhead_ctx);
+        g_overhead_ctx->ring.overhead = 0;
+        context_unlock(g_overhead_ctx);
     }
-    return free_space > 0 ? free_space - 1 : 0; // Leave one byte empty to distinguish full/empty
+    g_overhead_ctx = NULL;
+    g_overhead = NULL;
+    g_cycle_counter = NULL;
+    g_module_entry = NULL;
+    Dmod_ExitCritical();
 }
 
 /**
- * @brief Read a single byte from the input buffer tail.
+ * @brief Set the module the following writes are accounted to.
  * 
- * @param ctx DMLoG context.
- * @param out_byte Pointer to store the read byte.
- * @return true if the buffer is empty, false otherwise.
+ * Typically called with DMLOG_SET_MODULE() when entering a module, and with
+ * the returned name when leaving it. The name is copied to the overhead table
+ * on the first write, so it must stay valid until then - a string literal is
+ * the easiest choice.
+ * 
+ * @param module Module name, or NULL for the default (DMLOG_MODULE_NAME of
+ *               the library).
+ * @return const char* Previous module name.
  */
-static bool read_byte_from_input_tail(dmlog_ctx_t ctx, void* out_byte)
+const char* dmlog_set_module(const char* module)
 {
-    bool empty = (ctx->ring.input_tail_offset == ctx->ring.input_head_offset);
-    if(!empty)
+    Dmod_EnterCritical();
+    const char* previous = g_module;
+    g_module = module != NULL ? module : DMLOG_MODULE_NAME;
+    if(g_module != previous)
     {
-        if(out_byte != NULL)
-        {
-            uint8_t* input_buffer = (uint8_t*)((uintptr_t)ctx->ring.input_buffer);
-            *((uint8_t*)out_byte) = input_buffer[ctx->ring.input_tail_offset];
-        }
-        ctx->ring.input_tail_offset = (ctx->ring.input_tail_offset + 1) % ctx->ring.input_buffer_size;
+        g_module_entry = NULL;
     }
-    return empty;
+    Dmod_ExitCritical();
+    return previous;
 }
 
 /**
- * @brief Write a single byte to the input buffer head.
+ * @brief Calculate the required size of a tag dictionary.
  * 
- * @param ctx DMLoG context.
- * @param byte Byte to write.
- * @return true on success, false if the buffer is full.
+ * @param sets Number of distinct tag sets the dictionary can hold.
+ * @return size_t Required size of the dictionary in bytes.
  */
-static bool write_byte_to_input_head(dmlog_ctx_t ctx, uint8_t byte)
+size_t dmlog_tags_get_required_size(uint32_t sets)
 {
-    dmlog_index_t next_head = (ctx->ring.input_head_offset + 1) % ctx->ring.input_buffer_size;
-    if(next_head == ctx->ring.input_tail_offset)
-    {
-        // Buffer full
-        return false;
-    }
-    uint8_t* input_buffer = (uint8_t*)((uintptr_t)ctx->ring.input_buffer);
-    input_buffer[ctx->ring.input_head_offset] = byte;
-    ctx->ring.input_head_offset = next_head;
-    return true;
+    return DMLOG_TAG_DICTIONARY_SIZE(sets);
 }
 
 /**
- * @brief Check if input data is available in the buffer.
+ * @brief Store the tag sets of a context in a dictionary.
  * 
- * @param ctx DMLoG context.
- * @return true if input data is available, false otherwise.
+ * Every distinct tag set is stored once, the first time a line is logged
+ * with it, and the lines carry only its index. The dictionary is published
+ * in the ring header, so the monitor can expand the indexes. When it is full,
+ * further tag sets are logged as text.
+ * 
+ * @param ctx DMLoG context whose lines are tagged.
+ * @param buffer Buffer for the dictionary (see dmlog_tags_get_required_size()).
+ * @param size Size of the buffer in bytes.
+ * @return true on success, false on failure.
  */
-bool dmlog_input_available(dmlog_ctx_t ctx)
+bool dmlog_tags_enable(dmlog_ctx_t ctx, void* buffer, size_t size)
 {
     bool result = false;
     Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    if(is_valid(ctx) && buffer != NULL && size >= dmlog_tags_get_required_size(1))
     {
-        // Check both the ring buffer AND the internal read buffer
-        result = (ctx->ring.input_tail_offset != ctx->ring.input_head_offset) ||
-                 (ctx->input_read_entry_offset < DMOD_LOG_MAX_ENTRY_SIZE && 
-                  ctx->input_read_buffer[ctx->input_read_entry_offset] != '\0');
+        dmlog_tag_dictionary_t* table = buffer;
+        memset(buffer, 0, size);
+        table->capacity = (uint32_t)((size - sizeof(dmlog_tag_dictionary_t)) / DMLOG_TAG_SET_SIZE);
+        cache_clean(buffer, size);
+
+        g_tags_ctx = ctx;
+        g_tags = table;
+        if(++g_tags_generation == 0)
+        {
+            g_tags_generation = 1;
+        }
+
+        context_lock(ctx);
+        ctx->ring.tags = (uint64_t)(uintptr_t)table;
+        context_unlock(ctx);
+        result = true;
     }
     Dmod_ExitCritical();
     return result;
 }
 
 /**
- * @brief Get the amount of free space in the input buffer.
+ * @brief Stop storing tag sets in the dictionary.
  * 
- * @param ctx DMLoG context.
- * @return dmlog_index_t Number of free bytes in the input buffer.
+ * The following lines carry their tags as text. Lines that are still in the
+ * ring can no longer be expanded by the monitor.
  */
-dmlog_index_t dmlog_input_get_free_space(dmlog_ctx_t ctx)
+void dmlog_tags_disable(void)
 {
-    dmlog_index_t free_space = 0;
     Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    if(is_valid(g_tags_ctx))
     {
-        free_space = get_input_free_space(ctx);
+        context_lock(g_tags_ctx);
+        g_tags_ctx->ring.tags = 0;
+        context_unlock(g_tags_ctx);
     }
+    g_tags_ctx = NULL;
+    g_tags = NULL;
     Dmod_ExitCritical();
-    return free_space;
 }
 
 /**
- * @brief Read a single character from the input buffer.
+ * @brief Append text to a tag set, replacing control characters.
  * 
- * @param ctx DMLoG context.
- * @return char The next character from input, or '\0' if none available.
+ * @param text Tag set.
+ * @param length Pointer to the length of the tag set, updated.
+ * @param s Text to append.
+ * @return true on success, false if the text does not fit.
  */
-char dmlog_input_getc(dmlog_ctx_t ctx)
+static bool append_tag_text(char* text, size_t* length, const char* s)
 {
-    char c = '\0';
-    Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    for(; *s != '\0'; s++)
     {
-        context_lock(ctx);
-        
-        // Check if we need to read the next entry
-        if(ctx->input_read_entry_offset >= DMOD_LOG_MAX_ENTRY_SIZE || 
-           ctx->input_read_buffer[ctx->input_read_entry_offset] == '\0')
-        {
-            // Clear input read buffer
-            memset(ctx->input_read_buffer, 0, DMOD_LOG_MAX_ENTRY_SIZE);
-            
-            // Read next entry from input buffer
-            dmlog_index_t i = 0;
-            for(i = 0; i < DMOD_LOG_MAX_ENTRY_SIZE - 1; i++)
-            {
-                uint8_t byte;
-                if(read_byte_from_input_tail(ctx, &byte))
-                {
-                    // Buffer empty
-                    break;
-                }
-                ctx->input_read_buffer[i] = (char)byte;
-                
-                // Stop reading at newline (end of entry)
-                if(byte == '\n')
-                {
-                    i++; // Include the newline in the entry
-                    break;
-                }
-            }
-            
-            // Null-terminate the read buffer
-            if(i < DMOD_LOG_MAX_ENTRY_SIZE)
-            {
-                ctx->input_read_buffer[i] = '\0';
-            }
-            
-            ctx->input_read_entry_offset = 0;
-            
-            // Update flag if buffer is now empty
-            if(ctx->ring.input_tail_offset == ctx->ring.input_head_offset)
-            {
-                ctx->ring.flags &= ~DMLOG_FLAG_INPUT_AVAILABLE;
-            }
-        }
-        
-        if(ctx->input_read_buffer[ctx->input_read_entry_offset] != '\0')
+        if(*length + 1 >= DMLOG_TAG_SET_SIZE)
         {
-            c = ctx->input_read_buffer[ctx->input_read_entry_offset++];
+            return false;
         }
-        
-        context_unlock(ctx);
+        // A newline or record marker in a tag would break the line
+        text[(*length)++] = (unsigned char)*s < ' ' ? ' ' : *s;
     }
-    Dmod_ExitCritical();
-    return c;
+    return true;
 }
 
 /**
- * @brief Read a line from the input buffer.
+ * @brief Push a context tag (MDC style).
  * 
- * @param ctx DMLoG context.
- * @param s Buffer to store the string.
- * @param max_len Maximum length of the buffer.
- * @return true on success, false on failure.
+ * Every line logged until the tag is popped starts with "[key value]" (or
+ * "[key]" without a value), after the tags pushed before it. The strings are
+ * copied, so they do not have to stay valid.
+ * 
+ * @param key Tag key.
+ * @param value Tag value, or NULL.
+ * @return true on success, false if there are too many tags or the tag set
+ *         would exceed DMLOG_TAG_SET_SIZE.
  */
-bool dmlog_input_gets(dmlog_ctx_t ctx, char *s, size_t max_len)
+bool dmlog_tag_push(const char* key, const char* value)
 {
     bool result = false;
     Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    tag_stack_t* stack = &g_tag_stack;
+    if(key != NULL && stack->depth < DMLOG_TAG_MAX_DEPTH)
     {
-        context_lock(ctx);
-        size_t i = 0;
-        
-        while(i < max_len - 1)
+        char text[DMLOG_TAG_SET_SIZE];
+        size_t length = stack->depth > 0 ? stack->ends[stack->depth - 1] : 0;
+        memcpy(text, stack->text, length);
+        if(append_tag_text(text, &length, "[") &&
+           append_tag_text(text, &length, key) &&
+           (value == NULL || (append_tag_text(text, &length, " ") && append_tag_text(text, &length, value))) &&
+           append_tag_text(text, &length, "]") &&
+           length + 2 <= DMLOG_TAG_SET_SIZE)
         {
-            char c = dmlog_input_getc(ctx);
-            if(c == '\0')
-            {
-                break; // No more data
-            }
-            s[i++] = c;
-            if(c == '\n')
-            {
-                break; // End of line
-            }
+            text[length] = ' ';
+            text[length + 1] = '\0';
+            memcpy(stack->text, text, length + 2);
+            stack->ends[stack->depth++] = (uint16_t)length;
+            stack->generation = 0;
+            result = true;
         }
-        
-        s[i] = '\0'; // Null-terminate
-        result = (i > 0);
-        context_unlock(ctx);
     }
     Dmod_ExitCritical();
     return result;
 }
 
 /**
- * @brief Request input from the user (sets INPUT_REQUESTED flag).
- * 
- * This function sets a flag that the monitor can detect to prompt the user for input.
- * 
- * @param ctx DMLoG context.
- * @param flags Input request flags (e.g., echo off, line mode).
+ * @brief Pop the context tag pushed last.
  */
-void dmlog_input_request(dmlog_ctx_t ctx, dmlog_input_request_flags_t flags)
+void dmlog_tag_pop(void)
 {
     Dmod_EnterCritical();
-    if(dmlog_is_valid(ctx))
+    tag_stack_t* stack = &g_tag_stack;
+    if(stack->depth > 0)
     {
-        context_lock(ctx);
-        ctx->ring.flags &= ~DMLOG_INPUT_REQUEST_MASK;
-        ctx->ring.flags |= DMLOG_FLAG_INPUT_REQUESTED | (flags & DMLOG_INPUT_REQUEST_MASK);
-        context_unlock(ctx);
+        stack->depth--;
+        size_t length = stack->depth > 0 ? stack->ends[stack->depth - 1] : 0;
+        if(length > 0)
+        {
+            stack->text[length++] = ' ';
+        }
+        stack->text[length] = '\0';
+        stack->generation = 0;
     }
     Dmod_ExitCritical();
 }
 
 /**
- * @brief Send a file from the target to the host.
- * 
- * @param ctx DMLoG context.
- * @param src_file_path Path to the source file on the target.
- * @param dst_file_path Path to the destination file on the host.
- * @return true on success, false on failure.
+ * @brief Pop all context tags.
  */
-bool dmlog_file_send(dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path)
+void dmlog_tag_clear(void)
 {
-    if(!dmlog_is_valid(ctx) || src_file_path == NULL || dst_file_path == NULL)
-    {
-        DMOD_LOG_ERROR("Invalid parameters for dmlog_file_send\n");
-        return false;
-    }
-
-    // Note: Cannot be on the stack due to x86 (virtual memory access via gdb)
-    dmlog_file_transfer_t* transfer = Dmod_Malloc(sizeof(dmlog_file_transfer_t));
-    if(transfer == NULL)
-    {
-        DMOD_LOG_ERROR("Cannot allocate file transfer structure\n");
-        return false;
-    }
-    memset(transfer, 0, sizeof(*transfer));
-    strncpy(transfer->host_file_name, dst_file_path, sizeof(transfer->host_file_name) - 1);
-    transfer->chunk_size = DMLOG_FILE_TRANSFER_CHUNK_SIZE;
-    void* buffer = Dmod_Malloc(transfer->chunk_size);
-    if(buffer == NULL)
-    {
-        DMOD_LOG_ERROR("Cannot allocate file transfer buffer\n");
-        Dmod_Free(transfer);
-        return false;
-    }
+    Dmod_EnterCritical();
+    g_tag_stack.depth = 0;
+    g_tag_stack.text[0] = '\0';
+    g_tag_stack.generation = 0;
+    Dmod_ExitCritical();
+}
 
-    transfer->buffer_address = (uint64_t)(uintptr_t)buffer;
-    transfer->offset = 0;
+/**
+ * @brief Start logging heap events to the given context.
+ * 
+ * Allocations are reported with dmlog_heap_trace_alloc() and
+ * dmlog_heap_trace_free() - automatically for Dmod_Malloc()/Dmod_Free() when
+ * the library is built with DMLOG_HEAP_TRACE.
+ * 
+ * @param ctx DMLoG context to log heap events to.
+ */
+void dmlog_heap_trace_enable(dmlog_ctx_t ctx)
+{
+    Dmod_EnterCritical();
+    g_heap_trace_ctx = ctx;
+    Dmod_ExitCritical();
+}
 
-    DMOD_LOG_INFO("transfer struct addr: %p\n", (void*)transfer);
-    
-    void* file = Dmod_FileOpen(src_file_path, "rb");
-    if(file == NULL)
-    {
-        DMOD_LOG_ERROR("Cannot open file: %s\n", src_file_path);
-        Dmod_Free(buffer);
-        Dmod_Free(transfer);
-        return false;
-    }
+/**
+ * @brief Stop logging heap events.
+ */
+void dmlog_heap_trace_disable(void)
+{
+    Dmod_EnterCritical();
+    g_heap_trace_ctx = NULL;
+    Dmod_ExitCritical();
+}
 
-    transfer->total_size = Dmod_FileSize(file);
-    
-    bool result = true;
-    for(transfer->offset = 0; result && transfer->offset < transfer->total_size; )
+/**
+ * @brief Write a heap trace record.
+ * 
+ * The record is written as an entry of its own, so an allocation in the
+ * middle of a line does not split the line. Events caused by the tracing
+ * itself (e.g. a clock hook that allocates) are not logged.
+ * 
+ * @param type Record type (DMLOG_RECORD_HEAP_ALLOC or DMLOG_RECORD_HEAP_FREE).
+ * @param ptr Allocated or freed pointer.
+ * @param size Size of the allocation (DMLOG_RECORD_HEAP_ALLOC only).
+ * @param caller Address the allocation function returns to.
+ * @return true on success, false if tracing is disabled or failed.
+ */
+static bool write_heap_record(dmlog_record_type_t type, void* ptr, size_t size, uintptr_t caller)
+{
+    bool result = false;
+    uint32_t start;
+    Dmod_EnterCritical();
+    dmlog_ctx_t ctx = g_heap_trace_ctx;
+    if(ctx != NULL && !g_heap_trace_busy)
     {
-        uint32_t left_bytes = transfer->total_size - transfer->offset;
-        transfer->chunk_size = (left_bytes < DMLOG_FILE_TRANSFER_CHUNK_SIZE) ? left_bytes : DMLOG_FILE_TRANSFER_CHUNK_SIZE;
-        uint32_t read_bytes = Dmod_FileRead(buffer, 1, transfer->chunk_size, file);
-        if(read_bytes != transfer->chunk_size)
+        g_heap_trace_busy = true;
+        bool accounted = overhead_begin(ctx, &start);
+
+        uint8_t record[2 + DMLOG_RECORD_MAX_VALUE_SIZE * 4];
+        size_t length = 0;
+        record[length++] = DMLOG_RECORD_MARKER;
+        record[length++] = (uint8_t)type;
+        length += dmlog_record_encode_value(&record[length], (uintptr_t)ptr);
+        if(type == DMLOG_RECORD_HEAP_ALLOC)
         {
-            DMOD_LOG_ERROR("Cannot read file: %s\n", src_file_path);
-            result = false;
-            break;
+            length += dmlog_record_encode_value(&record[length], size);
         }
-        context_lock(ctx);
-        ctx->ring.file_transfer = (uint64_t)(uintptr_t)transfer;
-        ctx->ring.flags |= DMLOG_FLAG_FILE_SEND_REQ;
-        context_unlock(ctx);
-
-        // TODO: Add timeout mechanism - currently it is not possible
-        // due to gdb synchronization issues.
-        while(((ctx->ring.flags & DMLOG_FLAG_FILE_SEND_REQ) != 0));
-
-        if(transfer->status != 0)
+        length += dmlog_record_encode_value(&record[length], caller);
+        length += dmlog_record_encode_value(&record[length], g_clock != NULL ? g_clock() : 0);
+        if(is_valid(ctx))
         {
-            DMOD_LOG_ERROR("Cannot send file - host reported error %s\n", strerror(transfer->status));
-            result = false;
-            break;
+            context_lock(ctx);
+            handle_clear_request(ctx);
+            write_entry(ctx, record, (dmlog_index_t)length);
+            result = true;
+            context_unlock(ctx);
         }
-        
-        transfer->offset += transfer->chunk_size;
-    }
-
-    context_lock(ctx);
-    ctx->ring.file_transfer = 0;
-    ctx->ring.flags &= ~DMLOG_FLAG_FILE_SEND_REQ;
-    context_unlock(ctx);
-
-    Dmod_Free(buffer);
-    Dmod_FileClose(file);
-    Dmod_Free(transfer);
 
+        overhead_end(accounted, start);
+        g_heap_trace_busy = false;
+    }
+    Dmod_ExitCritical();
     return result;
 }
 
 /**
- * @brief Receive a file from the host to the target.
+ * @brief Log an allocation.
  * 
- * @param ctx DMLoG context.
- * @param src_file_path Path to the source file on the host.
- * @param dst_file_path Path to the destination file on the target.
- * @return true on success, false on failure.
+ * Failed allocations (ptr == NULL) are logged as well.
+ * 
+ * @param ptr Allocated pointer.
+ * @param size Requested size.
+ * @param caller Address the allocation function returns to.
+ * @return true on success, false if tracing is disabled or failed.
  */
-bool dmlog_file_receive(dmlog_ctx_t ctx, const char* src_file_path, const char* dst_file_path)
+bool dmlog_heap_trace_alloc(void* ptr, size_t size, uintptr_t caller)
 {
-    if(!dmlog_is_valid(ctx) || src_file_path == NULL || dst_file_path == NULL)
-    {
-        return false;
-    }
-    dmlog_file_transfer_t *transfer = Dmod_Malloc(sizeof(dmlog_file_transfer_t));
-    if(transfer == NULL)
-    {
-        DMOD_LOG_ERROR("Cannot allocate file transfer structure\n");
-        return false;
-    }
-
-    if(strlen(dst_file_path) >= sizeof(transfer->host_file_name))
-    {
-        DMOD_LOG_ERROR("Destination file path too long: %s\n", dst_file_path);
-        Dmod_Free(transfer);
-        return false;
-    }
-
-    memset(transfer, 0, sizeof(transfer));
-    strncpy(transfer->host_file_name, src_file_path, sizeof(transfer->host_file_name) - 1);
-    transfer->chunk_size = DMLOG_FILE_TRANSFER_CHUNK_SIZE;
-    void* buffer = Dmod_Malloc(transfer->chunk_size);
-    if(buffer == NULL)
-    {
-        DMOD_LOG_ERROR("Cannot allocate file transfer buffer\n");
-        Dmod_Free(transfer);
-        return false;
-    }
+    return write_heap_record(DMLOG_RECORD_HEAP_ALLOC, ptr, size, caller);
+}
 
-    transfer->buffer_address = (uint64_t)(uintptr_t)buffer;
-    transfer->offset = 0;
-    
-    void* file = Dmod_FileOpen(src_file_path, "wb");
-    if(file == NULL)
+/**
+ * @brief Log a free.
+ * 
+ * Call it before the memory is actually released, so the event cannot be
+ * logged after an allocation that already reuses the block.
+ * 
+ * @param ptr Freed pointer (NULL is ignored).
+ * @param caller Address the free function returns to.
+ * @return true on success, false if tracing is disabled or failed.
+ */
+bool dmlog_heap_trace_free(void* ptr, uintptr_t caller)
+{
+    if(ptr == NULL)
     {
-        Dmod_Free(buffer);
-        Dmod_Free(transfer);
-        DMOD_LOG_ERROR("Cannot open file for writing: %s\n", dst_file_path);
         return false;
     }
-
-    transfer->total_size = 0; // Will be set by the host
-    
-    bool result = true;
-    for(transfer->offset = 0; result && (transfer->offset < transfer->total_size || transfer->total_size == 0); )
-    {
-        transfer->chunk_size = DMLOG_FILE_TRANSFER_CHUNK_SIZE;
-
-        context_lock(ctx);
-        ctx->ring.file_transfer = (uint64_t)(uintptr_t)transfer;
-        ctx->ring.flags |= DMLOG_FLAG_FILE_RECV_REQ;
-        context_unlock(ctx);
-
-        // TODO: Add timeout mechanism - currently it is not possible due to gdb synchronization issues.
-        while(((ctx->ring.flags & DMLOG_FLAG_FILE_RECV_REQ) != 0));
-
-        if(transfer->status != 0)
-        {
-            DMOD_LOG_ERROR("Cannot receive file - host reported error %s\n", strerror(transfer->status));
-            result = false;
-            break;
-        }
-
-        if(transfer->chunk_size == 0 || transfer->total_size == 0)
-        {
-            DMOD_LOG_WARN("Empty file received: %s\n", dst_file_path);
-            break;
-        }
-        size_t written_bytes = Dmod_FileWrite(buffer, 1, transfer->chunk_size, file);
-        if(written_bytes != transfer->chunk_size)
-        {
-            DMOD_LOG_ERROR("Cannot receive file - cannot write data to %s\n", dst_file_path);
-            result = false;
-            break;
-        }
-        transfer->offset += transfer->chunk_size;
-    }
-
-    context_lock(ctx);
-    ctx->ring.file_transfer = 0;
-    ctx->ring.flags &= ~DMLOG_FLAG_FILE_RECV_REQ;
-    context_unlock(ctx);
-
-    Dmod_Free(buffer);
-    Dmod_FileClose(file);
-    Dmod_Free(transfer);
-
-    return result;
+    return write_heap_record(DMLOG_RECORD_HEAP_FREE, ptr, 0, caller);
 }
 
 #ifndef DMLOG_DONT_IMPLEMENT_DMOD_API
@@ -1061,17 +3067,23 @@ DMOD_INPUT_API_DECLARATION( Dmod, 1.0, size_t ,_WriteKernel, ( const void* Buffe
         return 0;
     }
 
-    const char* bytes = (const char*)Buffer;
     size_t written = 0;
-    while(written < Size)
+    uint32_t start;
+    Dmod_EnterCritical();
+    bool accounted = overhead_begin(ctx, &start);
+    if(is_valid(ctx))
     {
-        if(!dmlog_putc(ctx, bytes[written]))
+        context_lock(ctx);
+        handle_clear_request(ctx);
+        if(put_text(ctx, (const char*)Buffer, Size))
         {
-            break;
+            written = Size;
         }
-        written++;
+        flush_entry(ctx);
+        context_unlock(ctx);
     }
-    dmlog_flush(ctx);
+    overhead_end(accounted, start);
+    Dmod_ExitCritical();
 
     return written;
 }
@@ -1116,10 +3128,17 @@ DMOD_INPUT_API_DECLARATION( Dmod, 1.0, size_t ,_ReadKernel, ( void* Buffer, size
     }
 
     size_t read_count = 0;
-    while(read_count < Size && dmlog_input_available(ctx))
+    Dmod_EnterCritical();
+    if(is_valid(ctx))
     {
-        bytes[read_count++] = dmlog_input_getc(ctx);
+        context_lock(ctx);
+        while(read_count < Size && input_available(ctx))
+        {
+            bytes[read_count++] = input_getc(ctx);
+        }
+        context_unlock(ctx);
     }
+    Dmod_ExitCritical();
 
     return read_count;
 }
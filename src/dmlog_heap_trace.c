@@ -0,0 +1,28 @@
+/*
+ * Heap tracing wrappers for Dmod_Malloc()/Dmod_Free().
+ *
+ * Built only with DMLOG_HEAP_TRACE=ON, which also links everything with
+ * -Wl,--wrap=Dmod_Malloc -Wl,--wrap=Dmod_Free. The linker then redirects all
+ * calls to these wrappers, and the original functions stay reachable as
+ * __real_Dmod_Malloc()/__real_Dmod_Free(). Nothing is logged until
+ * dmlog_heap_trace_enable() is called.
+ */
+#include "dmlog.h"
+#include "dmod.h"
+
+void* __real_Dmod_Malloc(size_t Size);
+void  __real_Dmod_Free(void* Ptr);
+
+void* __wrap_Dmod_Malloc(size_t Size)
+{
+    void* ptr = __real_Dmod_Malloc(Size);
+    dmlog_heap_trace_alloc(ptr, Size, (uintptr_t)__builtin_return_address(0));
+    return ptr;
+}
+
+void __wrap_Dmod_Free(void* Ptr)
+{
+    // Logged first - once freed, the block may be reused by another thread
+    dmlog_heap_trace_free(Ptr, (uintptr_t)__builtin_return_address(0));
+    __real_Dmod_Free(Ptr);
+}
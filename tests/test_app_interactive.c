@@ -6,15 +6,34 @@
  * allowing automated testing of dmlog with gdbserver integration.
  * 
  * Usage: test_app_interactive <input_file> [buffer_size]
+ *        test_app_interactive --load <spec> [buffer_size]
  * 
  * Input file format:
  * - Regular lines are logged to dmlog (one line = one log entry)
  * - Special marker "<user_input>" triggers reading from dmlog input
+ * - "<file_send:src:dst>" and "<file_recv:src:dst>" transfer a file
+ * - "<batch_send:dir:src,src,...>" and "<batch_recv:dir:src,src,...>" transfer
+ *   a batch of files into a directory
  * - Lines starting with "#" are comments and ignored
  * 
  * Arguments:
  * - input_file: Path to test scenario file
  * - buffer_size: Optional buffer size in bytes (default: 4096)
+ * 
+ * Load generator mode (--load) logs numbered messages at a controlled rate
+ * instead of a scenario, to measure what reaches the host (see
+ * test_soak_gdb.sh). The spec is a comma separated list of key=value pairs:
+ * - rate: Messages per second (default: 1000)
+ * - duration: Duration in seconds (default: 10)
+ * - size: Message size in bytes, MIN or MIN-MAX (default: 64)
+ * - dist: Size distribution - uniform or bimodal (90% MIN, 10% MAX) (default: uniform)
+ * - burst: Messages logged back to back, the average rate is kept (default: 1)
+ * - seed: Seed of the size generator (default: 1)
+ * - wait: 1 to start when the monitor sends a line of input, so nothing is
+ *   logged before it is connected, 0 to start immediately (default: 1)
+ * 
+ * Every message is "LOAD <seq> <time_us> <padding>\n" where time_us is the
+ * wall clock time it was logged. The run ends with "LOAD done sent=<n> bytes=<n>".
  */
 
 #include "dmlog.h"
@@ -24,11 +43,37 @@
 #include <unistd.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <time.h>
 
 #define DEFAULT_BUFFER_SIZE (4 * 1024)
-#define MAX_BUFFER_SIZE (16 * 1024)
+#define MAX_BUFFER_SIZE (64 * 1024)
+#define MAX_BATCH_FILES 16
+#define BATCH_TIMEOUT_MS 60000   /* A batch that takes longer is cancelled */
 #define MAX_LINE_LENGTH 512
 
+/* Load generator defaults */
+#define LOAD_DEFAULT_RATE       1000
+#define LOAD_DEFAULT_DURATION   10
+#define LOAD_DEFAULT_SIZE       64
+#define LOAD_MIN_SIZE           32      /* Room for the header of a message */
+#define LOAD_MAX_SIZE           (DMOD_LOG_MAX_ENTRY_SIZE - 1)
+
+typedef enum {
+    LOAD_DIST_UNIFORM,
+    LOAD_DIST_BIMODAL,
+} load_dist_t;
+
+typedef struct {
+    double rate;
+    double duration;
+    size_t min_size;
+    size_t max_size;
+    load_dist_t dist;
+    unsigned burst;
+    uint32_t seed;
+    bool wait;
+} load_config_t;
+
 static volatile bool keep_running = true;
 static dmlog_ctx_t g_dmlog_ctx = NULL;
 // Use static buffer so it can be found with nm for gdbserver testing
@@ -39,8 +84,224 @@ void signal_handler(int signum) {
     keep_running = false;
 }
 
+static double get_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static uint64_t get_wall_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+// Clock of dmlog - bounds the wait for a monitor with flow control in real time
+static uint64_t get_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void sleep_until_ms(double deadline) {
+    double left = deadline - get_time_ms();
+    if (left > 0) {
+        struct timespec ts;
+        ts.tv_sec = (time_t)(left / 1000.0);
+        ts.tv_nsec = (long)((left - (double)ts.tv_sec * 1000.0) * 1000000.0);
+        nanosleep(&ts, NULL);
+    }
+}
+
+// xorshift32 - reproducible message sizes for a given seed
+static uint32_t next_random(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static bool parse_load_spec(const char *spec, load_config_t *config) {
+    config->rate = LOAD_DEFAULT_RATE;
+    config->duration = LOAD_DEFAULT_DURATION;
+    config->min_size = LOAD_DEFAULT_SIZE;
+    config->max_size = LOAD_DEFAULT_SIZE;
+    config->dist = LOAD_DIST_UNIFORM;
+    config->burst = 1;
+    config->seed = 1;
+    config->wait = true;
+
+    char buffer[MAX_LINE_LENGTH];
+    strncpy(buffer, spec, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    for (char *item = strtok(buffer, ","); item != NULL; item = strtok(NULL, ",")) {
+        char *value = strchr(item, '=');
+        if (value == NULL) {
+            fprintf(stderr, "Error: Invalid load option: %s\n", item);
+            return false;
+        }
+        *value++ = '\0';
+        if (strcmp(item, "rate") == 0) {
+            config->rate = atof(value);
+        } else if (strcmp(item, "duration") == 0) {
+            config->duration = atof(value);
+        } else if (strcmp(item, "size") == 0) {
+            char *max = strchr(value, '-');
+            config->min_size = (size_t)atoi(value);
+            config->max_size = max ? (size_t)atoi(max + 1) : config->min_size;
+        } else if (strcmp(item, "dist") == 0) {
+            if (strcmp(value, "uniform") == 0) {
+                config->dist = LOAD_DIST_UNIFORM;
+            } else if (strcmp(value, "bimodal") == 0) {
+                config->dist = LOAD_DIST_BIMODAL;
+            } else {
+                fprintf(stderr, "Error: Unknown size distribution: %s\n", value);
+                return false;
+            }
+        } else if (strcmp(item, "burst") == 0) {
+            config->burst = (unsigned)atoi(value);
+        } else if (strcmp(item, "seed") == 0) {
+            config->seed = (uint32_t)strtoul(value, NULL, 0);
+        } else if (strcmp(item, "wait") == 0) {
+            config->wait = atoi(value) != 0;
+        } else {
+            fprintf(stderr, "Error: Unknown load option: %s\n", item);
+            return false;
+        }
+    }
+
+    if (config->rate <= 0 || config->duration <= 0 || config->burst == 0 || config->seed == 0) {
+        fprintf(stderr, "Error: rate, duration, burst and seed must be positive\n");
+        return false;
+    }
+    if (config->min_size < LOAD_MIN_SIZE || config->max_size > LOAD_MAX_SIZE || config->min_size > config->max_size) {
+        fprintf(stderr, "Error: Message size must be within %d-%d bytes\n", LOAD_MIN_SIZE, LOAD_MAX_SIZE);
+        return false;
+    }
+    return true;
+}
+
+static size_t next_message_size(const load_config_t *config, uint32_t *state) {
+    size_t range = config->max_size - config->min_size;
+    if (range == 0) {
+        return config->min_size;
+    }
+    uint32_t r = next_random(state);
+    if (config->dist == LOAD_DIST_BIMODAL) {
+        return (r % 10 == 0) ? config->max_size : config->min_size;
+    }
+    return config->min_size + r % (range + 1);
+}
+
+// Logs numbered messages at the configured rate until the duration elapses
+static void run_load(const load_config_t *config) {
+    char message[LOAD_MAX_SIZE + 1];
+    uint32_t state = config->seed;
+    uint32_t seq = 0;
+    uint64_t bytes = 0;
+    uint32_t total = (uint32_t)(config->rate * config->duration);
+
+    if (config->wait) {
+        printf("Waiting for the monitor to send a line of input...\n");
+        dmlog_input_request(g_dmlog_ctx, DMLOG_INPUT_REQUEST_FLAG_LINE_MODE);
+        while (keep_running && !dmlog_input_available(g_dmlog_ctx)) {
+            usleep(1000);
+        }
+        dmlog_input_gets(g_dmlog_ctx, message, sizeof(message));
+    }
+
+    double start = get_time_ms();
+
+    printf("Generating load: %u messages at %.0f msg/s, %zu-%zu bytes (%s), bursts of %u\n",
+           total, config->rate, config->min_size, config->max_size,
+           config->dist == LOAD_DIST_BIMODAL ? "bimodal" : "uniform", config->burst);
+
+    while (keep_running && seq < total) {
+        // Keep the average rate - every burst starts when its first message is due
+        sleep_until_ms(start + (double)seq * 1000.0 / config->rate);
+
+        for (unsigned i = 0; i < config->burst && seq < total; i++, seq++) {
+            size_t size = next_message_size(config, &state);
+            int header = snprintf(message, sizeof(message), "LOAD %u %llu ", seq,
+                                  (unsigned long long)get_wall_time_us());
+            memset(message + header, 'x', size - 1 - (size_t)header);
+            message[size - 1] = '\n';
+            dmlog_putsn(g_dmlog_ctx, message, size);
+            bytes += size;
+        }
+    }
+
+    double elapsed = get_time_ms() - start;
+    printf("Load done: %u messages, %llu bytes in %.1f ms (%.0f msg/s)\n", seq,
+           (unsigned long long)bytes, elapsed, elapsed > 0 ? seq * 1000.0 / elapsed : 0.0);
+    snprintf(message, sizeof(message), "LOAD done sent=%u bytes=%llu\n", seq, (unsigned long long)bytes);
+    dmlog_puts(g_dmlog_ctx, message);
+    dmlog_flush(g_dmlog_ctx);
+}
+
+// Runs a <batch_send:dst_dir:src,src,...> or <batch_recv:dst_dir:src,src,...> marker
+static void run_batch(int line_num, char *spec, bool send) {
+    const char *name = send ? "send" : "receive";
+    char *sources = strchr(spec, ':');
+    if (sources == NULL) {
+        printf("[Line %d] Error: Invalid batch syntax\n", line_num);
+        dmlog_puts(g_dmlog_ctx, "ERROR: Invalid batch syntax\n");
+        return;
+    }
+    *sources++ = '\0';
+    size_t len = strlen(sources);
+    if (len > 0 && sources[len-1] == '>') {
+        sources[len-1] = '\0';
+    }
+
+    dmlog_file_batch_entry_t files[MAX_BATCH_FILES];
+    size_t count = 0;
+    for (char *path = strtok(sources, ","); path != NULL && count < MAX_BATCH_FILES; path = strtok(NULL, ",")) {
+        files[count].src_file_path = path;
+        files[count].dst_file_path = NULL;
+        count++;
+    }
+
+    char message[DMOD_LOG_MAX_ENTRY_SIZE];
+    printf("[Line %d] Batch %s: %zu files -> %s\n", line_num, name, count, spec);
+    snprintf(message, sizeof(message), "%s batch: %zu files -> %s\n", send ? "Sending" : "Receiving", count, spec);
+    dmlog_puts(g_dmlog_ctx, message);
+    dmlog_flush(g_dmlog_ctx);
+
+    double start_time = get_time_ms();
+    dmlog_transfer_t transfer = send ? dmlog_file_batch_send_start(g_dmlog_ctx, files, count, spec)
+                                     : dmlog_file_batch_receive_start(g_dmlog_ctx, files, count, spec);
+    while (dmlog_file_transfer_poll(transfer) == DMLOG_TRANSFER_PENDING && get_time_ms() - start_time < BATCH_TIMEOUT_MS) {
+    }
+    bool result = dmlog_file_transfer_finish(transfer);
+    printf("[Line %d] Batch %s %s in %.1f ms\n", line_num, name, result ? "successful" : "failed", get_time_ms() - start_time);
+    for (size_t i = 0; i < count; i++) {
+        if (files[i].status != 0) {
+            snprintf(message, sizeof(message), "Batch file failed: %s (%d)\n", files[i].src_file_path, (int)files[i].status);
+            dmlog_puts(g_dmlog_ctx, message);
+        }
+    }
+    snprintf(message, sizeof(message), "Batch %s %s\n", name, result ? "successful" : "failed");
+    dmlog_puts(g_dmlog_ctx, message);
+}
+
+static void close_monitor(void) {
+    dmlog_exit_monitor(g_dmlog_ctx);
+    
+    // Give monitor time to read final logs and process any pending inputs
+    // For tests with multiple inputs, we need a bit more time
+    sleep(3);
+
+    printf("Exiting gracefully...\n");
+    dmlog_destroy(g_dmlog_ctx);
+}
+
 void print_usage(const char *progname) {
     fprintf(stderr, "Usage: %s <input_file> [buffer_size]\n", progname);
+    fprintf(stderr, "       %s --load <spec> [buffer_size]\n", progname);
     fprintf(stderr, "\n");
     fprintf(stderr, "Arguments:\n");
     fprintf(stderr, "  input_file   : Path to test scenario file\n");
@@ -49,7 +310,18 @@ void print_usage(const char *progname) {
     fprintf(stderr, "Input file format:\n");
     fprintf(stderr, "  - Regular lines are logged to dmlog\n");
     fprintf(stderr, "  - '<user_input>' marker triggers reading from dmlog input\n");
+    fprintf(stderr, "  - '<file_send:src:dst>' / '<file_recv:src:dst>' transfer a file\n");
+    fprintf(stderr, "  - '<batch_send:dir:src,...>' / '<batch_recv:dir:src,...>' transfer a batch of files\n");
     fprintf(stderr, "  - Lines starting with '#' are comments\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Load spec (comma separated key=value pairs):\n");
+    fprintf(stderr, "  rate=N        : Messages per second (default: %d)\n", LOAD_DEFAULT_RATE);
+    fprintf(stderr, "  duration=S    : Duration in seconds (default: %d)\n", LOAD_DEFAULT_DURATION);
+    fprintf(stderr, "  size=MIN[-MAX]: Message size in bytes, %d-%d (default: %d)\n", LOAD_MIN_SIZE, LOAD_MAX_SIZE, LOAD_DEFAULT_SIZE);
+    fprintf(stderr, "  dist=D        : Size distribution - uniform or bimodal (default: uniform)\n");
+    fprintf(stderr, "  burst=N       : Messages logged back to back (default: 1)\n");
+    fprintf(stderr, "  seed=N        : Seed of the size generator (default: 1)\n");
+    fprintf(stderr, "  wait=0|1      : Start when the monitor sends a line of input (default: 1)\n");
 }
 
 int main(int argc, char *argv[]) {
@@ -59,6 +331,18 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // In load generator mode the spec takes the place of the input file
+    load_config_t load_config = { 0 };
+    bool load_mode = strcmp(argv[1], "--load") == 0;
+    if (load_mode) {
+        if (argc < 3 || !parse_load_spec(argv[2], &load_config)) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        argv++;
+        argc--;
+    }
+
     const char *input_file = argv[1];
     size_t buffer_size = DEFAULT_BUFFER_SIZE;
 
@@ -75,7 +359,7 @@ int main(int argc, char *argv[]) {
     signal(SIGINT, signal_handler);
 
     printf("=== dmlog Interactive Test Application ===\n");
-    printf("Input file: %s\n", input_file);
+    printf("%s: %s\n", load_mode ? "Load spec" : "Input file", input_file);
     printf("Buffer size: %zu bytes\n", buffer_size);
     
     // Pre-create test files that might be needed for file_send operations
@@ -101,6 +385,8 @@ int main(int argc, char *argv[]) {
     }
     Dmod_SetLogLevel(Dmod_LogLevel_Verbose);
 
+    dmlog_set_clock(get_clock_us);
+
     // Create dmlog buffer using static global buffer
     g_dmlog_ctx = dmlog_create(g_log_buffer, buffer_size);
     if (!g_dmlog_ctx) {
@@ -110,6 +396,13 @@ int main(int argc, char *argv[]) {
 
     printf("dmlog context created at: %p\n", (void*)g_log_buffer);
 
+    if (load_mode) {
+        run_load(&load_config);
+        printf("Load completed. Closing monitor...\n");
+        close_monitor();
+        return 0;
+    }
+
     // Open input file
     FILE *f = fopen(input_file, "r");
     if (!f) {
@@ -211,11 +504,19 @@ int main(int argc, char *argv[]) {
                 dmlog_puts(g_dmlog_ctx, "ERROR: Invalid file_recv syntax\n");
             }
         }
+        // Check for batch markers: <batch_send:dst_dir:src,src,...> and <batch_recv:dst_dir:src,src,...>
+        else if (strncmp(line, "<batch_send:", 12) == 0) {
+            run_batch(line_num, line + 12, true);
+        }
+        else if (strncmp(line, "<batch_recv:", 12) == 0) {
+            run_batch(line_num, line + 12, false);
+        }
         // Check for special marker
         else if (strcmp(line, "<user_input>") == 0) {
             printf("[Line %d] Requesting user input...\n", line_num);
             
             // Request input from dmlog
+            double request_time = get_time_ms();
             dmlog_input_request(g_dmlog_ctx, DMLOG_INPUT_REQUEST_FLAG_LINE_MODE);
             
             // Wait for input to become available (with timeout)
@@ -234,6 +535,7 @@ int main(int argc, char *argv[]) {
                 char input_buffer[256];
                 if (dmlog_input_gets(g_dmlog_ctx, input_buffer, sizeof(input_buffer))) {
                     printf("[Line %d] Received input: %s", line_num, input_buffer);
+                    printf("[Line %d] Input latency: %.1f ms\n", line_num, get_time_ms() - request_time);
                     
                     // Echo the input to dmlog output
                     dmlog_puts(g_dmlog_ctx, "Received: ");
@@ -263,14 +565,7 @@ int main(int argc, char *argv[]) {
     fclose(f);
 
     printf("Test scenario completed. Closing monitor...\n");
-    dmlog_exit_monitor(g_dmlog_ctx);
-    
-    // Give monitor time to read final logs and process any pending inputs
-    // For tests with multiple inputs, we need a bit more time
-    sleep(3);
-
-    printf("Exiting gracefully...\n");
-    dmlog_destroy(g_dmlog_ctx);
+    close_monitor();
 
     return 0;
 }
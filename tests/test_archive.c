@@ -0,0 +1,258 @@
+#include "archive.h"
+#include "query.h"
+#include "trace.h"
+#include "test_common.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Test counters
+int tests_passed = 0;
+int tests_failed = 0;
+
+#define TEST_ARCHIVE_DIR    "test_archive_data"
+#define TEST_QUERY_OUTPUT   "test_archive_query.txt"
+
+// Time between the lines archived before and after the checkpoint
+static int64_t middle_ms = 0;
+
+// Helper function to prepare a query over the test archive
+static void init_query(query_t* query) {
+    memset(query, 0, sizeof(*query));
+    query->directory = TEST_ARCHIVE_DIR;
+    query->from_ms = INT64_MIN;
+    query->to_ms = INT64_MAX;
+}
+
+// Helper function to run a query and read back what it printed
+static int run_query(const query_t* query, char* output, size_t size) {
+    output[0] = '\0';
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    FILE* file = fopen(TEST_QUERY_OUTPUT, "w+");
+    if (saved_stdout < 0 || file == NULL) {
+        if (file != NULL) {
+            fclose(file);
+        }
+        return -1;
+    }
+    dup2(fileno(file), STDOUT_FILENO);
+    int result = query_run(query);
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    rewind(file);
+    size_t length = fread(output, 1, size - 1, file);
+    output[length] = '\0';
+    fclose(file);
+    return result;
+}
+
+// Helper function to count the lines matching the given terms
+static long count_matches(const char* first, const char* second) {
+    query_t query;
+    init_query(&query);
+    query.count_only = true;
+    if (first != NULL) {
+        query_add_term(&query, first);
+    }
+    if (second != NULL) {
+        query_add_term(&query, second);
+    }
+    char output[64];
+    run_query(&query, output, sizeof(output));
+    return strtol(output, NULL, 10);
+}
+
+// Helper function to remove the test archive
+static void remove_archive(void) {
+    char path[ARCHIVE_MAX_PATH_LENGTH];
+    const char* extensions[] = { "log", "lines", "idx", "idx.tmp" };
+    for (uint32_t segment = 1; segment < 64; segment++) {
+        for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++) {
+            archive_segment_path(path, sizeof(path), TEST_ARCHIVE_DIR, segment, extensions[i]);
+            remove(path);
+        }
+    }
+    rmdir(TEST_ARCHIVE_DIR);
+    remove(TEST_QUERY_OUTPUT);
+}
+
+// Helper function to build a line with more words than a line used to be matched by
+static size_t long_line(char* line, size_t size, const char* end) {
+    size_t length = 0;
+    for (int i = 0; i < 600 && length + 16 < size; i++) {
+        length += (size_t)snprintf(&line[length], size - length, "w%d ", i);
+    }
+    length += (size_t)snprintf(&line[length], size - length, "%s\n", end);
+    return length;
+}
+
+// Test: Lines archived and indexed at a checkpoint
+static void test_write_and_checkpoint(void) {
+    TEST_SECTION("Write And Checkpoint");
+
+    archive_t* archive = archive_open(TEST_ARCHIVE_DIR, 0);
+    ASSERT_TEST(archive != NULL, "Archive is opened");
+    if (archive == NULL) {
+        return;
+    }
+
+    const char* lines = "boot ok\n"
+                        "SDCard error: timeout\n"
+                        "watchdog reset\n"
+                        "error in stack overflow handler\n";
+    ASSERT_TEST(archive_write(archive, lines, strlen(lines)), "Lines are written");
+    char line[8192];
+    size_t length = long_line(line, sizeof(line), "needle phrase at the end");
+    ASSERT_TEST(archive_write(archive, line, length), "Long line is written");
+    ASSERT_TEST(archive_checkpoint(archive, true), "Index is checkpointed");
+
+    char path[ARCHIVE_MAX_PATH_LENGTH];
+    archive_index_header_t header = { 0 };
+    archive_segment_path(path, sizeof(path), TEST_ARCHIVE_DIR, 1, "idx");
+    FILE* file = fopen(path, "rb");
+    if (file != NULL) {
+        if (fread(&header, sizeof(header), 1, file) != 1) {
+            memset(&header, 0, sizeof(header));
+        }
+        fclose(file);
+    }
+    ASSERT_TEST(header.magic == ARCHIVE_INDEX_MAGIC && header.version == ARCHIVE_INDEX_VERSION, "Index file has a valid header");
+    ASSERT_TEST(header.line_count == 5, "Index covers the checkpointed lines");
+
+    // Lines after the checkpoint are only in the line table, one of them written in pieces
+    usleep(20000);
+    middle_ms = archive_now_ms();
+    usleep(20000);
+    const char* tail = "sdcard mounted\nstack over";
+    ASSERT_TEST(archive_write(archive, tail, strlen(tail)), "Tail lines are written");
+    ASSERT_TEST(archive_write(archive, "flow detected\n", strlen("flow detected\n")), "Rest of a split line is written");
+    length = long_line(line, sizeof(line), "tail needle phrase");
+    ASSERT_TEST(archive_write(archive, line, length), "Long tail line is written");
+
+    // The tail must be searchable before the archive is closed
+    ASSERT_TEST(count_matches("mounted", NULL) == 1, "Line after the checkpoint is found");
+    ASSERT_TEST(count_matches("stack overflow", NULL) == 2, "Phrase is found before and after the checkpoint");
+    ASSERT_TEST(count_matches("tail needle phrase", NULL) == 1, "Phrase at the end of a long tail line is found");
+
+    archive_close(archive);
+}
+
+// Test: Term and phrase queries
+static void test_term_queries(void) {
+    TEST_SECTION("Term Queries");
+
+    ASSERT_TEST(count_matches("error", NULL) == 2, "Term matches all lines containing it");
+    ASSERT_TEST(count_matches("ERROR", NULL) == 2, "Terms are case insensitive");
+    ASSERT_TEST(count_matches("sdcard", "error") == 1, "All terms must match");
+    ASSERT_TEST(count_matches("stack overflow", NULL) == 2, "Phrase matches consecutive words");
+    ASSERT_TEST(count_matches("overflow stack", NULL) == 0, "Phrase does not match words in another order");
+    ASSERT_TEST(count_matches("needle phrase", NULL) == 2, "Phrase after 600 words of a line is found");
+    ASSERT_TEST(count_matches("w599 needle", "w0") == 1, "Words at both ends of a long line are found");
+
+    query_t query;
+    init_query(&query);
+    query_add_term(&query, "watchdog");
+    query.show_location = true;
+    char output[256];
+    ASSERT_TEST(run_query(&query, output, sizeof(output)) == 0, "Query with matches returns 0");
+    ASSERT_TEST(strcmp(output, "1:3:watchdog reset\n") == 0, "Matching line is printed with its location");
+
+    init_query(&query);
+    query_add_term(&query, "missing");
+    ASSERT_TEST(run_query(&query, output, sizeof(output)) == 1 && output[0] == '\0', "Query without matches returns 1");
+    ASSERT_TEST(!query_add_term(&query, "--"), "Term without words is refused");
+}
+
+// Test: Time range queries
+static void test_time_range(void) {
+    TEST_SECTION("Time Range");
+
+    query_t query;
+    init_query(&query);
+    query.count_only = true;
+    char output[64];
+    run_query(&query, output, sizeof(output));
+    ASSERT_TEST(strcmp(output, "8\n") == 0, "All lines are in the full range");
+
+    query.from_ms = middle_ms;
+    run_query(&query, output, sizeof(output));
+    ASSERT_TEST(strcmp(output, "3\n") == 0, "Lines after the start of the range");
+
+    query.from_ms = INT64_MIN;
+    query.to_ms = middle_ms;
+    run_query(&query, output, sizeof(output));
+    ASSERT_TEST(strcmp(output, "5\n") == 0, "Lines before the end of the range");
+
+    query_add_term(&query, "stack overflow");
+    run_query(&query, output, sizeof(output));
+    ASSERT_TEST(strcmp(output, "1\n") == 0, "Phrase limited to the time range");
+
+    init_query(&query);
+    query.to_ms = middle_ms - 60000;
+    ASSERT_TEST(run_query(&query, output, sizeof(output)) == 1, "Range before the archive matches nothing");
+}
+
+// Test: Lines spread over several segments
+static void test_segments(void) {
+    TEST_SECTION("Segments");
+
+    archive_t* archive = archive_open(TEST_ARCHIVE_DIR, 64);
+    ASSERT_TEST(archive != NULL, "Archive is reopened with small segments");
+    if (archive == NULL) {
+        return;
+    }
+    for (int i = 0; i < 10; i++) {
+        char line[64];
+        int length = snprintf(line, sizeof(line), "rotated line number %d of the segment test\n", i);
+        archive_write(archive, line, (size_t)length);
+    }
+    archive_write(archive, "last line without newline", strlen("last line without newline"));
+    archive_close(archive);
+
+    char path[ARCHIVE_MAX_PATH_LENGTH];
+    ASSERT_TEST(!archive_segment_path(path, 16, TEST_ARCHIVE_DIR, 3, "idx"), "Segment path that does not fit is refused");
+    archive_segment_path(path, sizeof(path), TEST_ARCHIVE_DIR, 3, "idx");
+    ASSERT_TEST(access(path, F_OK) == 0, "Reopened archive rotates to new segments");
+    ASSERT_TEST(count_matches("rotated", NULL) == 10, "Query covers all segments");
+    ASSERT_TEST(count_matches("without newline", NULL) == 1, "Incomplete line is archived on close");
+    ASSERT_TEST(count_matches("error", NULL) == 2, "Older segment is still searched");
+}
+
+int main(void) {
+    printf("\n");
+    printf("========================================\n");
+    printf("     DMLOG Archive Tests\n");
+    printf("========================================\n");
+
+    current_trace_level = TRACE_LEVEL_WARN;
+    remove_archive();
+
+    test_write_and_checkpoint();
+    test_term_queries();
+    test_time_range();
+    test_segments();
+
+    remove_archive();
+
+    // Print summary
+    printf("\n");
+    printf("========================================\n");
+    printf("          Test Summary\n");
+    printf("========================================\n");
+    printf("Tests Passed: " COLOR_GREEN "%d" COLOR_RESET "\n", tests_passed);
+    printf("Tests Failed: " COLOR_RED "%d" COLOR_RESET "\n", tests_failed);
+    printf("Total Tests:  %d\n", tests_passed + tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n" COLOR_GREEN "All tests passed!" COLOR_RESET "\n\n");
+        return 0;
+    } else {
+        printf("\n" COLOR_RED "Some tests failed!" COLOR_RESET "\n\n");
+        return 1;
+    }
+}
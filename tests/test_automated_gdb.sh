@@ -13,6 +13,19 @@
 # Usage:
 #   ./test_automated_gdb.sh           # Run all tests
 #   ./test_automated_gdb.sh <number>  # Run specific test by number
+#
+# Extra monitor options can be passed via MONITOR_ARGS, e.g. to compare the
+# input round-trip latency with and without type-ahead input prefetch:
+#   MONITOR_ARGS=--no-prefetch ./test_automated_gdb.sh
+#
+# The same scenarios can be run through dmlog_exporter instead of gdbserver
+# (both ends on localhost, the application is never stopped):
+#   BACKEND=exporter ./test_automated_gdb.sh
+#
+# With TRANSPORT=stdio the monitor starts gdbserver itself and talks to it over
+# a pipe instead of TCP (see the exec: host of dmlog_monitor). The average
+# round trip of the backend requests is reported to compare the transports:
+#   TRANSPORT=stdio ./test_automated_gdb.sh
 
 set -e
 
@@ -20,10 +33,21 @@ SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 BUILD_DIR="${SCRIPT_DIR}/../build"
 TEST_APP="${BUILD_DIR}/tests/test_app_interactive"
 MONITOR="${BUILD_DIR}/tools/monitor/dmlog_monitor"
+EXPORTER="${BUILD_DIR}/tools/exporter/dmlog_exporter"
 SCENARIOS_DIR="${SCRIPT_DIR}/scenarios"
 
 GDB_PORT=1234
+EXPORTER_PORT=4455
+BACKEND=${BACKEND:-gdb}
+TRANSPORT=${TRANSPORT:-tcp}
 MONITOR_TIMEOUT=30  # 1 minute timeout (fallback - app should exit via "exit" command)
+MONITOR_ARGS=${MONITOR_ARGS:-}
+if [ "$BACKEND" = "exporter" ]; then
+    # The application is never stopped - it waits for the monitor instead of overwriting unread logs
+    BACKEND_ARGS="--exporter --port $EXPORTER_PORT --flow-control"
+else
+    BACKEND_ARGS="--gdb --port $GDB_PORT"
+fi
 
 # Color output
 RED='\033[0;31m'
@@ -31,7 +55,7 @@ GREEN='\033[0;32m'
 YELLOW='\033[1;33m'
 NC='\033[0m' # No Color
 
-echo "=== dmlog Automated Integration Test with GDB ==="
+echo "=== dmlog Automated Integration Test with ${BACKEND} backend (${TRANSPORT}) ==="
 echo ""
 
 # Parse command line arguments for specific test number
@@ -55,7 +79,17 @@ if [ ! -f "$MONITOR" ]; then
     exit 1
 fi
 
-if ! command -v gdbserver &> /dev/null; then
+if [ "$BACKEND" = "exporter" ]; then
+    if [ ! -f "$EXPORTER" ]; then
+        echo -e "${RED}ERROR: dmlog_exporter not found at $EXPORTER${NC}"
+        echo "Please build with DMLOG_BUILD_TOOLS=ON"
+        exit 1
+    fi
+    if [ "$TRANSPORT" != "tcp" ]; then
+        echo -e "${RED}ERROR: The exporter backend supports only TRANSPORT=tcp${NC}"
+        exit 1
+    fi
+elif ! command -v gdbserver &> /dev/null; then
     echo -e "${YELLOW}SKIP: gdbserver not found. Install with: apt-get install gdbserver${NC}"
     exit 0
 fi
@@ -64,6 +98,10 @@ fi
 TESTS_RUN=0
 TESTS_PASSED=0
 TESTS_FAILED=0
+TOTAL_LATENCY_MS=0
+TOTAL_INPUTS=0
+TOTAL_REQUEST_US=0
+TOTAL_REQUESTS=0
 
 # Cleanup function
 cleanup() {
@@ -134,6 +172,17 @@ run_test() {
             print "File receive successful"
             next
         }
+        /<batch_send:|<batch_recv:/ {
+            # Extract <batch_send:dir:src,src,...> - mawk compatible
+            send = ($0 ~ /<batch_send:/)
+            gsub(/<batch_(send|recv):/, "", $0)
+            gsub(/>/, "", $0)
+            split($0, parts, ":")
+            count = split(parts[2], files, ",")
+            print (send ? "Sending" : "Receiving") " batch: " count " files -> " parts[1]
+            print "Batch " (send ? "send" : "receive") " successful"
+            next
+        }
         { print }
     ' "$scenario_file" > "$expected_output"
     
@@ -154,22 +203,52 @@ run_test() {
         echo "Host file for firmware" > /tmp/test_host_file.txt
     fi
     
-    echo "Step 1: Starting gdbserver with test application..."
-    echo "application output at: $app_output"
-    gdbserver --once :${GDB_PORT} "$TEST_APP" "$scenario_file" "$buffer_size" &
-    local GDBSERVER_PID=$!
-    
-    # Wait for gdbserver to be ready
-    sleep 2
-    
-    if ! kill -0 $GDBSERVER_PID 2>/dev/null; then
-        echo -e "${RED}✗ FAILED: gdbserver failed to start${NC}"
-        cat "$app_output"
-        TESTS_FAILED=$((TESTS_FAILED + 1))
-        return 1
+    if grep -q "<batch_send:\|<batch_recv:" "$scenario_file"; then
+        rm -rf /tmp/dmlog_batch_fw /tmp/dmlog_batch_host /tmp/dmlog_batch_fw_received
+        mkdir -p /tmp/dmlog_batch_fw /tmp/dmlog_batch_host /tmp/dmlog_batch_fw_received
+        echo "Small batch file" > /tmp/dmlog_batch_fw/a.txt
+        : > /tmp/dmlog_batch_fw/b.txt
+        seq 1 500 > /tmp/dmlog_batch_fw/c.txt
+    fi
+
+    if grep -q "/tmp/dmlog_compress_host.log" "$scenario_file"; then
+        # Log alike data spanning many windows of the firmware
+        for i in $(seq 1 2000); do
+            echo "[INFO] $i: sensor reading $((i % 17)) within limits, queue depth $((i % 5))"
+        done > /tmp/dmlog_compress_host.log
+        rm -f /tmp/dmlog_compress_fw.log
     fi
     
-    echo "   gdbserver started (PID: $GDBSERVER_PID)"
+    local backend_args=($BACKEND_ARGS)
+    local GDBSERVER_PID=""
+    if [ "$TRANSPORT" = "stdio" ]; then
+        # The monitor starts gdbserver on its stdin/stdout; the output of the
+        # application goes to the stderr of gdbserver
+        echo "Step 1: gdbserver is started by the monitor over stdio"
+        echo "application output at: $app_output"
+        backend_args+=(--host "exec:exec gdbserver stdio '$TEST_APP' '$scenario_file' '$buffer_size' 2> '$app_output'")
+    else
+        echo "Step 1: Starting ${BACKEND} server with test application..."
+        echo "application output at: $app_output"
+        if [ "$BACKEND" = "exporter" ]; then
+            "$EXPORTER" --once --bind 127.0.0.1 --port ${EXPORTER_PORT} -- "$TEST_APP" "$scenario_file" "$buffer_size" > "$app_output" 2>&1 &
+        else
+            gdbserver --once :${GDB_PORT} "$TEST_APP" "$scenario_file" "$buffer_size" > "$app_output" 2>&1 &
+        fi
+        GDBSERVER_PID=$!
+
+        # Wait for the server to be ready
+        sleep 2
+
+        if ! kill -0 $GDBSERVER_PID 2>/dev/null; then
+            echo -e "${RED}✗ FAILED: ${BACKEND} server failed to start${NC}"
+            cat "$app_output"
+            TESTS_FAILED=$((TESTS_FAILED + 1))
+            return 1
+        fi
+
+        echo "   ${BACKEND} server started (PID: $GDBSERVER_PID)"
+    fi
     
     # Get buffer address from test app using nm
     # Since we build with -no-pie, the address is fixed and predictable
@@ -201,23 +280,52 @@ run_test() {
         echo "With input file at: $input_data"
         
         # Run monitor with input file
-        timeout $MONITOR_TIMEOUT "$MONITOR" --gdb --port $GDB_PORT --addr $BUFFER_ADDR --time --input-file "$input_data" > "$test_output" 2>&1 &
+        timeout $MONITOR_TIMEOUT "$MONITOR" "${backend_args[@]}" --addr $BUFFER_ADDR --time --input-file "$input_data" $MONITOR_ARGS > "$test_output" 2>&1 &
     else
         echo "   No input required for this test."
 
         # Run monitor without input for output-only tests
-        timeout $MONITOR_TIMEOUT "$MONITOR" --gdb --port $GDB_PORT --addr $BUFFER_ADDR > "$test_output" 2>&1 &
+        timeout $MONITOR_TIMEOUT "$MONITOR" "${backend_args[@]}" --addr $BUFFER_ADDR $MONITOR_ARGS > "$test_output" 2>&1 &
     fi
     
     local MONITOR_PID=$!
+    local start_time=$(date +%s%N)
     
     echo "   Monitor started (PID: $MONITOR_PID), running for ${MONITOR_TIMEOUT}s..."
     
     # Wait for monitor to complete (with timeout)
     wait $MONITOR_PID 2>/dev/null || true
+    local elapsed_ms=$(( ($(date +%s%N) - start_time) / 1000000 ))
     
     echo "Step 3: Cleaning up..."
     cleanup $GDBSERVER_PID ""
+
+    # Report timing - the test app logs the round trip of every input request
+    # (from dmlog_input_request() until the input is available)
+    echo "   Monitor session time: ${elapsed_ms} ms"
+    local latencies=$(grep -o "Input latency: [0-9.]*" "$app_output" 2>/dev/null | awk '{print $3}')
+    if [ -n "$latencies" ]; then
+        echo "   Input round trips (ms): $(echo $latencies)"
+        # The first request includes the monitor start-up, so it is reported separately
+        local stats=$(echo "$latencies" | awk 'NR > 1 { sum += $1; n++ } END { if (n > 0) printf "%d %.1f", n, sum / n; else print "0 0" }')
+        local count=${stats% *}
+        local average=${stats#* }
+        if [ "$count" -gt 0 ]; then
+            echo "   Average round trip after the first input: ${average} ms"
+            TOTAL_LATENCY_MS=$(awk -v a="$TOTAL_LATENCY_MS" -v b="$average" -v n="$count" 'BEGIN { printf "%.1f", a + b * n }')
+            TOTAL_INPUTS=$((TOTAL_INPUTS + count))
+        fi
+    fi
+
+    # The monitor reports the round trips of its backend requests on exit
+    local round_trips=$(grep -o "Backend round trips: [0-9]* requests, average [0-9.]*" "$test_output" 2>/dev/null | tail -1)
+    if [ -n "$round_trips" ]; then
+        local requests=$(echo "$round_trips" | awk '{ print $4 }')
+        local request_us=$(echo "$round_trips" | awk '{ print $7 }')
+        echo "   Backend requests: $requests, average round trip ${request_us} us"
+        TOTAL_REQUEST_US=$(awk -v a="$TOTAL_REQUEST_US" -v b="$request_us" -v n="$requests" 'BEGIN { printf "%.1f", a + b * n }')
+        TOTAL_REQUESTS=$((TOTAL_REQUESTS + requests))
+    fi
     
     # Wait a bit for port to be released
     sleep 2
@@ -255,6 +363,26 @@ run_test() {
     echo ""
     echo "Summary: Found $found_count/$expected_count expected messages"
     
+    # Files of a batch sent to the host and back must arrive unchanged
+    if grep -q "<batch_recv:" "$scenario_file"; then
+        if diff -r /tmp/dmlog_batch_fw /tmp/dmlog_batch_fw_received > /dev/null; then
+            echo -e "   ${GREEN}✓${NC} Batch files are unchanged after the round trip"
+        else
+            echo -e "   ${RED}✗${NC} Batch files differ after the round trip"
+            all_found=false
+        fi
+    fi
+
+    # Compressed chunks must decode to the file of the host
+    if grep -q "/tmp/dmlog_compress_host.log" "$scenario_file"; then
+        if cmp -s /tmp/dmlog_compress_host.log /tmp/dmlog_compress_fw.log; then
+            echo -e "   ${GREEN}✓${NC} Compressed file is received unchanged"
+        else
+            echo -e "   ${RED}✗${NC} Compressed file differs on the firmware"
+            all_found=false
+        fi
+    fi
+    
     if [ "$all_found" = true ]; then
         echo -e "${GREEN}✓ PASSED${NC}: $scenario_name"
         TESTS_PASSED=$((TESTS_PASSED + 1))
@@ -318,6 +446,12 @@ maybe_run_test 6 "$SCENARIOS_DIR/test_file_recv.txt" 4096
 # Test 7: Bidirectional file transfer
 maybe_run_test 7 "$SCENARIOS_DIR/test_file_bidirectional.txt" 4096
 
+# Test 8: Batch file transfer
+maybe_run_test 8 "$SCENARIOS_DIR/test_file_batch.txt" 4096
+
+# Test 9: Compressed file receive (Host -> FW)
+maybe_run_test 9 "$SCENARIOS_DIR/test_file_compressed.txt" 4096
+
 # Print final summary
 echo ""
 echo "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━"
@@ -330,6 +464,12 @@ if [ $TESTS_FAILED -gt 0 ]; then
 else
     echo "Tests failed:       0"
 fi
+if [ $TOTAL_INPUTS -gt 0 ]; then
+    echo "Input round trip:   $(awk -v t="$TOTAL_LATENCY_MS" -v n="$TOTAL_INPUTS" 'BEGIN { printf "%.1f", t / n }') ms average over $TOTAL_INPUTS inputs${MONITOR_ARGS:+ ($MONITOR_ARGS)}"
+fi
+if [ $TOTAL_REQUESTS -gt 0 ]; then
+    echo "Request round trip: $(awk -v t="$TOTAL_REQUEST_US" -v n="$TOTAL_REQUESTS" 'BEGIN { printf "%.1f", t / n }') us average over $TOTAL_REQUESTS requests (${BACKEND}, ${TRANSPORT})"
+fi
 echo "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━"
 
 if [ $TESTS_FAILED -gt 0 ]; then
@@ -1,6 +1,7 @@
 #include "dmlog.h"
 #include "test_common.h"
 #include <string.h>
+#include <stdint.h>
 #include <time.h>
 #include <sys/time.h>
 
@@ -206,6 +207,115 @@ static void test_benchmark_wraparound(void) {
     dmlog_destroy(ctx);
 }
 
+// Writes a line to the input ring the way the monitor does
+static void put_input_line(dmlog_ctx_t ctx, const char* line, size_t length) {
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+    dmlog_host_t* host = (dmlog_host_t*)(uintptr_t)ring->host;
+    uint8_t* input = (uint8_t*)(uintptr_t)ring->input_buffer;
+    dmlog_index_t head = host->input_head_offset;
+    for (size_t i = 0; i < length; i++) {
+        input[head] = (uint8_t)line[i];
+        head = (head + 1) % ring->input_buffer_size;
+    }
+    host->input_head_offset = head;
+}
+
+// Test: Cost of a byte through every public write and read call
+static void test_benchmark_per_byte(void) {
+    TEST_SECTION("Benchmark: Per Byte Cost of the Public API");
+
+    memset(test_buffer, 0, TEST_BUFFER_SIZE);
+    dmlog_ctx_t ctx = dmlog_create(test_buffer, TEST_BUFFER_SIZE);
+    ASSERT_TEST(ctx != NULL, "Create context for per byte benchmark");
+
+    static const char line[] = "[INFO] sensor 42: reading within limits, queue depth 3, ok\n";
+    const size_t length = sizeof(line) - 1;
+    const int ROUNDS = 20000;
+    const double bytes = (double)ROUNDS * length;
+    char read_buf[256];
+
+    double start_time = get_time_us();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < length; i++) {
+            dmlog_putc(ctx, line[i]);
+        }
+    }
+    double putc_ns = (get_time_us() - start_time) * 1000.0 / bytes;
+
+    start_time = get_time_us();
+    for (int r = 0; r < ROUNDS; r++) {
+        dmlog_puts(ctx, line);
+    }
+    double puts_ns = (get_time_us() - start_time) * 1000.0 / bytes;
+
+    start_time = get_time_us();
+    for (int r = 0; r < ROUNDS; r++) {
+        dmlog_putsn(ctx, line, length);
+    }
+    double putsn_ns = (get_time_us() - start_time) * 1000.0 / bytes;
+
+    // Reads are timed in batches that fit in the ring
+    const int BATCH = 2000;
+    double getc_us = 0;
+    double gets_us = 0;
+    bool intact = true;
+    for (int r = 0; r < ROUNDS; r += BATCH) {
+        dmlog_clear(ctx);
+        for (int i = 0; i < BATCH; i++) {
+            dmlog_puts(ctx, line);
+        }
+        start_time = get_time_us();
+        for (int i = 0; i < BATCH / 2; i++) {
+            size_t n = 0;
+            dmlog_read_next(ctx);
+            while (n < sizeof(read_buf) - 1 && (read_buf[n] = dmlog_getc(ctx)) != '\n') {
+                n++;
+            }
+            intact = intact && n == length - 1;
+        }
+        getc_us += get_time_us() - start_time;
+        start_time = get_time_us();
+        for (int i = 0; i < BATCH / 2; i++) {
+            dmlog_read_next(ctx);
+            intact = dmlog_gets(ctx, read_buf, sizeof(read_buf)) && intact && strcmp(read_buf, line) == 0;
+        }
+        gets_us += get_time_us() - start_time;
+    }
+    double getc_ns = getc_us * 1000.0 / (bytes / 2);
+    double gets_ns = gets_us * 1000.0 / (bytes / 2);
+
+    double input_getc_us = 0;
+    double input_gets_us = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        put_input_line(ctx, line, length);
+        start_time = get_time_us();
+        if (r % 2 == 0) {
+            size_t n = 0;
+            while (n < sizeof(read_buf) - 1 && (read_buf[n] = dmlog_input_getc(ctx)) != '\n') {
+                n++;
+            }
+            input_getc_us += get_time_us() - start_time;
+            intact = intact && n == length - 1;
+        } else {
+            intact = dmlog_input_gets(ctx, read_buf, sizeof(read_buf)) && intact && strcmp(read_buf, line) == 0;
+            input_gets_us += get_time_us() - start_time;
+        }
+    }
+    double input_getc_ns = input_getc_us * 1000.0 / (bytes / 2);
+    double input_gets_ns = input_gets_us * 1000.0 / (bytes / 2);
+
+    ASSERT_TEST(intact, "Every line is read back intact");
+    TEST_BENCH("dmlog_putc:       %.2f ns/byte", putc_ns);
+    TEST_BENCH("dmlog_puts:       %.2f ns/byte", puts_ns);
+    TEST_BENCH("dmlog_putsn:      %.2f ns/byte", putsn_ns);
+    TEST_BENCH("dmlog_getc:       %.2f ns/byte (with dmlog_read_next)", getc_ns);
+    TEST_BENCH("dmlog_gets:       %.2f ns/byte (with dmlog_read_next)", gets_ns);
+    TEST_BENCH("dmlog_input_getc: %.2f ns/byte", input_getc_ns);
+    TEST_BENCH("dmlog_input_gets: %.2f ns/byte", input_gets_ns);
+
+    dmlog_destroy(ctx);
+}
+
 int main(void) {
     printf("\n");
     printf("========================================\n");
@@ -217,6 +327,7 @@ int main(void) {
     test_benchmark_varying_sizes();
     test_benchmark_read_performance();
     test_benchmark_wraparound();
+    test_benchmark_per_byte();
     
     // Print summary
     printf("\n");
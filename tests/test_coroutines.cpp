@@ -0,0 +1,349 @@
+#include "dmlog.hpp"
+#include "test_common.h"
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+// Test counters
+int tests_passed = 0;
+int tests_failed = 0;
+
+#define TEST_BUFFER_SIZE (8 * 1024)  // 8KB for tests
+static char test_buffer[TEST_BUFFER_SIZE];
+
+#define TEST_SEND_FILE      "test_coroutines_send.bin"
+#define TEST_SEND_FILE_2    "test_coroutines_send_2.bin"
+#define TEST_RECV_FILE      "test_coroutines_recv.bin"
+
+// Minimal coroutine type - started eagerly, destroyed when it returns
+struct task {
+    struct promise_type {
+        task get_return_object() { return task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+
+static dmlog_ctx_t create_test_context(void) {
+    memset(test_buffer, 0, TEST_BUFFER_SIZE);
+    dmlog_ctx_t ctx = dmlog_create(test_buffer, TEST_BUFFER_SIZE);
+    if (ctx) {
+        dmlog_clear(ctx);
+    }
+    return ctx;
+}
+
+// Simulates the monitor sending a line of input
+static void host_send_input(dmlog_ctx_t ctx, const char* data) {
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+    dmlog_host_t* host = (dmlog_host_t*)((uintptr_t)ring->host);
+    uint8_t* input_buffer = (uint8_t*)((uintptr_t)ring->input_buffer);
+    uint32_t input_head = host->input_head_offset;
+    for (size_t i = 0; data[i] != '\0'; i++) {
+        input_buffer[input_head] = (uint8_t)data[i];
+        input_head = (input_head + 1) % ring->input_buffer_size;
+    }
+    host->input_head_offset = input_head;
+    host->input_serviced = ring->input_request;
+}
+
+// Simulates the monitor servicing one chunk of a file transfer
+// Returns the address of the serviced transfer, 0 if nothing was requested
+static uint64_t host_service_chunk(dmlog_ctx_t ctx, std::string& sent, const std::string& received) {
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+    dmlog_host_t* host = (dmlog_host_t*)((uintptr_t)ring->host);
+    dmlog_file_transfer_t* transfer = (dmlog_file_transfer_t*)((uintptr_t)ring->file_transfer);
+    uint8_t* buffer = transfer ? (uint8_t*)((uintptr_t)transfer->buffer_address) : NULL;
+    if (ring->file_request == host->file_serviced) {
+        return 0;
+    }
+    if (ring->flags & DMLOG_FLAG_FILE_SEND_REQ) {
+        sent.append((const char*)buffer, transfer->chunk_size);
+        host->file_serviced = ring->file_request;
+        return ring->file_transfer;
+    }
+    if (ring->flags & DMLOG_FLAG_FILE_RECV_REQ) {
+        size_t left = received.size() - transfer->offset;
+        transfer->total_size = (uint32_t)received.size();
+        transfer->chunk_size = (uint32_t)(left < transfer->chunk_size ? left : transfer->chunk_size);
+        memcpy(buffer, received.data() + transfer->offset, transfer->chunk_size);
+        host->file_serviced = ring->file_request;
+        return ring->file_transfer;
+    }
+    return 0;
+}
+
+static std::string make_file(const char* path, size_t size) {
+    std::string content;
+    for (size_t i = 0; i < size; i++) {
+        content.push_back((char)('a' + i % 26));
+    }
+    FILE* file = fopen(path, "wb");
+    fwrite(content.data(), 1, content.size(), file);
+    fclose(file);
+    return content;
+}
+
+static std::string read_file(const char* path) {
+    std::string content;
+    FILE* file = fopen(path, "rb");
+    if (file) {
+        char chunk[256];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            content.append(chunk, n);
+        }
+        fclose(file);
+    }
+    return content;
+}
+
+static task reader(dmlog_ctx_t ctx, std::string* out, int* done) {
+    dmlog::line line = co_await dmlog::read_line(ctx);
+    *out = std::string(line.view());
+    (*done)++;
+}
+
+static task sender(dmlog_ctx_t ctx, const char* src, const char* dst, int* result) {
+    *result = (co_await dmlog::send_file(ctx, src, dst)) ? 1 : 0;
+}
+
+static task receiver(dmlog_ctx_t ctx, const char* src, const char* dst, int* result) {
+    *result = (co_await dmlog::receive_file(ctx, src, dst)) ? 1 : 0;
+}
+
+static task batch_sender(dmlog_ctx_t ctx, dmlog_file_batch_entry_t* files, size_t count, int* result) {
+    *result = (co_await dmlog::send_files(ctx, files, count, "host")) ? 1 : 0;
+}
+
+// Test: Reading a line that is already available does not suspend
+static void test_read_line_ready(void) {
+    TEST_SECTION("Read line - input available");
+    dmlog_ctx_t ctx = create_test_context();
+    host_send_input(ctx, "ready\n");
+
+    std::string out;
+    int done = 0;
+    reader(ctx, &out, &done);
+    ASSERT_TEST(done == 1, "Coroutine completes without suspending");
+    ASSERT_TEST(out == "ready\n", "Line is read");
+    ASSERT_TEST(dmlog::poll() == 0, "Nothing to resume");
+    dmlog_destroy(ctx);
+}
+
+// Test: Reading a line suspends until the host sends it
+static void test_read_line_suspends(void) {
+    TEST_SECTION("Read line - waits for the host");
+    dmlog_ctx_t ctx = create_test_context();
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+
+    std::string out;
+    int done = 0;
+    reader(ctx, &out, &done);
+    ASSERT_TEST(done == 0, "Coroutine is suspended");
+    ASSERT_TEST((ring->flags & DMLOG_FLAG_INPUT_REQUESTED) != 0, "Input is requested");
+    ASSERT_TEST(dmlog::poll() == 0, "Not resumed without input");
+
+    host_send_input(ctx, "hello\n");
+    ASSERT_TEST(dmlog::poll() == 1, "Resumed when input arrives");
+    ASSERT_TEST(done == 1 && out == "hello\n", "Line is read");
+    dmlog_destroy(ctx);
+}
+
+// Test: Waiting readers get the lines in order
+static void test_read_line_order(void) {
+    TEST_SECTION("Read line - several readers");
+    dmlog_ctx_t ctx = create_test_context();
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+
+    std::string first, second;
+    int done = 0;
+    reader(ctx, &first, &done);
+    reader(ctx, &second, &done);
+    ASSERT_TEST(done == 0, "Both coroutines are suspended");
+
+    host_send_input(ctx, "one\n");
+    ASSERT_TEST(dmlog::poll() == 1, "One reader resumed for one line");
+    ASSERT_TEST(first == "one\n", "First reader gets the first line");
+    ASSERT_TEST((ring->flags & DMLOG_FLAG_INPUT_REQUESTED) != 0, "Input is requested again for the second reader");
+
+    host_send_input(ctx, "two\n");
+    ASSERT_TEST(dmlog::poll() == 1, "Second reader resumed");
+    ASSERT_TEST(second == "two\n" && done == 2, "Second reader gets the second line");
+    dmlog_destroy(ctx);
+}
+
+// Test: Destroying a suspended coroutine removes its waiter
+static void test_read_line_destroyed(void) {
+    TEST_SECTION("Read line - destroyed while suspended");
+    dmlog_ctx_t ctx = create_test_context();
+
+    std::string out;
+    int done = 0;
+    task t = reader(ctx, &out, &done);
+    t.handle.destroy();
+
+    host_send_input(ctx, "kept\n");
+    ASSERT_TEST(dmlog::poll() == 0, "Destroyed coroutine is not resumed");
+    ASSERT_TEST(dmlog_input_available(ctx), "Input is left for other readers");
+    dmlog_destroy(ctx);
+}
+
+// Test: Sending a file suspends between the chunks
+static void test_send_file(void) {
+    TEST_SECTION("Send file");
+    dmlog_ctx_t ctx = create_test_context();
+    std::string content = make_file(TEST_SEND_FILE, DMLOG_FILE_TRANSFER_CHUNK_SIZE * 2 + 100);
+
+    int result = -1;
+    sender(ctx, TEST_SEND_FILE, "host.bin", &result);
+    ASSERT_TEST(result == -1, "Coroutine is suspended");
+
+    std::string sent;
+    int chunks = 0;
+    for (int i = 0; i < 10 && result == -1; i++) {
+        if (host_service_chunk(ctx, sent, "") != 0) {
+            chunks++;
+        }
+        dmlog::poll();
+    }
+    ASSERT_TEST(result == 1, "Transfer succeeded");
+    ASSERT_TEST(chunks == 3, "File sent in 3 chunks");
+    ASSERT_TEST(sent == content, "Host received the file");
+    ASSERT_TEST(((dmlog_ring_t*)ctx)->file_transfer == 0, "Ring released");
+
+    remove(TEST_SEND_FILE);
+    dmlog_destroy(ctx);
+}
+
+// Test: Receiving a file suspends between the chunks
+static void test_receive_file(void) {
+    TEST_SECTION("Receive file");
+    dmlog_ctx_t ctx = create_test_context();
+    std::string content;
+    for (size_t i = 0; i < DMLOG_FILE_TRANSFER_CHUNK_SIZE + 10; i++) {
+        content.push_back((char)('A' + i % 26));
+    }
+
+    int result = -1;
+    receiver(ctx, "host.bin", TEST_RECV_FILE, &result);
+    ASSERT_TEST(result == -1, "Coroutine is suspended");
+
+    std::string unused;
+    for (int i = 0; i < 10 && result == -1; i++) {
+        host_service_chunk(ctx, unused, content);
+        dmlog::poll();
+    }
+    ASSERT_TEST(result == 1, "Transfer succeeded");
+    ASSERT_TEST(read_file(TEST_RECV_FILE) == content, "File written on the target");
+
+    remove(TEST_RECV_FILE);
+    dmlog_destroy(ctx);
+}
+
+// Test: Transfers wait for each other
+static void test_concurrent_transfers(void) {
+    TEST_SECTION("Concurrent transfers");
+    dmlog_ctx_t ctx = create_test_context();
+    std::string first = make_file(TEST_SEND_FILE, DMLOG_FILE_TRANSFER_CHUNK_SIZE + 1);
+    std::string second = make_file(TEST_SEND_FILE_2, 10);
+
+    int result_1 = -1;
+    int result_2 = -1;
+    sender(ctx, TEST_SEND_FILE, "first.bin", &result_1);
+    sender(ctx, TEST_SEND_FILE_2, "second.bin", &result_2);
+
+    std::string sent;
+    uint64_t transfers[8] = {0};
+    int chunks = 0;
+    for (int i = 0; i < 10 && (result_1 == -1 || result_2 == -1); i++) {
+        uint64_t transfer = host_service_chunk(ctx, sent, "");
+        if (transfer != 0 && chunks < 8) {
+            transfers[chunks++] = transfer;
+        }
+        dmlog::poll();
+    }
+    ASSERT_TEST(result_1 == 1 && result_2 == 1, "Both transfers succeeded");
+    ASSERT_TEST(chunks == 3, "3 chunks serviced");
+    ASSERT_TEST(transfers[0] == transfers[1] && transfers[1] != transfers[2], "Second transfer waits for the first one");
+    ASSERT_TEST(sent == first + second, "Files are not interleaved");
+
+    remove(TEST_SEND_FILE);
+    remove(TEST_SEND_FILE_2);
+    dmlog_destroy(ctx);
+}
+
+// Test: A batch of files is sent through one transfer
+static void test_send_files(void) {
+    TEST_SECTION("Send files");
+    dmlog_ctx_t ctx = create_test_context();
+    std::string first = make_file(TEST_SEND_FILE, 100);
+    std::string second = make_file(TEST_SEND_FILE_2, 10);
+    dmlog_file_batch_entry_t files[] = {
+        { TEST_SEND_FILE, nullptr, 1 },
+        { TEST_SEND_FILE_2, nullptr, 1 },
+    };
+
+    int result = -1;
+    batch_sender(ctx, files, 2, &result);
+    ASSERT_TEST(result == -1, "Coroutine is suspended");
+
+    std::string sent;
+    int chunks = 0;
+    for (int i = 0; i < 10 && result == -1; i++) {
+        if (host_service_chunk(ctx, sent, "") != 0) {
+            chunks++;
+        }
+        dmlog::poll();
+    }
+    ASSERT_TEST(result == 1 && files[0].status == 0 && files[1].status == 0, "Batch succeeded");
+    ASSERT_TEST(chunks == 1, "Both files sent in 1 chunk");
+    ASSERT_TEST(sent.size() == 2 * sizeof(dmlog_file_batch_header_t) + first.size() + second.size() &&
+                sent.substr(sizeof(dmlog_file_batch_header_t), first.size()) == first, "Host received the stream of the files");
+
+    remove(TEST_SEND_FILE);
+    remove(TEST_SEND_FILE_2);
+    dmlog_destroy(ctx);
+}
+
+// Test: A transfer that cannot start completes immediately
+static void test_transfer_failure(void) {
+    TEST_SECTION("Transfer failure");
+    dmlog_ctx_t ctx = create_test_context();
+
+    int result = -1;
+    sender(ctx, "test_coroutines_missing.bin", "host.bin", &result);
+    ASSERT_TEST(result == 0, "Missing file fails without suspending");
+    ASSERT_TEST(dmlog::poll() == 0, "Nothing to resume");
+    dmlog_destroy(ctx);
+}
+
+int main(void) {
+    printf("Running dmlog coroutine tests...\n\n");
+
+    test_read_line_ready();
+    test_read_line_suspends();
+    test_read_line_order();
+    test_read_line_destroyed();
+    test_send_file();
+    test_receive_file();
+    test_concurrent_transfers();
+    test_send_files();
+    test_transfer_failure();
+
+    // Print summary
+    printf("\n");
+    printf("=====================================\n");
+    printf("Test Summary:\n");
+    printf("  Passed: %d\n", tests_passed);
+    printf("  Failed: %d\n", tests_failed);
+    printf("  Total:  %d\n", tests_passed + tests_failed);
+    printf("=====================================\n");
+
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -2,6 +2,7 @@
 #include "test_common.h"
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
 
 // Test counters
 int tests_passed = 0;
@@ -474,6 +475,702 @@ static void test_invalid_context(void) {
     TEST_INFO("NULL context operations handled gracefully");
 }
 
+// Simulated write-back cache: cache_buffer is what the CPU sees, cache_memory
+// what the debug probe sees. Whole lines are cleaned and invalidated.
+#define CACHE_TEST_BUFFER_SIZE (4 * 1024)
+static uint8_t cache_buffer[CACHE_TEST_BUFFER_SIZE] __attribute__((aligned(DMLOG_CACHE_LINE_SIZE)));
+static uint8_t cache_memory[CACHE_TEST_BUFFER_SIZE];
+static int cache_cleans = 0;
+static int cache_invalidates = 0;
+static void (*probe_write)(void) = NULL;    // Called once by the next clean, while the firmware holds the ring
+
+static void cache_line_range(volatile void* address, size_t size, size_t* start, size_t* end) {
+    size_t offset = (size_t)((uintptr_t)address - (uintptr_t)cache_buffer);
+    *start = offset - offset % DMLOG_CACHE_LINE_SIZE;
+    *end = offset + size + DMLOG_CACHE_LINE_SIZE - 1;
+    *end -= *end % DMLOG_CACHE_LINE_SIZE;
+    if (*end > CACHE_TEST_BUFFER_SIZE) {
+        *end = CACHE_TEST_BUFFER_SIZE;
+    }
+}
+
+static void test_cache_clean(volatile void* address, size_t size) {
+    if (probe_write != NULL) {
+        void (*write)(void) = probe_write;
+        probe_write = NULL;
+        write();
+    }
+    size_t start, end;
+    cache_line_range(address, size, &start, &end);
+    memcpy(&cache_memory[start], &cache_buffer[start], end - start);
+    cache_cleans++;
+}
+
+static void test_cache_invalidate(volatile void* address, size_t size) {
+    size_t start, end;
+    cache_line_range(address, size, &start, &end);
+    memcpy(&cache_buffer[start], &cache_memory[start], end - start);
+    cache_invalidates++;
+}
+
+// Input the probe writes to memory behind the back of the firmware
+static void probe_write_input(void) {
+    dmlog_ring_t* probe_ring = (dmlog_ring_t*)cache_memory;
+    dmlog_host_t* probe_host = (dmlog_host_t*)&cache_memory[(size_t)(probe_ring->host - (uintptr_t)cache_buffer)];
+    uint8_t* probe_input = &cache_memory[(size_t)(probe_ring->input_buffer - (uintptr_t)cache_buffer)];
+    memcpy(&probe_input[probe_host->input_head_offset], "go\n", 3);
+    probe_host->input_head_offset += 3;
+    probe_host->input_serviced = probe_ring->input_request;
+}
+
+// Test: Cache maintenance hooks
+static void test_cache_hooks(void) {
+    TEST_SECTION("Cache Maintenance Hooks");
+
+    memset(cache_buffer, 0, sizeof(cache_buffer));
+    memset(cache_memory, 0, sizeof(cache_memory));
+    dmlog_set_cache_ops(test_cache_clean, test_cache_invalidate);
+
+    dmlog_ctx_t ctx = dmlog_create(cache_buffer, sizeof(cache_buffer));
+    ASSERT_TEST(ctx != NULL, "Create context in cached memory");
+    ASSERT_TEST(cache_cleans > 0, "Clean hook called on creation");
+
+    // Everything published must be visible to the probe, also after wrap-around
+    dmlog_ring_t* ring = (dmlog_ring_t*)cache_buffer;
+    dmlog_ring_t* probe_ring = (dmlog_ring_t*)cache_memory;
+    size_t output_offset = (size_t)(ring->buffer - (uintptr_t)cache_buffer);
+    char msg[64];
+    bool visible = true;
+    for (int i = 0; i < 200; i++) {
+        snprintf(msg, sizeof(msg), "Cached entry number %d\n", i);
+        dmlog_puts(ctx, msg);
+        visible = visible && probe_ring->head_offset == ring->head_offset &&
+                  probe_ring->tail_offset == ring->tail_offset &&
+                  memcmp(&cache_memory[output_offset], &cache_buffer[output_offset], ring->buffer_size) == 0;
+    }
+    ASSERT_TEST(visible, "Published entries are written back to memory");
+    ASSERT_TEST((probe_ring->flags & DMLOG_FLAG_BUSY) == 0, "BUSY flag is released in memory");
+
+    // Oldest entries are overwritten, the newest one is complete
+    char last[256] = "";
+    char read_buf[256];
+    while (dmlog_read_next(ctx)) {
+        if (dmlog_gets(ctx, read_buf, sizeof(read_buf))) {
+            strcpy(last, read_buf);
+        }
+    }
+    ASSERT_TEST(strcmp(last, "Cached entry number 199\n") == 0, "Newest entry read back after wrap-around");
+
+    // The probe writes input while the firmware is logging
+    size_t host_offset = (size_t)(ring->host - (uintptr_t)cache_buffer);
+    dmlog_host_t* probe_host = (dmlog_host_t*)&cache_memory[host_offset];
+    ASSERT_TEST(((uintptr_t)ring->input_buffer % DMLOG_CACHE_LINE_SIZE) == 0, "Input buffer starts on a cache line");
+    ASSERT_TEST(host_offset % DMLOG_CACHE_LINE_SIZE == 0 && host_offset >= sizeof(dmlog_ring_t),
+                "Host control block starts on a cache line of its own");
+    dmlog_input_request(ctx, DMLOG_INPUT_REQUEST_FLAG_LINE_MODE);
+    ASSERT_TEST((probe_ring->flags & DMLOG_FLAG_INPUT_REQUESTED) != 0, "Input request is written back to memory");
+    dmlog_index_t input_head = probe_host->input_head_offset;
+    probe_write = probe_write_input;
+    dmlog_puts(ctx, "Logged while the probe writes input\n");
+    ASSERT_TEST(probe_write == NULL, "Probe wrote while the firmware was logging");
+    ASSERT_TEST(probe_host->input_head_offset == input_head + 3 && probe_host->input_serviced == probe_ring->input_request,
+                "Writes of the probe survive the write back of the header");
+    dmlog_puts(ctx, "Logged after the probe wrote input\n");
+    ASSERT_TEST((probe_ring->flags & DMLOG_FLAG_INPUT_REQUESTED) == 0, "Serviced input request is retired");
+    cache_invalidates = 0;
+    ASSERT_TEST(dmlog_input_available(ctx), "Input written by the probe is available");
+    char input[16];
+    ASSERT_TEST(dmlog_input_gets(ctx, input, sizeof(input)) && strcmp(input, "go\n") == 0, "Input written by the probe is read");
+    ASSERT_TEST(cache_invalidates > 0, "Invalidate hook called before reading input");
+
+    dmlog_destroy(ctx);
+    dmlog_set_cache_ops(NULL, NULL);
+}
+
+#define FLOW_TEST_BUFFER_SIZE 2048
+#define FLOW_TEST_ENTRIES 100
+static uint8_t flow_buffer[FLOW_TEST_BUFFER_SIZE] __attribute__((aligned(DMLOG_CACHE_LINE_SIZE)));
+static char flow_received[FLOW_TEST_ENTRIES * 64];
+static size_t flow_received_length = 0;
+static int flow_waits = 0;
+static bool flow_busy_while_waiting = false;
+
+// Host that reads a few bytes of the ring whenever the firmware reloads the host control block
+static void flow_host_read(volatile void* address, size_t size) {
+    dmlog_ring_t* ring = (dmlog_ring_t*)flow_buffer;
+    dmlog_host_t* host = (dmlog_host_t*)(uintptr_t)ring->host;
+    if (address != (volatile void*)host || !(host->flags & DMLOG_FLAG_FLOW_CONTROL)) {
+        return;
+    }
+    const uint8_t* output = (const uint8_t*)(uintptr_t)ring->buffer;
+    for (int i = 0; i < 16 && host->tail_offset != ring->head_offset; i++) {
+        flow_received[flow_received_length++] = (char)output[host->tail_offset];
+        host->tail_offset = (host->tail_offset + 1) % ring->buffer_size;
+    }
+    flow_waits++;
+    flow_busy_while_waiting = flow_busy_while_waiting || (ring->flags & DMLOG_FLAG_BUSY) != 0;
+}
+
+static void flow_host_clean(volatile void* address, size_t size) {
+}
+
+// Test: The firmware waits for the host instead of overwriting unread entries
+static void test_flow_control(void) {
+    TEST_SECTION("Flow Control");
+
+    dmlog_set_cache_ops(flow_host_clean, flow_host_read);
+    dmlog_ctx_t ctx = dmlog_create(flow_buffer, sizeof(flow_buffer));
+    ASSERT_TEST(ctx != NULL, "Create context for flow control");
+    dmlog_ring_t* ring = (dmlog_ring_t*)flow_buffer;
+    dmlog_host_t* host = (dmlog_host_t*)(uintptr_t)ring->host;
+
+    // Without flow control the oldest entries are overwritten
+    char msg[64];
+    for (int i = 0; i < FLOW_TEST_ENTRIES; i++) {
+        snprintf(msg, sizeof(msg), "Overwritten entry number %d\n", i);
+        dmlog_puts(ctx, msg);
+    }
+    ASSERT_TEST(flow_waits == 0, "Firmware does not wait without flow control");
+
+    host->tail_offset = ring->head_offset;
+    host->flags |= DMLOG_FLAG_FLOW_CONTROL;
+    char expected[sizeof(flow_received)] = "";
+    size_t expected_length = 0;
+    for (int i = 0; i < FLOW_TEST_ENTRIES; i++) {
+        snprintf(msg, sizeof(msg), "Flow controlled entry number %d\n", i);
+        dmlog_puts(ctx, msg);
+        expected_length += (size_t)snprintf(&expected[expected_length], sizeof(expected) - expected_length, "%s", msg);
+    }
+    // Read what is left
+    while (host->tail_offset != ring->head_offset) {
+        flow_host_read(host, sizeof(*host));
+    }
+    ASSERT_TEST(flow_waits > 0, "Firmware waits for the host when the ring is full");
+    ASSERT_TEST(!flow_busy_while_waiting, "Ring is not busy while the firmware waits");
+    ASSERT_TEST(flow_received_length == expected_length && memcmp(flow_received, expected, expected_length) == 0,
+                "Host receives every entry in order");
+
+    // Dropping the flow control releases the firmware
+    host->flags &= ~DMLOG_FLAG_FLOW_CONTROL;
+    for (int i = 0; i < FLOW_TEST_ENTRIES; i++) {
+        dmlog_puts(ctx, "Entry logged after the host is gone\n");
+    }
+    ASSERT_TEST(flow_received_length == expected_length, "Firmware overwrites entries again without flow control");
+
+    dmlog_destroy(ctx);
+    dmlog_set_cache_ops(NULL, NULL);
+}
+
+static int dead_host_polls = 0;
+static uint64_t dead_host_time_us = 0;
+
+// Host that is gone - it left the flow control on and never reads the ring again
+static void dead_host_read(volatile void* address, size_t size) {
+    dmlog_ring_t* ring = (dmlog_ring_t*)flow_buffer;
+    if (address == (volatile void*)(uintptr_t)ring->host) {
+        dead_host_polls++;
+    }
+}
+
+static uint64_t dead_host_clock(void) {
+    dead_host_time_us += 1000;
+    return dead_host_time_us;
+}
+
+// Test: A host that stops reading does not stop the logging calls
+static void test_flow_control_timeout(void) {
+    TEST_SECTION("Flow Control Timeout");
+
+    dmlog_set_cache_ops(flow_host_clean, dead_host_read);
+    dmlog_ctx_t ctx = dmlog_create(flow_buffer, sizeof(flow_buffer));
+    ASSERT_TEST(ctx != NULL, "Create context for flow control timeout");
+    dmlog_ring_t* ring = (dmlog_ring_t*)flow_buffer;
+    dmlog_host_t* host = (dmlog_host_t*)(uintptr_t)ring->host;
+
+    host->tail_offset = ring->head_offset;
+    host->flags |= DMLOG_FLAG_FLOW_CONTROL;
+    dead_host_polls = 0;
+    for (int i = 0; i < FLOW_TEST_ENTRIES; i++) {
+        dmlog_puts(ctx, "Entry logged while the host is gone\n");
+    }
+    ASSERT_TEST(ring->flags & DMLOG_FLAG_FLOW_CONTROL_LOST, "Firmware reports the lost flow control");
+    ASSERT_TEST(dead_host_polls >= DMLOG_FLOW_CONTROL_TIMEOUT && dead_host_polls < DMLOG_FLOW_CONTROL_TIMEOUT + 2 * FLOW_TEST_ENTRIES,
+                "Firmware waits for the host only once, for the timeout");
+    ASSERT_TEST(!(ring->flags & DMLOG_FLAG_BUSY), "Ring is not left busy after the timeout");
+    ASSERT_TEST(ring->tail_offset != host->tail_offset, "Firmware overwrites unread entries after the timeout");
+
+    // The firmware clears the report once the host dropped the flag
+    host->flags &= ~DMLOG_FLAG_FLOW_CONTROL;
+    dmlog_puts(ctx, "Entry logged after the host dropped the flow control\n");
+    ASSERT_TEST(!(ring->flags & DMLOG_FLAG_FLOW_CONTROL_LOST), "Lost flow control is cleared when the host drops the flag");
+
+    // With a clock the timeout is measured in microseconds
+    dmlog_set_clock(dead_host_clock);
+    host->tail_offset = ring->head_offset;
+    host->flags |= DMLOG_FLAG_FLOW_CONTROL;
+    dead_host_polls = 0;
+    for (int i = 0; i < FLOW_TEST_ENTRIES; i++) {
+        dmlog_puts(ctx, "Entry logged while the host is gone again\n");
+    }
+    ASSERT_TEST(ring->flags & DMLOG_FLAG_FLOW_CONTROL_LOST, "Firmware times out by the clock");
+    ASSERT_TEST(dead_host_polls <= DMLOG_FLOW_CONTROL_TIMEOUT / 1000 + 2 * FLOW_TEST_ENTRIES, "Clock bounds the wait");
+    dmlog_set_clock(NULL);
+
+    // A host that comes back turns the flow control on again and is waited for
+    host->flags &= ~DMLOG_FLAG_FLOW_CONTROL;
+    dmlog_puts(ctx, "Host is back\n");
+    dmlog_set_cache_ops(flow_host_clean, flow_host_read);
+    host->tail_offset = ring->head_offset;
+    host->flags |= DMLOG_FLAG_FLOW_CONTROL;
+    flow_waits = 0;
+    flow_received_length = 0;
+    for (int i = 0; i < FLOW_TEST_ENTRIES; i++) {
+        dmlog_puts(ctx, "Flow controlled entry again\n");
+    }
+    ASSERT_TEST(flow_waits > 0 && !(ring->flags & DMLOG_FLAG_FLOW_CONTROL_LOST), "Firmware waits for a host that reads again");
+
+    host->flags &= ~DMLOG_FLAG_FLOW_CONTROL;
+    dmlog_destroy(ctx);
+    dmlog_set_cache_ops(NULL, NULL);
+}
+
+static uint32_t fake_cycles = 0;
+
+static uint32_t test_cycle_counter(void) {
+    fake_cycles += 10;
+    return fake_cycles;
+}
+
+static const dmlog_overhead_entry_t* find_overhead_entry(const dmlog_overhead_t* table, const char* name) {
+    for (uint32_t i = 0; i < table->count; i++) {
+        if (strcmp(table->entries[i].name, name) == 0) {
+            return &table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Test: Logging overhead accounting
+static void test_overhead_accounting(void) {
+    TEST_SECTION("Logging Overhead Accounting");
+    reset_buffer();
+
+    dmlog_ctx_t ctx = create_test_context();
+    ASSERT_TEST(ctx != NULL, "Create context for overhead tests");
+
+    static uint8_t table_buffer[512];
+    size_t table_size = dmlog_overhead_get_required_size(3);
+    ASSERT_TEST(table_size <= sizeof(table_buffer), "Overhead table fits in the test buffer");
+    ASSERT_TEST(!dmlog_overhead_enable(ctx, table_buffer, sizeof(dmlog_overhead_t), test_cycle_counter, 1000000),
+                "Enable fails for a table without entries");
+    ASSERT_TEST(dmlog_overhead_enable(ctx, table_buffer, table_size, test_cycle_counter, 1000000), "Enable overhead accounting");
+    const dmlog_overhead_t* table = (const dmlog_overhead_t*)table_buffer;
+    ASSERT_TEST(table->capacity == 3 && table->count == 0, "Table is empty after enable");
+    ASSERT_TEST(((dmlog_ring_t*)ctx)->overhead == (uintptr_t)table_buffer, "Table is published in the ring header");
+
+    // Nested calls (dmlog_puts -> dmlog_putc -> dmlog_flush) are counted once
+    const char* previous = dmlog_set_module("radio");
+    ASSERT_TEST(strcmp(previous, DMLOG_MODULE_NAME) == 0, "Default module is DMLOG_MODULE_NAME");
+    dmlog_puts(ctx, "radio: link up\n");
+    dmlog_puts(ctx, "radio: rssi -70\n");
+    const dmlog_overhead_entry_t* radio = find_overhead_entry(table, "radio");
+    ASSERT_TEST(radio != NULL, "Module is added on its first write");
+    ASSERT_TEST(radio != NULL && radio->calls == 2, "Nested calls are counted once");
+    ASSERT_TEST(radio != NULL && radio->bytes == strlen("radio: link up\n") + strlen("radio: rssi -70\n"), "Bytes are accounted");
+    ASSERT_TEST(radio != NULL && radio->flushes == 2, "Flushes are accounted");
+    ASSERT_TEST(radio != NULL && radio->cycles == 20, "Cycles of the outermost call are accounted");
+
+    // Modules that do not fit are accounted to "(other)"
+    dmlog_set_module("storage-module-long-name");
+    dmlog_put_address(ctx, 0x1234);
+    dmlog_set_module("ui");
+    dmlog_puts(ctx, "ui\n");
+    dmlog_set_module("power");
+    dmlog_puts(ctx, "power\n");
+    ASSERT_TEST(table->count == 3, "Table holds at most capacity entries");
+    ASSERT_TEST(find_overhead_entry(table, "storage-module-") != NULL, "Long module names are truncated");
+    const dmlog_overhead_entry_t* other = find_overhead_entry(table, "(other)");
+    ASSERT_TEST(other != NULL && other->calls == 2, "Modules that do not fit are accounted to (other)");
+
+    // Other contexts are not accounted
+    static char other_buffer[2048];
+    dmlog_ctx_t other_ctx = dmlog_create(other_buffer, sizeof(other_buffer));
+    dmlog_set_module("radio");
+    uint32_t radio_calls = radio != NULL ? radio->calls : 0;
+    dmlog_puts(other_ctx, "not accounted\n");
+    ASSERT_TEST(radio != NULL && radio->calls == radio_calls, "Writes to other contexts are not accounted");
+    dmlog_destroy(other_ctx);
+
+    dmlog_overhead_disable();
+    ASSERT_TEST(((dmlog_ring_t*)ctx)->overhead == 0, "Table is unpublished after disable");
+    dmlog_puts(ctx, "radio: not accounted\n");
+    ASSERT_TEST(radio != NULL && radio->calls == radio_calls, "Writes are not accounted after disable");
+
+    dmlog_set_module(previous);
+    dmlog_destroy(ctx);
+}
+
+// Test: Output ring spanning several memory regions
+static void test_segmented_ring(void) {
+    TEST_SECTION("Segmented Ring");
+    reset_buffer();
+
+    static char region_a[300];
+    static char region_b[7];
+    static char region_c[200];
+    dmlog_region_t regions[] = {
+        { test_buffer, 2048 },
+        { region_a, sizeof(region_a) },
+        { NULL, 0 },                        // empty regions are skipped
+        { region_b, sizeof(region_b) },
+        { region_c, sizeof(region_c) },
+    };
+    dmlog_ctx_t ctx = dmlog_create_segmented(regions, sizeof(regions) / sizeof(regions[0]));
+    ASSERT_TEST(ctx != NULL, "Create segmented context");
+    ASSERT_TEST(dmlog_create_segmented(NULL, 0) == NULL, "Create segmented context without regions fails");
+
+    const dmlog_ring_t* ring = (const dmlog_ring_t*)ctx;
+    const dmlog_segment_t* segments = (const dmlog_segment_t*)(uintptr_t)ring->segments;
+    ASSERT_TEST(ring->segment_count == 4, "Segment table lists every non-empty region");
+    dmlog_index_t total = 0;
+    bool ordered = true;
+    for (uint32_t i = 0; i < ring->segment_count; i++) {
+        ordered = ordered && segments[i].offset == total;
+        total += segments[i].size;
+    }
+    ASSERT_TEST(ordered && total == ring->buffer_size, "Segments cover the whole output ring in order");
+    ASSERT_TEST(segments[1].address == (uintptr_t)region_a && segments[3].address == (uintptr_t)region_c,
+                "Further regions follow the first one");
+    ASSERT_TEST(ring->input_buffer >= (uintptr_t)test_buffer && ring->input_buffer + ring->input_buffer_size <= (uintptr_t)test_buffer + 2048,
+                "Input buffer is in the first region");
+    ASSERT_TEST(test_buffer[2048] == 0, "First region is not overrun");
+
+    char read_buf[256];
+    ASSERT_TEST(dmlog_read_next(ctx), "Version message is read from the segmented ring");
+
+    // Write enough to wrap around several times; every entry must read back intact
+    char msg[128];
+    bool intact = true;
+    int read_count = 0;
+    for (int i = 0; i < 300; i++) {
+        snprintf(msg, sizeof(msg), "Segmented entry %d with some padding text %d\n", i, i * 7);
+        dmlog_puts(ctx, msg);
+        if (i % 5 == 4) {
+            while (dmlog_read_next(ctx)) {
+                dmlog_gets(ctx, read_buf, sizeof(read_buf));
+                int number = -1, check = -1;
+                intact = intact && sscanf(read_buf, "Segmented entry %d with some padding text %d", &number, &check) == 2 &&
+                         check == number * 7;
+                read_count++;
+            }
+        }
+    }
+    ASSERT_TEST(intact && read_count == 300, "Entries split between segments read back intact");
+    ASSERT_TEST(ring->head_offset < ring->buffer_size && ring->tail_offset == ring->head_offset, "Ring is empty after reading everything");
+
+    dmlog_clear(ctx);
+    ASSERT_TEST(region_b[0] == 0 && region_c[0] == 0, "Clear zeroes every segment");
+    ASSERT_TEST(ring->segment_count == 4, "Clear keeps the segment table");
+
+    dmlog_destroy(ctx);
+}
+
+// Simulates the monitor servicing one chunk of a batch transfer
+// Sent chunks are appended to sent, received chunks are taken from received
+// Returns true if a chunk was serviced
+static bool host_service_batch(dmlog_ctx_t ctx, uint8_t* sent, size_t* sent_size, const uint8_t* received, size_t received_size) {
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+    dmlog_host_t* host = (dmlog_host_t*)(uintptr_t)ring->host;
+    dmlog_file_transfer_t* transfer = (dmlog_file_transfer_t*)(uintptr_t)ring->file_transfer;
+    uint8_t* buffer = transfer ? (uint8_t*)(uintptr_t)transfer->buffer_address : NULL;
+    if (ring->file_request == host->file_serviced) {
+        return false;
+    }
+    if (ring->flags & DMLOG_FLAG_FILE_SEND_REQ) {
+        memcpy(sent + *sent_size, buffer, transfer->chunk_size);
+        *sent_size += transfer->chunk_size;
+        host->file_serviced = ring->file_request;
+        return true;
+    }
+    if (ring->flags & DMLOG_FLAG_FILE_RECV_REQ) {
+        size_t left = received_size - transfer->offset;
+        transfer->chunk_size = (uint32_t)(left < transfer->chunk_size ? left : transfer->chunk_size);
+        memcpy(buffer, received + transfer->offset, transfer->chunk_size);
+        host->file_serviced = ring->file_request;
+        return true;
+    }
+    return false;
+}
+
+static void write_test_file(const char* path, size_t size, char fill) {
+    FILE* file = fopen(path, "wb");
+    for (size_t i = 0; i < size; i++) {
+        fputc(fill + (char)(i % 10), file);
+    }
+    fclose(file);
+}
+
+static bool check_test_file(const char* path, size_t size, char fill) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    bool same = true;
+    size_t length = 0;
+    int c;
+    while ((c = fgetc(file)) != EOF) {
+        same = same && length < size && c == fill + (char)(length % 10);
+        length++;
+    }
+    fclose(file);
+    return same && length == size;
+}
+
+// Appends a file of a batch to a stream built by the host
+static size_t append_batch_file(uint8_t* stream, size_t size, const char* data, uint32_t data_size, int32_t status) {
+    dmlog_file_batch_header_t header = { data_size, status };
+    memcpy(stream + size, &header, sizeof(header));
+    memcpy(stream + size + sizeof(header), data, data_size);
+    return size + sizeof(header) + data_size;
+}
+
+// Test: Batch file transfer streams many files through one transfer
+static void test_file_batch(void) {
+    TEST_SECTION("File Batch Transfer");
+    reset_buffer();
+    dmlog_ctx_t ctx = create_test_context();
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+
+    static const char* names[] = { "test_batch_0.txt", "test_batch_1.txt", "test_batch_2.txt", "test_batch_3.txt", "test_batch_4.txt" };
+    static const size_t sizes[] = { 40, 0, 35, DMLOG_FILE_TRANSFER_CHUNK_SIZE + 100, 12 };
+    dmlog_file_batch_entry_t files[5];
+    size_t total = 0;
+    for (int i = 0; i < 5; i++) {
+        write_test_file(names[i], sizes[i], (char)('a' + i));
+        files[i].src_file_path = names[i];
+        files[i].dst_file_path = NULL;
+        files[i].status = 1;
+        total += sizeof(dmlog_file_batch_header_t) + sizes[i];
+    }
+    files[4].dst_file_path = "other/renamed.txt";
+
+    // Send - the whole batch takes as many chunks as one file of the same size
+    static uint8_t sent[4096];
+    size_t sent_size = 0;
+    int chunks = 0;
+    dmlog_transfer_t transfer = dmlog_file_batch_send_start(ctx, files, 5, "logs");
+    ASSERT_TEST(transfer != NULL, "Start sending a batch");
+    ASSERT_TEST(dmlog_file_transfer_poll(transfer) == DMLOG_TRANSFER_PENDING, "First chunk is requested");
+    const dmlog_file_transfer_t* info = (const dmlog_file_transfer_t*)(uintptr_t)ring->file_transfer;
+    const char* manifest = (const char*)(uintptr_t)info->manifest_address;
+    ASSERT_TEST((info->flags & DMLOG_FILE_TRANSFER_FLAG_BATCH) && info->file_count == 5, "Transfer is marked as a batch of 5 files");
+    ASSERT_TEST(strcmp(manifest, "logs/test_batch_0.txt") == 0, "Manifest puts files without a destination in the directory");
+    size_t position = 0;
+    for (int i = 0; i < 4; i++) {
+        position += strlen(manifest + position) + 1;
+    }
+    ASSERT_TEST(strcmp(manifest + position, "other/renamed.txt") == 0 && position + strlen(manifest + position) + 1 == info->manifest_size,
+                "Manifest keeps explicit destinations");
+    while (dmlog_file_transfer_poll(transfer) == DMLOG_TRANSFER_PENDING) {
+        chunks += host_service_batch(ctx, sent, &sent_size, NULL, 0);
+    }
+    ASSERT_TEST(dmlog_file_transfer_finish(transfer), "Batch is sent");
+    ASSERT_TEST(sent_size == total, "Stream holds a header and the data of every file");
+    ASSERT_TEST(chunks == (int)((total + DMLOG_FILE_TRANSFER_CHUNK_SIZE - 1) / DMLOG_FILE_TRANSFER_CHUNK_SIZE),
+                "Files share chunks");
+    bool intact = true;
+    bool success = true;
+    position = 0;
+    for (int i = 0; i < 5; i++) {
+        dmlog_file_batch_header_t header;
+        memcpy(&header, sent + position, sizeof(header));
+        position += sizeof(header);
+        intact = intact && header.size == sizes[i] && header.status == 0;
+        for (size_t j = 0; j < sizes[i] && intact; j++) {
+            intact = sent[position + j] == (uint8_t)('a' + i + (char)(j % 10));
+        }
+        position += sizes[i];
+        success = success && files[i].status == 0;
+    }
+    ASSERT_TEST(intact, "Files are streamed back to back in manifest order");
+    ASSERT_TEST(success, "Every file is reported as sent");
+    ASSERT_TEST(ring->file_transfer == 0, "Ring is released after the batch");
+
+    // Files missing on the target or failing on the host are reported, the rest is sent
+    files[1].src_file_path = "test_batch_missing.txt";
+    sent_size = 0;
+    transfer = dmlog_file_batch_send_start(ctx, files, 5, "logs");
+    dmlog_file_transfer_poll(transfer);
+    info = (const dmlog_file_transfer_t*)(uintptr_t)ring->file_transfer;
+    while (dmlog_file_transfer_poll(transfer) == DMLOG_TRANSFER_PENDING) {
+        if (host_service_batch(ctx, sent, &sent_size, NULL, 0) && info->offset == 0) {
+            ((int32_t*)(uintptr_t)info->status_address)[2] = -EACCES;
+        }
+    }
+    ASSERT_TEST(!dmlog_file_transfer_finish(transfer), "Batch with failed files reports failure");
+    dmlog_file_batch_header_t missing;
+    memcpy(&missing, sent + sizeof(dmlog_file_batch_header_t) + sizes[0], sizeof(missing));
+    ASSERT_TEST(missing.size == 0 && missing.status == -ENOENT, "Missing file is streamed as an error");
+    ASSERT_TEST(files[0].status == 0 && files[1].status == -ENOENT && files[2].status == -EACCES &&
+                files[3].status == 0 && files[4].status == 0, "Status of every file is reported");
+    files[1].src_file_path = names[1];
+
+    // Receive - the files are written to the target as their data arrives
+    static uint8_t stream[4096];
+    static char data[DMLOG_FILE_TRANSFER_CHUNK_SIZE + 100];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (char)('a' + i % 10);
+    }
+    size_t stream_size = append_batch_file(stream, 0, data, sizeof(data), 0);
+    stream_size = append_batch_file(stream, stream_size, data, 0, -ENOENT);
+    stream_size = append_batch_file(stream, stream_size, data, 0, 0);
+    stream_size = append_batch_file(stream, stream_size, data, 7, 0);
+    dmlog_file_batch_entry_t received[] = {
+        { "host/big.txt", "test_batch_recv_0.txt", 1 },
+        { "host/missing.txt", "test_batch_recv_1.txt", 1 },
+        { "host/empty.txt", "test_batch_recv_2.txt", 1 },
+        { "host/test_batch_recv_3.txt", NULL, 1 },
+    };
+    remove("test_batch_recv_1.txt");
+    transfer = dmlog_file_batch_receive_start(ctx, received, 4, ".");
+    ASSERT_TEST(transfer != NULL, "Start receiving a batch");
+    while (dmlog_file_transfer_poll(transfer) == DMLOG_TRANSFER_PENDING) {
+        host_service_batch(ctx, NULL, NULL, stream, stream_size);
+    }
+    ASSERT_TEST(!dmlog_file_transfer_finish(transfer), "Batch with a file missing on the host reports failure");
+    ASSERT_TEST(received[0].status == 0 && check_test_file("test_batch_recv_0.txt", sizeof(data), 'a'), "File spanning chunks is received");
+    ASSERT_TEST(received[1].status == -ENOENT && !check_test_file("test_batch_recv_1.txt", 0, 'a'), "File missing on the host is not created");
+    ASSERT_TEST(received[2].status == 0 && check_test_file("test_batch_recv_2.txt", 0, 'a'), "Empty file is received");
+    ASSERT_TEST(received[3].status == 0 && check_test_file("./test_batch_recv_3.txt", 7, 'a'), "File is received into the directory");
+
+    // A batch finished before the host serviced it is cancelled
+    transfer = dmlog_file_batch_send_start(ctx, files, 2, "logs");
+    ASSERT_TEST(!dmlog_file_transfer_finish(transfer) && files[0].status == -ECANCELED && files[1].status == -ECANCELED,
+                "Files of a cancelled batch are reported as cancelled");
+    ASSERT_TEST(dmlog_file_batch_send_start(ctx, files, 0, "logs") == NULL, "Empty batch is rejected");
+    ASSERT_TEST(dmlog_file_batch_send_start(ctx, files, 1, NULL) == NULL, "File without a destination is rejected");
+
+    for (int i = 0; i < 5; i++) {
+        remove(names[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        remove(received[i].dst_file_path ? received[i].dst_file_path : "test_batch_recv_3.txt");
+    }
+    dmlog_destroy(ctx);
+}
+
+// Chunk of a received file prepared by the simulated host
+typedef struct {
+    uint8_t  data[DMLOG_FILE_TRANSFER_CHUNK_SIZE];
+    uint32_t size;
+    bool     compressed;
+} test_chunk_t;
+
+// Appends literals to a compressed chunk and to the expected file
+static void put_test_literals(test_chunk_t* chunk, uint8_t* expected, size_t* expected_size, const char* text) {
+    size_t length = strlen(text);
+    chunk->data[chunk->size++] = (uint8_t)(length - 1);
+    memcpy(chunk->data + chunk->size, text, length);
+    chunk->size += length;
+    memcpy(expected + *expected_size, text, length);
+    *expected_size += length;
+}
+
+// Appends a copy to a compressed chunk and to the expected file
+static void put_test_match(test_chunk_t* chunk, uint8_t* expected, size_t* expected_size, uint32_t length, uint32_t distance) {
+    chunk->data[chunk->size++] = (uint8_t)(0x80 | (length - DMLOG_COMPRESSION_MIN_MATCH));
+    chunk->data[chunk->size++] = (uint8_t)(distance & 0xFF);
+    chunk->data[chunk->size++] = (uint8_t)(distance >> 8);
+    for (uint32_t i = 0; i < length; i++, (*expected_size)++) {
+        expected[*expected_size] = expected[*expected_size - distance];
+    }
+}
+
+// Receives a file the host sends as the given chunks
+static bool receive_test_chunks(dmlog_ctx_t ctx, const char* path, const test_chunk_t* chunks, int count, uint32_t total_size, uint32_t* window_size) {
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+    dmlog_host_t* host = (dmlog_host_t*)(uintptr_t)ring->host;
+    dmlog_transfer_t transfer = dmlog_file_receive_start(ctx, "host/file.bin", path);
+    int index = 0;
+    while (dmlog_file_transfer_poll(transfer) == DMLOG_TRANSFER_PENDING) {
+        if ((ring->flags & DMLOG_FLAG_FILE_RECV_REQ) && ring->file_request != host->file_serviced && index < count) {
+            dmlog_file_transfer_t* info = (dmlog_file_transfer_t*)(uintptr_t)ring->file_transfer;
+            *window_size = info->window_size;
+            memcpy((void*)(uintptr_t)info->buffer_address, chunks[index].data, chunks[index].size);
+            info->chunk_size = chunks[index].size;
+            info->total_size = total_size;
+            info->flags |= chunks[index].compressed ? DMLOG_FILE_TRANSFER_FLAG_COMPRESSED : 0;
+            host->file_serviced = ring->file_request;
+            index++;
+        }
+    }
+    return dmlog_file_transfer_finish(transfer) && index == count;
+}
+
+// Test: Received chunks compressed by the host are decoded through the window
+static void test_file_compression(void) {
+    TEST_SECTION("File Transfer Compression");
+    reset_buffer();
+    dmlog_ctx_t ctx = create_test_context();
+
+    static test_chunk_t chunks[3];
+    static uint8_t expected[16384];
+    size_t expected_size = 0;
+    memset(chunks, 0, sizeof(chunks));
+
+    // Literals, a copy of them and a copy overlapping itself
+    chunks[0].compressed = true;
+    put_test_literals(&chunks[0], expected, &expected_size, "[INFO] sensor 0123456789\n");
+    put_test_match(&chunks[0], expected, &expected_size, DMLOG_COMPRESSION_MAX_MATCH, 25);
+    put_test_literals(&chunks[0], expected, &expected_size, "=");
+    put_test_match(&chunks[0], expected, &expected_size, 60, 1);
+
+    // Raw chunk in between
+    for (int i = 0; i < 300; i++) {
+        chunks[1].data[i] = (uint8_t)('A' + i % 26);
+    }
+    chunks[1].size = 300;
+    memcpy(expected + expected_size, chunks[1].data, 300);
+    expected_size += 300;
+
+    // Copies from the previous chunks, wrapping the window several times
+    chunks[2].compressed = true;
+    size_t start = expected_size;
+    put_test_match(&chunks[2], expected, &expected_size, 100, 400);
+    for (int i = 0; i < 40; i++) {
+        put_test_match(&chunks[2], expected, &expected_size, DMLOG_COMPRESSION_MAX_MATCH, (i % 2 && i > 10) ? DMLOG_FILE_COMPRESSION_WINDOW : 300);
+    }
+    put_test_literals(&chunks[2], expected, &expected_size, "end\n");
+
+    uint32_t window_size = 0;
+    bool received = receive_test_chunks(ctx, "test_compressed.bin", chunks, 3, (uint32_t)expected_size, &window_size);
+    ASSERT_TEST(window_size == DMLOG_FILE_COMPRESSION_WINDOW, "Target offers its window to the host");
+    ASSERT_TEST(received, "Compressed file is received");
+    ASSERT_TEST(expected_size - start > 10 * DMLOG_FILE_TRANSFER_CHUNK_SIZE, "Compressed chunk carries many times its size");
+
+    static uint8_t data[16384];
+    FILE* file = fopen("test_compressed.bin", "rb");
+    size_t size = file ? fread(data, 1, sizeof(data), file) : 0;
+    if (file) {
+        fclose(file);
+    }
+    ASSERT_TEST(size == expected_size && memcmp(data, expected, size) == 0, "Decoded file matches the original");
+
+    // Copies from before the start of the file, or past its end, are rejected
+    memset(chunks, 0, sizeof(chunks));
+    expected_size = 0;
+    chunks[0].compressed = true;
+    put_test_literals(&chunks[0], expected, &expected_size, "abc");
+    chunks[0].data[chunks[0].size++] = 0x80;
+    chunks[0].data[chunks[0].size++] = 4;
+    chunks[0].data[chunks[0].size++] = 0;
+    ASSERT_TEST(!receive_test_chunks(ctx, "test_compressed.bin", chunks, 1, 100, &window_size), "Copy from before the file fails the transfer");
+    ASSERT_TEST(!receive_test_chunks(ctx, "test_compressed.bin", chunks, 1, 2, &window_size), "Data past the file size fails the transfer");
+
+    remove("test_compressed.bin");
+    dmlog_destroy(ctx);
+}
+
 int main(void) {
     printf("\n");
     printf("========================================\n");
@@ -495,6 +1192,13 @@ int main(void) {
     test_stress();
     test_max_entry_size();
     test_invalid_context();
+    test_cache_hooks();
+    test_flow_control();
+    test_flow_control_timeout();
+    test_overhead_accounting();
+    test_segmented_ring();
+    test_file_batch();
+    test_file_compression();
     
     // Print summary
     printf("\n");
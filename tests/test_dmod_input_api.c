@@ -32,23 +32,11 @@ static dmlog_ctx_t create_and_set_default_context(void) {
 // This simulates what monitor_send_input would do
 static bool write_to_input_buffer(dmlog_ctx_t ctx, const char* data, size_t length) {
     // Access the ring structure directly (simulating what monitor does via OpenOCD)
-    typedef struct {
-        volatile uint32_t           magic;
-        volatile uint32_t           flags;
-        volatile uint32_t           head_offset;
-        volatile uint32_t           tail_offset;
-        volatile uint32_t           buffer_size;
-        volatile uint64_t           buffer;
-        volatile uint32_t           input_head_offset;
-        volatile uint32_t           input_tail_offset;
-        volatile uint32_t           input_buffer_size;
-        volatile uint64_t           input_buffer;
-    } __attribute__((packed)) test_ring_t;
-    
-    test_ring_t* ring = (test_ring_t*)ctx;
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+    dmlog_host_t* host = (dmlog_host_t*)((uintptr_t)ring->host);
     
     // Check available space
-    uint32_t input_head = ring->input_head_offset;
+    uint32_t input_head = host->input_head_offset;
     uint32_t input_tail = ring->input_tail_offset;
     uint32_t input_size = ring->input_buffer_size;
     
@@ -71,9 +59,8 @@ static bool write_to_input_buffer(dmlog_ctx_t ctx, const char* data, size_t leng
         input_head = (input_head + 1) % input_size;
     }
     
-    // Update head offset and set flag
-    ring->input_head_offset = input_head;
-    ring->flags |= DMLOG_FLAG_INPUT_AVAILABLE;
+    // Update head offset in the control block of the host
+    host->input_head_offset = input_head;
     
     return true;
 }
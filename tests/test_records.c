@@ -0,0 +1,379 @@
+#include "dmlog.h"
+#include "test_common.h"
+#include <string.h>
+#include <stdlib.h>
+
+// Test counters
+int tests_passed = 0;
+int tests_failed = 0;
+
+#define TEST_BUFFER_SIZE (8 * 1024)  // 8KB for tests
+static char test_buffer[TEST_BUFFER_SIZE];
+
+// Helper function to create context and clear initial version message for tests
+static dmlog_ctx_t create_test_context(void) {
+    memset(test_buffer, 0, TEST_BUFFER_SIZE);
+    dmlog_ctx_t ctx = dmlog_create(test_buffer, TEST_BUFFER_SIZE);
+    if (ctx) {
+        // Clear the initial version message for clean testing
+        dmlog_clear(ctx);
+    }
+    return ctx;
+}
+
+// Helper function to read the next entry as raw bytes
+static size_t read_record(dmlog_ctx_t ctx, uint8_t* out, size_t max_len) {
+    if (!dmlog_read_next(ctx)) {
+        return 0;
+    }
+    const char* entry = dmlog_get_ref_buffer(ctx);
+    size_t length = strlen(entry);
+    if (length > max_len) {
+        length = max_len;
+    }
+    memcpy(out, entry, length);
+    return length;
+}
+
+// Helper function to decode the values of a record
+static size_t decode_values(const uint8_t* record, size_t length, uint64_t* values, size_t max_values) {
+    size_t count = 0;
+    size_t offset = 2;
+    while (offset < length && count < max_values) {
+        size_t used = dmlog_record_decode_value(&record[offset], length - offset, &values[count]);
+        if (used == 0) {
+            break;
+        }
+        offset += used;
+        count++;
+    }
+    return count;
+}
+
+// Test: Value encoding round trip
+static void test_value_encoding(void) {
+    TEST_SECTION("Value Encoding");
+
+    const uint64_t values[] = { 0, 1, 0x3F, 0x40, 0x1234, 0x08000000, 0xFFFFFFFF, 0x7FFFDEADBEEF, UINT64_MAX };
+    bool all_ok = true;
+    bool no_special_bytes = true;
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        uint8_t encoded[DMLOG_RECORD_MAX_VALUE_SIZE];
+        size_t length = dmlog_record_encode_value(encoded, values[i]);
+        uint64_t decoded = 0;
+        if (length == 0 || length > DMLOG_RECORD_MAX_VALUE_SIZE ||
+            dmlog_record_decode_value(encoded, length, &decoded) != length || decoded != values[i]) {
+            all_ok = false;
+        }
+        for (size_t j = 0; j < length; j++) {
+            if (encoded[j] == '\0' || encoded[j] == '\n') {
+                no_special_bytes = false;
+            }
+        }
+    }
+    ASSERT_TEST(all_ok, "Values survive encode/decode round trip");
+    ASSERT_TEST(no_special_bytes, "Encoded values contain no NUL or newline bytes");
+
+    uint8_t encoded[DMLOG_RECORD_MAX_VALUE_SIZE];
+    ASSERT_TEST(dmlog_record_encode_value(encoded, 0x3F) == 1, "Small value takes one byte");
+    ASSERT_TEST(dmlog_record_encode_value(encoded, 0xFFFFFFFF) == 6, "32-bit value takes six bytes");
+
+    uint64_t decoded = 0;
+    size_t length = dmlog_record_encode_value(encoded, 0x12345678);
+    ASSERT_TEST(dmlog_record_decode_value(encoded, length - 1, &decoded) == 0, "Truncated value is rejected");
+    ASSERT_TEST(dmlog_record_decode_value((const uint8_t*)"A", 1, &decoded) == 0, "Text byte is rejected");
+}
+
+// Test: Address record
+static void test_put_address(void) {
+    TEST_SECTION("Address Record");
+
+    dmlog_ctx_t ctx = create_test_context();
+    ASSERT_TEST(ctx != NULL, "Create context");
+    ASSERT_TEST(dmlog_put_address(ctx, (uintptr_t)0x0800ABCD) == true, "Put address");
+
+    uint8_t record[DMLOG_RECORD_MAX_SIZE];
+    size_t length = read_record(ctx, record, sizeof(record));
+    ASSERT_TEST(length > 2, "Read address record");
+    ASSERT_TEST(record[0] == DMLOG_RECORD_MARKER && record[1] == DMLOG_RECORD_ADDRESS, "Record header is correct");
+
+    uint64_t value = 0;
+    ASSERT_TEST(decode_values(record, length, &value, 1) == 1 && value == 0x0800ABCD, "Address decodes correctly");
+
+    // Record following text in the same entry starts a new entry only when needed
+    dmlog_puts(ctx, "fault at ");
+    dmlog_put_address(ctx, (uintptr_t)0x20001000);
+    length = read_record(ctx, record, sizeof(record));
+    ASSERT_TEST(length > 9 && memcmp(record, "fault at ", 9) == 0, "Text prefix is kept in the entry");
+    ASSERT_TEST(record[9] == DMLOG_RECORD_MARKER, "Record follows the text prefix");
+
+    ASSERT_TEST(dmlog_put_address(NULL, 0x1234) == false, "Put address with NULL context fails");
+    dmlog_destroy(ctx);
+}
+
+// Test: Backtrace record
+static void test_put_backtrace(void) {
+    TEST_SECTION("Backtrace Record");
+
+    dmlog_ctx_t ctx = create_test_context();
+    const uintptr_t pcs[] = { 0x08001234, 0x08001100, 0x08004000, 0x08000200 };
+    ASSERT_TEST(dmlog_put_backtrace(ctx, pcs, 4) == true, "Put backtrace");
+
+    uint8_t record[DMLOG_RECORD_MAX_SIZE];
+    size_t length = read_record(ctx, record, sizeof(record));
+    ASSERT_TEST(record[0] == DMLOG_RECORD_MARKER && record[1] == DMLOG_RECORD_BACKTRACE, "Record header is correct");
+
+    uint64_t values[DMLOG_BACKTRACE_MAX_DEPTH + 1];
+    size_t count = decode_values(record, length, values, DMLOG_BACKTRACE_MAX_DEPTH + 1);
+    ASSERT_TEST(count == 5 && values[0] == 4, "Backtrace has frame count and frames");
+
+    // Rebuild the addresses from the zigzag encoded deltas
+    bool frames_ok = count == 5 && values[1] == pcs[0];
+    uint64_t pc = values[1];
+    for (size_t i = 1; frames_ok && i < 4; i++) {
+        int64_t delta = (int64_t)(values[i + 1] >> 1) ^ -(int64_t)(values[i + 1] & 1);
+        pc += (uint64_t)delta;
+        frames_ok = pc == pcs[i];
+    }
+    ASSERT_TEST(frames_ok, "Frames decode correctly");
+    ASSERT_TEST(length < 2 + 4 * 6, "Deltas keep the record compact");
+
+    uintptr_t many[DMLOG_BACKTRACE_MAX_DEPTH + 8];
+    for (size_t i = 0; i < sizeof(many) / sizeof(many[0]); i++) {
+        many[i] = 0x08000000 + i * 0x10;
+    }
+    dmlog_put_backtrace(ctx, many, sizeof(many) / sizeof(many[0]));
+    length = read_record(ctx, record, sizeof(record));
+    count = decode_values(record, length, values, DMLOG_BACKTRACE_MAX_DEPTH + 1);
+    ASSERT_TEST(values[0] == DMLOG_BACKTRACE_MAX_DEPTH && count == DMLOG_BACKTRACE_MAX_DEPTH + 1, "Backtrace depth is limited");
+
+    ASSERT_TEST(dmlog_put_backtrace(ctx, NULL, 1) == false, "Backtrace with NULL frames fails");
+    dmlog_destroy(ctx);
+}
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__riscv)
+static size_t captured_frames = 0;
+
+__attribute__((noinline)) static void leaf_function(dmlog_ctx_t ctx) {
+    captured_frames = dmlog_backtrace(ctx, 0);
+    __asm__ volatile("" ::: "memory");
+}
+
+__attribute__((noinline)) static void middle_function(dmlog_ctx_t ctx) {
+    leaf_function(ctx);
+    __asm__ volatile("" ::: "memory");
+}
+#endif
+
+// Test: Frame pointer backtrace
+static void test_backtrace_frame_pointers(void) {
+    TEST_SECTION("Frame Pointer Backtrace");
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__riscv)
+    dmlog_ctx_t ctx = create_test_context();
+    dmlog_set_unwinder(NULL, NULL);
+    middle_function(ctx);
+    TEST_INFO("Captured %zu frames", captured_frames);
+    ASSERT_TEST(captured_frames >= 2, "Backtrace contains the calling functions");
+
+    uint8_t record[DMLOG_RECORD_MAX_SIZE];
+    size_t length = read_record(ctx, record, sizeof(record));
+    uint64_t values[DMLOG_BACKTRACE_MAX_DEPTH + 1];
+    size_t count = decode_values(record, length, values, DMLOG_BACKTRACE_MAX_DEPTH + 1);
+    ASSERT_TEST(count == captured_frames + 1 && values[0] == captured_frames, "Logged frame count matches");
+
+    // The first frame returns into leaf_function
+    uintptr_t leaf = (uintptr_t)&leaf_function;
+    ASSERT_TEST(values[1] > leaf && values[1] < leaf + 256, "First frame is inside the caller");
+    dmlog_destroy(ctx);
+#else
+    TEST_INFO("Frame pointer unwinding is not supported on this architecture");
+#endif
+}
+
+// Test unwinder returning fixed frames
+static size_t test_unwinder(uintptr_t* pcs, size_t max_depth, void* user_data) {
+    size_t* calls = (size_t*)user_data;
+    (*calls)++;
+    size_t count = 0;
+    for (; count < 5 && count < max_depth; count++) {
+        pcs[count] = 0x1000 + count;
+    }
+    return count;
+}
+
+// Test: Custom unwinder
+static void test_backtrace_unwinder(void) {
+    TEST_SECTION("Custom Unwinder");
+
+    dmlog_ctx_t ctx = create_test_context();
+    size_t calls = 0;
+    dmlog_set_unwinder(test_unwinder, &calls);
+    ASSERT_TEST(dmlog_backtrace(ctx, 2) == 3, "Unwinder frames are skipped");
+    ASSERT_TEST(calls == 1, "Unwinder is called once");
+
+    uint8_t record[DMLOG_RECORD_MAX_SIZE];
+    size_t length = read_record(ctx, record, sizeof(record));
+    uint64_t values[DMLOG_BACKTRACE_MAX_DEPTH + 1];
+    size_t count = decode_values(record, length, values, DMLOG_BACKTRACE_MAX_DEPTH + 1);
+    ASSERT_TEST(count == 4 && values[0] == 3 && values[1] == 0x1002, "Backtrace starts after skipped frames");
+
+    dmlog_set_unwinder(NULL, NULL);
+    dmlog_destroy(ctx);
+}
+
+// Test clock returning a fixed time
+static uint64_t test_clock(void) {
+    return 123456789;
+}
+
+// Test clock that allocates (the nested event must not be logged)
+static uint64_t allocating_clock(void) {
+    dmlog_heap_trace_alloc((void*)0x5000, 1, 0x1234);
+    return 1;
+}
+
+// Test: Heap trace records
+static void test_heap_trace(void) {
+    TEST_SECTION("Heap Trace");
+
+    dmlog_ctx_t ctx = create_test_context();
+    ASSERT_TEST(dmlog_heap_trace_alloc((void*)0x1000, 16, 0x0800ABCD) == false, "Nothing is logged before tracing is enabled");
+    ASSERT_TEST(dmlog_read_next(ctx) == false, "Ring stays empty");
+
+    dmlog_heap_trace_enable(ctx);
+    dmlog_set_clock(test_clock);
+    ASSERT_TEST(dmlog_heap_trace_alloc((void*)0x20001000, 64, 0x0800ABCD) == true, "Log allocation");
+    ASSERT_TEST(dmlog_heap_trace_free((void*)0x20001000, 0x0800ABEF) == true, "Log free");
+    ASSERT_TEST(dmlog_heap_trace_free(NULL, 0x0800ABEF) == false, "free(NULL) is not logged");
+
+    uint8_t record[DMLOG_RECORD_MAX_SIZE];
+    uint64_t values[4];
+    size_t length = read_record(ctx, record, sizeof(record));
+    ASSERT_TEST(record[0] == DMLOG_RECORD_MARKER && record[1] == DMLOG_RECORD_HEAP_ALLOC, "Allocation record header is correct");
+    ASSERT_TEST(decode_values(record, length, values, 4) == 4 && values[0] == 0x20001000 && values[1] == 64 &&
+                values[2] == 0x0800ABCD && values[3] == 123456789, "Allocation record values are correct");
+
+    // Records are not terminated by a newline, so both arrive in the same read
+    const uint8_t* free_record = memchr(&record[1], DMLOG_RECORD_MARKER, length - 1);
+    ASSERT_TEST(free_record != NULL && free_record[1] == DMLOG_RECORD_HEAP_FREE, "Free record header is correct");
+    ASSERT_TEST(free_record != NULL && decode_values(free_record, length - (free_record - record), values, 4) == 3 &&
+                values[0] == 0x20001000 && values[1] == 0x0800ABEF && values[2] == 123456789, "Free record values are correct");
+
+    dmlog_set_clock(allocating_clock);
+    dmlog_heap_trace_alloc((void*)0x20002000, 8, 0x0800ABCD);
+    length = read_record(ctx, record, sizeof(record));
+    ASSERT_TEST(decode_values(record, length, values, 4) == 4 && values[0] == 0x20002000, "Outer event is logged");
+    ASSERT_TEST(dmlog_read_next(ctx) == false, "Event caused by tracing itself is not logged");
+
+    // An allocation in the middle of a line is logged before the line, which stays whole
+    dmlog_set_clock(test_clock);
+    dmlog_putc(ctx, 'a');
+    dmlog_putc(ctx, 'b');
+    dmlog_heap_trace_alloc((void*)0x20003000, 32, 0x0800ABCD);
+    dmlog_puts(ctx, "c\n");
+    length = read_record(ctx, record, sizeof(record));
+    ASSERT_TEST(record[0] == DMLOG_RECORD_MARKER && record[1] == DMLOG_RECORD_HEAP_ALLOC, "Record written in a line comes first");
+    ASSERT_TEST(length > 4 && memcmp(&record[length - 4], "abc\n", 4) == 0 &&
+                memchr(&record[1], DMLOG_RECORD_MARKER, length - 1) == NULL, "Line around the record is not split");
+
+    dmlog_set_clock(NULL);
+    dmlog_heap_trace_disable();
+    ASSERT_TEST(dmlog_heap_trace_free((void*)0x20002000, 0) == false, "Nothing is logged after tracing is disabled");
+    dmlog_destroy(ctx);
+}
+
+// Test: Context tags and the tag dictionary
+static void test_tags(void) {
+    TEST_SECTION("Context Tags");
+
+    static uint8_t dictionary_buffer[DMLOG_TAG_DICTIONARY_SIZE(2)];
+    dmlog_ctx_t ctx = create_test_context();
+    char entry[DMOD_LOG_MAX_ENTRY_SIZE];
+
+    // Without a dictionary the tags are logged as text
+    ASSERT_TEST(dmlog_tag_push("net", NULL) == true, "Push tag without value");
+    ASSERT_TEST(dmlog_tag_push("conn", "17") == true, "Push tag with value");
+    dmlog_puts(ctx, "Connected\n");
+    dmlog_read_next(ctx);
+    ASSERT_TEST(strcmp(dmlog_get_ref_buffer(ctx), "[net][conn 17] Connected\n") == 0, "Tags are logged as text without a dictionary");
+
+    ASSERT_TEST(dmlog_tags_enable(ctx, dictionary_buffer, 16) == false, "Dictionary buffer must hold a set");
+    ASSERT_TEST(dmlog_tags_enable(ctx, dictionary_buffer, sizeof(dictionary_buffer)) == true, "Enable dictionary");
+    dmlog_ring_t* ring = (dmlog_ring_t*)ctx;
+    dmlog_tag_dictionary_t* dictionary = (dmlog_tag_dictionary_t*)dictionary_buffer;
+    ASSERT_TEST(ring->tags == (uint64_t)(uintptr_t)dictionary_buffer, "Dictionary is published in the ring header");
+    ASSERT_TEST(dictionary->capacity == 2 && dictionary->count == 0, "Dictionary starts empty");
+
+    // Two lines in one write - every line starts with the set index
+    dmlog_puts(ctx, "First\nSecond\n");
+    ASSERT_TEST(dictionary->count == 1 && strcmp(dictionary->sets[0], "[net][conn 17] ") == 0, "Tag set is stored once");
+    dmlog_read_next(ctx);
+    strcpy(entry, dmlog_get_ref_buffer(ctx));
+    ASSERT_TEST((uint8_t)entry[0] == DMLOG_RECORD_MARKER && entry[1] == DMLOG_RECORD_TAG_SET &&
+                (uint8_t)entry[2] == 0xC0 && strcmp(&entry[3], "First\n") == 0, "First line refers to set 0");
+    dmlog_read_next(ctx);
+    strcpy(entry, dmlog_get_ref_buffer(ctx));
+    ASSERT_TEST(entry[1] == DMLOG_RECORD_TAG_SET && (uint8_t)entry[2] == 0xC0 && strcmp(&entry[3], "Second\n") == 0, "Second line refers to set 0");
+
+    // A line that is written in pieces is tagged once
+    dmlog_puts(ctx, "Part 1, ");
+    dmlog_puts(ctx, "part 2\n");
+    dmlog_read_next(ctx);
+    strcpy(entry, dmlog_get_ref_buffer(ctx));
+    ASSERT_TEST(entry[1] == DMLOG_RECORD_TAG_SET && strcmp(&entry[3], "Part 1, part 2\n") == 0, "Continuation of a line is not tagged");
+
+    dmlog_tag_pop();
+    dmlog_puts(ctx, "Closed\n");
+    dmlog_read_next(ctx);
+    strcpy(entry, dmlog_get_ref_buffer(ctx));
+    ASSERT_TEST(dictionary->count == 2 && strcmp(dictionary->sets[1], "[net] ") == 0, "Popped set is stored");
+    ASSERT_TEST((uint8_t)entry[2] == 0xC1 && strcmp(&entry[3], "Closed\n") == 0, "Line refers to set 1");
+
+    // A full dictionary falls back to text, known sets still use their index
+    ASSERT_TEST(dmlog_tag_push("req", "4432\n") == true, "Push tag with a newline in the value");
+    dmlog_puts(ctx, "Request\n");
+    dmlog_read_next(ctx);
+    ASSERT_TEST(dictionary->count == 2 && strcmp(dmlog_get_ref_buffer(ctx), "[net][req 4432 ] Request\n") == 0, "Full dictionary logs the set as text");
+    dmlog_tag_pop();
+    dmlog_puts(ctx, "Known\n");
+    dmlog_read_next(ctx);
+    strcpy(entry, dmlog_get_ref_buffer(ctx));
+    ASSERT_TEST((uint8_t)entry[2] == 0xC1 && strcmp(&entry[3], "Known\n") == 0, "Known set uses its index");
+
+    char long_value[DMLOG_TAG_SET_SIZE + 1];
+    memset(long_value, 'x', DMLOG_TAG_SET_SIZE);
+    long_value[DMLOG_TAG_SET_SIZE] = '\0';
+    ASSERT_TEST(dmlog_tag_push("long", long_value) == false, "Tag set longer than DMLOG_TAG_SET_SIZE is rejected");
+
+    dmlog_tag_clear();
+    dmlog_puts(ctx, "Untagged\n");
+    dmlog_read_next(ctx);
+    ASSERT_TEST(strcmp(dmlog_get_ref_buffer(ctx), "Untagged\n") == 0, "No tags after clear");
+
+    dmlog_tags_disable();
+    ASSERT_TEST(ring->tags == 0, "Dictionary is removed from the ring header");
+    dmlog_destroy(ctx);
+}
+
+int main(void) {
+    printf("Running dmlog record tests...\n\n");
+
+    test_value_encoding();
+    test_put_address();
+    test_put_backtrace();
+    test_backtrace_frame_pointers();
+    test_backtrace_unwinder();
+    test_heap_trace();
+    test_tags();
+
+    // Print summary
+    printf("\n");
+    printf("=====================================\n");
+    printf("Test Summary:\n");
+    printf("  Passed: %d\n", tests_passed);
+    printf("  Failed: %d\n", tests_failed);
+    printf("  Total:  %d\n", tests_passed + tests_failed);
+    printf("=====================================\n");
+
+    return tests_failed > 0 ? 1 : 0;
+}
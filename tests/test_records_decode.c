@@ -0,0 +1,249 @@
+#include "dmlog.h"
+#include "records.h"
+#include "symbols.h"
+#include "test_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Test counters
+int tests_passed = 0;
+int tests_failed = 0;
+
+#define TEST_BUFFER_SIZE (8 * 1024)  // 8KB for tests
+static char test_buffer[TEST_BUFFER_SIZE];
+
+// Backend of the tests - the records decoded here never read the target memory
+int backend_read_memory(backend_type_t type, int socket, uint64_t address, void *buffer, size_t length) {
+    return -1;
+}
+
+// Helper function to create context and clear initial version message for tests
+static dmlog_ctx_t create_test_context(void) {
+    memset(test_buffer, 0, TEST_BUFFER_SIZE);
+    dmlog_ctx_t ctx = dmlog_create(test_buffer, TEST_BUFFER_SIZE);
+    if (ctx) {
+        // Clear the initial version message for clean testing
+        dmlog_clear(ctx);
+    }
+    return ctx;
+}
+
+// Helper function to read the next entry as the monitor receives it
+static size_t read_entry(dmlog_ctx_t ctx, char* out, size_t max_len) {
+    if (!dmlog_read_next(ctx)) {
+        return 0;
+    }
+    const char* entry = dmlog_get_ref_buffer(ctx);
+    size_t length = strlen(entry);
+    if (length >= max_len) {
+        length = max_len - 1;
+    }
+    memcpy(out, entry, length);
+    out[length] = '\0';
+    return length;
+}
+
+// Helper function to check that text contains "(<this file>:<line>)"
+static bool has_location(const char* text, unsigned line) {
+    char location[64];
+    snprintf(location, sizeof(location), "test_records_decode.c:%u)", line);
+    return strstr(text, location) != NULL;
+}
+
+// Functions symbolized by the tests - the line of the entry of the target is its declaration
+static const unsigned target_line = __LINE__ + 1;
+__attribute__((noinline)) static void decode_target_function(void) { __asm__ volatile("" ::: "memory"); }
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__riscv)
+static unsigned leaf_line = 0;
+static unsigned middle_line = 0;
+
+__attribute__((noinline)) static void decode_leaf_function(dmlog_ctx_t ctx) {
+    leaf_line = __LINE__; dmlog_backtrace(ctx, 0);
+    __asm__ volatile("" ::: "memory");
+}
+
+__attribute__((noinline)) static void decode_middle_function(dmlog_ctx_t ctx) {
+    middle_line = __LINE__; decode_leaf_function(ctx);
+    __asm__ volatile("" ::: "memory");
+}
+#endif
+
+// Test: Address record symbolized with the symbol table and the line table
+static void test_address_round_trip(symbols_t* symbols) {
+    TEST_SECTION("Address Round Trip");
+
+    dmlog_ctx_t ctx = create_test_context();
+    dmlog_puts(ctx, "handler ");
+    dmlog_put_address(ctx, (uintptr_t)&decode_target_function);
+    dmlog_puts(ctx, " done\n");
+
+    char entry[256];
+    size_t length = read_entry(ctx, entry, sizeof(entry));
+    ASSERT_TEST(length > 0 && strchr(entry, DMLOG_RECORD_MARKER) != NULL, "Entry carries a binary record");
+
+    records_decoder_t decoder;
+    records_init(&decoder, symbols);
+    const char* text = records_format(&decoder, entry, length);
+    TEST_INFO("Decoded: %s", text);
+    ASSERT_TEST(strchr(text, DMLOG_RECORD_MARKER) == NULL, "Record is replaced with text");
+    ASSERT_TEST(strncmp(text, "handler 0x", strlen("handler 0x")) == 0, "Text before the record is kept");
+    ASSERT_TEST(strstr(text, "<decode_target_function+0x0>") != NULL, "Address is symbolized with the ELF symbol table");
+    ASSERT_TEST(has_location(text, target_line), "Address is symbolized with the DWARF line table");
+    ASSERT_TEST(strstr(text, ") done\n") != NULL, "Text after the record is kept");
+
+    char expected[64];
+    snprintf(expected, sizeof(expected), "0x%08llx ", (unsigned long long)(uintptr_t)&decode_target_function);
+    ASSERT_TEST(strstr(text, expected) != NULL, "Address value survives the round trip");
+
+    records_deinit(&decoder);
+    dmlog_destroy(ctx);
+}
+
+// Test: Backtrace record symbolized as return addresses
+static void test_backtrace_round_trip(symbols_t* symbols) {
+    TEST_SECTION("Backtrace Round Trip");
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__riscv)
+    dmlog_ctx_t ctx = create_test_context();
+    dmlog_set_unwinder(NULL, NULL);
+    decode_middle_function(ctx);
+
+    char entry[256];
+    size_t length = read_entry(ctx, entry, sizeof(entry));
+
+    records_decoder_t decoder;
+    records_init(&decoder, symbols);
+    const char* text = records_format(&decoder, entry, length);
+    TEST_INFO("Decoded:\n%s", text);
+    ASSERT_TEST(strncmp(text, "Backtrace:\n    #0 0x", strlen("Backtrace:\n    #0 0x")) == 0, "Backtrace lists the frames");
+
+    const char* first = strstr(text, "#0 ");
+    const char* second = strstr(text, "#1 ");
+    const char* first_end = first ? strchr(first, '\n') : NULL;
+    const char* second_end = second ? strchr(second, '\n') : NULL;
+    ASSERT_TEST(first_end != NULL && second_end != NULL, "Backtrace has the calling functions");
+    if (first_end != NULL && second_end != NULL) {
+        char frame[256];
+        snprintf(frame, sizeof(frame), "%.*s", (int)(first_end - first), first);
+        ASSERT_TEST(strstr(frame, "<decode_leaf_function+") != NULL, "First frame returns into the leaf function");
+        ASSERT_TEST(has_location(frame, leaf_line), "First frame is the line of the call");
+        snprintf(frame, sizeof(frame), "%.*s", (int)(second_end - second), second);
+        ASSERT_TEST(strstr(frame, "<decode_middle_function+") != NULL, "Second frame returns into the middle function");
+        ASSERT_TEST(has_location(frame, middle_line), "Second frame is the line of the call");
+    }
+
+    records_deinit(&decoder);
+    dmlog_destroy(ctx);
+#else
+    TEST_INFO("Frame pointer unwinding is not supported on this architecture");
+#endif
+}
+
+// Test: Record split between reads of the monitor
+static void test_split_record(symbols_t* symbols) {
+    TEST_SECTION("Split Record");
+
+    dmlog_ctx_t ctx = create_test_context();
+    dmlog_puts(ctx, "at ");
+    dmlog_put_address(ctx, (uintptr_t)&decode_target_function);
+    dmlog_puts(ctx, "\n");
+
+    char entry[256];
+    size_t length = read_entry(ctx, entry, sizeof(entry));
+
+    records_decoder_t decoder;
+    records_init(&decoder, symbols);
+    char whole[512];
+    snprintf(whole, sizeof(whole), "%s", records_format(&decoder, entry, length));
+
+    // Feed the entry one byte at a time
+    char pieces[512] = "";
+    bool nothing_early = true;
+    for (size_t i = 0; i < length; i++) {
+        const char* text = records_format(&decoder, &entry[i], 1);
+        size_t used = strlen(pieces);
+        if (text == &entry[i]) {
+            snprintf(&pieces[used], sizeof(pieces) - used, "%c", entry[i]);
+        } else {
+            snprintf(&pieces[used], sizeof(pieces) - used, "%s", text);
+        }
+        if (strchr(pieces, DMLOG_RECORD_MARKER) != NULL) {
+            nothing_early = false;
+        }
+    }
+    ASSERT_TEST(nothing_early, "Incomplete record is not printed");
+    ASSERT_TEST(strcmp(pieces, whole) == 0, "Record split in single bytes decodes like the whole entry");
+
+    records_deinit(&decoder);
+    dmlog_destroy(ctx);
+}
+
+// Test: Records without symbols or tag dictionary
+static void test_plain_records(void) {
+    TEST_SECTION("Plain Records");
+
+    dmlog_ctx_t ctx = create_test_context();
+    dmlog_put_address(ctx, (uintptr_t)0x0800ABCD);
+    dmlog_puts(ctx, "\n");
+
+    char entry[256];
+    size_t length = read_entry(ctx, entry, sizeof(entry));
+
+    records_decoder_t decoder;
+    records_init(&decoder, NULL);
+    ASSERT_TEST(strcmp(records_format(&decoder, entry, length), "0x0800abcd\n") == 0, "Address without symbols is printed plain");
+
+    const char* plain = "no records here\n";
+    ASSERT_TEST(records_format(&decoder, plain, strlen(plain)) == plain, "Plain text is passed through");
+
+    // Tag set record as the firmware writes it
+    uint8_t record[DMLOG_RECORD_MAX_SIZE] = { DMLOG_RECORD_MARKER, DMLOG_RECORD_TAG_SET };
+    size_t record_length = 2 + dmlog_record_encode_value(&record[2], 3);
+    record[record_length++] = 'x';
+    const char* text = records_format(&decoder, (const char*)record, record_length);
+    ASSERT_TEST(strcmp(text, "[tag set 3] x") == 0, "Tag set without a dictionary shows its index");
+
+    records_deinit(&decoder);
+    dmlog_destroy(ctx);
+}
+
+int main(void) {
+    printf("\n");
+    printf("========================================\n");
+    printf("     DMLOG Records Decode Tests\n");
+    printf("========================================\n");
+
+    // The test binary is its own firmware - it is built with -g and without PIE
+    symbols_t* symbols = symbols_load("/proc/self/exe");
+    ASSERT_TEST(symbols != NULL, "Symbols of the test binary are loaded");
+    if (symbols == NULL || symbols_lookup(symbols, (uintptr_t)&decode_target_function, false) == NULL) {
+        printf("\n" COLOR_RED "The test binary has no symbols or is position independent!" COLOR_RESET "\n\n");
+        symbols_free(symbols);
+        return 1;
+    }
+
+    test_address_round_trip(symbols);
+    test_backtrace_round_trip(symbols);
+    test_split_record(symbols);
+    test_plain_records();
+
+    symbols_free(symbols);
+
+    // Print summary
+    printf("\n");
+    printf("========================================\n");
+    printf("          Test Summary\n");
+    printf("========================================\n");
+    printf("Tests Passed: " COLOR_GREEN "%d" COLOR_RESET "\n", tests_passed);
+    printf("Tests Failed: " COLOR_RED "%d" COLOR_RESET "\n", tests_failed);
+    printf("Total Tests:  %d\n", tests_passed + tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n" COLOR_GREEN "All tests passed!" COLOR_RESET "\n\n");
+        return 0;
+    } else {
+        printf("\n" COLOR_RED "Some tests failed!" COLOR_RESET "\n\n");
+        return 1;
+    }
+}
@@ -0,0 +1,235 @@
+#!/bin/bash
+# End-to-end soak benchmark for dmlog with gdbserver and dmlog_monitor
+#
+# Runs test_app_interactive in load generator mode under gdbserver, lets
+# dmlog_monitor archive every line it receives and reports:
+# - the sustained throughput that reached the host
+# - the messages lost on the way (gaps in the sequence numbers - the ring
+#   overwrites the oldest data when the monitor does not keep up)
+# - the latency from logging a message on the target to its arrival in the
+#   monitor (both ends on localhost, so they share the clock)
+#
+# Usage:
+#   ./test_soak_gdb.sh
+#
+# The load is configured with environment variables (see the load spec of
+# test_app_interactive):
+#   RATE=5000 DURATION=30 SIZE=32-200 DIST=bimodal BURST=50 ./test_soak_gdb.sh
+#
+# BUFFER_SIZE sets the size of the ring. MAX_LOSS=PERCENT makes the script
+# fail when more messages are lost. BACKEND, TRANSPORT and MONITOR_ARGS work
+# like in test_automated_gdb.sh:
+#   BACKEND=exporter ./test_soak_gdb.sh
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${SCRIPT_DIR}/../build"
+TEST_APP="${BUILD_DIR}/tests/test_app_interactive"
+MONITOR="${BUILD_DIR}/tools/monitor/dmlog_monitor"
+EXPORTER="${BUILD_DIR}/tools/exporter/dmlog_exporter"
+QUERY="${BUILD_DIR}/tools/query/dmlog_query"
+
+GDB_PORT=1234
+EXPORTER_PORT=4455
+BACKEND=${BACKEND:-gdb}
+TRANSPORT=${TRANSPORT:-tcp}
+MONITOR_ARGS=${MONITOR_ARGS:-}
+
+RATE=${RATE:-2000}
+DURATION=${DURATION:-10}
+SIZE=${SIZE:-32-128}
+DIST=${DIST:-uniform}
+BURST=${BURST:-1}
+BUFFER_SIZE=${BUFFER_SIZE:-16384}
+MAX_LOSS=${MAX_LOSS:-}
+MONITOR_TIMEOUT=$((DURATION + 30))
+
+LOAD_SPEC="rate=${RATE},duration=${DURATION},size=${SIZE},dist=${DIST},burst=${BURST}"
+INPUT_DATA="/tmp/dmlog_soak_input.txt"
+APP_OUTPUT="/tmp/dmlog_soak_app.txt"
+MONITOR_OUTPUT="/tmp/dmlog_soak_monitor.txt"
+RECEIVED="/tmp/dmlog_soak_received.txt"
+LATENCIES="/tmp/dmlog_soak_latencies.txt"
+ARCHIVE_DIR="/tmp/dmlog_soak_archive"
+
+# Color output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+echo "=== dmlog Soak Benchmark with ${BACKEND} backend (${TRANSPORT}) ==="
+echo "Load: ${LOAD_SPEC}, ring of ${BUFFER_SIZE} bytes"
+echo ""
+
+# Check prerequisites
+for binary in "$TEST_APP" "$MONITOR" "$QUERY"; do
+    if [ ! -f "$binary" ]; then
+        echo -e "${RED}ERROR: $(basename "$binary") not found at $binary${NC}"
+        echo "Please build the project with DMLOG_BUILD_TOOLS=ON first"
+        exit 1
+    fi
+done
+
+if [ "$BACKEND" = "exporter" ]; then
+    if [ ! -f "$EXPORTER" ]; then
+        echo -e "${RED}ERROR: dmlog_exporter not found at $EXPORTER${NC}"
+        echo "Please build with DMLOG_BUILD_TOOLS=ON"
+        exit 1
+    fi
+    if [ "$TRANSPORT" != "tcp" ]; then
+        echo -e "${RED}ERROR: The exporter backend supports only TRANSPORT=tcp${NC}"
+        exit 1
+    fi
+    backend_args=(--exporter --port $EXPORTER_PORT)
+else
+    if ! command -v gdbserver &> /dev/null; then
+        echo -e "${YELLOW}SKIP: gdbserver not found. Install with: apt-get install gdbserver${NC}"
+        exit 0
+    fi
+    backend_args=(--gdb --port $GDB_PORT)
+fi
+
+BUFFER_ADDR=$(nm "$TEST_APP" | grep ' [BbDd] g_log_buffer' | awk '{print "0x" $1}')
+if [ -z "$BUFFER_ADDR" ]; then
+    echo -e "${RED}ERROR: Could not find g_log_buffer symbol in test application${NC}"
+    exit 1
+fi
+
+rm -rf "$ARCHIVE_DIR"
+rm -f "$APP_OUTPUT" "$MONITOR_OUTPUT" "$RECEIVED" "$LATENCIES"
+
+# The load generator starts when it receives a line of input, so nothing is
+# lost before the monitor is connected
+echo "start" > "$INPUT_DATA"
+
+SERVER_PID=""
+if [ "$TRANSPORT" = "stdio" ]; then
+    echo "Step 1: gdbserver is started by the monitor over stdio"
+    backend_args+=(--host "exec:exec gdbserver stdio '$TEST_APP' --load '$LOAD_SPEC' '$BUFFER_SIZE' 2> '$APP_OUTPUT'")
+else
+    echo "Step 1: Starting ${BACKEND} server with the load generator..."
+    if [ "$BACKEND" = "exporter" ]; then
+        "$EXPORTER" --once --bind 127.0.0.1 --port ${EXPORTER_PORT} -- "$TEST_APP" --load "$LOAD_SPEC" "$BUFFER_SIZE" > "$APP_OUTPUT" 2>&1 &
+    else
+        gdbserver --once :${GDB_PORT} "$TEST_APP" --load "$LOAD_SPEC" "$BUFFER_SIZE" > "$APP_OUTPUT" 2>&1 &
+    fi
+    SERVER_PID=$!
+
+    # Wait for the server to be ready
+    sleep 2
+
+    if ! kill -0 $SERVER_PID 2>/dev/null; then
+        echo -e "${RED}ERROR: ${BACKEND} server failed to start${NC}"
+        cat "$APP_OUTPUT"
+        exit 1
+    fi
+fi
+
+echo "Step 2: Monitoring for ${DURATION}s (buffer address: $BUFFER_ADDR)..."
+timeout $MONITOR_TIMEOUT "$MONITOR" "${backend_args[@]}" --addr $BUFFER_ADDR --archive "$ARCHIVE_DIR" --input-file "$INPUT_DATA" $MONITOR_ARGS > "$MONITOR_OUTPUT" 2>&1 || true
+
+if [ -n "$SERVER_PID" ] && kill -0 $SERVER_PID 2>/dev/null; then
+    kill $SERVER_PID 2>/dev/null || true
+    wait $SERVER_PID 2>/dev/null || true
+fi
+
+echo "Step 3: Analyzing the received messages..."
+
+# The archive keeps the time every line was received (in ms). Printed in UTC,
+# so it can be compared with the wall clock time in the messages.
+TZ=UTC "$QUERY" --archive "$ARCHIVE_DIR" --time LOAD > "$RECEIVED" 2>/dev/null || true
+
+# The target reports what it sent both in the ring and on its stdout
+SENT=$(grep -o "LOAD done sent=[0-9]*" "$RECEIVED" | tail -1 | cut -d= -f2)
+if [ -z "$SENT" ]; then
+    SENT=$(grep -o "Load done: [0-9]*" "$APP_OUTPUT" | tail -1 | awk '{ print $3 }')
+fi
+OFFERED=$(grep -o "([0-9]* msg/s)" "$APP_OUTPUT" | tail -1 | tr -d '()')
+
+# Fields: [YYYY-MM-DD HH:MM:SS.mmm] LOAD <seq> <time_us> <padding>
+STATS=$(awk -v latencies="$LATENCIES" '
+    function days_from_civil(y, m, d,    era, yoe, doy, doe) {
+        y -= (m <= 2)
+        era = int(y / 400)
+        yoe = y - era * 400
+        doy = int((153 * (m > 2 ? m - 3 : m + 9) + 2) / 5) + d - 1
+        doe = yoe * 365 + int(yoe / 4) - int(yoe / 100) + doy
+        return era * 146097 + doe - 719468
+    }
+    $3 == "LOAD" && $4 ~ /^[0-9]+$/ {
+        split(substr($1, 2), date, "-")
+        split($2, time, ":")
+        received_ms = (days_from_civil(date[1] + 0, date[2] + 0, date[3] + 0) * 86400 + time[1] * 3600 + time[2] * 60) * 1000 + time[3] * 1000
+        seq = $4 + 0
+        if (seq in seen) {
+            duplicates++
+            next
+        }
+        seen[seq] = 1
+        if (count > 0 && seq < last_seq) {
+            reordered++
+        }
+        last_seq = seq
+        count++
+        bytes += length(substr($0, index($0, "LOAD"))) + 1
+        if (count == 1) {
+            first_ms = received_ms
+        }
+        last_ms = received_ms
+        print received_ms - $5 / 1000 > latencies
+    }
+    END {
+        printf "%d %d %d %d %.3f\n", count, bytes, duplicates, reordered, (last_ms - first_ms) / 1000
+    }
+' "$RECEIVED")
+read RECEIVED_COUNT RECEIVED_BYTES DUPLICATES REORDERED SPAN_S <<< "$STATS"
+
+if [ "$RECEIVED_COUNT" -eq 0 ] || [ -z "$SENT" ]; then
+    echo -e "${RED}✗ FAILED: No load messages received${NC}"
+    echo ""
+    echo "Monitor output:"
+    tail -20 "$MONITOR_OUTPUT"
+    echo ""
+    echo "Application output:"
+    tail -20 "$APP_OUTPUT"
+    exit 1
+fi
+
+LOST=$((SENT - RECEIVED_COUNT))
+LATENCY=$(sort -n "$LATENCIES" | awk '
+    { value[NR] = $1; sum += $1 }
+    END {
+        p50 = value[int((NR - 1) * 0.50) + 1]
+        p99 = value[int((NR - 1) * 0.99) + 1]
+        printf "avg %.1f ms, p50 %.0f ms, p99 %.0f ms, max %.0f ms", sum / NR, p50, p99, value[NR]
+    }')
+THROUGHPUT=$(awk -v n="$RECEIVED_COUNT" -v b="$RECEIVED_BYTES" -v s="$SPAN_S" '
+    BEGIN { if (s <= 0) s = 0.001; printf "%.0f msg/s, %.1f KiB/s", n / s, b / s / 1024 }')
+LOSS=$(awk -v l="$LOST" -v s="$SENT" 'BEGIN { printf "%.2f", (s > 0 ? l * 100 / s : 0) }')
+ROUND_TRIPS=$(grep -o "Backend round trips: [0-9]* requests, average [0-9.]* us" "$MONITOR_OUTPUT" | tail -1 | cut -d' ' -f4-)
+
+echo ""
+echo "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━"
+echo "SOAK RESULTS (${BACKEND}, ${TRANSPORT})"
+echo "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━"
+echo "Load:               ${LOAD_SPEC}, ring of ${BUFFER_SIZE} bytes"
+echo "Sent:               ${SENT} messages${OFFERED:+ (${OFFERED})}"
+echo "Received:           ${RECEIVED_COUNT} messages, ${RECEIVED_BYTES} bytes in ${SPAN_S} s"
+echo "Throughput:         ${THROUGHPUT}"
+echo "Lost:               ${LOST} messages (${LOSS}%)"
+echo "Latency:            ${LATENCY}"
+if [ "${DUPLICATES:-0}" -gt 0 ] || [ "${REORDERED:-0}" -gt 0 ]; then
+    echo -e "${YELLOW}Out of order:       ${REORDERED} reordered, ${DUPLICATES} duplicated${NC}"
+fi
+if [ -n "$ROUND_TRIPS" ]; then
+    echo "Backend requests:   ${ROUND_TRIPS}"
+fi
+echo "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━"
+
+if [ -n "$MAX_LOSS" ] && awk -v l="$LOSS" -v m="$MAX_LOSS" 'BEGIN { exit !(l > m) }'; then
+    echo -e "${RED}✗ FAILED: Loss of ${LOSS}% exceeds MAX_LOSS=${MAX_LOSS}%${NC}"
+    exit 1
+fi
+echo -e "${GREEN}Soak benchmark completed${NC}"
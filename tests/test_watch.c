@@ -0,0 +1,204 @@
+#include "watch.h"
+#include "symbols.h"
+#include "test_common.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Test counters
+int tests_passed = 0;
+int tests_failed = 0;
+
+#define TEST_OUTPUT_FILE "test_watch_output.txt"
+
+// Variables sampled by the tests - this binary is built with -g and is its own firmware
+typedef enum { WATCH_MODE_IDLE = 1, WATCH_MODE_RUNNING = -7 } watch_mode_t;
+
+volatile int16_t        watch_temperature = -1234;
+volatile uint32_t       watch_counter = 4000000000u;
+volatile float          watch_ratio = 0.5f;
+volatile double         watch_voltage = 3.25;
+volatile bool           watch_enabled = true;
+volatile watch_mode_t   watch_mode = WATCH_MODE_RUNNING;
+volatile uint64_t       watch_big = 0x1122334455667788ull;
+volatile uint8_t        watch_blob[6] = { 0xde, 0xad, 0xbe, 0xef, 0x01, 0x02 };
+volatile void*          watch_pointer = (void*)(uintptr_t)0x1000;
+
+// Difference between the runtime addresses and the addresses in the ELF file (PIE)
+static int64_t load_bias = 0;
+static int read_count = 0;
+
+// Backend of the tests - reads the memory of this process
+int backend_read_memory(backend_type_t type, int socket, uint64_t address, void *buffer, size_t length) {
+    memcpy(buffer, (const void*)(uintptr_t)(address + (uint64_t)load_bias), length);
+    read_count++;
+    return 0;
+}
+
+// Helper function to sample once and read the sample line back
+static bool sample_line(const char* variables, symbols_t* symbols, watch_format_t format, char* line, size_t size) {
+    watch_t* watch = watch_open(variables, symbols, TEST_OUTPUT_FILE, format, 0);
+    if (watch == NULL) {
+        return false;
+    }
+    bool sampled = watch_sample(watch, BACKEND_TYPE_EXPORTER, -1);
+    watch_close(watch);
+
+    FILE* file = fopen(TEST_OUTPUT_FILE, "r");
+    line[0] = '\0';
+    if (file != NULL) {
+        // The last line is the sample, a CSV header comes first
+        char buffer[512];
+        while (fgets(buffer, sizeof(buffer), file)) {
+            strncpy(line, buffer, size - 1);
+            line[size - 1] = '\0';
+        }
+        fclose(file);
+    }
+    return sampled;
+}
+
+// Helper function to strip the time stamp column of a CSV sample
+static const char* csv_values(const char* line) {
+    const char* comma = strchr(line, ',');
+    return comma ? comma + 1 : "";
+}
+
+// Test: Variable types from the DWARF information
+static void test_variable_types(symbols_t* symbols) {
+    TEST_SECTION("Variable Types");
+
+    symbols_variable_t variable;
+    ASSERT_TEST(symbols_find_variable(symbols, "watch_temperature", &variable) &&
+                variable.type == SYMBOLS_TYPE_SIGNED && variable.type_size == 2, "int16_t is a signed 2 byte value");
+    ASSERT_TEST(symbols_find_variable(symbols, "watch_counter", &variable) &&
+                variable.type == SYMBOLS_TYPE_UNSIGNED && variable.type_size == 4, "uint32_t is an unsigned 4 byte value");
+    ASSERT_TEST(symbols_find_variable(symbols, "watch_ratio", &variable) &&
+                variable.type == SYMBOLS_TYPE_FLOAT && variable.type_size == 4, "float is a 4 byte floating point value");
+    ASSERT_TEST(symbols_find_variable(symbols, "watch_voltage", &variable) &&
+                variable.type == SYMBOLS_TYPE_FLOAT && variable.type_size == 8, "double is an 8 byte floating point value");
+    ASSERT_TEST(symbols_find_variable(symbols, "watch_enabled", &variable) &&
+                variable.type == SYMBOLS_TYPE_BOOL, "bool is a boolean");
+    ASSERT_TEST(symbols_find_variable(symbols, "watch_mode", &variable) &&
+                variable.type == SYMBOLS_TYPE_SIGNED, "Enumeration is a signed value");
+    ASSERT_TEST(symbols_find_variable(symbols, "watch_pointer", &variable) &&
+                variable.type == SYMBOLS_TYPE_POINTER && variable.type_size == sizeof(void*), "Pointer is a pointer");
+    ASSERT_TEST(symbols_find_variable(symbols, "watch_blob", &variable) &&
+                variable.type == SYMBOLS_TYPE_UNKNOWN && variable.size == sizeof(watch_blob), "Array has the size of the symbol");
+    ASSERT_TEST(!symbols_find_variable(symbols, "watch_missing", &variable), "Unknown variable is not found");
+}
+
+// Test: Variables watched by name
+static void test_watch_by_name(symbols_t* symbols) {
+    TEST_SECTION("Watch By Name");
+
+    char line[512];
+    read_count = 0;
+    ASSERT_TEST(sample_line("watch_temperature,watch_counter,watch_ratio,watch_voltage,watch_enabled,watch_mode,watch_blob",
+                            symbols, WATCH_FORMAT_CSV, line, sizeof(line)), "Variables are sampled");
+    ASSERT_TEST(strcmp(csv_values(line), "-1234,4000000000,0.5,3.25,1,-7,deadbeef0102\n") == 0, "Values are formatted by their type");
+    ASSERT_TEST(read_count == 1, "Variables close to each other are read together");
+
+    char expected[64];
+    snprintf(expected, sizeof(expected), "0x%0*llx\n", (int)sizeof(void*) * 2, 0x1000ull);
+    ASSERT_TEST(sample_line("watch_pointer", symbols, WATCH_FORMAT_CSV, line, sizeof(line)) &&
+                strcmp(csv_values(line), expected) == 0, "Pointer is shown as an address");
+
+    ASSERT_TEST(sample_line("watch_counter", symbols, WATCH_FORMAT_CSV, line, sizeof(line)), "Header is written");
+    FILE* file = fopen(TEST_OUTPUT_FILE, "r");
+    char header[64] = "";
+    if (file != NULL) {
+        if (fgets(header, sizeof(header), file) == NULL) {
+            header[0] = '\0';
+        }
+        fclose(file);
+    }
+    ASSERT_TEST(strcmp(header, "time,watch_counter\n") == 0, "CSV header lists the variables");
+}
+
+// Test: Types given after the name
+static void test_watch_with_type(symbols_t* symbols) {
+    TEST_SECTION("Watch With Type");
+
+    char line[512];
+    ASSERT_TEST(sample_line("watch_counter:i32,watch_temperature:u16,watch_big:u8,watch_blob:hex", symbols, WATCH_FORMAT_CSV, line, sizeof(line)) &&
+                strcmp(csv_values(line), "-294967296,64302,136,deadbeef0102\n") == 0, "Given type overrides the DWARF type");
+
+    watch_t* watch = watch_open("watch_counter:c64", symbols, TEST_OUTPUT_FILE, WATCH_FORMAT_CSV, 0);
+    ASSERT_TEST(watch == NULL, "Unknown type is refused");
+    watch_close(watch);
+}
+
+// Test: Variables watched by address
+static void test_watch_by_address(symbols_t* symbols) {
+    TEST_SECTION("Watch By Address");
+
+    // Addresses as they are in the ELF file
+    char variables[128];
+    snprintf(variables, sizeof(variables), "0x%llx:u64,0x%llx:f32",
+             (unsigned long long)((uintptr_t)&watch_big - (uint64_t)load_bias),
+             (unsigned long long)((uintptr_t)&watch_ratio - (uint64_t)load_bias));
+    char line[512];
+    ASSERT_TEST(sample_line(variables, NULL, WATCH_FORMAT_CSV, line, sizeof(line)) &&
+                strcmp(csv_values(line), "1234605616436508552,0.5\n") == 0, "Addresses are sampled without symbols");
+
+    snprintf(variables, sizeof(variables), "0x%llx", (unsigned long long)((uintptr_t)&watch_big - (uint64_t)load_bias));
+    watch_t* watch = watch_open(variables, symbols, TEST_OUTPUT_FILE, WATCH_FORMAT_CSV, 0);
+    ASSERT_TEST(watch == NULL, "Address without a type is refused");
+    watch_close(watch);
+}
+
+// Test: InfluxDB line protocol
+static void test_line_protocol(symbols_t* symbols) {
+    TEST_SECTION("Line Protocol");
+
+    char line[512];
+    ASSERT_TEST(sample_line("watch_temperature,watch_counter,watch_enabled,watch_blob", symbols, WATCH_FORMAT_LINE, line, sizeof(line)),
+                "Variables are sampled");
+    const char* expected = "dmlog_watch watch_temperature=-1234i,watch_counter=4000000000i,watch_enabled=true,watch_blob=\"deadbeef0102\" ";
+    ASSERT_TEST(strncmp(line, expected, strlen(expected)) == 0, "Fields are typed for InfluxDB");
+    ASSERT_TEST(strlen(line) > strlen(expected) + 1 && line[strlen(line) - 1] == '\n', "Line ends with a time stamp");
+}
+
+int main(void) {
+    printf("\n");
+    printf("========================================\n");
+    printf("     DMLOG Watch Tests\n");
+    printf("========================================\n");
+
+    symbols_t* symbols = symbols_load("/proc/self/exe");
+    ASSERT_TEST(symbols != NULL, "Symbols of the test binary are loaded");
+    symbols_variable_t counter;
+    if (symbols == NULL || !symbols_find_variable(symbols, "watch_counter", &counter)) {
+        printf("\n" COLOR_RED "The test binary has no symbols!" COLOR_RESET "\n\n");
+        return 1;
+    }
+    load_bias = (int64_t)((uintptr_t)&watch_counter - counter.address);
+
+    test_variable_types(symbols);
+    test_watch_by_name(symbols);
+    test_watch_with_type(symbols);
+    test_watch_by_address(symbols);
+    test_line_protocol(symbols);
+
+    symbols_free(symbols);
+    remove(TEST_OUTPUT_FILE);
+
+    // Print summary
+    printf("\n");
+    printf("========================================\n");
+    printf("          Test Summary\n");
+    printf("========================================\n");
+    printf("Tests Passed: " COLOR_GREEN "%d" COLOR_RESET "\n", tests_passed);
+    printf("Tests Failed: " COLOR_RED "%d" COLOR_RESET "\n", tests_failed);
+    printf("Total Tests:  %d\n", tests_passed + tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n" COLOR_GREEN "All tests passed!" COLOR_RESET "\n\n");
+        return 0;
+    } else {
+        printf("\n" COLOR_RED "Some tests failed!" COLOR_RESET "\n\n");
+        return 1;
+    }
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <signal.h>
+#include "server.h"
+#include "trace.h"
+
+#ifndef DMLOG_VERSION
+#   define DMLOG_VERSION "unknown"
+#endif
+
+void usage(const char *progname)
+{
+    printf("Usage: %s [options] --pid PID\n", progname);
+    printf("       %s [options] -- PROGRAM [ARGS...]\n", progname);
+    printf("Options:\n");
+    printf("  --help        Show this help message\n");
+    printf("  --version     Show version information\n");
+    printf("  --bind        Address to listen on, or unix:PATH (default: 0.0.0.0)\n");
+    printf("  --port        Port to listen on (default: %d)\n", EXPORTER_DEFAULT_PORT);
+    printf("  --pid         Serve a running process\n");
+    printf("  --interval    Sampling interval of the watched ranges in ms (default: %d)\n", SERVER_DEFAULT_INTERVAL);
+    printf("  --once        Exit when the first client disconnects\n");
+    printf("  --trace-level Set trace level (error, warn, info, verbose)\n");
+    printf("  --verbose     Enable verbose output (equivalent to --trace-level verbose)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *bind_address = "0.0.0.0";
+    int port = EXPORTER_DEFAULT_PORT;
+    pid_t pid = 0;
+    uint32_t interval = SERVER_DEFAULT_INTERVAL;
+    bool once = false;
+    char **program = NULL;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--help") == 0)
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if(strcmp(argv[i], "--version") == 0)
+        {
+            printf("dmlog exporter version %s\n", DMLOG_VERSION);
+            return 0;
+        }
+        else if(strcmp(argv[i], "--bind") == 0 && i + 1 < argc)
+        {
+            bind_address = argv[++i];
+        }
+        else if(strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+        {
+            port = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--pid") == 0 && i + 1 < argc)
+        {
+            pid = (pid_t)strtol(argv[++i], NULL, 0);
+        }
+        else if(strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+        {
+            interval = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if(strcmp(argv[i], "--once") == 0)
+        {
+            once = true;
+        }
+        else if(strcmp(argv[i], "--trace-level") == 0 && i + 1 < argc)
+        {
+            const char *level_str = argv[++i];
+            if(strcmp(level_str, "error") == 0)
+            {
+                current_trace_level = TRACE_LEVEL_ERROR;
+            }
+            else if(strcmp(level_str, "warn") == 0)
+            {
+                current_trace_level = TRACE_LEVEL_WARN;
+            }
+            else if(strcmp(level_str, "info") == 0)
+            {
+                current_trace_level = TRACE_LEVEL_INFO;
+            }
+            else if(strcmp(level_str, "verbose") == 0)
+            {
+                current_trace_level = TRACE_LEVEL_VERBOSE;
+            }
+            else
+            {
+                TRACE_ERROR("Unknown trace level: %s\n", level_str);
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "--verbose") == 0)
+        {
+            current_trace_level = TRACE_LEVEL_VERBOSE;
+        }
+        else if(strcmp(argv[i], "--") == 0 && i + 1 < argc)
+        {
+            program = &argv[i + 1];
+            break;
+        }
+        else
+        {
+            TRACE_ERROR("Unknown option: %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if((pid > 0) == (program != NULL))
+    {
+        TRACE_ERROR("Either --pid or a program to start is required\n");
+        usage(argv[0]);
+        return 1;
+    }
+
+    TRACE_INFO("dmlog exporter version %s\n", DMLOG_VERSION);
+
+    // A client that disappears must not kill the exporter
+    signal(SIGPIPE, SIG_IGN);
+
+    bool owns_process = program != NULL;
+    if(owns_process)
+    {
+        pid = server_launch(program);
+        if(pid < 0)
+        {
+            return 1;
+        }
+    }
+
+    server_t *server = server_open(bind_address, port, pid, owns_process, interval);
+    if(server == NULL)
+    {
+        if(owns_process)
+        {
+            kill(pid, SIGTERM);
+        }
+        return 1;
+    }
+    int status = server_run(server, once);
+    server_close(server);
+    return status;
+}
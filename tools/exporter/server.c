@@ -0,0 +1,688 @@
+#define _GNU_SOURCE
+
+#include "server.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * @brief Range of the process memory watched by the client
+ */
+typedef struct
+{
+    uint64_t    address;
+    size_t      length;
+    uint8_t*    sent;       //!< Bytes the client has
+    uint8_t*    current;    //!< Bytes of the last sample
+    bool        sampled;    //!< The last sample succeeded
+} watch_range_t;
+
+struct server
+{
+    pid_t           pid;
+    bool            owns_process;       //!< The process was started by the exporter
+    bool            process_exited;
+    int             exit_status;
+    int             listen_socket;
+    char*           unix_path;          //!< Path of the listening Unix socket (NULL for TCP)
+    int             client;
+    uint32_t        interval;           //!< Sampling interval in milliseconds
+    watch_range_t   watches[EXPORTER_MAX_WATCHES];
+    size_t          watch_count;
+    uint8_t*        buffer;             //!< Payload of the current request or reply
+    size_t          buffer_size;
+    uint8_t*        batch;              //!< Updates of the current sample
+    size_t          batch_length;
+    size_t          batch_size;
+};
+
+/**
+ * @brief Make sure a buffer can hold the given number of bytes
+ *
+ * @param buffer Buffer to grow
+ * @param size Current size of the buffer
+ * @param required Required size
+ * @return true on success, false on failure
+ */
+static bool reserve(uint8_t** buffer, size_t* size, size_t required)
+{
+    if(required <= *size)
+    {
+        return true;
+    }
+    size_t new_size = *size ? *size : 4096;
+    while(new_size < required)
+    {
+        new_size *= 2;
+    }
+    uint8_t* new_buffer = realloc(*buffer, new_size);
+    if(new_buffer == NULL)
+    {
+        TRACE_ERROR("Failed to allocate %zu bytes\n", new_size);
+        return false;
+    }
+    *buffer = new_buffer;
+    *size = new_size;
+    return true;
+}
+
+/**
+ * @brief Read memory of the process
+ *
+ * @param server Server
+ * @param address Address in the process
+ * @param buffer Buffer to store the bytes
+ * @param length Number of bytes to read
+ * @return int 0 on success, errno value on failure
+ */
+static int process_read(server_t* server, uint64_t address, void* buffer, size_t length)
+{
+    for(size_t done = 0; done < length; )
+    {
+        struct iovec local = { .iov_base = (uint8_t*)buffer + done, .iov_len = length - done };
+        struct iovec remote = { .iov_base = (void*)(uintptr_t)(address + done), .iov_len = length - done };
+        ssize_t read = process_vm_readv(server->pid, &local, 1, &remote, 1, 0);
+        if(read <= 0)
+        {
+            return read < 0 ? errno : EFAULT;
+        }
+        done += (size_t)read;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write memory of the process
+ *
+ * @param server Server
+ * @param address Address in the process
+ * @param buffer Bytes to write
+ * @param length Number of bytes to write
+ * @return int 0 on success, errno value on failure
+ */
+static int process_write(server_t* server, uint64_t address, const void* buffer, size_t length)
+{
+    for(size_t done = 0; done < length; )
+    {
+        struct iovec local = { .iov_base = (uint8_t*)buffer + done, .iov_len = length - done };
+        struct iovec remote = { .iov_base = (void*)(uintptr_t)(address + done), .iov_len = length - done };
+        ssize_t written = process_vm_writev(server->pid, &local, 1, &remote, 1, 0);
+        if(written <= 0)
+        {
+            return written < 0 ? errno : EFAULT;
+        }
+        done += (size_t)written;
+    }
+    return 0;
+}
+
+/**
+ * @brief Check if the process is still running
+ *
+ * @param server Server
+ * @return true if the process is running
+ */
+static bool process_running(server_t* server)
+{
+    if(server->process_exited)
+    {
+        return false;
+    }
+    if(server->owns_process)
+    {
+        int status;
+        if(waitpid(server->pid, &status, WNOHANG) == server->pid)
+        {
+            server->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            server->process_exited = true;
+            TRACE_INFO("Process %d exited with status %d\n", (int)server->pid, server->exit_status);
+        }
+    }
+    else if(kill(server->pid, 0) < 0 && errno == ESRCH)
+    {
+        server->process_exited = true;
+        TRACE_INFO("Process %d exited\n", (int)server->pid);
+    }
+    return !server->process_exited;
+}
+
+/**
+ * @brief Drop a watched range
+ *
+ * @param server Server
+ * @param index Index of the range
+ */
+static void remove_watch(server_t* server, size_t index)
+{
+    free(server->watches[index].sent);
+    free(server->watches[index].current);
+    // Keep the order, the ranges are sampled in the order they were watched
+    memmove(&server->watches[index], &server->watches[index + 1], (--server->watch_count - index) * sizeof(watch_range_t));
+}
+
+/**
+ * @brief Send a reply to the client
+ *
+ * @param server Server
+ * @param status 0 or errno value
+ * @param address Address of the request
+ * @param data Data of the reply (NULL - none)
+ * @param length Number of data bytes
+ * @return int 0 on success, -1 on failure
+ */
+static int send_reply(server_t* server, int status, uint64_t address, const void* data, uint32_t length)
+{
+    exporter_header_t header = {
+        .type = EXPORTER_MSG_REPLY,
+        .status = (uint8_t)status,
+        .length = status == 0 && data != NULL ? length : 0,
+        .address = address
+    };
+    return exporter_send(server->client, &header, status == 0 ? data : NULL);
+}
+
+/**
+ * @brief Start watching a range and reply with its current bytes
+ *
+ * @param server Server
+ * @param address Start of the range
+ * @param length Length of the range
+ * @return int 0 on success, -1 on failure
+ */
+static int handle_watch(server_t* server, uint64_t address, uint32_t length)
+{
+    // Watching the same address again replaces the range
+    for(size_t i = 0; i < server->watch_count; i++)
+    {
+        if(server->watches[i].address == address)
+        {
+            remove_watch(server, i);
+            break;
+        }
+    }
+    if(length == 0 || server->watch_count >= EXPORTER_MAX_WATCHES)
+    {
+        return send_reply(server, length == 0 ? EINVAL : ENOSPC, address, NULL, 0);
+    }
+
+    watch_range_t* watch = &server->watches[server->watch_count];
+    watch->address = address;
+    watch->length = length;
+    watch->sent = malloc(length);
+    watch->current = malloc(length);
+    watch->sampled = false;
+    if(watch->sent == NULL || watch->current == NULL)
+    {
+        free(watch->sent);
+        free(watch->current);
+        return send_reply(server, ENOMEM, address, NULL, 0);
+    }
+    int status = process_read(server, address, watch->sent, length);
+    if(status != 0)
+    {
+        free(watch->sent);
+        free(watch->current);
+        return send_reply(server, status, address, NULL, 0);
+    }
+    server->watch_count++;
+    TRACE_VERBOSE("Watching %u bytes at 0x%08" PRIx64 "\n", length, address);
+    return send_reply(server, 0, address, watch->sent, length);
+}
+
+/**
+ * @brief Receive a request from the client and reply to it
+ *
+ * @param server Server
+ * @return int 0 on success, -1 if the client disconnected or broke the protocol
+ */
+static int handle_request(server_t* server)
+{
+    exporter_header_t header;
+    if(exporter_receive(server->client, &header, sizeof(header)) < 0)
+    {
+        return -1;
+    }
+    if(header.length > EXPORTER_MAX_LENGTH || !reserve(&server->buffer, &server->buffer_size, header.length))
+    {
+        TRACE_ERROR("Request of %u bytes is too large\n", header.length);
+        return -1;
+    }
+
+    int status;
+    switch(header.type)
+    {
+        case EXPORTER_CMD_READ:
+            status = process_read(server, header.address, server->buffer, header.length);
+            return send_reply(server, status, header.address, server->buffer, header.length);
+
+        case EXPORTER_CMD_WRITE:
+            if(exporter_receive(server->client, server->buffer, header.length) < 0)
+            {
+                return -1;
+            }
+            status = process_write(server, header.address, server->buffer, header.length);
+            if(status == 0)
+            {
+                // The client applied the write to its copy already
+                for(size_t i = 0; i < server->watch_count; i++)
+                {
+                    watch_range_t* watch = &server->watches[i];
+                    uint64_t start = header.address > watch->address ? header.address : watch->address;
+                    uint64_t end = header.address + header.length < watch->address + watch->length ?
+                                   header.address + header.length : watch->address + watch->length;
+                    if(start < end)
+                    {
+                        memcpy(watch->sent + (start - watch->address), server->buffer + (start - header.address), end - start);
+                    }
+                }
+            }
+            return send_reply(server, status, header.address, NULL, 0);
+
+        case EXPORTER_CMD_WATCH:
+            return handle_watch(server, header.address, header.length);
+
+        case EXPORTER_CMD_UNWATCH:
+            for(size_t i = server->watch_count; i > 0; i--)
+            {
+                if(header.address == 0 || server->watches[i - 1].address == header.address)
+                {
+                    remove_watch(server, i - 1);
+                }
+            }
+            return send_reply(server, 0, header.address, NULL, 0);
+
+        default:
+            TRACE_ERROR("Unknown request 0x%02X\n", header.type);
+            return -1;
+    }
+}
+
+/**
+ * @brief Append a message to the batch of the current sample
+ *
+ * @param server Server
+ * @param type Message type
+ * @param address Address the message refers to
+ * @param data Payload (NULL - none)
+ * @param length Number of payload bytes
+ * @return true on success, false on failure
+ */
+static bool append_message(server_t* server, uint8_t type, uint64_t address, const void* data, uint32_t length)
+{
+    exporter_header_t header = {
+        .type = type,
+        .length = length,
+        .address = address
+    };
+    if(!reserve(&server->batch, &server->batch_size, server->batch_length + sizeof(header) + length))
+    {
+        return false;
+    }
+    memcpy(server->batch + server->batch_length, &header, sizeof(header));
+    if(length > 0)
+    {
+        memcpy(server->batch + server->batch_length + sizeof(header), data, length);
+    }
+    server->batch_length += sizeof(header) + length;
+    return true;
+}
+
+/**
+ * @brief Sample the watched ranges and send the bytes that changed
+ *
+ * All ranges are read before any of them is compared, so a sample is as
+ * close to a single moment as the process memory allows. Ranges are read
+ * in the order they were watched.
+ *
+ * @param server Server
+ * @return int 0 on success, -1 on failure
+ */
+static int sample(server_t* server)
+{
+    for(size_t i = 0; i < server->watch_count; i++)
+    {
+        watch_range_t* watch = &server->watches[i];
+        watch->sampled = process_read(server, watch->address, watch->current, watch->length) == 0;
+    }
+
+    server->batch_length = 0;
+    for(size_t i = 0; i < server->watch_count; i++)
+    {
+        watch_range_t* watch = &server->watches[i];
+        size_t offset = 0;
+        while(watch->sampled && offset < watch->length)
+        {
+            if(watch->current[offset] == watch->sent[offset])
+            {
+                offset++;
+                continue;
+            }
+            // Short runs of unchanged bytes are cheaper to send than a new header
+            size_t end = offset + 1;
+            for(size_t j = end; j < watch->length && j - end <= SERVER_MERGE_GAP; j++)
+            {
+                if(watch->current[j] != watch->sent[j])
+                {
+                    end = j + 1;
+                }
+            }
+            if(!append_message(server, EXPORTER_MSG_UPDATE, watch->address + offset, &watch->current[offset], (uint32_t)(end - offset)))
+            {
+                return -1;
+            }
+            memcpy(&watch->sent[offset], &watch->current[offset], end - offset);
+            offset = end;
+        }
+    }
+    if(server->batch_length == 0)
+    {
+        return 0;
+    }
+    if(!append_message(server, EXPORTER_MSG_SYNC, 0, NULL, 0))
+    {
+        return -1;
+    }
+    // The whole sample goes out at once
+    for(size_t done = 0; done < server->batch_length; )
+    {
+        ssize_t sent = send(server->client, server->batch + done, server->batch_length - done, MSG_NOSIGNAL);
+        if(sent < 0 && errno != EINTR)
+        {
+            return -1;
+        }
+        done += sent > 0 ? (size_t)sent : 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Serve a connected client until it disconnects or the process exits
+ *
+ * @param server Server
+ */
+static void serve_client(server_t* server)
+{
+    exporter_hello_t hello = {
+        .magic = EXPORTER_MAGIC,
+        .version = EXPORTER_PROTOCOL_VERSION,
+        .pid = (uint32_t)server->pid,
+        .interval = server->interval
+    };
+    exporter_header_t header = {
+        .type = EXPORTER_MSG_HELLO,
+        .length = sizeof(hello)
+    };
+    if(exporter_send(server->client, &header, &hello) < 0)
+    {
+        return;
+    }
+
+    while(process_running(server))
+    {
+        struct pollfd pfd = { .fd = server->client, .events = POLLIN };
+        int ready = poll(&pfd, 1, (int)server->interval);
+        if(ready < 0 && errno != EINTR)
+        {
+            TRACE_ERROR("Failed to wait for the client: %s\n", strerror(errno));
+            break;
+        }
+        if(ready > 0 && handle_request(server) < 0)
+        {
+            break;
+        }
+        if(sample(server) < 0)
+        {
+            break;
+        }
+    }
+    while(server->watch_count > 0)
+    {
+        remove_watch(server, server->watch_count - 1);
+    }
+}
+
+/**
+ * @brief Start a program to serve
+ *
+ * @param argv Program and its arguments (NULL terminated)
+ * @return pid_t Process ID, -1 on failure
+ */
+pid_t server_launch(char* const argv[])
+{
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        execvp(argv[0], argv);
+        fprintf(stderr, "Failed to start %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+    if(pid < 0)
+    {
+        TRACE_ERROR("Failed to start %s: %s\n", argv[0], strerror(errno));
+        return -1;
+    }
+    TRACE_INFO("Started %s (process %d)\n", argv[0], (int)pid);
+    return pid;
+}
+
+/**
+ * @brief Listen on a TCP address
+ *
+ * @param bind_address Address to listen on
+ * @param port Port to listen on
+ * @return int Listening socket, -1 on failure
+ */
+static int listen_tcp(const char* bind_address, int port)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+        .ai_flags = AI_PASSIVE
+    };
+    struct addrinfo *res = NULL;
+    char port_str[6];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    if(getaddrinfo(bind_address, port_str, &hints, &res) != 0)
+    {
+        TRACE_ERROR("getaddrinfo failed for %s:%s\n", bind_address, port_str);
+        return -1;
+    }
+    int listen_socket = -1;
+    for(struct addrinfo *rp = res; rp != NULL && listen_socket < 0; rp = rp->ai_next)
+    {
+        int sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if(sock < 0)
+        {
+            continue;
+        }
+        int reuse = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if(bind(sock, rp->ai_addr, rp->ai_addrlen) == 0 && listen(sock, 1) == 0)
+        {
+            listen_socket = sock;
+        }
+        else
+        {
+            close(sock);
+        }
+    }
+    freeaddrinfo(res);
+    if(listen_socket < 0)
+    {
+        TRACE_ERROR("Failed to listen on %s:%s: %s\n", bind_address, port_str, strerror(errno));
+    }
+    return listen_socket;
+}
+
+/**
+ * @brief Listen on a Unix domain socket
+ *
+ * A socket file left behind by a previous run is replaced.
+ *
+ * @param path Path of the socket
+ * @return int Listening socket, -1 on failure
+ */
+static int listen_unix(const char* path)
+{
+    struct sockaddr_un sun = { .sun_family = AF_UNIX };
+    if(strlen(path) >= sizeof(sun.sun_path))
+    {
+        TRACE_ERROR("Unix socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(sun.sun_path, path);
+    unlink(path);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(sock < 0 || bind(sock, (struct sockaddr*)&sun, sizeof(sun)) != 0 || listen(sock, 1) != 0)
+    {
+        TRACE_ERROR("Failed to listen on %s: %s\n", path, strerror(errno));
+        if(sock >= 0)
+        {
+            close(sock);
+        }
+        return -1;
+    }
+    return sock;
+}
+
+/**
+ * @brief Create the server and start listening
+ *
+ * @param bind_address Address to listen on (or unix:PATH)
+ * @param port Port to listen on
+ * @param pid Process to serve
+ * @param owns_process The process was started by server_launch() (it is stopped with the server)
+ * @param interval_ms Sampling interval of the watched ranges in milliseconds
+ * @return server_t* Server, NULL on failure
+ */
+server_t* server_open(const char* bind_address, int port, pid_t pid, bool owns_process, uint32_t interval_ms)
+{
+    server_t* server = calloc(1, sizeof(server_t));
+    if(server == NULL)
+    {
+        TRACE_ERROR("Failed to allocate server\n");
+        return NULL;
+    }
+    server->pid = pid;
+    server->owns_process = owns_process;
+    server->client = -1;
+    server->interval = interval_ms ? interval_ms : SERVER_DEFAULT_INTERVAL;
+
+    if(strncmp(bind_address, SERVER_UNIX_PREFIX, strlen(SERVER_UNIX_PREFIX)) == 0)
+    {
+        server->unix_path = strdup(bind_address + strlen(SERVER_UNIX_PREFIX));
+        server->listen_socket = server->unix_path ? listen_unix(server->unix_path) : -1;
+    }
+    else
+    {
+        server->listen_socket = listen_tcp(bind_address, port);
+    }
+    if(server->listen_socket < 0)
+    {
+        free(server->unix_path);
+        free(server);
+        return NULL;
+    }
+    if(server->unix_path)
+    {
+        TRACE_INFO("Serving process %d on %s\n", (int)pid, bind_address);
+    }
+    else
+    {
+        TRACE_INFO("Serving process %d on %s:%d\n", (int)pid, bind_address, port);
+    }
+    return server;
+}
+
+/**
+ * @brief Stop the server (and the process it started)
+ *
+ * @param server Server (may be NULL)
+ */
+void server_close(server_t* server)
+{
+    if(server)
+    {
+        if(server->owns_process && process_running(server))
+        {
+            kill(server->pid, SIGTERM);
+            waitpid(server->pid, NULL, 0);
+        }
+        close(server->listen_socket);
+        if(server->unix_path)
+        {
+            unlink(server->unix_path);
+            free(server->unix_path);
+        }
+        free(server->buffer);
+        free(server->batch);
+        free(server);
+    }
+}
+
+/**
+ * @brief Accept clients until the process exits
+ *
+ * @param server Server
+ * @param once Stop after the first client disconnects
+ * @return int Exit status of the process if it was started by the server, 0 otherwise
+ */
+int server_run(server_t* server, bool once)
+{
+    while(process_running(server))
+    {
+        struct pollfd pfd = { .fd = server->listen_socket, .events = POLLIN };
+        int ready = poll(&pfd, 1, SERVER_ACCEPT_TIMEOUT);
+        if(ready <= 0)
+        {
+            continue;
+        }
+
+        struct sockaddr_storage peer;
+        socklen_t peer_length = sizeof(peer);
+        server->client = accept(server->listen_socket, (struct sockaddr*)&peer, &peer_length);
+        if(server->client < 0)
+        {
+            continue;
+        }
+        if(server->unix_path)
+        {
+            TRACE_INFO("Client connected\n");
+        }
+        else
+        {
+            // Every request waits for its reply - do not let Nagle's algorithm hold it back
+            int no_delay = 1;
+            setsockopt(server->client, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+            char host[NI_MAXHOST] = "?";
+            getnameinfo((struct sockaddr*)&peer, peer_length, host, sizeof(host), NULL, 0, NI_NUMERICHOST);
+            TRACE_INFO("Client connected from %s\n", host);
+        }
+
+        serve_client(server);
+
+        close(server->client);
+        server->client = -1;
+        TRACE_INFO("Client disconnected\n");
+        if(once)
+        {
+            break;
+        }
+    }
+    return server->exit_status;
+}
@@ -0,0 +1,30 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "exporter_protocol.h"
+
+/**
+ * @file server.h
+ * @brief Server of the memory of a Linux process for the monitor exporter backend.
+ *
+ * The memory is accessed with process_vm_readv()/process_vm_writev(), so the
+ * process is never stopped. Watched ranges are sampled locally every interval
+ * and only the bytes that changed since the previous sample are sent.
+ */
+
+#define SERVER_UNIX_PREFIX          "unix:" /* bind address prefix of a Unix domain socket */
+#define SERVER_DEFAULT_INTERVAL     1       /* milliseconds */
+#define SERVER_MERGE_GAP            32      /* unchanged bytes sent instead of starting a new update */
+#define SERVER_ACCEPT_TIMEOUT       100     /* milliseconds between checks of the process while no client is connected */
+
+typedef struct server server_t;
+
+pid_t server_launch(char* const argv[]);
+server_t* server_open(const char* bind_address, int port, pid_t pid, bool owns_process, uint32_t interval_ms);
+void server_close(server_t* server);
+int server_run(server_t* server, bool once);
+
+#endif // SERVER_H
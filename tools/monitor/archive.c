@@ -0,0 +1,661 @@
+#define _GNU_SOURCE
+
+#include "archive.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define ARCHIVE_MAX_PENDING_LINE    (64u * 1024u)
+#define ARCHIVE_INITIAL_TERMS       4096
+
+/**
+ * @brief In-memory posting list of a single term
+ */
+typedef struct
+{
+    char*       term;               //!< Term (null-terminated, lower-case)
+    uint32_t    hash;               //!< FNV-1a hash of the term
+    uint32_t    count;              //!< Number of lines containing the term
+    uint32_t    last_line;          //!< Last line added (for delta encoding)
+    uint8_t*    postings;           //!< Delta-encoded varint line numbers
+    uint32_t    postings_size;      //!< Used bytes in postings
+    uint32_t    postings_capacity;  //!< Allocated bytes in postings
+} archive_term_t;
+
+struct archive
+{
+    char            directory[ARCHIVE_MAX_PATH_LENGTH];
+    uint32_t        segment_size;
+    uint32_t        segment;
+    FILE*           log_file;
+    FILE*           lines_file;
+    uint64_t        log_size;
+    uint32_t        line_count;
+    int64_t         first_timestamp_ms;
+    int64_t         last_timestamp_ms;
+    archive_term_t* terms;
+    size_t          term_capacity;
+    size_t          term_count;
+    char*           pending;
+    size_t          pending_length;
+    size_t          pending_capacity;
+    bool            dirty;
+    time_t          last_checkpoint;
+};
+
+/**
+ * @brief Context passed to the tokenizer while indexing a line
+ */
+typedef struct
+{
+    archive_t*  archive;
+    uint32_t    line;
+    bool        failed;
+} index_line_ctx_t;
+
+/**
+ * @brief Get current host time in milliseconds since the epoch
+ *
+ * @return int64_t Current time in milliseconds
+ */
+int64_t archive_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Encode an unsigned integer as LEB128 varint
+ *
+ * @param out Output buffer (at least 10 bytes)
+ * @param value Value to encode
+ * @return size_t Number of bytes written
+ */
+size_t archive_varint_encode(uint8_t* out, uint64_t value)
+{
+    size_t length = 0;
+    do
+    {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[length++] = byte | (value ? 0x80 : 0);
+    } while(value);
+    return length;
+}
+
+/**
+ * @brief Decode a LEB128 varint
+ *
+ * @param in Input buffer
+ * @param end End of the input buffer
+ * @param value Decoded value
+ * @return size_t Number of bytes consumed, 0 on malformed input
+ */
+size_t archive_varint_decode(const uint8_t* in, const uint8_t* end, uint64_t* value)
+{
+    uint64_t result = 0;
+    size_t length = 0;
+    for(unsigned shift = 0; in + length < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = in[length++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+        {
+            *value = result;
+            return length;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Split text into lower-cased tokens
+ *
+ * Tokens are runs of alphanumeric characters and underscores. Tokens longer
+ * than ARCHIVE_MAX_TOKEN_LENGTH are truncated.
+ *
+ * @param text Text to tokenize
+ * @param length Length of the text
+ * @param callback Callback called for each token
+ * @param user_data User data for the callback
+ */
+void archive_tokenize(const char* text, size_t length, archive_token_cb_t callback, void* user_data)
+{
+    char token[ARCHIVE_MAX_TOKEN_LENGTH + 1];
+    size_t token_length = 0;
+    bool in_token = false;
+
+    for(size_t i = 0; i <= length; i++)
+    {
+        unsigned char c = i < length ? (unsigned char)text[i] : 0;
+        if(isalnum(c) || c == '_')
+        {
+            in_token = true;
+            if(token_length < ARCHIVE_MAX_TOKEN_LENGTH)
+            {
+                token[token_length++] = (char)tolower(c);
+            }
+        }
+        else if(in_token)
+        {
+            if(!callback(token, token_length, user_data))
+            {
+                return;
+            }
+            token_length = 0;
+            in_token = false;
+        }
+    }
+}
+
+/**
+ * @brief Build the path of a segment file
+ *
+ * @param path Output buffer
+ * @param size Size of the output buffer
+ * @param directory Archive directory
+ * @param segment Segment number
+ * @param extension File extension ("log", "lines", "idx")
+ * @return true on success, false if the path does not fit (errno is set to ENAMETOOLONG)
+ */
+bool archive_segment_path(char* path, size_t size, const char* directory, uint32_t segment, const char* extension)
+{
+    int length = snprintf(path, size, "%s/segment-%06u.%s", directory, segment, extension);
+    if(length < 0 || (size_t)length >= size)
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Calculate FNV-1a hash of a token
+ */
+static uint32_t hash_token(const char* token, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)token[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Release all terms of the in-memory index
+ */
+static void clear_terms(archive_t* archive)
+{
+    for(size_t i = 0; i < archive->term_capacity; i++)
+    {
+        free(archive->terms[i].term);
+        free(archive->terms[i].postings);
+    }
+    memset(archive->terms, 0, archive->term_capacity * sizeof(archive_term_t));
+    archive->term_count = 0;
+}
+
+/**
+ * @brief Double the capacity of the term hash table
+ */
+static bool grow_terms(archive_t* archive)
+{
+    size_t new_capacity = archive->term_capacity * 2;
+    archive_term_t* new_terms = calloc(new_capacity, sizeof(archive_term_t));
+    if(new_terms == NULL)
+    {
+        TRACE_ERROR("Failed to grow archive term table\n");
+        return false;
+    }
+    for(size_t i = 0; i < archive->term_capacity; i++)
+    {
+        archive_term_t* term = &archive->terms[i];
+        if(term->term == NULL)
+        {
+            continue;
+        }
+        size_t slot = term->hash & (new_capacity - 1);
+        while(new_terms[slot].term != NULL)
+        {
+            slot = (slot + 1) & (new_capacity - 1);
+        }
+        new_terms[slot] = *term;
+    }
+    free(archive->terms);
+    archive->terms = new_terms;
+    archive->term_capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @brief Find a term in the hash table or insert a new one
+ */
+static archive_term_t* find_or_add_term(archive_t* archive, const char* token, size_t length)
+{
+    if((archive->term_count + 1) * 10 > archive->term_capacity * 7 && !grow_terms(archive))
+    {
+        return NULL;
+    }
+
+    uint32_t hash = hash_token(token, length);
+    size_t slot = hash & (archive->term_capacity - 1);
+    while(archive->terms[slot].term != NULL)
+    {
+        archive_term_t* term = &archive->terms[slot];
+        if(term->hash == hash && strncmp(term->term, token, length) == 0 && term->term[length] == '\0')
+        {
+            return term;
+        }
+        slot = (slot + 1) & (archive->term_capacity - 1);
+    }
+
+    archive_term_t* term = &archive->terms[slot];
+    term->term = strndup(token, length);
+    if(term->term == NULL)
+    {
+        return NULL;
+    }
+    term->hash = hash;
+    archive->term_count++;
+    return term;
+}
+
+/**
+ * @brief Tokenizer callback adding a posting for the current line
+ */
+static bool index_token(const char* token, size_t length, void* user_data)
+{
+    index_line_ctx_t* ctx = user_data;
+    archive_term_t* term = find_or_add_term(ctx->archive, token, length);
+    if(term == NULL)
+    {
+        ctx->failed = true;
+        return false;
+    }
+    if(term->count > 0 && term->last_line == ctx->line)
+    {
+        return true; // Already indexed for this line
+    }
+
+    if(term->postings_size + 10 > term->postings_capacity)
+    {
+        uint32_t new_capacity = term->postings_capacity ? term->postings_capacity * 2 : 16;
+        uint8_t* postings = realloc(term->postings, new_capacity);
+        if(postings == NULL)
+        {
+            ctx->failed = true;
+            return false;
+        }
+        term->postings = postings;
+        term->postings_capacity = new_capacity;
+    }
+
+    uint32_t delta = term->count > 0 ? ctx->line - term->last_line : ctx->line;
+    term->postings_size += archive_varint_encode(term->postings + term->postings_size, delta);
+    term->last_line = ctx->line;
+    term->count++;
+    return true;
+}
+
+/**
+ * @brief Compare two terms for sorting
+ */
+static int compare_terms(const void* a, const void* b)
+{
+    const archive_term_t* term_a = *(const archive_term_t* const*)a;
+    const archive_term_t* term_b = *(const archive_term_t* const*)b;
+    return strcmp(term_a->term, term_b->term);
+}
+
+/**
+ * @brief Write the in-memory index of the current segment to disk
+ *
+ * The index is written to a temporary file and then renamed, so readers
+ * never observe a partially written index. All terms of the segment are
+ * written every time (see archive.h).
+ */
+static bool write_index(archive_t* archive)
+{
+    char path[ARCHIVE_MAX_PATH_LENGTH];
+    char tmp_path[ARCHIVE_MAX_PATH_LENGTH + 8];
+    if(!archive_segment_path(path, sizeof(path), archive->directory, archive->segment, "idx"))
+    {
+        TRACE_ERROR("Failed to write archive index of segment %u: %s\n", archive->segment, strerror(errno));
+        return false;
+    }
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    archive_term_t** sorted = malloc((archive->term_count + 1) * sizeof(archive_term_t*));
+    uint32_t* offsets = malloc((archive->term_count + 1) * sizeof(uint32_t));
+    FILE* file = fopen(tmp_path, "wb");
+    if(sorted == NULL || offsets == NULL || file == NULL)
+    {
+        TRACE_ERROR("Failed to write archive index '%s': %s\n", tmp_path, strerror(errno));
+        free(sorted);
+        free(offsets);
+        if(file)
+        {
+            fclose(file);
+        }
+        return false;
+    }
+
+    size_t count = 0;
+    for(size_t i = 0; i < archive->term_capacity; i++)
+    {
+        if(archive->terms[i].term != NULL)
+        {
+            sorted[count++] = &archive->terms[i];
+        }
+    }
+    qsort(sorted, count, sizeof(archive_term_t*), compare_terms);
+
+    archive_index_header_t header = {
+        .magic              = ARCHIVE_INDEX_MAGIC,
+        .version            = ARCHIVE_INDEX_VERSION,
+        .line_count         = archive->line_count,
+        .term_count         = (uint32_t)count,
+        .log_size           = archive->log_size,
+        .first_timestamp_ms = archive->first_timestamp_ms,
+        .last_timestamp_ms  = archive->last_timestamp_ms,
+    };
+    bool result = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    uint32_t position = sizeof(header);
+    for(size_t i = 0; result && i < count; i++)
+    {
+        archive_term_t* term = sorted[i];
+        uint8_t prefix[1 + ARCHIVE_MAX_TOKEN_LENGTH + 20];
+        size_t length = strlen(term->term);
+        size_t prefix_length = 0;
+        prefix[prefix_length++] = (uint8_t)length;
+        memcpy(&prefix[prefix_length], term->term, length);
+        prefix_length += length;
+        prefix_length += archive_varint_encode(&prefix[prefix_length], term->count);
+        prefix_length += archive_varint_encode(&prefix[prefix_length], term->postings_size);
+
+        offsets[i] = position;
+        result = fwrite(prefix, 1, prefix_length, file) == prefix_length &&
+                 fwrite(term->postings, 1, term->postings_size, file) == term->postings_size;
+        position += (uint32_t)(prefix_length + term->postings_size);
+    }
+
+    header.offsets_position = position;
+    result = result && fwrite(offsets, sizeof(uint32_t), count, file) == count;
+    result = result && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    result = (fclose(file) == 0) && result;
+    free(sorted);
+    free(offsets);
+
+    if(!result || rename(tmp_path, path) != 0)
+    {
+        TRACE_ERROR("Failed to write archive index '%s': %s\n", path, strerror(errno));
+        unlink(tmp_path);
+        return false;
+    }
+    TRACE_VERBOSE("Archive index checkpoint: segment %u, %u lines, %zu terms\n",
+        archive->segment, archive->line_count, count);
+    return true;
+}
+
+/**
+ * @brief Close the current segment, writing its final index
+ */
+static bool close_segment(archive_t* archive)
+{
+    bool result = true;
+    if(archive->log_file != NULL)
+    {
+        result = write_index(archive);
+        fclose(archive->log_file);
+        fclose(archive->lines_file);
+        archive->log_file = NULL;
+        archive->lines_file = NULL;
+    }
+    clear_terms(archive);
+    archive->log_size = 0;
+    archive->line_count = 0;
+    archive->first_timestamp_ms = 0;
+    archive->last_timestamp_ms = 0;
+    archive->dirty = false;
+    return result;
+}
+
+/**
+ * @brief Open the next segment for writing
+ */
+static bool open_segment(archive_t* archive)
+{
+    char path[ARCHIVE_MAX_PATH_LENGTH];
+    archive->segment++;
+
+    bool valid = archive_segment_path(path, sizeof(path), archive->directory, archive->segment, "log");
+    archive->log_file = valid ? fopen(path, "wb") : NULL;
+    valid = valid && archive_segment_path(path, sizeof(path), archive->directory, archive->segment, "lines");
+    archive->lines_file = valid ? fopen(path, "wb") : NULL;
+    if(archive->log_file == NULL || archive->lines_file == NULL)
+    {
+        TRACE_ERROR("Failed to open archive segment %u: %s\n", archive->segment, strerror(errno));
+        if(archive->log_file)
+        {
+            fclose(archive->log_file);
+        }
+        if(archive->lines_file)
+        {
+            fclose(archive->lines_file);
+        }
+        archive->log_file = NULL;
+        archive->lines_file = NULL;
+        return false;
+    }
+    archive->last_checkpoint = time(NULL);
+    TRACE_INFO("Archiving to segment %u in '%s'\n", archive->segment, archive->directory);
+    return true;
+}
+
+/**
+ * @brief Append a complete line to the archive and index it
+ */
+static bool add_line(archive_t* archive, const char* line, size_t length)
+{
+    if(archive->log_file != NULL && archive->line_count > 0 &&
+       archive->log_size + length > archive->segment_size)
+    {
+        close_segment(archive);
+    }
+    if(archive->log_file == NULL && !open_segment(archive))
+    {
+        return false;
+    }
+
+    archive_line_t record = {
+        .offset       = (uint32_t)archive->log_size,
+        .timestamp_ms = archive_now_ms()
+    };
+    if(fwrite(line, 1, length, archive->log_file) != length ||
+       fwrite(&record, sizeof(record), 1, archive->lines_file) != 1)
+    {
+        TRACE_ERROR("Failed to write to archive segment %u: %s\n", archive->segment, strerror(errno));
+        return false;
+    }
+    fflush(archive->log_file);
+    fflush(archive->lines_file);
+
+    index_line_ctx_t index_ctx = { .archive = archive, .line = archive->line_count, .failed = false };
+    archive_tokenize(line, length, index_token, &index_ctx);
+    if(index_ctx.failed)
+    {
+        TRACE_ERROR("Out of memory while indexing archive line\n");
+        return false;
+    }
+
+    if(archive->line_count == 0)
+    {
+        archive->first_timestamp_ms = record.timestamp_ms;
+    }
+    archive->last_timestamp_ms = record.timestamp_ms;
+    archive->log_size += length;
+    archive->line_count++;
+    archive->dirty = true;
+    return true;
+}
+
+/**
+ * @brief Find the highest segment number already present in the directory
+ */
+static uint32_t find_last_segment(const char* directory)
+{
+    uint32_t last = 0;
+    DIR* dir = opendir(directory);
+    if(dir == NULL)
+    {
+        return 0;
+    }
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        unsigned segment = 0;
+        char extension[8];
+        if(sscanf(entry->d_name, "segment-%u.%7s", &segment, extension) == 2 && segment > last)
+        {
+            last = segment;
+        }
+    }
+    closedir(dir);
+    return last;
+}
+
+/**
+ * @brief Open an archive directory for writing
+ *
+ * The directory is created if it does not exist. New data is always written
+ * to a new segment, following any segments already present.
+ *
+ * @param directory Archive directory
+ * @param segment_size Maximum size of a segment log in bytes (0 for default)
+ * @return archive_t* Archive handle, or NULL on failure
+ */
+archive_t* archive_open(const char* directory, uint32_t segment_size)
+{
+    if(strlen(directory) >= ARCHIVE_MAX_PATH_LENGTH - 32)
+    {
+        TRACE_ERROR("Archive directory path too long: %s\n", directory);
+        return NULL;
+    }
+    if(mkdir(directory, 0755) != 0 && errno != EEXIST)
+    {
+        TRACE_ERROR("Failed to create archive directory '%s': %s\n", directory, strerror(errno));
+        return NULL;
+    }
+
+    archive_t* archive = calloc(1, sizeof(archive_t));
+    if(archive == NULL)
+    {
+        TRACE_ERROR("Failed to allocate archive\n");
+        return NULL;
+    }
+    archive->term_capacity = ARCHIVE_INITIAL_TERMS;
+    archive->terms = calloc(archive->term_capacity, sizeof(archive_term_t));
+    if(archive->terms == NULL)
+    {
+        TRACE_ERROR("Failed to allocate archive term table\n");
+        free(archive);
+        return NULL;
+    }
+    strncpy(archive->directory, directory, sizeof(archive->directory) - 1);
+    archive->segment_size = segment_size ? segment_size : ARCHIVE_DEFAULT_SEGMENT_SIZE;
+    archive->segment = find_last_segment(directory);
+    return archive;
+}
+
+/**
+ * @brief Close the archive, writing any pending data and the final index
+ *
+ * @param archive Archive handle
+ */
+void archive_close(archive_t* archive)
+{
+    if(archive == NULL)
+    {
+        return;
+    }
+    if(archive->pending_length > 0)
+    {
+        add_line(archive, archive->pending, archive->pending_length);
+        archive->pending_length = 0;
+    }
+    close_segment(archive);
+    free(archive->terms);
+    free(archive->pending);
+    free(archive);
+}
+
+/**
+ * @brief Append log data to the archive
+ *
+ * Data does not need to be line aligned - incomplete lines are kept until
+ * the rest of the line arrives.
+ *
+ * @param archive Archive handle
+ * @param data Log data
+ * @param length Length of the data
+ * @return true on success, false on failure
+ */
+bool archive_write(archive_t* archive, const char* data, size_t length)
+{
+    bool result = true;
+    for(size_t i = 0; i < length; i++)
+    {
+        if(archive->pending_length + 1 > archive->pending_capacity)
+        {
+            size_t new_capacity = archive->pending_capacity ? archive->pending_capacity * 2 : 512;
+            char* pending = realloc(archive->pending, new_capacity);
+            if(pending == NULL)
+            {
+                TRACE_ERROR("Failed to allocate archive line buffer\n");
+                return false;
+            }
+            archive->pending = pending;
+            archive->pending_capacity = new_capacity;
+        }
+        archive->pending[archive->pending_length++] = data[i];
+        if(data[i] == '\n' || archive->pending_length >= ARCHIVE_MAX_PENDING_LINE)
+        {
+            result = add_line(archive, archive->pending, archive->pending_length) && result;
+            archive->pending_length = 0;
+        }
+    }
+    return archive_checkpoint(archive, false) && result;
+}
+
+/**
+ * @brief Write the index of the current segment if it is due
+ *
+ * @param archive Archive handle
+ * @param force Write the index even if the checkpoint interval did not pass
+ * @return true on success, false on failure
+ */
+bool archive_checkpoint(archive_t* archive, bool force)
+{
+    if(archive == NULL || !archive->dirty || archive->log_file == NULL)
+    {
+        return true;
+    }
+    time_t now = time(NULL);
+    if(!force && difftime(now, archive->last_checkpoint) < ARCHIVE_CHECKPOINT_INTERVAL)
+    {
+        return true;
+    }
+    archive->last_checkpoint = now;
+    archive->dirty = false;
+    return write_index(archive);
+}
@@ -0,0 +1,96 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * @file archive.h
+ * @brief Log archive with an inverted index built as lines arrive.
+ *
+ * The monitor writes every received log line into a directory of segments.
+ * Each segment consists of three files:
+ *
+ * - `segment-NNNNNN.log`   - raw log lines, exactly as received
+ * - `segment-NNNNNN.lines` - line table, one archive_line_t per line
+ * - `segment-NNNNNN.idx`   - inverted index (token -> line postings)
+ *
+ * The index is built in memory while lines are appended and is checkpointed
+ * to disk periodically, on segment rotation and when the archive is closed.
+ * Lines appended after the last checkpoint are still described by the line
+ * table, so readers can scan that (short) tail linearly.
+ *
+ * A checkpoint rewrites the whole index of the current segment, not only the
+ * lines added since the previous one. Its cost therefore grows with the
+ * segment - while lines keep arriving, up to the index of a full segment is
+ * written every ARCHIVE_CHECKPOINT_INTERVAL seconds. The segment size bounds
+ * it, and nothing is written while no new lines arrive.
+ *
+ * Index file layout (all integers little-endian):
+ *
+ *     archive_index_header_t
+ *     term records:   u8 term_len, term bytes, varint posting_count,
+ *                     varint postings_size, postings (delta-encoded varints)
+ *     term offsets:   term_count x u32 offset of each term record,
+ *                     sorted by term so readers can binary search
+ */
+
+#define ARCHIVE_INDEX_MAGIC             0x584C4D44  /* "DMLX" */
+#define ARCHIVE_INDEX_VERSION           1
+#define ARCHIVE_MAX_TOKEN_LENGTH        63
+#define ARCHIVE_DEFAULT_SEGMENT_SIZE    (16u * 1024u * 1024u)
+#define ARCHIVE_CHECKPOINT_INTERVAL     5   /* seconds */
+#define ARCHIVE_MAX_PATH_LENGTH         1024
+
+/**
+ * @brief Line table record (segment-NNNNNN.lines)
+ */
+typedef struct
+{
+    uint32_t    offset;         //!< Offset of the line in the segment log
+    int64_t     timestamp_ms;   //!< Host time when the line was received
+} __attribute__((packed)) archive_line_t;
+
+/**
+ * @brief Index file header (segment-NNNNNN.idx)
+ */
+typedef struct
+{
+    uint32_t    magic;              //!< ARCHIVE_INDEX_MAGIC
+    uint32_t    version;            //!< ARCHIVE_INDEX_VERSION
+    uint32_t    line_count;         //!< Number of lines covered by this index
+    uint32_t    term_count;         //!< Number of distinct terms
+    uint64_t    log_size;           //!< Size of the log covered by this index
+    int64_t     first_timestamp_ms; //!< Timestamp of the first indexed line
+    int64_t     last_timestamp_ms;  //!< Timestamp of the last indexed line
+    uint32_t    offsets_position;   //!< File position of the term offsets table
+    uint32_t    reserved;
+} __attribute__((packed)) archive_index_header_t;
+
+typedef struct archive archive_t;
+
+/**
+ * @brief Tokenizer callback
+ *
+ * @param token Lower-cased token (not null-terminated)
+ * @param length Token length
+ * @param user_data User data passed to archive_tokenize()
+ * @return true to continue, false to stop tokenizing
+ */
+typedef bool (*archive_token_cb_t)(const char* token, size_t length, void* user_data);
+
+archive_t* archive_open(const char* directory, uint32_t segment_size);
+void archive_close(archive_t* archive);
+bool archive_write(archive_t* archive, const char* data, size_t length);
+bool archive_checkpoint(archive_t* archive, bool force);
+
+void archive_tokenize(const char* text, size_t length, archive_token_cb_t callback, void* user_data);
+bool archive_segment_path(char* path, size_t size, const char* directory, uint32_t segment, const char* extension);
+int64_t archive_now_ms(void);
+
+size_t archive_varint_encode(uint8_t* out, uint64_t value);
+size_t archive_varint_decode(const uint8_t* in, const uint8_t* end, uint64_t* value);
+
+#endif // ARCHIVE_H
@@ -1,6 +1,24 @@
+#define _GNU_SOURCE
+
 #include "backend.h"
 #include "openocd.h"
 #include "gdb.h"
+#include "exporter.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 backend_if_t backend_openocd = 
 {
@@ -18,18 +36,258 @@ backend_if_t backend_gdb =
     .read_memory = gdb_read_memory,
     .write_memory = gdb_write_memory
 };
+backend_if_t backend_exporter = 
+{
+    .name = "Exporter",
+    .connect = exporter_connect,
+    .disconnect = exporter_disconnect,
+    .read_memory = exporter_read_memory,
+    .write_memory = exporter_write_memory,
+    .watch_memory = exporter_watch_memory
+};
 backend_if_t *backends[BACKEND_TYPE__COUNT] = 
 {
     &backend_openocd,
-    &backend_gdb
+    &backend_gdb,
+    &backend_exporter
 };
 
 const backend_addr_t* backend_default_addrs[BACKEND_TYPE__COUNT] = 
 {
     &openocd_default_addr,
-    &gdb_default_addr
+    &gdb_default_addr,
+    &exporter_default_addr
 };
 
+/**
+ * @brief Command started for an exec: address
+ */
+static struct
+{
+    int     socket;
+    pid_t   pid;
+} exec_child = { .socket = -1, .pid = -1 };
+
+/**
+ * @brief Round trip times of the backend requests
+ */
+static struct
+{
+    uint64_t    count;
+    double      total;      //!< microseconds
+    double      min;
+    double      max;
+} round_trips;
+
+/**
+ * @brief Get the monotonic time in microseconds
+ * 
+ * @return double Time in microseconds
+ */
+static double get_time_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e6 + (double)now.tv_nsec / 1e3;
+}
+
+/**
+ * @brief Account the round trip of a backend request
+ * 
+ * @param start Time the request was started (get_time_us())
+ */
+static void account_round_trip(double start)
+{
+    double elapsed = get_time_us() - start;
+    if(round_trips.count == 0 || elapsed < round_trips.min)
+    {
+        round_trips.min = elapsed;
+    }
+    if(elapsed > round_trips.max)
+    {
+        round_trips.max = elapsed;
+    }
+    round_trips.total += elapsed;
+    round_trips.count++;
+}
+
+/**
+ * @brief Connect to a Unix domain socket
+ * 
+ * @param path Path of the socket
+ * @return int Socket file descriptor on success, -1 on failure
+ */
+static int connect_unix(const char *path)
+{
+    struct sockaddr_un sun = { .sun_family = AF_UNIX };
+    if(strlen(path) >= sizeof(sun.sun_path))
+    {
+        TRACE_ERROR("Unix socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(sun.sun_path, path);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(sock < 0 || connect(sock, (struct sockaddr*)&sun, sizeof(sun)) != 0)
+    {
+        TRACE_ERROR("Failed to connect to %s: %s\n", path, strerror(errno));
+        if(sock >= 0)
+        {
+            close(sock);
+        }
+        return -1;
+    }
+    return sock;
+}
+
+/**
+ * @brief Start a command connected to a socket through its stdin/stdout
+ * 
+ * @param command Shell command
+ * @return int Socket file descriptor on success, -1 on failure
+ */
+static int connect_exec(const char *command)
+{
+    if(exec_child.pid > 0)
+    {
+        TRACE_ERROR("A backend command is already running\n");
+        return -1;
+    }
+    int sockets[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+    {
+        TRACE_ERROR("Failed to create socket pair: %s\n", strerror(errno));
+        return -1;
+    }
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        dup2(sockets[1], STDIN_FILENO);
+        dup2(sockets[1], STDOUT_FILENO);
+        close(sockets[0]);
+        close(sockets[1]);
+        execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+        _exit(127);
+    }
+    close(sockets[1]);
+    if(pid < 0)
+    {
+        TRACE_ERROR("Failed to start %s: %s\n", command, strerror(errno));
+        close(sockets[0]);
+        return -1;
+    }
+    exec_child.socket = sockets[0];
+    exec_child.pid = pid;
+    TRACE_INFO("Started backend command: %s\n", command);
+    return sockets[0];
+}
+
+/**
+ * @brief Connect over TCP with Nagle's algorithm disabled
+ * 
+ * Backend requests are small and every one waits for its reply, so Nagle's
+ * algorithm and delayed acknowledgements would add up to tens of
+ * milliseconds per request.
+ * 
+ * @param host Host name or address
+ * @param port Port number
+ * @return int Socket file descriptor on success, -1 on failure
+ */
+static int connect_tcp(const char *host, int port)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+        .ai_protocol = IPPROTO_TCP
+    };
+    struct addrinfo *res = NULL;
+    char port_str[6];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    if(getaddrinfo(host, port_str, &hints, &res) != 0)
+    {
+        TRACE_ERROR("getaddrinfo failed for %s:%s\n", host, port_str);
+        return -1;
+    }
+    int sock = -1;
+    for(struct addrinfo *rp = res; rp != NULL && sock < 0; rp = rp->ai_next)
+    {
+        sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if(sock < 0)
+        {
+            continue;
+        }
+        // Buffer sizes must be set before connecting to take part in the window negotiation
+        int buffer_size = BACKEND_SOCKET_BUFFER_SIZE;
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+        if(connect(sock, rp->ai_addr, rp->ai_addrlen) != 0)
+        {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if(sock < 0)
+    {
+        TRACE_ERROR("Failed to connect to %s:%s\n", host, port_str);
+        return -1;
+    }
+    int no_delay = 1;
+    if(setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay)) != 0)
+    {
+        TRACE_WARN("Failed to disable Nagle's algorithm: %s\n", strerror(errno));
+    }
+    return sock;
+}
+
+int backend_socket_connect(const backend_addr_t *addr)
+{
+    if(strncmp(addr->host, BACKEND_UNIX_PREFIX, strlen(BACKEND_UNIX_PREFIX)) == 0)
+    {
+        return connect_unix(addr->host + strlen(BACKEND_UNIX_PREFIX));
+    }
+    if(strncmp(addr->host, BACKEND_EXEC_PREFIX, strlen(BACKEND_EXEC_PREFIX)) == 0)
+    {
+        return connect_exec(addr->host + strlen(BACKEND_EXEC_PREFIX));
+    }
+    return connect_tcp(addr->host, addr->port);
+}
+
+void backend_socket_close(int socket)
+{
+    close(socket);
+    if(socket != exec_child.socket || exec_child.pid <= 0)
+    {
+        return;
+    }
+    // The command sees the end of its input and should exit on its own
+    int waited = 0;
+    while(waitpid(exec_child.pid, NULL, WNOHANG) == 0)
+    {
+        if(waited >= BACKEND_EXEC_EXIT_TIMEOUT)
+        {
+            kill(exec_child.pid, SIGTERM);
+            waitpid(exec_child.pid, NULL, 0);
+            break;
+        }
+        usleep(10000);
+        waited += 10;
+    }
+    exec_child.socket = -1;
+    exec_child.pid = -1;
+}
+
+void backend_report_round_trips(void)
+{
+    if(round_trips.count > 0)
+    {
+        TRACE_INFO("Backend round trips: %" PRIu64 " requests, average %.1f us, min %.1f us, max %.1f us\n",
+            round_trips.count,
+            round_trips.total / (double)round_trips.count,
+            round_trips.min,
+            round_trips.max);
+    }
+}
+
 int backend_connect(backend_type_t type, const backend_addr_t *addr)
 {
     if(type >= BACKEND_TYPE__COUNT || backends[type] == NULL)
@@ -54,7 +312,10 @@ int backend_read_memory(backend_type_t type, int socket, uint64_t address, void
     {
         return -1;
     }
-    return backends[type]->read_memory(socket, address, buffer, length);
+    double start = get_time_us();
+    int result = backends[type]->read_memory(socket, address, buffer, length);
+    account_round_trip(start);
+    return result;
 }
 
 int backend_write_memory(backend_type_t type, int socket, uint64_t address, const void *buffer, size_t length)
@@ -63,7 +324,19 @@ int backend_write_memory(backend_type_t type, int socket, uint64_t address, cons
     {
         return -1;
     }
-    return backends[type]->write_memory(socket, address, buffer, length);
+    double start = get_time_us();
+    int result = backends[type]->write_memory(socket, address, buffer, length);
+    account_round_trip(start);
+    return result;
+}
+
+int backend_watch_memory(backend_type_t type, int socket, uint64_t address, size_t length)
+{
+    if(type >= BACKEND_TYPE__COUNT || backends[type] == NULL || backends[type]->watch_memory == NULL)
+    {
+        return -1;
+    }
+    return backends[type]->watch_memory(socket, address, length);
 }
 
 const char* backend_type_to_string(backend_type_t type)
@@ -11,6 +11,7 @@ typedef enum
 {
     BACKEND_TYPE_OPENOCD,   //!< OpenOCD backend
     BACKEND_TYPE_GDB,       //!< GDB backend (not implemented)
+    BACKEND_TYPE_EXPORTER,  //!< dmlog_exporter backend (Linux processes)
 
     BACKEND_TYPE__COUNT     //!< Number of backend types
 } backend_type_t;
@@ -18,10 +19,21 @@ typedef enum
 /**
  * @file backend.h
  * @brief Backend interface definitions for dmlog monitor.
+ * 
+ * The host of a backend address selects the transport:
+ * - `unix:PATH` - Unix domain socket at PATH
+ * - `exec:COMMAND` - COMMAND started by the monitor, talking over its stdin/stdout
+ *   (e.g. `exec:gdbserver stdio ./app`)
+ * - anything else - TCP host name or address, with Nagle's algorithm disabled
  */
+#define BACKEND_UNIX_PREFIX         "unix:"
+#define BACKEND_EXEC_PREFIX         "exec:"
+#define BACKEND_SOCKET_BUFFER_SIZE  (256 * 1024)    /* send and receive buffers of TCP connections */
+#define BACKEND_EXEC_EXIT_TIMEOUT   1000            /* milliseconds to wait for a started command to exit */
+
 typedef struct 
 {
-    char host[256];         //!< Backend host address
+    char host[256];         //!< Backend host address (or unix:PATH, exec:COMMAND)
     int port;               //!< Backend port number
     backend_type_t type;    //!< Backend type
 } backend_addr_t;
@@ -70,6 +82,16 @@ typedef struct
      * @return int 0 on success, -1 on failure
      */
     int (*write_memory)(int socket, uint64_t address, const void *buffer, size_t length); 
+
+    /**
+     * @brief Watch a memory range, so reading it needs no round trip (optional).
+     * 
+     * @param socket Socket file descriptor
+     * @param address Start of the range
+     * @param length Length of the range (0 - stop watching the range at the address, or all ranges if the address is 0)
+     * @return int 0 on success, -1 on failure
+     */
+    int (*watch_memory)(int socket, uint64_t address, size_t length);
 } backend_if_t;
 
 extern backend_if_t backend_openocd;
@@ -118,6 +140,40 @@ extern int backend_read_memory(backend_type_t type, int socket, uint64_t address
  */
 extern int backend_write_memory(backend_type_t type, int socket, uint64_t address, const void *buffer, size_t length);
 
+/**
+ * @brief Watch a memory range via the specified backend.
+ * 
+ * @param type Backend type.
+ * @param socket Socket file descriptor.
+ * @param address Start of the range.
+ * @param length Length of the range (0 - stop watching the range at the address, or all ranges if the address is 0).
+ * @return int 0 on success, -1 on failure or if the backend cannot watch memory.
+ */
+extern int backend_watch_memory(backend_type_t type, int socket, uint64_t address, size_t length);
+
+/**
+ * @brief Open the connection to a backend server.
+ * 
+ * @param addr Backend address (see the transports above).
+ * @return int Socket file descriptor on success, -1 on failure.
+ */
+extern int backend_socket_connect(const backend_addr_t *addr);
+
+/**
+ * @brief Close a connection opened by backend_socket_connect().
+ * 
+ * A command started for an exec: address is given some time to exit and
+ * terminated otherwise.
+ * 
+ * @param socket Socket file descriptor.
+ */
+extern void backend_socket_close(int socket);
+
+/**
+ * @brief Print the number and round trip times of the backend requests.
+ */
+extern void backend_report_round_trips(void);
+
 /**
  * @brief Convert backend type to string representation.
  * 
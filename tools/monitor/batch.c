@@ -0,0 +1,415 @@
+#include "batch.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#define BATCH_HEADER_SIZE   ((uint32_t)sizeof(dmlog_file_batch_header_t))
+#define BATCH_MAX_CHUNK     (1024 * 1024)   /* sanity limit of the chunk size */
+
+struct file_batch
+{
+    backend_type_t              backend_type;
+    int                         socket;
+    uint64_t                    transfer_address;   //!< Transfer being serviced (0 - none)
+    uint32_t                    offset;             //!< Offset of the stream expected with the next chunk
+    uint64_t                    status_address;     //!< Per file status table of the firmware
+    uint32_t                    file_count;
+    char*                       manifest;           //!< Host paths of the files, each '\0' terminated
+    const char**                paths;              //!< Path of every file in the manifest
+    uint32_t                    file_index;         //!< File being streamed
+    uint32_t                    record_offset;      //!< Position in the header and data of that file
+    dmlog_file_batch_header_t   header;             //!< Header of that file
+    FILE*                       file;               //!< Open file of that file (NULL - none or failed)
+    uint8_t*                    chunk;
+    uint32_t                    chunk_capacity;
+};
+
+/**
+ * @brief Forget the batch being serviced
+ *
+ * @param batch Batch state
+ */
+static void reset(file_batch_t* batch)
+{
+    if(batch->file)
+    {
+        fclose(batch->file);
+        batch->file = NULL;
+    }
+    free(batch->manifest);
+    free(batch->paths);
+    batch->manifest = NULL;
+    batch->paths = NULL;
+    batch->transfer_address = 0;
+    batch->file_count = 0;
+}
+
+/**
+ * @brief Start servicing a batch - read its manifest
+ *
+ * @param batch Batch state
+ * @param transfer_address Address of the transfer structure on the target
+ * @param transfer Transfer structure read from the target
+ * @return true on success, false on failure
+ */
+static bool begin(file_batch_t* batch, uint64_t transfer_address, const dmlog_file_transfer_t* transfer)
+{
+    reset(batch);
+    uint32_t file_count = transfer->file_count;
+    uint32_t manifest_size = transfer->manifest_size;
+    if(file_count == 0 || file_count > BATCH_MAX_FILES || manifest_size == 0 || manifest_size > file_count * DMLOG_MAX_FILE_PATH_LENGTH)
+    {
+        TRACE_ERROR("Invalid file batch (%u files, manifest of %u bytes)\n", file_count, manifest_size);
+        return false;
+    }
+
+    batch->manifest = malloc(manifest_size);
+    batch->paths = malloc(file_count * sizeof(const char*));
+    if(batch->manifest == NULL || batch->paths == NULL)
+    {
+        TRACE_ERROR("Failed to allocate file batch manifest\n");
+        reset(batch);
+        return false;
+    }
+    if(backend_read_memory(batch->backend_type, batch->socket, transfer->manifest_address, batch->manifest, manifest_size) < 0)
+    {
+        TRACE_ERROR("Failed to read file batch manifest from target at 0x%08" PRIx64 "\n", (uint64_t)transfer->manifest_address);
+        reset(batch);
+        return false;
+    }
+
+    uint32_t count = 0;
+    uint32_t start = 0;
+    for(uint32_t i = 0; i < manifest_size && count < file_count; i++)
+    {
+        if(batch->manifest[i] == '\0')
+        {
+            batch->paths[count++] = &batch->manifest[start];
+            start = i + 1;
+        }
+    }
+    if(count != file_count)
+    {
+        TRACE_ERROR("File batch manifest lists %u of %u files\n", count, file_count);
+        reset(batch);
+        return false;
+    }
+
+    batch->transfer_address = transfer_address;
+    batch->file_count = file_count;
+    batch->status_address = transfer->status_address;
+    batch->offset = 0;
+    batch->file_index = 0;
+    batch->record_offset = 0;
+    TRACE_INFO("Starting file batch of %u files\n", file_count);
+    return true;
+}
+
+/**
+ * @brief Check that a chunk continues the batch being serviced
+ *
+ * The first chunk of a batch starts it.
+ *
+ * @param batch Batch state
+ * @param transfer_address Address of the transfer structure on the target
+ * @param transfer Transfer structure read from the target
+ * @return true if the chunk can be serviced, false otherwise (the status of the transfer is set)
+ */
+static bool check_chunk(file_batch_t* batch, uint64_t transfer_address, dmlog_file_transfer_t* transfer)
+{
+    if(transfer->chunk_size > BATCH_MAX_CHUNK)
+    {
+        TRACE_ERROR("Invalid file batch chunk of %u bytes\n", transfer->chunk_size);
+        transfer->status = -EINVAL;
+        return false;
+    }
+    if(transfer->offset == 0)
+    {
+        if(!begin(batch, transfer_address, transfer))
+        {
+            transfer->status = -EINVAL;
+            return false;
+        }
+    }
+    else if(transfer_address != batch->transfer_address || transfer->offset != batch->offset)
+    {
+        TRACE_ERROR("File batch chunk at offset %u does not continue the batch (expected %u)\n", transfer->offset, batch->offset);
+        transfer->status = -EPROTO;
+        return false;
+    }
+    if(transfer->chunk_size > batch->chunk_capacity)
+    {
+        uint8_t* chunk = realloc(batch->chunk, transfer->chunk_size);
+        if(chunk == NULL)
+        {
+            TRACE_ERROR("Failed to allocate file batch chunk\n");
+            transfer->status = -ENOMEM;
+            return false;
+        }
+        batch->chunk = chunk;
+        batch->chunk_capacity = transfer->chunk_size;
+    }
+    transfer->status = 0;
+    return true;
+}
+
+/**
+ * @brief Report a file that failed on the host to the firmware
+ *
+ * @param batch Batch state
+ * @param status Negative errno
+ */
+static void fail_file(file_batch_t* batch, int32_t status)
+{
+    TRACE_ERROR("File batch: '%s' failed: %s\n", batch->paths[batch->file_index], strerror(-status));
+    uint64_t address = batch->status_address + (uint64_t)batch->file_index * sizeof(int32_t);
+    if(backend_write_memory(batch->backend_type, batch->socket, address, &status, sizeof(status)) < 0)
+    {
+        TRACE_ERROR("Failed to write file batch status to target\n");
+    }
+    if(batch->file)
+    {
+        fclose(batch->file);
+        batch->file = NULL;
+    }
+}
+
+/**
+ * @brief Move to the next file of the batch
+ *
+ * @param batch Batch state
+ * @param receiving true if the file was received from the firmware
+ */
+static void next_file(file_batch_t* batch, bool receiving)
+{
+    if(batch->file)
+    {
+        int result = fclose(batch->file);
+        batch->file = NULL;
+        if(result != 0 && receiving)
+        {
+            fail_file(batch, -EIO);
+        }
+        else
+        {
+            TRACE_INFO("File batch: %s '%s' (%u bytes)\n", receiving ? "received" : "sent", batch->paths[batch->file_index], batch->header.size);
+        }
+    }
+    batch->file_index++;
+    batch->record_offset = 0;
+}
+
+/**
+ * @brief Create the file whose header was just received
+ *
+ * @param batch Batch state
+ */
+static void create_file(file_batch_t* batch)
+{
+    if(batch->header.status != 0)
+    {
+        TRACE_WARN("File batch: '%s' was not sent by the firmware: %s\n", batch->paths[batch->file_index], strerror(-batch->header.status));
+        return;
+    }
+    batch->file = fopen(batch->paths[batch->file_index], "wb");
+    if(batch->file == NULL)
+    {
+        fail_file(batch, -errno);
+    }
+}
+
+/**
+ * @brief Open the file whose header is about to be sent
+ *
+ * @param batch Batch state
+ */
+static void open_file(file_batch_t* batch)
+{
+    const char* path = batch->paths[batch->file_index];
+    batch->header.size = 0;
+    batch->header.status = 0;
+    batch->file = fopen(path, "rb");
+    if(batch->file == NULL)
+    {
+        batch->header.status = -errno;
+        TRACE_ERROR("File batch: cannot open '%s': %s\n", path, strerror(errno));
+        return;
+    }
+    long size = -1;
+    if(fseek(batch->file, 0, SEEK_END) == 0)
+    {
+        size = ftell(batch->file);
+    }
+    if(size < 0 || size > UINT32_MAX || fseek(batch->file, 0, SEEK_SET) != 0)
+    {
+        batch->header.status = -EIO;
+        TRACE_ERROR("File batch: cannot get the size of '%s'\n", path);
+        fclose(batch->file);
+        batch->file = NULL;
+        return;
+    }
+    batch->header.size = (uint32_t)size;
+}
+
+/**
+ * @brief Allocate the state of the batch transfers
+ *
+ * @param backend_type Backend type
+ * @param socket Backend socket
+ * @return file_batch_t* Batch state, NULL on failure
+ */
+file_batch_t* batch_open(backend_type_t backend_type, int socket)
+{
+    file_batch_t* batch = calloc(1, sizeof(file_batch_t));
+    if(batch == NULL)
+    {
+        TRACE_ERROR("Failed to allocate file batch state\n");
+        return NULL;
+    }
+    batch->backend_type = backend_type;
+    batch->socket = socket;
+    return batch;
+}
+
+/**
+ * @brief Free the state of the batch transfers
+ *
+ * @param batch Batch state (may be NULL)
+ */
+void batch_close(file_batch_t* batch)
+{
+    if(batch)
+    {
+        reset(batch);
+        free(batch->chunk);
+        free(batch);
+    }
+}
+
+/**
+ * @brief Store a chunk of a batch sent by the firmware
+ *
+ * @param batch Batch state
+ * @param transfer_address Address of the transfer structure on the target
+ * @param transfer Transfer structure read from the target, its status is set on failure
+ * @return true on success, false if the whole batch failed
+ */
+bool batch_store_chunk(file_batch_t* batch, uint64_t transfer_address, dmlog_file_transfer_t* transfer)
+{
+    if(!check_chunk(batch, transfer_address, transfer))
+    {
+        return false;
+    }
+    uint32_t length = transfer->chunk_size;
+    if(length > 0 && backend_read_memory(batch->backend_type, batch->socket, transfer->buffer_address, batch->chunk, length) < 0)
+    {
+        TRACE_ERROR("Failed to read file batch chunk from target buffer\n");
+        transfer->status = -EIO;
+        return false;
+    }
+
+    uint32_t position = 0;
+    while(position < length && batch->file_index < batch->file_count)
+    {
+        uint32_t available = length - position;
+        uint32_t count;
+        if(batch->record_offset < BATCH_HEADER_SIZE)
+        {
+            uint32_t left = BATCH_HEADER_SIZE - batch->record_offset;
+            count = (left < available) ? left : available;
+            memcpy((uint8_t*)&batch->header + batch->record_offset, &batch->chunk[position], count);
+            if(count == left)
+            {
+                create_file(batch);
+            }
+        }
+        else
+        {
+            uint32_t left = BATCH_HEADER_SIZE + batch->header.size - batch->record_offset;
+            count = (left < available) ? left : available;
+            if(batch->file && fwrite(&batch->chunk[position], 1, count, batch->file) != count)
+            {
+                fail_file(batch, -EIO);
+            }
+        }
+        position += count;
+        batch->record_offset += count;
+        bool header_done = batch->record_offset >= BATCH_HEADER_SIZE;
+        if(header_done && batch->record_offset == BATCH_HEADER_SIZE + batch->header.size)
+        {
+            next_file(batch, true);
+        }
+    }
+    batch->offset = transfer->offset + length;
+    return true;
+}
+
+/**
+ * @brief Fill a chunk of a batch received by the firmware
+ *
+ * The chunk is written to the buffer of the firmware, and the chunk size of
+ * the transfer is set to the number of bytes in it.
+ *
+ * @param batch Batch state
+ * @param transfer_address Address of the transfer structure on the target
+ * @param transfer Transfer structure read from the target, its status is set on failure
+ * @return true on success, false if the whole batch failed
+ */
+bool batch_fill_chunk(file_batch_t* batch, uint64_t transfer_address, dmlog_file_transfer_t* transfer)
+{
+    if(!check_chunk(batch, transfer_address, transfer))
+    {
+        return false;
+    }
+    uint32_t capacity = transfer->chunk_size;
+    uint32_t length = 0;
+    while(length < capacity && batch->file_index < batch->file_count)
+    {
+        uint32_t space = capacity - length;
+        uint32_t count;
+        if(batch->record_offset == 0)
+        {
+            open_file(batch);
+        }
+        if(batch->record_offset < BATCH_HEADER_SIZE)
+        {
+            uint32_t left = BATCH_HEADER_SIZE - batch->record_offset;
+            count = (left < space) ? left : space;
+            memcpy(&batch->chunk[length], (uint8_t*)&batch->header + batch->record_offset, count);
+        }
+        else
+        {
+            uint32_t left = BATCH_HEADER_SIZE + batch->header.size - batch->record_offset;
+            count = (left < space) ? left : space;
+            size_t read_bytes = batch->file ? fread(&batch->chunk[length], 1, count, batch->file) : 0;
+            if(read_bytes != count)
+            {
+                // The size is already sent, so the rest of the file is padded
+                if(batch->file)
+                {
+                    fail_file(batch, -EIO);
+                }
+                memset(&batch->chunk[length + read_bytes], 0, count - read_bytes);
+            }
+        }
+        length += count;
+        batch->record_offset += count;
+        if(batch->record_offset == BATCH_HEADER_SIZE + batch->header.size)
+        {
+            next_file(batch, false);
+        }
+    }
+
+    if(length > 0 && backend_write_memory(batch->backend_type, batch->socket, transfer->buffer_address, batch->chunk, length) < 0)
+    {
+        TRACE_ERROR("Failed to write file batch chunk to target buffer\n");
+        transfer->status = -EIO;
+        return false;
+    }
+    transfer->chunk_size = length;
+    batch->offset = transfer->offset + length;
+    return true;
+}
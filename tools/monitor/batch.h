@@ -0,0 +1,29 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dmlog.h"
+#include "backend.h"
+
+/**
+ * @file batch.h
+ * @brief Host side of the batch file transfers of the firmware.
+ *
+ * A batch streams many files through the chunks of a single transfer (see
+ * dmlog_file_batch_send_start()). The host paths are read from the manifest with
+ * the first chunk, and the files are kept open across chunks until their
+ * data ends. Files that fail on the host are reported in the per file status
+ * table of the firmware, the batch itself goes on.
+ */
+
+#define BATCH_MAX_FILES     65536   /* sanity limit of the number of files */
+
+typedef struct file_batch file_batch_t;
+
+file_batch_t* batch_open(backend_type_t backend_type, int socket);
+void batch_close(file_batch_t* batch);
+bool batch_store_chunk(file_batch_t* batch, uint64_t transfer_address, dmlog_file_transfer_t* transfer);
+bool batch_fill_chunk(file_batch_t* batch, uint64_t transfer_address, dmlog_file_transfer_t* transfer);
+
+#endif // BATCH_H
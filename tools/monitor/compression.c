@@ -0,0 +1,182 @@
+#include "compression.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMPRESSION_HASH_BITS   12
+#define COMPRESSION_HASH_SIZE   (1u << COMPRESSION_HASH_BITS)
+#define COMPRESSION_MAX_CHAIN   64      /* candidates checked for every position */
+#define COMPRESSION_MATCH_SIZE  3       /* token and distance */
+#define COMPRESSION_NONE        UINT32_MAX
+
+/**
+ * @brief Hash the first DMLOG_COMPRESSION_MIN_MATCH bytes at a position
+ */
+static uint32_t hash_position(const uint8_t* data)
+{
+    uint32_t value = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    return (value * 2654435761u) >> (32 - COMPRESSION_HASH_BITS);
+}
+
+/**
+ * @brief Add a position to the hash chains
+ */
+static void insert_position(const uint8_t* data, size_t size, size_t position, uint32_t* head, uint32_t* previous)
+{
+    if(position + DMLOG_COMPRESSION_MIN_MATCH > size)
+    {
+        return;
+    }
+    uint32_t hash = hash_position(&data[position]);
+    previous[position] = head[hash];
+    head[hash] = (uint32_t)position;
+}
+
+/**
+ * @brief Find the longest match of a position within the window
+ *
+ * @return Length of the match (0 if it is shorter than DMLOG_COMPRESSION_MIN_MATCH)
+ */
+static size_t find_match(const uint8_t* data, size_t size, size_t position, uint32_t window_size,
+                         const uint32_t* head, const uint32_t* previous, size_t* distance)
+{
+    size_t best_length = 0;
+    if(position + DMLOG_COMPRESSION_MIN_MATCH > size)
+    {
+        return 0;
+    }
+    size_t max_length = size - position;
+    if(max_length > DMLOG_COMPRESSION_MAX_MATCH)
+    {
+        max_length = DMLOG_COMPRESSION_MAX_MATCH;
+    }
+    uint32_t candidate = head[hash_position(&data[position])];
+    for(int chain = 0; candidate != COMPRESSION_NONE && chain < COMPRESSION_MAX_CHAIN; chain++)
+    {
+        if(position - candidate > window_size)
+        {
+            break;
+        }
+        size_t length = 0;
+        while(length < max_length && data[candidate + length] == data[position + length])
+        {
+            length++;
+        }
+        if(length > best_length)
+        {
+            best_length = length;
+            *distance = position - candidate;
+            if(length == max_length)
+            {
+                break;
+            }
+        }
+        candidate = previous[candidate];
+    }
+    return (best_length >= DMLOG_COMPRESSION_MIN_MATCH) ? best_length : 0;
+}
+
+/**
+ * @brief Write the pending literals that fit into the output
+ *
+ * @return Number of literals written
+ */
+static size_t put_literals(const uint8_t* literals, size_t count, uint8_t* out, size_t capacity, size_t* out_size)
+{
+    size_t written = 0;
+    while(written < count && *out_size + 1 < capacity)
+    {
+        size_t run = count - written;
+        if(run > DMLOG_COMPRESSION_MAX_LITERALS)
+        {
+            run = DMLOG_COMPRESSION_MAX_LITERALS;
+        }
+        if(run > capacity - *out_size - 1)
+        {
+            run = capacity - *out_size - 1;
+        }
+        out[(*out_size)++] = (uint8_t)(run - 1);
+        memcpy(&out[*out_size], &literals[written], run);
+        *out_size += run;
+        written += run;
+    }
+    return written;
+}
+
+/**
+ * @brief Compress the data following a dictionary into a chunk
+ *
+ * Compresses as much of the data as fits into the chunk, greedily taking the
+ * longest match within the window at every position.
+ *
+ * @param data Dictionary (the data of the file preceding the chunk) followed by the data to compress
+ * @param dictionary_size Size of the dictionary (at most window_size)
+ * @param size Size of the dictionary and the data
+ * @param out Buffer for the compressed chunk
+ * @param capacity Size of the buffer
+ * @param window_size Window of the firmware (at most 65535)
+ * @param consumed Number of data bytes in the compressed chunk
+ *
+ * @return Size of the compressed chunk
+ */
+size_t compression_encode(const uint8_t* data, size_t dictionary_size, size_t size,
+                          uint8_t* out, size_t capacity, uint32_t window_size, size_t* consumed)
+{
+    size_t out_size = 0;
+    *consumed = 0;
+    uint32_t* head = malloc(COMPRESSION_HASH_SIZE * sizeof(uint32_t));
+    uint32_t* previous = malloc(size * sizeof(uint32_t));
+    if(head == NULL || previous == NULL || window_size > UINT16_MAX)
+    {
+        free(head);
+        free(previous);
+        return 0;
+    }
+    memset(head, 0xFF, COMPRESSION_HASH_SIZE * sizeof(uint32_t));
+    for(size_t i = 0; i < dictionary_size; i++)
+    {
+        insert_position(data, size, i, head, previous);
+    }
+
+    size_t position = dictionary_size;
+    size_t literal_start = position;
+    bool full = false;
+    while(position < size)
+    {
+        size_t distance = 0;
+        size_t length = find_match(data, size, position, window_size, head, previous, &distance);
+        if(length == 0)
+        {
+            insert_position(data, size, position, head, previous);
+            position++;
+            continue;
+        }
+
+        // The literals before the match go first
+        size_t literals = position - literal_start;
+        size_t written = put_literals(&data[literal_start], literals, out, capacity, &out_size);
+        literal_start += written;
+        if(written != literals || out_size + COMPRESSION_MATCH_SIZE > capacity)
+        {
+            full = true;
+            break;
+        }
+        out[out_size++] = (uint8_t)(0x80 | (length - DMLOG_COMPRESSION_MIN_MATCH));
+        out[out_size++] = (uint8_t)(distance & 0xFF);
+        out[out_size++] = (uint8_t)(distance >> 8);
+        for(size_t i = 0; i < length; i++)
+        {
+            insert_position(data, size, position + i, head, previous);
+        }
+        position += length;
+        literal_start = position;
+    }
+    if(!full)
+    {
+        literal_start += put_literals(&data[literal_start], position - literal_start, out, capacity, &out_size);
+    }
+    *consumed = literal_start - dictionary_size;
+    free(head);
+    free(previous);
+    return out_size;
+}
@@ -0,0 +1,25 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dmlog.h"
+
+/**
+ * @file compression.h
+ * @brief Compression of the file chunks received by the firmware.
+ *
+ * The chunks are compressed on the host, where it is cheap, into the token
+ * format the firmware decodes (see DMLOG_FILE_TRANSFER_FLAG_COMPRESSED). The
+ * firmware keeps the last window_size bytes of the file, so a chunk may copy
+ * from the data of the previous ones - the host passes them as the
+ * dictionary, and does not have to keep any state between chunks.
+ */
+
+/* Most file bytes a compressed byte can carry (a match token and its distance) */
+#define COMPRESSION_MAX_RATIO   (DMLOG_COMPRESSION_MAX_MATCH / 3 + 1)
+
+size_t compression_encode(const uint8_t* data, size_t dictionary_size, size_t size,
+                          uint8_t* out, size_t capacity, uint32_t window_size, size_t* consumed);
+
+#endif // COMPRESSION_H
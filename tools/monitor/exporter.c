@@ -0,0 +1,394 @@
+#define _GNU_SOURCE
+
+#include "exporter.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Default exporter backend address
+ */
+const backend_addr_t exporter_default_addr = {
+    .host = EXPORTER_DEFAULT_HOST,
+    .port = EXPORTER_DEFAULT_PORT,
+    .type = BACKEND_TYPE_EXPORTER
+};
+
+/**
+ * @brief Local copy of a watched range, kept up to date by the pushed updates
+ */
+typedef struct
+{
+    uint64_t    address;
+    size_t      length;
+    uint8_t*    data;
+} mirror_t;
+
+/**
+ * @brief State of the connection to the exporter (the monitor uses a single one)
+ */
+static struct
+{
+    int         socket;
+    mirror_t    mirrors[EXPORTER_MAX_WATCHES];
+    size_t      mirror_count;
+} session = { .socket = -1 };
+
+/**
+ * @brief Find the mirror containing the whole range
+ *
+ * @param address Start of the range
+ * @param length Length of the range
+ * @return mirror_t* Mirror, NULL if the range is not watched
+ */
+static mirror_t* find_mirror(uint64_t address, size_t length)
+{
+    for(size_t i = 0; i < session.mirror_count; i++)
+    {
+        mirror_t* mirror = &session.mirrors[i];
+        if(address >= mirror->address && address - mirror->address <= mirror->length &&
+           length <= mirror->length - (address - mirror->address))
+        {
+            return mirror;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Drop the mirror at the given index
+ *
+ * @param index Index of the mirror
+ */
+static void remove_mirror(size_t index)
+{
+    free(session.mirrors[index].data);
+    session.mirrors[index] = session.mirrors[--session.mirror_count];
+}
+
+/**
+ * @brief Receive the payload of an update into its mirror
+ *
+ * @param header Header of the update
+ * @return int 0 on success, -1 on failure
+ */
+static int apply_update(const exporter_header_t* header)
+{
+    mirror_t* mirror = find_mirror(header->address, header->length);
+    if(mirror == NULL)
+    {
+        // The range was unwatched while the update was on its way
+        return exporter_discard(session.socket, header->length);
+    }
+    return exporter_receive(session.socket, mirror->data + (header->address - mirror->address), header->length);
+}
+
+/**
+ * @brief Apply the updates pushed by the exporter
+ *
+ * Without a reply to wait for, only the messages that already arrived are
+ * processed. A sample is always applied up to its EXPORTER_MSG_SYNC, so the
+ * mirrors never hold a mix of two samples.
+ *
+ * @param reply Where to store the header of the next reply (NULL - do not wait for a reply)
+ * @return int 0 on success, -1 on failure
+ */
+static int process_messages(exporter_header_t* reply)
+{
+    bool in_sample = false;
+    for(;;)
+    {
+        if(reply == NULL && !in_sample)
+        {
+            struct pollfd pfd = { .fd = session.socket, .events = POLLIN };
+            int ready = poll(&pfd, 1, 0);
+            if(ready < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if(ready <= 0)
+            {
+                return ready;
+            }
+        }
+
+        exporter_header_t header;
+        if(exporter_receive(session.socket, &header, sizeof(header)) < 0)
+        {
+            TRACE_ERROR("Connection to the exporter lost\n");
+            return -1;
+        }
+        if(header.type == EXPORTER_MSG_UPDATE)
+        {
+            in_sample = true;
+            if(apply_update(&header) < 0)
+            {
+                TRACE_ERROR("Failed to receive update from the exporter\n");
+                return -1;
+            }
+        }
+        else if(header.type == EXPORTER_MSG_SYNC)
+        {
+            in_sample = false;
+        }
+        else if(header.type == EXPORTER_MSG_REPLY && reply != NULL && !in_sample)
+        {
+            *reply = header;
+            return 0;
+        }
+        else
+        {
+            TRACE_ERROR("Unexpected message 0x%02X from the exporter\n", header.type);
+            return -1;
+        }
+    }
+}
+
+/**
+ * @brief Send a request and wait for its reply
+ *
+ * @param command Request (EXPORTER_CMD_*)
+ * @param address Target address
+ * @param length Number of bytes the request refers to
+ * @param payload Payload of a write request (NULL - none)
+ * @param data Buffer for the data of the reply (NULL - none expected)
+ * @return int 0 on success, -1 on failure
+ */
+static int request(uint8_t command, uint64_t address, uint32_t length, const void* payload, void* data)
+{
+    exporter_header_t header = {
+        .type = command,
+        .length = length,
+        .address = address
+    };
+    if(exporter_send(session.socket, &header, payload) < 0)
+    {
+        TRACE_ERROR("Failed to send request to the exporter: %s\n", strerror(errno));
+        return -1;
+    }
+
+    exporter_header_t reply;
+    if(process_messages(&reply) < 0)
+    {
+        return -1;
+    }
+    if(reply.status != 0)
+    {
+        TRACE_ERROR("Exporter request 0x%02X at 0x%08" PRIx64 " failed: %s\n", command, address, strerror(reply.status));
+        exporter_discard(session.socket, reply.length);
+        return -1;
+    }
+    uint32_t expected = data != NULL ? length : 0;
+    if(reply.length != expected)
+    {
+        TRACE_ERROR("Invalid reply length from the exporter: %u != %u\n", reply.length, expected);
+        return -1;
+    }
+    return expected > 0 ? exporter_receive(session.socket, data, expected) : 0;
+}
+
+/**
+ * @brief Connect to dmlog_exporter
+ *
+ * @param addr Exporter address
+ * @return int Socket file descriptor on success, -1 on failure
+ */
+int exporter_connect(const backend_addr_t *addr)
+{
+    if(session.socket >= 0)
+    {
+        TRACE_ERROR("Already connected to an exporter\n");
+        return -1;
+    }
+
+    int sock = backend_socket_connect(addr);
+    if(sock < 0)
+    {
+        return -1;
+    }
+
+    exporter_header_t header;
+    exporter_hello_t hello;
+    if(exporter_receive(sock, &header, sizeof(header)) < 0 ||
+       header.type != EXPORTER_MSG_HELLO || header.length != sizeof(hello) ||
+       exporter_receive(sock, &hello, sizeof(hello)) < 0 ||
+       hello.magic != EXPORTER_MAGIC)
+    {
+        TRACE_ERROR("%s:%d is not a dmlog exporter\n", addr->host, addr->port);
+        backend_socket_close(sock);
+        return -1;
+    }
+    if(hello.version != EXPORTER_PROTOCOL_VERSION)
+    {
+        TRACE_ERROR("Unsupported exporter protocol version %u (expected %u)\n", hello.version, EXPORTER_PROTOCOL_VERSION);
+        backend_socket_close(sock);
+        return -1;
+    }
+
+    session.socket = sock;
+    TRACE_INFO("Connected to exporter at %s:%d (process %u, sampling every %u ms)\n", addr->host, addr->port, hello.pid, hello.interval);
+    return sock;
+}
+
+/**
+ * @brief Disconnect from the exporter and drop the mirrors
+ *
+ * @param socket Socket file descriptor
+ * @return int 0 on success
+ */
+int exporter_disconnect(int socket)
+{
+    if(socket != session.socket)
+    {
+        return -1;
+    }
+    while(session.mirror_count > 0)
+    {
+        remove_mirror(session.mirror_count - 1);
+    }
+    backend_socket_close(socket);
+    session.socket = -1;
+    return 0;
+}
+
+/**
+ * @brief Read memory of the process served by the exporter
+ *
+ * Watched ranges are read from their mirrors after applying the pending updates.
+ *
+ * @param socket Socket file descriptor
+ * @param address Memory address to read from
+ * @param buffer Buffer to store read data
+ * @param length Number of bytes to read
+ * @return int 0 on success, -1 on failure
+ */
+int exporter_read_memory(int socket, uint64_t address, void *buffer, size_t length)
+{
+    if(socket != session.socket || process_messages(NULL) < 0)
+    {
+        return -1;
+    }
+    mirror_t* mirror = find_mirror(address, length);
+    if(mirror != NULL)
+    {
+        memcpy(buffer, mirror->data + (address - mirror->address), length);
+        return 0;
+    }
+    for(size_t done = 0; done < length; )
+    {
+        uint32_t chunk = length - done < EXPORTER_MAX_LENGTH ? (uint32_t)(length - done) : EXPORTER_MAX_LENGTH;
+        if(request(EXPORTER_CMD_READ, address + done, chunk, NULL, (uint8_t*)buffer + done) < 0)
+        {
+            return -1;
+        }
+        done += chunk;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write memory of the process served by the exporter
+ *
+ * @param socket Socket file descriptor
+ * @param address Memory address to write to
+ * @param buffer Buffer containing data to write
+ * @param length Number of bytes to write
+ * @return int 0 on success, -1 on failure
+ */
+int exporter_write_memory(int socket, uint64_t address, const void *buffer, size_t length)
+{
+    if(socket != session.socket)
+    {
+        return -1;
+    }
+    for(size_t done = 0; done < length; )
+    {
+        uint32_t chunk = length - done < EXPORTER_MAX_LENGTH ? (uint32_t)(length - done) : EXPORTER_MAX_LENGTH;
+        if(request(EXPORTER_CMD_WRITE, address + done, chunk, (const uint8_t*)buffer + done, NULL) < 0)
+        {
+            return -1;
+        }
+        done += chunk;
+    }
+
+    // Keep the mirrors in line with the write (the exporter does not push it back)
+    for(size_t i = 0; i < session.mirror_count; i++)
+    {
+        mirror_t* mirror = &session.mirrors[i];
+        uint64_t start = address > mirror->address ? address : mirror->address;
+        uint64_t end = address + length < mirror->address + mirror->length ? address + length : mirror->address + mirror->length;
+        if(start < end)
+        {
+            memcpy(mirror->data + (start - mirror->address), (const uint8_t*)buffer + (start - address), end - start);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Watch a memory range, so the exporter pushes its changes
+ *
+ * @param socket Socket file descriptor
+ * @param address Start of the range
+ * @param length Length of the range (0 - stop watching the range at the address, or all ranges if the address is 0)
+ * @return int 0 on success, -1 on failure
+ */
+int exporter_watch_memory(int socket, uint64_t address, size_t length)
+{
+    if(socket != session.socket)
+    {
+        return -1;
+    }
+    if(length == 0)
+    {
+        if(request(EXPORTER_CMD_UNWATCH, address, 0, NULL, NULL) < 0)
+        {
+            return -1;
+        }
+        for(size_t i = session.mirror_count; i > 0; i--)
+        {
+            if(address == 0 || session.mirrors[i - 1].address == address)
+            {
+                remove_mirror(i - 1);
+            }
+        }
+        return 0;
+    }
+    if(length > EXPORTER_MAX_LENGTH || session.mirror_count >= EXPORTER_MAX_WATCHES)
+    {
+        TRACE_ERROR("Cannot watch %zu bytes at 0x%08" PRIx64 "\n", length, address);
+        return -1;
+    }
+
+    uint8_t* data = malloc(length);
+    if(data == NULL)
+    {
+        TRACE_ERROR("Failed to allocate mirror of %zu bytes\n", length);
+        return -1;
+    }
+    if(request(EXPORTER_CMD_WATCH, address, (uint32_t)length, NULL, data) < 0)
+    {
+        free(data);
+        return -1;
+    }
+    // Watching the same address again replaces the range
+    for(size_t i = 0; i < session.mirror_count; i++)
+    {
+        if(session.mirrors[i].address == address)
+        {
+            remove_mirror(i);
+            break;
+        }
+    }
+    session.mirrors[session.mirror_count++] = (mirror_t){ .address = address, .length = length, .data = data };
+    TRACE_VERBOSE("Watching %zu bytes at 0x%08" PRIx64 "\n", length, address);
+    return 0;
+}
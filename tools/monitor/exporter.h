@@ -0,0 +1,26 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "backend.h"
+#include "exporter_protocol.h"
+
+/**
+ * @file exporter.h
+ * @brief Backend for dmlog_exporter, serving the memory of a Linux process over TCP.
+ *
+ * Watched ranges (the ring header and the output ring) are mirrored locally:
+ * the exporter pushes the bytes that changed, so reading them costs no round
+ * trip. Other reads and all writes are sent to the exporter.
+ */
+
+extern const backend_addr_t exporter_default_addr;
+
+extern int exporter_connect(const backend_addr_t *addr);
+extern int exporter_disconnect(int socket);
+extern int exporter_read_memory(int socket, uint64_t address, void *buffer, size_t length);
+extern int exporter_write_memory(int socket, uint64_t address, const void *buffer, size_t length);
+extern int exporter_watch_memory(int socket, uint64_t address, size_t length);
+
+#endif // EXPORTER_H
\ No newline at end of file
@@ -0,0 +1,106 @@
+#define _GNU_SOURCE
+
+#include "exporter_protocol.h"
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Send a message with a single system call
+ *
+ * The header and the payload go out together, so a small request is never
+ * split into two TCP segments.
+ *
+ * @param socket Socket file descriptor
+ * @param header Message header
+ * @param payload Payload of header->length bytes (NULL - no payload)
+ * @return int 0 on success, -1 on failure
+ */
+int exporter_send(int socket, const exporter_header_t* header, const void* payload)
+{
+    struct iovec iov[2] = {
+        { .iov_base = (void*)header, .iov_len = sizeof(exporter_header_t) },
+        { .iov_base = (void*)payload, .iov_len = payload != NULL ? header->length : 0 }
+    };
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+    size_t left = iov[0].iov_len + iov[1].iov_len;
+    while(left > 0)
+    {
+        ssize_t sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if(sent < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        left -= (size_t)sent;
+        while(msg.msg_iovlen > 0 && (size_t)sent >= msg.msg_iov->iov_len)
+        {
+            sent -= (ssize_t)msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if(msg.msg_iovlen > 0)
+        {
+            msg.msg_iov->iov_base = (uint8_t*)msg.msg_iov->iov_base + sent;
+            msg.msg_iov->iov_len -= (size_t)sent;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Receive exactly the given number of bytes
+ *
+ * @param socket Socket file descriptor
+ * @param buffer Buffer to store the bytes
+ * @param length Number of bytes to receive
+ * @return int 0 on success, -1 on failure or when the peer closed the connection
+ */
+int exporter_receive(int socket, void* buffer, size_t length)
+{
+    for(size_t done = 0; done < length; )
+    {
+        ssize_t received = recv(socket, (uint8_t*)buffer + done, length - done, 0);
+        if(received == 0)
+        {
+            return -1;
+        }
+        if(received < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        done += (size_t)received;
+    }
+    return 0;
+}
+
+/**
+ * @brief Receive and drop the given number of bytes
+ *
+ * @param socket Socket file descriptor
+ * @param length Number of bytes to drop
+ * @return int 0 on success, -1 on failure
+ */
+int exporter_discard(int socket, size_t length)
+{
+    uint8_t buffer[1024];
+    while(length > 0)
+    {
+        size_t chunk = length < sizeof(buffer) ? length : sizeof(buffer);
+        if(exporter_receive(socket, buffer, chunk) < 0)
+        {
+            return -1;
+        }
+        length -= chunk;
+    }
+    return 0;
+}
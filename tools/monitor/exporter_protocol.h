@@ -0,0 +1,65 @@
+#ifndef EXPORTER_PROTOCOL_H
+#define EXPORTER_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file exporter_protocol.h
+ * @brief Binary protocol between dmlog_exporter and the monitor exporter backend.
+ *
+ * Every message starts with an exporter_header_t. WRITE requests, replies and
+ * updates are followed by `length` bytes of payload. All fields are
+ * little-endian.
+ *
+ * After the connection is accepted the exporter sends EXPORTER_MSG_HELLO. The
+ * monitor then sends requests (EXPORTER_CMD_*), each answered by a single
+ * EXPORTER_MSG_REPLY in order. Between the replies the exporter pushes
+ * EXPORTER_MSG_UPDATE messages with the bytes that changed in the watched
+ * ranges. All updates sampled at the same moment are sent together and closed
+ * by EXPORTER_MSG_SYNC, so the client never sees a half-applied sample.
+ */
+
+#define EXPORTER_DEFAULT_HOST       "localhost"
+#define EXPORTER_DEFAULT_PORT       4455
+#define EXPORTER_MAGIC              0x584C4D44u             /* "DMLX" */
+#define EXPORTER_PROTOCOL_VERSION   1
+#define EXPORTER_MAX_LENGTH         (16u * 1024u * 1024u)   /* maximum payload of a message */
+#define EXPORTER_MAX_WATCHES        80                      /* ring header and up to 64 ring segments */
+
+typedef enum
+{
+    EXPORTER_CMD_READ       = 0x01, //!< Read `length` bytes at `address`
+    EXPORTER_CMD_WRITE      = 0x02, //!< Write the payload at `address`
+    EXPORTER_CMD_WATCH      = 0x03, //!< Push changes of `length` bytes at `address` (reply carries the current bytes)
+    EXPORTER_CMD_UNWATCH    = 0x04, //!< Stop watching the range at `address` (0 - all ranges)
+
+    EXPORTER_MSG_HELLO      = 0x80, //!< Sent once after the connection is accepted (exporter_hello_t)
+    EXPORTER_MSG_REPLY      = 0x81, //!< Reply to a request, `status` is 0 or an errno value
+    EXPORTER_MSG_UPDATE     = 0x82, //!< New bytes of a watched range at `address`
+    EXPORTER_MSG_SYNC       = 0x83, //!< End of the updates of a single sample
+} exporter_message_type_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t     type;       //!< exporter_message_type_t
+    uint8_t     status;     //!< 0 - success, errno value otherwise (replies only)
+    uint16_t    reserved;
+    uint32_t    length;     //!< Number of bytes the message refers to (WRITE, REPLY and UPDATE carry them as payload)
+    uint64_t    address;    //!< Target address the message refers to
+} exporter_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t    magic;      //!< EXPORTER_MAGIC
+    uint16_t    version;    //!< EXPORTER_PROTOCOL_VERSION
+    uint16_t    reserved;
+    uint32_t    pid;        //!< Process the exporter serves
+    uint32_t    interval;   //!< Sampling interval of the watched ranges in milliseconds
+} exporter_hello_t;
+
+int exporter_send(int socket, const exporter_header_t* header, const void* payload);
+int exporter_receive(int socket, void* buffer, size_t length);
+int exporter_discard(int socket, size_t length);
+
+#endif // EXPORTER_PROTOCOL_H
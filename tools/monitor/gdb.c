@@ -247,57 +247,31 @@ static int gdb_drain_pending_packets(int socket)
  */
 int gdb_connect(const backend_addr_t *addr)
 {
-    struct addrinfo hints = {
-        .ai_family = AF_INET,
-        .ai_socktype = SOCK_STREAM,
-        .ai_protocol = IPPROTO_TCP
-    };
-    struct addrinfo *res = NULL;
-    struct addrinfo *rp = NULL;
-    char port_str[6];
-    snprintf(port_str, sizeof(port_str), "%d", addr->port);
-
-    if (getaddrinfo(addr->host, port_str, &hints, &res) != 0) {
-        TRACE_ERROR("getaddrinfo failed for %s:%s\n", addr->host, port_str);
+    int sock = backend_socket_connect(addr);
+    if (sock < 0) {
         return -1;
     }
 
-    for (rp = res; rp != NULL; rp = rp->ai_next) {
-        int sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-        if (sock < 0)
-            continue;
+    // Note: NoAck mode is disabled because it requires tracking state
+    // and would complicate the implementation. ACK mode is reliable enough.
 
-        if (connect(sock, rp->ai_addr, rp->ai_addrlen) == 0) {
-            freeaddrinfo(res);
-            
-            // Note: NoAck mode is disabled because it requires tracking state
-            // and would complicate the implementation. ACK mode is reliable enough.
-            
-            TRACE_INFO("Connected to GDB server at %s:%d\n", addr->host, addr->port);
-            
-            // Drain any pending packets (like unsolicited stop replies)
-            // This handles cases where GDB sends S02 (SIGINT) at connection time
-            gdb_drain_pending_packets(sock);
-            
-            // Send continue command to start/resume the target
-            // When gdbserver starts a process, it stops at entry point
-            // We need to continue it so the program can run and initialize
-            // gdb_continue() will run the target then interrupt it after a delay
-            if (gdb_continue(sock) < 0) {
-                TRACE_ERROR("Failed to continue target execution\n");
-                close(sock);
-                return -1;
-            }
-            
-            return sock;
-        }
+    TRACE_INFO("Connected to GDB server at %s:%d\n", addr->host, addr->port);
+
+    // Drain any pending packets (like unsolicited stop replies)
+    // This handles cases where GDB sends S02 (SIGINT) at connection time
+    gdb_drain_pending_packets(sock);
 
-        close(sock);
+    // Send continue command to start/resume the target
+    // When gdbserver starts a process, it stops at entry point
+    // We need to continue it so the program can run and initialize
+    // gdb_continue() will run the target then interrupt it after a delay
+    if (gdb_continue(sock) < 0) {
+        TRACE_ERROR("Failed to continue target execution\n");
+        backend_socket_close(sock);
+        return -1;
     }
 
-    freeaddrinfo(res);
-    TRACE_ERROR("Failed to connect to GDB server at %s:%s\n", addr->host, port_str);
-    return -1;
+    return sock;
 }
 
 /**
@@ -308,7 +282,7 @@ int gdb_connect(const backend_addr_t *addr)
  */
 int gdb_disconnect(int socket)
 {
-    close(socket);
+    backend_socket_close(socket);
     TRACE_INFO("Disconnected from GDB server\n");
     return 0;
 }
@@ -0,0 +1,549 @@
+#include "heap.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define HEAP_INITIAL_BLOCKS         1024    /* must be a power of 2 */
+#define HEAP_INITIAL_SITES          256     /* must be a power of 2 */
+
+/**
+ * @brief Outstanding allocation
+ */
+typedef struct
+{
+    uint64_t        ptr;            //!< Pointer (0 - empty slot)
+    uint64_t        size;           //!< Requested size
+    uint64_t        timestamp_us;   //!< Time of the allocation
+    uint32_t        site;           //!< Index of the call site
+} heap_block_t;
+
+/**
+ * @brief Statistics of a single call site
+ */
+typedef struct
+{
+    uint64_t        caller;         //!< Address the allocation returned to
+    uint64_t        bytes;          //!< Outstanding bytes
+    uint64_t        blocks;         //!< Outstanding blocks
+    uint64_t        peak_bytes;     //!< Maximum of bytes
+    uint64_t        allocs;         //!< Number of allocations
+    uint64_t        failed;         //!< Number of failed allocations
+    uint64_t        leak_bytes;     //!< Suspected leaks (computed for the report)
+    uint64_t        leak_blocks;
+    uint64_t        oldest_us;      //!< Age of the oldest suspected leak
+} heap_site_t;
+
+struct heap_profile
+{
+    char            report_path[1024];
+    symbols_t*      symbols;
+    uint64_t        leak_age_us;
+    heap_block_t*   blocks;         //!< Open addressing table of outstanding blocks
+    size_t          block_capacity;
+    size_t          block_count;
+    heap_site_t*    sites;
+    size_t          site_count;
+    size_t          site_capacity;
+    uint32_t*       site_table;     //!< Open addressing table of site indices + 1
+    size_t          site_table_capacity;
+    uint64_t        bytes;
+    uint64_t        peak_bytes;
+    uint64_t        allocs;
+    uint64_t        frees;
+    uint64_t        failed_allocs;
+    uint64_t        unknown_frees;  //!< Frees of blocks allocated before tracing (or lost events)
+    uint64_t        now_us;         //!< Latest event time
+    bool            dirty;
+    time_t          last_report;
+};
+
+static uint64_t hash_u64(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+static uint64_t host_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/**
+ * @brief Find the slot of a block in the block table
+ *
+ * @param profile Heap profile
+ * @param ptr Pointer of the block
+ * @return size_t Slot of the block, or the empty slot where it belongs
+ */
+static size_t find_block(const heap_profile_t* profile, uint64_t ptr)
+{
+    size_t mask = profile->block_capacity - 1;
+    size_t slot = hash_u64(ptr) & mask;
+    while(profile->blocks[slot].ptr != 0 && profile->blocks[slot].ptr != ptr)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static bool grow_blocks(heap_profile_t* profile)
+{
+    size_t old_capacity = profile->block_capacity;
+    heap_block_t* old_blocks = profile->blocks;
+    size_t new_capacity = old_capacity ? old_capacity * 2 : HEAP_INITIAL_BLOCKS;
+    heap_block_t* blocks = calloc(new_capacity, sizeof(heap_block_t));
+    if(blocks == NULL)
+    {
+        TRACE_ERROR("Failed to allocate heap block table\n");
+        return false;
+    }
+    profile->blocks = blocks;
+    profile->block_capacity = new_capacity;
+    for(size_t i = 0; i < old_capacity; i++)
+    {
+        if(old_blocks[i].ptr != 0)
+        {
+            profile->blocks[find_block(profile, old_blocks[i].ptr)] = old_blocks[i];
+        }
+    }
+    free(old_blocks);
+    return true;
+}
+
+/**
+ * @brief Remove a block from the block table (backward shift deletion)
+ *
+ * @param profile Heap profile
+ * @param slot Slot of the block
+ */
+static void remove_block(heap_profile_t* profile, size_t slot)
+{
+    size_t mask = profile->block_capacity - 1;
+    size_t next = (slot + 1) & mask;
+    while(profile->blocks[next].ptr != 0)
+    {
+        size_t home = hash_u64(profile->blocks[next].ptr) & mask;
+        // Move the block back if its home slot is not between the hole and its slot
+        if(((next - home) & mask) >= ((next - slot) & mask))
+        {
+            profile->blocks[slot] = profile->blocks[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    profile->blocks[slot].ptr = 0;
+    profile->block_count--;
+}
+
+/**
+ * @brief Get the call site of an allocation, adding it if it is new
+ *
+ * @param profile Heap profile
+ * @param caller Caller address
+ * @return heap_site_t* Call site, NULL if memory could not be allocated
+ */
+static heap_site_t* get_site(heap_profile_t* profile, uint64_t caller)
+{
+    if((profile->site_count + 1) * 2 > profile->site_table_capacity)
+    {
+        size_t new_capacity = profile->site_table_capacity ? profile->site_table_capacity * 2 : HEAP_INITIAL_SITES;
+        uint32_t* table = calloc(new_capacity, sizeof(uint32_t));
+        if(table == NULL)
+        {
+            TRACE_ERROR("Failed to allocate heap call site table\n");
+            return NULL;
+        }
+        for(size_t i = 0; i < profile->site_count; i++)
+        {
+            size_t slot = hash_u64(profile->sites[i].caller) & (new_capacity - 1);
+            while(table[slot] != 0)
+            {
+                slot = (slot + 1) & (new_capacity - 1);
+            }
+            table[slot] = (uint32_t)i + 1;
+        }
+        free(profile->site_table);
+        profile->site_table = table;
+        profile->site_table_capacity = new_capacity;
+    }
+
+    size_t mask = profile->site_table_capacity - 1;
+    size_t slot = hash_u64(caller) & mask;
+    while(profile->site_table[slot] != 0)
+    {
+        heap_site_t* site = &profile->sites[profile->site_table[slot] - 1];
+        if(site->caller == caller)
+        {
+            return site;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if(profile->site_count == profile->site_capacity)
+    {
+        size_t new_capacity = profile->site_capacity ? profile->site_capacity * 2 : HEAP_INITIAL_SITES;
+        heap_site_t* sites = realloc(profile->sites, new_capacity * sizeof(heap_site_t));
+        if(sites == NULL)
+        {
+            TRACE_ERROR("Failed to allocate heap call sites\n");
+            return NULL;
+        }
+        profile->sites = sites;
+        profile->site_capacity = new_capacity;
+    }
+    heap_site_t* site = &profile->sites[profile->site_count++];
+    memset(site, 0, sizeof(*site));
+    site->caller = caller;
+    profile->site_table[slot] = (uint32_t)profile->site_count;
+    return site;
+}
+
+/**
+ * @brief Update the current time of the profile
+ *
+ * @param profile Heap profile
+ * @param timestamp_us Time of the event from the target, 0 if the target has no clock
+ * @return uint64_t Time of the event
+ */
+static uint64_t event_time(heap_profile_t* profile, uint64_t timestamp_us)
+{
+    if(timestamp_us == 0)
+    {
+        timestamp_us = host_time_us();
+    }
+    if(timestamp_us > profile->now_us)
+    {
+        profile->now_us = timestamp_us;
+    }
+    profile->dirty = true;
+    return timestamp_us;
+}
+
+/**
+ * @brief Create a heap profile
+ *
+ * @param report_path File to write the report to
+ * @param symbols Optional symbols used to name call sites
+ * @param leak_age Seconds after which an outstanding block is reported as a suspected leak
+ * @return heap_profile_t* Heap profile, NULL on failure
+ */
+heap_profile_t* heap_profile_open(const char* report_path, symbols_t* symbols, uint32_t leak_age)
+{
+    heap_profile_t* profile = calloc(1, sizeof(heap_profile_t));
+    if(profile == NULL)
+    {
+        TRACE_ERROR("Failed to allocate heap profile\n");
+        return NULL;
+    }
+    if(strlen(report_path) >= sizeof(profile->report_path) || !grow_blocks(profile))
+    {
+        TRACE_ERROR("Failed to create heap profile: %s\n", report_path);
+        free(profile);
+        return NULL;
+    }
+    strcpy(profile->report_path, report_path);
+    profile->symbols = symbols;
+    profile->leak_age_us = (uint64_t)(leak_age ? leak_age : HEAP_DEFAULT_LEAK_AGE) * 1000000u;
+    profile->dirty = true;
+    return profile;
+}
+
+/**
+ * @brief Write the final report and free the heap profile
+ *
+ * @param profile Heap profile (may be NULL)
+ */
+void heap_profile_close(heap_profile_t* profile)
+{
+    if(profile)
+    {
+        heap_profile_checkpoint(profile, true);
+        free(profile->blocks);
+        free(profile->sites);
+        free(profile->site_table);
+        free(profile);
+    }
+}
+
+/**
+ * @brief Add an allocation event
+ *
+ * @param profile Heap profile
+ * @param ptr Allocated pointer (0 - failed allocation)
+ * @param size Requested size
+ * @param caller Caller address
+ * @param timestamp_us Time of the event (0 - unknown)
+ */
+void heap_profile_alloc(heap_profile_t* profile, uint64_t ptr, uint64_t size, uint64_t caller, uint64_t timestamp_us)
+{
+    uint64_t now = event_time(profile, timestamp_us);
+    heap_site_t* site = get_site(profile, caller);
+    if(site == NULL)
+    {
+        return;
+    }
+    profile->allocs++;
+    site->allocs++;
+    if(ptr == 0)
+    {
+        profile->failed_allocs++;
+        site->failed++;
+        return;
+    }
+
+    if((profile->block_count + 1) * 2 > profile->block_capacity && !grow_blocks(profile))
+    {
+        return;
+    }
+    size_t slot = find_block(profile, ptr);
+    heap_block_t* block = &profile->blocks[slot];
+    if(block->ptr != 0)
+    {
+        // The free of the previous block at this address was lost - drop it
+        heap_profile_free(profile, ptr, timestamp_us);
+        profile->frees--;
+        slot = find_block(profile, ptr);
+        block = &profile->blocks[slot];
+        site = get_site(profile, caller);
+    }
+    block->ptr = ptr;
+    block->size = size;
+    block->timestamp_us = now;
+    block->site = (uint32_t)(site - profile->sites);
+    profile->block_count++;
+
+    site->bytes += size;
+    site->blocks++;
+    if(site->bytes > site->peak_bytes)
+    {
+        site->peak_bytes = site->bytes;
+    }
+    profile->bytes += size;
+    if(profile->bytes > profile->peak_bytes)
+    {
+        profile->peak_bytes = profile->bytes;
+    }
+}
+
+/**
+ * @brief Add a free event
+ *
+ * @param profile Heap profile
+ * @param ptr Freed pointer
+ * @param timestamp_us Time of the event (0 - unknown)
+ */
+void heap_profile_free(heap_profile_t* profile, uint64_t ptr, uint64_t timestamp_us)
+{
+    event_time(profile, timestamp_us);
+    profile->frees++;
+    size_t slot = find_block(profile, ptr);
+    heap_block_t* block = &profile->blocks[slot];
+    if(block->ptr == 0)
+    {
+        profile->unknown_frees++;
+        return;
+    }
+    heap_site_t* site = &profile->sites[block->site];
+    site->bytes -= block->size;
+    site->blocks--;
+    profile->bytes -= block->size;
+    remove_block(profile, slot);
+}
+
+static int compare_blocks_by_address(const void* a, const void* b)
+{
+    const heap_block_t* block_a = a;
+    const heap_block_t* block_b = b;
+    return block_a->ptr < block_b->ptr ? -1 : (block_a->ptr > block_b->ptr ? 1 : 0);
+}
+
+static int compare_sites_by_bytes(const void* a, const void* b)
+{
+    const heap_site_t* site_a = *(const heap_site_t* const*)a;
+    const heap_site_t* site_b = *(const heap_site_t* const*)b;
+    return site_a->bytes < site_b->bytes ? 1 : (site_a->bytes > site_b->bytes ? -1 : 0);
+}
+
+static int compare_sites_by_leaks(const void* a, const void* b)
+{
+    const heap_site_t* site_a = *(const heap_site_t* const*)a;
+    const heap_site_t* site_b = *(const heap_site_t* const*)b;
+    return site_a->leak_bytes < site_b->leak_bytes ? 1 : (site_a->leak_bytes > site_b->leak_bytes ? -1 : 0);
+}
+
+static void print_site(heap_profile_t* profile, FILE* out, uint64_t caller)
+{
+    const char* location = symbols_lookup(profile->symbols, caller, true);
+    fprintf(out, "0x%08" PRIx64 "%s%s\n", caller, location ? " " : "", location ? location : "");
+}
+
+/**
+ * @brief Print the heap report
+ *
+ * @param profile Heap profile
+ * @param out Output stream
+ */
+void heap_profile_report(heap_profile_t* profile, FILE* out)
+{
+    // Sorted copy of the outstanding blocks for the fragmentation estimate
+    heap_block_t* live = malloc((profile->block_count ? profile->block_count : 1) * sizeof(heap_block_t));
+    heap_site_t** sites = malloc((profile->site_count ? profile->site_count : 1) * sizeof(heap_site_t*));
+    if(live == NULL || sites == NULL)
+    {
+        TRACE_ERROR("Failed to allocate heap report\n");
+        free(live);
+        free(sites);
+        return;
+    }
+    for(size_t i = 0; i < profile->site_count; i++)
+    {
+        sites[i] = &profile->sites[i];
+        sites[i]->leak_bytes = 0;
+        sites[i]->leak_blocks = 0;
+        sites[i]->oldest_us = 0;
+    }
+    size_t live_count = 0;
+    for(size_t i = 0; i < profile->block_capacity; i++)
+    {
+        const heap_block_t* block = &profile->blocks[i];
+        if(block->ptr == 0)
+        {
+            continue;
+        }
+        live[live_count++] = *block;
+        uint64_t age = profile->now_us > block->timestamp_us ? profile->now_us - block->timestamp_us : 0;
+        if(age >= profile->leak_age_us)
+        {
+            heap_site_t* site = &profile->sites[block->site];
+            site->leak_bytes += block->size;
+            site->leak_blocks++;
+            if(age > site->oldest_us)
+            {
+                site->oldest_us = age;
+            }
+        }
+    }
+    qsort(live, live_count, sizeof(heap_block_t), compare_blocks_by_address);
+
+    uint64_t hole_bytes = 0;
+    uint64_t hole_count = 0;
+    uint64_t largest_hole = 0;
+    for(size_t i = 1; i < live_count; i++)
+    {
+        uint64_t end = live[i - 1].ptr + live[i - 1].size;
+        if(live[i].ptr > end && live[i].ptr - end >= HEAP_MIN_HOLE_SIZE)
+        {
+            uint64_t hole = live[i].ptr - end;
+            hole_bytes += hole;
+            hole_count++;
+            if(hole > largest_hole)
+            {
+                largest_hole = hole;
+            }
+        }
+    }
+
+    time_t now = time(NULL);
+    char time_text[32];
+    strftime(time_text, sizeof(time_text), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    fprintf(out, "Heap profile (updated %s)\n", time_text);
+    fprintf(out, "  Events:        %" PRIu64 " allocs, %" PRIu64 " frees, %" PRIu64 " failed allocs, %" PRIu64 " frees of untracked blocks\n",
+            profile->allocs, profile->frees, profile->failed_allocs, profile->unknown_frees);
+    fprintf(out, "  Outstanding:   %zu blocks, %" PRIu64 " bytes (peak %" PRIu64 " bytes)\n",
+            live_count, profile->bytes, profile->peak_bytes);
+    if(live_count > 0)
+    {
+        uint64_t start = live[0].ptr;
+        uint64_t end = live[live_count - 1].ptr + live[live_count - 1].size;
+        fprintf(out, "  Fragmentation: blocks span 0x%08" PRIx64 "-0x%08" PRIx64 " (%" PRIu64 " bytes), %" PRIu64 " bytes free in %" PRIu64 " holes",
+                start, end, end - start, hole_bytes, hole_count);
+        if(hole_bytes > 0)
+        {
+            fprintf(out, ", largest %" PRIu64 " bytes (%.1f%% fragmented)", largest_hole,
+                    100.0 * (double)(hole_bytes - largest_hole) / (double)hole_bytes);
+        }
+        fprintf(out, "\n");
+    }
+
+    qsort(sites, profile->site_count, sizeof(heap_site_t*), compare_sites_by_bytes);
+    fprintf(out, "\nOutstanding bytes by call site:\n");
+    fprintf(out, "%12s %8s %10s %12s %8s  %s\n", "bytes", "blocks", "allocs", "peak", "failed", "call site");
+    for(size_t i = 0; i < profile->site_count && i < HEAP_REPORT_MAX_SITES; i++)
+    {
+        const heap_site_t* site = sites[i];
+        if(site->bytes == 0 && site->failed == 0)
+        {
+            break;
+        }
+        fprintf(out, "%12" PRIu64 " %8" PRIu64 " %10" PRIu64 " %12" PRIu64 " %8" PRIu64 "  ",
+                site->bytes, site->blocks, site->allocs, site->peak_bytes, site->failed);
+        print_site(profile, out, site->caller);
+    }
+
+    qsort(sites, profile->site_count, sizeof(heap_site_t*), compare_sites_by_leaks);
+    fprintf(out, "\nSuspected leaks (outstanding for more than %" PRIu64 " s):\n", profile->leak_age_us / 1000000u);
+    if(profile->site_count == 0 || sites[0]->leak_bytes == 0)
+    {
+        fprintf(out, "  none\n");
+    }
+    else
+    {
+        fprintf(out, "%12s %8s %10s  %s\n", "bytes", "blocks", "oldest", "call site");
+    }
+    for(size_t i = 0; i < profile->site_count && i < HEAP_REPORT_MAX_SITES && sites[i]->leak_bytes > 0; i++)
+    {
+        const heap_site_t* site = sites[i];
+        fprintf(out, "%12" PRIu64 " %8" PRIu64 " %9" PRIu64 "s  ", site->leak_bytes, site->leak_blocks, site->oldest_us / 1000000u);
+        print_site(profile, out, site->caller);
+    }
+
+    free(live);
+    free(sites);
+}
+
+/**
+ * @brief Rewrite the report file if the profile changed
+ *
+ * @param profile Heap profile (may be NULL)
+ * @param force Write even if the report interval has not elapsed
+ * @return true on success, false on failure
+ */
+bool heap_profile_checkpoint(heap_profile_t* profile, bool force)
+{
+    if(profile == NULL || !profile->dirty)
+    {
+        return true;
+    }
+    time_t now = time(NULL);
+    if(!force && now - profile->last_report < HEAP_REPORT_INTERVAL)
+    {
+        return true;
+    }
+
+    // Write a temporary file and rename it, so readers never see a partial report
+    char temp_path[sizeof(profile->report_path) + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", profile->report_path);
+    FILE* file = fopen(temp_path, "w");
+    if(file == NULL)
+    {
+        TRACE_ERROR("Failed to write heap report: %s\n", temp_path);
+        return false;
+    }
+    heap_profile_report(profile, file);
+    if(fclose(file) != 0 || rename(temp_path, profile->report_path) != 0)
+    {
+        TRACE_ERROR("Failed to write heap report: %s\n", profile->report_path);
+        return false;
+    }
+    profile->dirty = false;
+    profile->last_report = now;
+    return true;
+}
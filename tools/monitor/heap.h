@@ -0,0 +1,35 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "symbols.h"
+
+/**
+ * @file heap.h
+ * @brief Live heap profile built from the heap trace records of the firmware.
+ *
+ * Every allocation is tracked until it is freed, so the profile knows the
+ * outstanding bytes of each call site, how the live blocks are spread over
+ * the heap and which blocks have been outstanding for a long time. The
+ * report is rewritten periodically, so it can be watched while the target
+ * is running (e.g. `watch cat heap.txt`).
+ */
+
+#define HEAP_DEFAULT_LEAK_AGE       30      /* seconds */
+#define HEAP_REPORT_INTERVAL        2       /* seconds */
+#define HEAP_REPORT_MAX_SITES       20
+#define HEAP_MIN_HOLE_SIZE          32      /* smaller gaps are allocator overhead */
+
+typedef struct heap_profile heap_profile_t;
+
+heap_profile_t* heap_profile_open(const char* report_path, symbols_t* symbols, uint32_t leak_age);
+void heap_profile_close(heap_profile_t* profile);
+void heap_profile_alloc(heap_profile_t* profile, uint64_t ptr, uint64_t size, uint64_t caller, uint64_t timestamp_us);
+void heap_profile_free(heap_profile_t* profile, uint64_t ptr, uint64_t timestamp_us);
+bool heap_profile_checkpoint(heap_profile_t* profile, bool force);
+void heap_profile_report(heap_profile_t* profile, FILE* out);
+
+#endif // HEAP_H
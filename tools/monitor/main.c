@@ -11,6 +11,9 @@
 #   define DMLOG_VERSION "unknown"
 #endif
 
+/* Monitor the signal handler releases the firmware of */
+static monitor_ctx_t* g_monitor = NULL;
+
 /**
  * @brief Signal handler for graceful shutdown
  */
@@ -19,6 +22,11 @@ static void signal_handler(int signum)
     (void)signum;
     // Restore terminal settings immediately
     monitor_restore_terminal();
+    // Best effort - do not leave the firmware waiting for a monitor that is gone
+    if(g_monitor != NULL && g_monitor->flow_control)
+    {
+        monitor_set_flow_control(g_monitor, false);
+    }
     exit(0);
 }
 
@@ -28,7 +36,7 @@ void usage(const char *progname)
     printf("Options:\n");
     printf("  --help        Show this help message\n");
     printf("  --version     Show version information\n");
-    printf("  --host        Backend IP address (default: localhost)\n");
+    printf("  --host        Backend IP address, unix:PATH or exec:COMMAND (default: localhost)\n");
     printf("  --port        Backend port (default: 4444)\n");
     printf("  --addr        Address of the ring buffer\n");
     printf("  --search      Search for the ring buffer in memory\n");
@@ -38,8 +46,23 @@ void usage(const char *progname)
     printf("  --blocking    Use blocking mode for reading log entries\n");
     printf("  --snapshot    Enable snapshot mode to reduce target reads\n");
     printf("  --gdb         Use GDB backend instead of OpenOCD\n");
+    printf("  --exporter    Use dmlog_exporter backend (Linux process, default port: 4455)\n");
     printf("  --input-file  File to read input from for automated testing\n");
     printf("  --init-script File to read as initialization script, then switch to stdin\n");
+    printf("  --archive     Directory to archive and index received logs in (see dmlog_query)\n");
+    printf("  --archive-segment-size Size of a single archive segment in MiB (default: 16)\n");
+    printf("  --no-prefetch Send input only when the firmware requests it (no type-ahead)\n");
+    printf("  --no-compression Send the files received by the firmware uncompressed\n");
+    printf("  --flow-control Make the firmware wait for the monitor instead of overwriting unread logs\n");
+    printf("  --no-flow-control Let the firmware overwrite logs the monitor has not read (default)\n");
+    printf("  --elf         Firmware ELF file used to symbolize logged addresses and backtraces\n");
+    printf("  --heap-profile File to write the live heap profile to (needs heap tracing in the firmware)\n");
+    printf("  --heap-leak-age Seconds after which an outstanding block is a suspected leak (default: 30)\n");
+    printf("  --overhead    Write a report of the logging overhead of each firmware module to FILE\n");
+    printf("  --watch       Comma separated variables to sample (name[:type] or address:type, see README)\n");
+    printf("  --watch-interval Sampling interval of the watched variables in ms (default: 100)\n");
+    printf("  --watch-output File to write the samples to (default: stdout)\n");
+    printf("  --watch-format Format of the samples: csv or line (InfluxDB line protocol, default: csv)\n");
 }
 
 int main(int argc, char *argv[])
@@ -49,6 +72,19 @@ int main(int argc, char *argv[])
     bool snapshot_mode = false;
     const char *input_file_path = NULL;
     bool init_script_mode = false;
+    const char *archive_path = NULL;
+    uint32_t archive_segment_size = 0;
+    bool prefetch_input = true;
+    bool compress_files = true;
+    bool flow_control = false;
+    const char *elf_path = NULL;
+    const char *heap_profile_path = NULL;
+    uint32_t heap_leak_age = 0;
+    const char *overhead_path = NULL;
+    const char *watch_list = NULL;
+    uint32_t watch_interval = 0;
+    const char *watch_output_path = NULL;
+    watch_format_t watch_format = WATCH_FORMAT_CSV;
     uint32_t ring_buffer_address = 0x20010000; // Default address
     backend_addr_t backend_addr;
     const backend_addr_t* default_addr = backend_default_addrs[BACKEND_TYPE_OPENOCD];
@@ -68,7 +104,13 @@ int main(int argc, char *argv[])
         }
         else if(strcmp(argv[i], "--host") == 0 && i + 1 < argc)
         {
-            strncpy(backend_addr.host, argv[++i], sizeof(backend_addr.host));
+            const char *host = argv[++i];
+            if(strlen(host) >= sizeof(backend_addr.host))
+            {
+                TRACE_ERROR("Host too long (max %zu characters): %s\n", sizeof(backend_addr.host) - 1, host);
+                return 1;
+            }
+            strcpy(backend_addr.host, host);
         }
         else if(strcmp(argv[i], "--port") == 0 && i + 1 < argc)
         {
@@ -129,6 +171,63 @@ int main(int argc, char *argv[])
             input_file_path = argv[++i];
             init_script_mode = true;
         }
+        else if(strcmp(argv[i], "--archive") == 0 && i + 1 < argc)
+        {
+            archive_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--archive-segment-size") == 0 && i + 1 < argc)
+        {
+            archive_segment_size = (uint32_t)strtoul(argv[++i], NULL, 0) * 1024u * 1024u;
+        }
+        else if(strcmp(argv[i], "--no-prefetch") == 0)
+        {
+            prefetch_input = false;
+        }
+        else if(strcmp(argv[i], "--no-compression") == 0)
+        {
+            compress_files = false;
+        }
+        else if(strcmp(argv[i], "--flow-control") == 0 || strcmp(argv[i], "--no-flow-control") == 0)
+        {
+            flow_control = strcmp(argv[i], "--flow-control") == 0;
+        }
+        else if(strcmp(argv[i], "--elf") == 0 && i + 1 < argc)
+        {
+            elf_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--heap-profile") == 0 && i + 1 < argc)
+        {
+            heap_profile_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--heap-leak-age") == 0 && i + 1 < argc)
+        {
+            heap_leak_age = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if(strcmp(argv[i], "--overhead") == 0 && i + 1 < argc)
+        {
+            overhead_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--watch") == 0 && i + 1 < argc)
+        {
+            watch_list = argv[++i];
+        }
+        else if(strcmp(argv[i], "--watch-interval") == 0 && i + 1 < argc)
+        {
+            watch_interval = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if(strcmp(argv[i], "--watch-output") == 0 && i + 1 < argc)
+        {
+            watch_output_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--watch-format") == 0 && i + 1 < argc)
+        {
+            if(!watch_parse_format(argv[++i], &watch_format))
+            {
+                TRACE_ERROR("Invalid watch format: %s\n", argv[i]);
+                usage(argv[0]);
+                return 1;
+            }
+        }
         else if(strcmp(argv[i], "--gdb") == 0)
         {
             const backend_addr_t* gdb_default = backend_default_addrs[BACKEND_TYPE_GDB];
@@ -148,6 +247,20 @@ int main(int argc, char *argv[])
             backend_addr.type = BACKEND_TYPE_GDB;
             default_addr = gdb_default;
         }
+        else if(strcmp(argv[i], "--exporter") == 0)
+        {
+            const backend_addr_t* exporter_default = backend_default_addrs[BACKEND_TYPE_EXPORTER];
+            if(backend_addr.port == default_addr->port)
+            {
+                backend_addr.port = exporter_default->port;
+            }
+            if(strcmp(backend_addr.host, default_addr->host) == 0)
+            {
+                strncpy(backend_addr.host, exporter_default->host, sizeof(backend_addr.host));
+            }
+            backend_addr.type = BACKEND_TYPE_EXPORTER;
+            default_addr = exporter_default;
+        }
         else
         {
             TRACE_ERROR("Unknown option: %s\n", argv[i]);
@@ -190,7 +303,87 @@ int main(int argc, char *argv[])
         }
     }
 
+    ctx->prefetch_input = prefetch_input;
+    ctx->compress_files = compress_files;
+
+    // Always written - a monitor that is gone may have left the flow control on
+    if(!monitor_set_flow_control(ctx, flow_control))
+    {
+        TRACE_ERROR("Failed to set up flow control\n");
+        monitor_disconnect(ctx);
+        return 1;
+    }
+    if(prefetch_input)
+    {
+        // Unbuffered stdin, so poll() sees all input that was typed ahead
+        setvbuf(stdin, NULL, _IONBF, 0);
+    }
+
+    // Open log archive if specified
+    if(archive_path != NULL)
+    {
+        ctx->archive = archive_open(archive_path, archive_segment_size);
+        if(ctx->archive == NULL)
+        {
+            TRACE_ERROR("Failed to open archive: %s\n", archive_path);
+            monitor_disconnect(ctx);
+            return 1;
+        }
+        TRACE_INFO("Archiving logs to: %s\n", archive_path);
+    }
+
+    // Load firmware symbols if specified
+    if(elf_path != NULL)
+    {
+        ctx->symbols = symbols_load(elf_path);
+        if(ctx->symbols == NULL)
+        {
+            TRACE_ERROR("Failed to load symbols from: %s\n", elf_path);
+            monitor_disconnect(ctx);
+            return 1;
+        }
+    }
+    records_init(&ctx->records, ctx->symbols);
+    ctx->records.tags = ctx->tags;
+
+    // Create heap profile if specified
+    if(heap_profile_path != NULL)
+    {
+        ctx->heap = heap_profile_open(heap_profile_path, ctx->symbols, heap_leak_age);
+        if(ctx->heap == NULL)
+        {
+            monitor_disconnect(ctx);
+            return 1;
+        }
+        ctx->records.heap = ctx->heap;
+        TRACE_INFO("Writing heap profile to: %s\n", heap_profile_path);
+    }
+
+    // Report the logging overhead if specified
+    if(overhead_path != NULL)
+    {
+        ctx->overhead = overhead_open(overhead_path);
+        if(ctx->overhead == NULL)
+        {
+            monitor_disconnect(ctx);
+            return 1;
+        }
+        TRACE_INFO("Writing logging overhead report to: %s\n", overhead_path);
+    }
+
+    // Start sampling variables if specified
+    if(watch_list != NULL)
+    {
+        ctx->watch = watch_open(watch_list, ctx->symbols, watch_output_path, watch_format, watch_interval);
+        if(ctx->watch == NULL)
+        {
+            monitor_disconnect(ctx);
+            return 1;
+        }
+    }
+
     // Register signal handlers for graceful shutdown
+    g_monitor = ctx;
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
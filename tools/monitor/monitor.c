@@ -3,12 +3,15 @@
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
+#include <inttypes.h>
 #include "monitor.h"
 #include "trace.h"
 #include "gdb.h"
+#include "compression.h"
 #include <termios.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 
 /**
  * @brief Restore terminal to normal settings (echo on, line mode on, blocking)
@@ -109,7 +112,31 @@ static bool is_buffer_empty(monitor_ctx_t* ctx)
 }
 
 /**
- * @brief Read data from the dmlog ring buffer, handling wrap-around
+ * @brief Get the target address of the contiguous part of the output ring at an offset
+ * 
+ * @param ctx Pointer to the monitor context
+ * @param offset Offset in the output ring
+ * @param length Pointer to store the number of contiguous bytes from the offset
+ * @return uint64_t Target address of the offset
+ */
+static uint64_t get_ring_span(monitor_ctx_t* ctx, dmlog_index_t offset, dmlog_index_t* length)
+{
+    if(ctx->segment_count == 0)
+    {
+        *length = ctx->ring.buffer_size - offset;
+        return ctx->ring.buffer + offset;
+    }
+    uint32_t i = 0;
+    while(i + 1 < ctx->segment_count && offset - ctx->segments[i].offset >= ctx->segments[i].size)
+    {
+        i++;
+    }
+    *length = ctx->segments[i].size - (offset - ctx->segments[i].offset);
+    return ctx->segments[i].address + (offset - ctx->segments[i].offset);
+}
+
+/**
+ * @brief Read data from the dmlog ring buffer, handling wrap-around and segments
  * 
  * @param ctx Pointer to the monitor context
  * @param dst Destination buffer to store read data
@@ -125,38 +152,258 @@ static bool read_from_buffer(monitor_ctx_t* ctx, void* dst, size_t length)
         return false;
     }
     length = length > available_data ? available_data : length;
-    uint32_t left_size = ctx->ring.buffer_size - ctx->tail_offset;
-    if(length <= left_size)
+    for(size_t done = 0; done < length; )
     {
-        uint32_t address = (uint32_t)((uintptr_t)ctx->ring.buffer) + ctx->tail_offset;
-        if(backend_read_memory(ctx->backend_type, ctx->socket, address, dst, length) < 0)
+        dmlog_index_t span;
+        uint64_t address = get_ring_span(ctx, ctx->tail_offset, &span);
+        size_t chunk = length - done < span ? length - done : span;
+        if(backend_read_memory(ctx->backend_type, ctx->socket, address, (uint8_t*)dst + done, chunk) < 0)
         {
-            TRACE_ERROR("Failed to read %zu bytes from buffer at offset %u\n", length, ctx->tail_offset);
+            TRACE_ERROR("Failed to read %zu bytes from buffer at offset %u\n", chunk, ctx->tail_offset);
             return false;
         }
-        ctx->tail_offset = (ctx->tail_offset + length) % ctx->ring.buffer_size;
+        done += chunk;
+        ctx->tail_offset = (ctx->tail_offset + chunk) % ctx->ring.buffer_size;
     }
-    else
+    return true;
+}
+
+/**
+ * @brief Read the segment table of a segmented output ring from the target
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return true on success, false on failure
+ */
+static bool load_segments(monitor_ctx_t* ctx)
+{
+    uint32_t segment_count = ctx->ring.segment_count;
+    if(segment_count > MONITOR_MAX_SEGMENTS)
     {
-        // Read in two parts due to wrap-around
-        uint32_t address = (uint32_t)((uintptr_t)ctx->ring.buffer) + ctx->tail_offset;
-        if(backend_read_memory(ctx->backend_type, ctx->socket, address, dst, left_size) < 0)
-        {
-            TRACE_ERROR("Failed to read %u bytes from buffer at offset %u\n", left_size, ctx->tail_offset);
-            return false;
-        }
-        size_t remaining = length - left_size;
-        address = (uint32_t)((uintptr_t)ctx->ring.buffer);
-        if(backend_read_memory(ctx->backend_type, ctx->socket, address, (uint8_t*)dst + left_size, remaining) < 0)
+        TRACE_ERROR("Too many ring segments: %u (max %d)\n", segment_count, MONITOR_MAX_SEGMENTS);
+        return false;
+    }
+    if(segment_count > 0 && backend_read_memory(ctx->backend_type, ctx->socket, ctx->ring.segments, ctx->segments, segment_count * sizeof(dmlog_segment_t)) < 0)
+    {
+        TRACE_ERROR("Failed to read ring segments from target at 0x%08" PRIx64 "\n", (uint64_t)ctx->ring.segments);
+        return false;
+    }
+    dmlog_index_t offset = 0;
+    for(uint32_t i = 0; i < segment_count; i++)
+    {
+        if(ctx->segments[i].offset != offset || ctx->segments[i].size == 0)
         {
-            TRACE_ERROR("Failed to read %zu bytes from buffer at offset 0\n", remaining);
+            TRACE_ERROR("Invalid ring segment %u at offset %u\n", i, ctx->segments[i].offset);
             return false;
         }
-        ctx->tail_offset = remaining;
+        TRACE_VERBOSE("Ring segment %u: 0x%08" PRIx64 ", %u bytes\n", i, (uint64_t)ctx->segments[i].address, ctx->segments[i].size);
+        offset += ctx->segments[i].size;
+    }
+    if(segment_count > 0 && offset != ctx->ring.buffer_size)
+    {
+        TRACE_ERROR("Ring segments cover %u bytes, the ring has %u\n", offset, ctx->ring.buffer_size);
+        return false;
+    }
+    ctx->segment_count = segment_count;
+    ctx->segments_address = ctx->ring.segments;
+    return true;
+}
+
+/**
+ * @brief Read the control block of the host from the target
+ * 
+ * The monitor is the only writer of the block, so it is read only when the
+ * target creates its ring - afterwards the local copy is up to date.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return true on success, false on failure
+ */
+static bool load_host_block(monitor_ctx_t* ctx)
+{
+    if(ctx->ring.host == 0)
+    {
+        TRACE_ERROR("The ring has no host control block - the firmware uses an older dmlog\n");
+        return false;
+    }
+    if(backend_read_memory(ctx->backend_type, ctx->socket, ctx->ring.host, &ctx->host, sizeof(dmlog_host_t)) < 0)
+    {
+        TRACE_ERROR("Failed to read the host control block from target at 0x%08" PRIx64 "\n", (uint64_t)ctx->ring.host);
+        return false;
+    }
+    ctx->host_address = ctx->ring.host;
+    return true;
+}
+
+/**
+ * @brief Write a field of the control block of the host to the target
+ * 
+ * The firmware never writes the block - the monitor does not have to wait
+ * until the ring is not busy.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @param offset Offset of the field in dmlog_host_t
+ * @param size Size of the field
+ * @return true on success, false on failure
+ */
+static bool write_host_field(monitor_ctx_t* ctx, size_t offset, size_t size)
+{
+    if(backend_write_memory(ctx->backend_type, ctx->socket, ctx->host_address + offset, (const uint8_t*)&ctx->host + offset, size) < 0)
+    {
+        TRACE_ERROR("Failed to write the host control block at offset %zu\n", offset);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Turn the flow control on again after the firmware timed out waiting
+ * 
+ * The firmware sets DMLOG_FLAG_FLOW_CONTROL_LOST when the monitor did not
+ * read the ring in time, and clears it once it saw the monitor drop
+ * DMLOG_FLAG_FLOW_CONTROL. Only then the flag is set again.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return true on success, false on failure
+ */
+static bool restore_flow_control(monitor_ctx_t* ctx)
+{
+    bool lost = (ctx->ring.flags & DMLOG_FLAG_FLOW_CONTROL_LOST) != 0;
+    if(lost && !ctx->flow_control_lost)
+    {
+        TRACE_WARN("The firmware timed out waiting for the monitor - logs may have been overwritten\n");
+        ctx->flow_control_lost = true;
+        ctx->host.flags &= ~DMLOG_FLAG_FLOW_CONTROL;
+        return write_host_field(ctx, offsetof(dmlog_host_t, flags), sizeof(uint32_t));
+    }
+    if(!lost && ctx->flow_control_lost)
+    {
+        ctx->flow_control_lost = false;
+        ctx->host.tail_offset = ctx->tail_offset;
+        ctx->host.flags |= DMLOG_FLAG_FLOW_CONTROL;
+        TRACE_VERBOSE("Flow control restored\n");
+        return write_host_field(ctx, offsetof(dmlog_host_t, tail_offset), sizeof(dmlog_index_t)) &&
+               write_host_field(ctx, offsetof(dmlog_host_t, flags), sizeof(uint32_t));
     }
     return true;
 }
 
+/**
+ * @brief Publish the read position of the monitor to the firmware
+ * 
+ * Only needed with flow control - otherwise the firmware does not wait for
+ * the monitor.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return true on success, false on failure
+ */
+static bool publish_tail(monitor_ctx_t* ctx)
+{
+    if(!ctx->flow_control)
+    {
+        return true;
+    }
+    if(!restore_flow_control(ctx))
+    {
+        return false;
+    }
+    if(ctx->flow_control_lost || ctx->host.tail_offset == ctx->tail_offset)
+    {
+        return true;
+    }
+    ctx->host.tail_offset = ctx->tail_offset;
+    return write_host_field(ctx, offsetof(dmlog_host_t, tail_offset), sizeof(dmlog_index_t));
+}
+
+/**
+ * @brief Check whether the firmware waits for input
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return true if input was requested and the request was not serviced yet
+ */
+static bool is_input_requested(monitor_ctx_t* ctx)
+{
+    return (ctx->ring.flags & DMLOG_FLAG_INPUT_REQUESTED) != 0 && ctx->ring.input_request != ctx->host.input_serviced;
+}
+
+/**
+ * @brief Check whether the firmware waits for a file transfer chunk
+ * 
+ * @param ctx Pointer to the monitor context
+ * @param flags DMLOG_FLAG_FILE_SEND_REQ and/or DMLOG_FLAG_FILE_RECV_REQ
+ * @return true if one of the requests is set and was not serviced yet
+ */
+static bool is_file_requested(monitor_ctx_t* ctx, uint32_t flags)
+{
+    return (ctx->ring.flags & flags) != 0 && ctx->ring.file_request != ctx->host.file_serviced;
+}
+
+/**
+ * @brief Ask the backend to push the changes of the ring header and the output ring
+ * 
+ * Backends that can watch memory (the exporter) then serve the reads of the
+ * ring from a local copy. The ranges are set up again when the target
+ * creates its ring at a different place.
+ * 
+ * @param ctx Pointer to the monitor context
+ */
+static void watch_ring(monitor_ctx_t* ctx)
+{
+    if(ctx->snapshot_mode || (ctx->ring_watched && ctx->watched_buffer == ctx->ring.buffer))
+    {
+        return;
+    }
+    ctx->ring_watched = true;
+    ctx->watched_buffer = ctx->ring.buffer;
+
+    // Drop the ranges of a previous ring, this also fails if the backend cannot watch memory
+    if(backend_watch_memory(ctx->backend_type, ctx->socket, 0, 0) < 0)
+    {
+        return;
+    }
+    // The header is watched first, so the output ring in a sample is never older than the header
+    bool watched = backend_watch_memory(ctx->backend_type, ctx->socket, ctx->ring_address, sizeof(dmlog_ring_t)) == 0;
+    if(ctx->segment_count == 0)
+    {
+        watched = watched && backend_watch_memory(ctx->backend_type, ctx->socket, ctx->ring.buffer, ctx->ring.buffer_size) == 0;
+    }
+    for(uint32_t i = 0; i < ctx->segment_count && watched; i++)
+    {
+        watched = backend_watch_memory(ctx->backend_type, ctx->socket, ctx->segments[i].address, ctx->segments[i].size) == 0;
+    }
+    if(!watched)
+    {
+        TRACE_WARN("Failed to watch the ring - reading it on demand\n");
+        backend_watch_memory(ctx->backend_type, ctx->socket, 0, 0);
+        return;
+    }
+    TRACE_INFO("Receiving ring changes pushed by the backend\n");
+}
+
+/**
+ * @brief Get the free space in the target input buffer from the cached ring
+ * 
+ * The firmware only moves the input tail forward, so the cached value is a
+ * lower bound of the real free space.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return dmlog_index_t Number of bytes that can be written to the input buffer
+ */
+static dmlog_index_t get_input_free_space(monitor_ctx_t *ctx)
+{
+    dmlog_index_t input_head = ctx->host.input_head_offset;
+    dmlog_index_t input_tail = ctx->ring.input_tail_offset;
+    dmlog_index_t input_size = ctx->ring.input_buffer_size;
+    dmlog_index_t free_space;
+    if(input_head >= input_tail)
+    {
+        free_space = input_size - (input_head - input_tail);
+    }
+    else
+    {
+        free_space = input_tail - input_head;
+    }
+    return free_space > 0 ? free_space - 1 : 0; // Leave one byte empty
+}
+
 /**
  * @brief Connect to the monitor via backend and initialize context
  * 
@@ -182,6 +429,13 @@ monitor_ctx_t *monitor_connect(backend_addr_t *addr, uint32_t ring_address, bool
         free(ctx);
         return NULL;
     }
+    ctx->tags = tags_open(ctx->backend_type, ctx->socket);
+    ctx->batch = batch_open(ctx->backend_type, ctx->socket);
+    if(ctx->tags == NULL || ctx->batch == NULL)
+    {
+        monitor_disconnect(ctx);
+        return NULL;
+    }
 
     ctx->ring_address  = ring_address;
     ctx->snapshot_mode = snapshot_mode;
@@ -191,6 +445,12 @@ monitor_ctx_t *monitor_connect(backend_addr_t *addr, uint32_t ring_address, bool
         monitor_disconnect(ctx);
         return NULL;
     }
+    if(snapshot_mode && ctx->segment_count > 0)
+    {
+        TRACE_ERROR("Snapshot mode does not support segmented rings - use live mode\n");
+        monitor_disconnect(ctx);
+        return NULL;
+    }
     if(snapshot_mode)
     {
         ctx->snapshot_size = dmlog_get_required_size(ctx->ring.buffer_size);
@@ -211,11 +471,43 @@ monitor_ctx_t *monitor_connect(backend_addr_t *addr, uint32_t ring_address, bool
     ctx->tail_offset = ctx->ring.tail_offset;
     ctx->input_file = NULL;  // No input file by default
     ctx->init_script_mode = false;  // No init script mode by default
+    ctx->prefetch_input = true;  // Push type-ahead input by default
+    ctx->compress_files = true;  // Compress the files received by the firmware if it can decode them
 
     TRACE_INFO("Connected to dmlog ring buffer at 0x%08X\n", ring_address);
     return ctx;
 }
 
+/**
+ * @brief Get the address of the logging overhead table published by the target
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return uint64_t Address of the table, 0 if accounting is disabled
+ */
+static uint64_t monitor_get_overhead_address(monitor_ctx_t *ctx)
+{
+    if(ctx->snapshot_mode)
+    {
+        return ctx->dmlog_ctx != NULL ? ((dmlog_ring_t*)ctx->dmlog_ctx)->overhead : 0;
+    }
+    return ctx->ring.overhead;
+}
+
+/**
+ * @brief Get the address of the tag dictionary published by the target
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return uint64_t Address of the dictionary, 0 if it is not enabled
+ */
+static uint64_t monitor_get_tags_address(monitor_ctx_t *ctx)
+{
+    if(ctx->snapshot_mode)
+    {
+        return ctx->dmlog_ctx != NULL ? ((dmlog_ring_t*)ctx->dmlog_ctx)->tags : 0;
+    }
+    return ctx->ring.tags;
+}
+
 /**
  * @brief Disconnect from the monitor and free resources
  * 
@@ -229,6 +521,20 @@ void monitor_disconnect(monitor_ctx_t *ctx)
         {
             fclose(ctx->input_file);
         }
+        archive_close(ctx->archive);
+        heap_profile_close(ctx->heap);
+        watch_close(ctx->watch);
+        overhead_checkpoint(ctx->overhead, ctx->backend_type, ctx->socket, monitor_get_overhead_address(ctx), true);
+        overhead_close(ctx->overhead);
+        records_deinit(&ctx->records);
+        tags_close(ctx->tags);
+        batch_close(ctx->batch);
+        symbols_free(ctx->symbols);
+        if(ctx->flow_control)
+        {
+            monitor_set_flow_control(ctx, false);
+        }
+        backend_report_round_trips();
         backend_disconnect(ctx->backend_type, ctx->socket);
         free(ctx);
         TRACE_INFO("Disconnected from monitor\n");
@@ -249,11 +555,26 @@ bool monitor_update_ring(monitor_ctx_t *ctx)
         TRACE_ERROR("Failed to read dmlog ring buffer from target\n");
         return false;
     }
+    if(ctx->ring.magic == DMLOG_MAGIC_NUMBER_V1)
+    {
+        // The host block does not exist there - writing to the old header would corrupt it
+        TRACE_ERROR("The firmware uses the version 1 dmlog ring header - update dmlog in the firmware or use an older monitor\n");
+        return false;
+    }
     if(ctx->ring.magic != DMLOG_MAGIC_NUMBER)
     {
         TRACE_ERROR("Invalid dmlog ring buffer magic number: 0x%08X != 0x%08X\n", ctx->ring.magic, DMLOG_MAGIC_NUMBER);
         return false;
     }
+    if((ctx->ring.segment_count != ctx->segment_count || ctx->ring.segments != ctx->segments_address) && !load_segments(ctx))
+    {
+        return false;
+    }
+    if(ctx->ring.host != ctx->host_address && !load_host_block(ctx))
+    {
+        return false;
+    }
+    watch_ring(ctx);
     dmlog_index_t number_of_new_bytes = ctx->ring.head_offset >= previous_head ?
     ctx->ring.head_offset - previous_head :
     ctx->ring.buffer_size - (previous_head - ctx->ring.head_offset);
@@ -316,6 +637,7 @@ bool monitor_wait_for_new_data(monitor_ctx_t *ctx)
     while(empty)
     {
         usleep(10000);
+        watch_poll(ctx->watch, ctx->backend_type, ctx->socket);
         if(!monitor_update_ring(ctx))
         {
             TRACE_ERROR("monitor_update_ring failed in wait_for_new_data\n");
@@ -323,16 +645,21 @@ bool monitor_wait_for_new_data(monitor_ctx_t *ctx)
         }
         // Check if firmware requested input - return early to handle it
         // This prevents deadlock when firmware requests input without producing output
-        if(ctx->ring.flags & DMLOG_FLAG_INPUT_REQUESTED)
+        if(is_input_requested(ctx))
         {
             TRACE_VERBOSE("Input requested (flags=0x%08X), returning from wait\n", ctx->ring.flags);
             return true;
         }
-        if(ctx->ring.flags & (DMLOG_FLAG_FILE_SEND_REQ | DMLOG_FLAG_FILE_SEND_REQ) )
+        if(is_file_requested(ctx, DMLOG_FLAG_FILE_SEND_REQ | DMLOG_FLAG_FILE_RECV_REQ))
         {
             TRACE_VERBOSE("File transfer requested (flags=0x%08X), returning from wait\n", ctx->ring.flags);
             return true;
         }
+        // Push input typed ahead while the firmware is busy without output
+        if(!monitor_prefetch_input(ctx))
+        {
+            return false;
+        }
         empty = is_buffer_empty(ctx);
 
         // For GDB backend, briefly resume target so firmware can process the input
@@ -377,6 +704,10 @@ bool monitor_update_entry(monitor_ctx_t *ctx, bool blocking_mode)
         TRACE_ERROR("Failed to read dmlog entry data from target\n");
         return false;
     }
+    if(!publish_tail(ctx))
+    {
+        return false;
+    }
 
     if(blocking_mode && !monitor_send_not_busy_command(ctx))
     {
@@ -442,8 +773,13 @@ bool monitor_load_snapshot(monitor_ctx_t *ctx, bool blocking_mode)
         return false;
     }
 
+    // The snapshot is read locally - drop the locks held on the target
     dmlog_ring_t* ring = (void*)ctx->dmlog_ctx;
     ring->flags = 0;
+    if(ring->host > ctx->ring_address && ring->host - ctx->ring_address + sizeof(dmlog_host_t) <= ctx->snapshot_size)
+    {
+        ((dmlog_host_t*)((uint8_t*)ctx->dmlog_ctx + (ring->host - ctx->ring_address)))->flags = 0;
+    }
     TRACE_VERBOSE("Dmlog Snapshot: head_offset=%u, tail_offset=%u, buffer_size=%x\n",
         ring->head_offset,
         ring->tail_offset,
@@ -453,6 +789,65 @@ bool monitor_load_snapshot(monitor_ctx_t *ctx, bool blocking_mode)
     return true;
 }
 
+/**
+ * @brief Print a log entry and append it to the archive
+ * 
+ * Binary records in the entry are replaced with formatted (and symbolized)
+ * addresses and tags first.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @param entry_data Entry received from the target
+ * @param show_timestamps Whether to show timestamps with log entries
+ */
+static void output_entry(monitor_ctx_t *ctx, const char* entry_data, bool show_timestamps)
+{
+    tags_set_address(ctx->tags, monitor_get_tags_address(ctx));
+    entry_data = records_format(&ctx->records, entry_data, strlen(entry_data));
+    if(entry_data[0] == '\0')
+    {
+        return; // Only heap trace records
+    }
+    if(show_timestamps)
+    {
+        time_t now = time(NULL);
+        struct tm *local_time = localtime(&now);
+        printf("[%02d:%02d:%02d] %s", 
+               local_time->tm_hour, 
+               local_time->tm_min, 
+               local_time->tm_sec, 
+               entry_data);
+    }
+    else
+    {
+        printf("%s", entry_data);
+    }
+    fflush(stdout);  // Ensure output is written immediately
+    if(ctx->archive)
+    {
+        archive_write(ctx->archive, entry_data, strlen(entry_data));
+    }
+}
+
+/**
+ * @brief Sleep while sampling the watched variables on time
+ * 
+ * @param ctx Pointer to the monitor context
+ * @param usec Time to sleep in microseconds
+ */
+static void monitor_sleep(monitor_ctx_t *ctx, useconds_t usec)
+{
+    if(ctx->watch == NULL)
+    {
+        usleep(usec);
+        return;
+    }
+    for(useconds_t slept = 0; slept < usec; slept += MONITOR_WATCH_POLL_INTERVAL)
+    {
+        watch_poll(ctx->watch, ctx->backend_type, ctx->socket);
+        usleep(usec - slept < MONITOR_WATCH_POLL_INTERVAL ? usec - slept : MONITOR_WATCH_POLL_INTERVAL);
+    }
+}
+
 /**
  * @brief Run the monitor loop (not implemented)
  * 
@@ -469,28 +864,19 @@ void monitor_run(monitor_ctx_t *ctx, bool show_timestamps, bool blocking_mode)
         {
             while(dmlog_read_next(ctx->dmlog_ctx))
             {
-                const char* entry_data = dmlog_get_ref_buffer(ctx->dmlog_ctx);
-                if(show_timestamps)
-                {
-                    time_t now = time(NULL);
-                    struct tm *local_time = localtime(&now);
-                    printf("[%02d:%02d:%02d] %s", 
-                           local_time->tm_hour, 
-                           local_time->tm_min, 
-                           local_time->tm_sec, 
-                           entry_data);
-                }
-                else
-                {
-                    printf("%s", entry_data);
-                }
-                fflush(stdout);  // Ensure output is written immediately
+                output_entry(ctx, dmlog_get_ref_buffer(ctx->dmlog_ctx), show_timestamps);
             }
             
             // Check for input request from firmware (after printing all output)
-            monitor_handle_input_request(ctx);
+            if(!monitor_handle_input_request(ctx))
+            {
+                monitor_prefetch_input(ctx);
+            }
+            archive_checkpoint(ctx->archive, false);
+            heap_profile_checkpoint(ctx->heap, false);
+            overhead_checkpoint(ctx->overhead, ctx->backend_type, ctx->socket, monitor_get_overhead_address(ctx), false);
             
-            usleep(300000); 
+            monitor_sleep(ctx, 300000); 
         }
         TRACE_INFO("Exiting snapshot monitoring loop\n");
     }
@@ -518,57 +904,52 @@ void monitor_run(monitor_ctx_t *ctx, bool show_timestamps, bool blocking_mode)
                 {
                     continue;
                 }
-                if(show_timestamps)
-                {
-                    time_t now = time(NULL);
-                    struct tm *local_time = localtime(&now);
-                    printf("[%02d:%02d:%02d] %s", 
-                           local_time->tm_hour, 
-                           local_time->tm_min, 
-                           local_time->tm_sec, 
-                           entry_data);
-                }
-                else
-                {
-                    printf("%s", entry_data);
-                }
-                fflush(stdout);  // Ensure output is written immediately
+                output_entry(ctx, entry_data, show_timestamps);
             }
             
             // Check for input request from firmware (after printing all output)
-            bool input_requested = (ctx->ring.flags & DMLOG_FLAG_INPUT_REQUESTED) != 0;
+            bool input_requested = is_input_requested(ctx);
             if(input_requested && !monitor_handle_input_request(ctx))
             {
                 TRACE_ERROR("Failed to handle input request\n");
                 return; // exit on EOF
             }
+            if(!input_requested && !monitor_prefetch_input(ctx))
+            {
+                TRACE_ERROR("Failed to prefetch input\n");
+                return; // exit on failure
+            }
 
-            bool send_file_requested = (ctx->ring.flags & DMLOG_FLAG_FILE_SEND_REQ) != 0;
+            bool send_file_requested = is_file_requested(ctx, DMLOG_FLAG_FILE_SEND_REQ);
             if(send_file_requested && !monitor_handle_send_file_request(ctx))
             {
                 TRACE_ERROR("Failed to handle file send request\n");
                 return; // exit on failure
             }
-            bool receive_file_requested = (ctx->ring.flags & DMLOG_FLAG_FILE_RECV_REQ) != 0;
+            bool receive_file_requested = is_file_requested(ctx, DMLOG_FLAG_FILE_RECV_REQ);
             if(receive_file_requested && !monitor_handle_receive_file_request(ctx))
             {
                 TRACE_ERROR("Failed to handle file receive request\n");
                 return; // exit on failure
             }
 
+            archive_checkpoint(ctx->archive, false);
+            heap_profile_checkpoint(ctx->heap, false);
+            overhead_checkpoint(ctx->overhead, ctx->backend_type, ctx->socket, monitor_get_overhead_address(ctx), false);
+
             if(ctx->ring.flags & DMLOG_FLAG_EXIT_REQUESTED)
             {
                 TRACE_VERBOSE("Exit requested (flags=0x%08X), returning from wait\n", ctx->ring.flags);
                 return;
             }
 
-            usleep(100000); // Sleep briefly to allow data to accumulate
+            monitor_sleep(ctx, 100000); // Sleep briefly to allow data to accumulate
         }
     }
 }
 
 /**
- * @brief Write flags to the dmlog ring buffer on the target
+ * @brief Write the flags of the host control block on the target
  * 
  * @param ctx Pointer to the monitor context
  * @param flags Flags to write
@@ -582,9 +963,10 @@ bool monitor_write_flags(monitor_ctx_t *ctx, uint32_t flags)
         return false;
     }
 
-    if(backend_write_memory(ctx->backend_type, ctx->socket, ctx->ring_address + offsetof(dmlog_ring_t, flags), &flags, sizeof(uint32_t)) < 0)
+    ctx->host.flags = flags;
+    if(!write_host_field(ctx, offsetof(dmlog_host_t, flags), sizeof(uint32_t)))
     {
-        TRACE_ERROR("Failed to write dmlog ring buffer flags to target\n");
+        TRACE_ERROR("Failed to write dmlog host flags to target\n");
         return false;
     }
 
@@ -593,8 +975,7 @@ bool monitor_write_flags(monitor_ctx_t *ctx, uint32_t flags)
         TRACE_ERROR("Failed to update dmlog ring buffer after writing flags\n");
         return false;
     }
-
-    return ctx->ring.flags == flags;
+    return true;
 }
 
 /**
@@ -606,7 +987,8 @@ bool monitor_write_flags(monitor_ctx_t *ctx, uint32_t flags)
 bool monitor_send_clear_command(monitor_ctx_t *ctx)
 {
     TRACE_INFO("Sending clear command to dmlog ring buffer\n");
-    if(!monitor_write_flags(ctx, ctx->ring.flags | DMLOG_FLAG_CLEAR_BUFFER))
+    ctx->host.clear_request++;
+    if(!write_host_field(ctx, offsetof(dmlog_host_t, clear_request), sizeof(uint32_t)))
     {
         TRACE_ERROR("Failed to send clear command to dmlog ring buffer\n");
         return false;
@@ -614,7 +996,7 @@ bool monitor_send_clear_command(monitor_ctx_t *ctx)
 
     TRACE_INFO("Waiting for clear command to be processed\n");
 
-    while(ctx->ring.flags & DMLOG_FLAG_CLEAR_BUFFER || (ctx->ring.tail_offset != 0))
+    while(ctx->ring.clear_count != ctx->host.clear_request || (ctx->ring.tail_offset != 0))
     {
         if(!monitor_update_ring(ctx))
         {
@@ -626,6 +1008,44 @@ bool monitor_send_clear_command(monitor_ctx_t *ctx)
 
     TRACE_INFO("Clear command processed successfully\n");
 
+    ctx->tail_offset = ctx->ring.tail_offset;
+    return publish_tail(ctx);
+}
+
+/**
+ * @brief Make the firmware wait for the monitor instead of overwriting unread entries
+ * 
+ * Backends that do not stop the target cannot keep up with a firmware that
+ * logs faster than the ring is sampled. With flow control the firmware waits
+ * in the logging call until the monitor has read the ring. The monitor
+ * releases the firmware when it disconnects, and a firmware left waiting by
+ * a monitor that is gone gives up after DMLOG_FLOW_CONTROL_TIMEOUT.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @param enable Whether the firmware should wait for the monitor
+ * @return true on success, false on failure
+ */
+bool monitor_set_flow_control(monitor_ctx_t *ctx, bool enable)
+{
+    if(enable && ctx->snapshot_mode)
+    {
+        TRACE_WARN("Flow control is not supported in snapshot mode\n");
+        return true;
+    }
+    // The read position must be valid before the firmware starts to use it
+    ctx->host.tail_offset = ctx->tail_offset;
+    if(enable && !write_host_field(ctx, offsetof(dmlog_host_t, tail_offset), sizeof(dmlog_index_t)))
+    {
+        return false;
+    }
+    ctx->flow_control = enable;
+    ctx->flow_control_lost = false;
+    ctx->host.flags = enable ? ctx->host.flags | DMLOG_FLAG_FLOW_CONTROL : ctx->host.flags & ~DMLOG_FLAG_FLOW_CONTROL;
+    if(!write_host_field(ctx, offsetof(dmlog_host_t, flags), sizeof(uint32_t)))
+    {
+        return false;
+    }
+    TRACE_VERBOSE("Flow control %s\n", enable ? "enabled" : "disabled");
     return true;
 }
 
@@ -638,7 +1058,7 @@ bool monitor_send_clear_command(monitor_ctx_t *ctx)
 bool monitor_send_busy_command(monitor_ctx_t *ctx)
 {
     TRACE_INFO("Sending busy command to dmlog ring buffer\n");
-    if( !monitor_write_flags(ctx, ctx->ring.flags | DMLOG_FLAG_BUSY) )
+    if( !monitor_write_flags(ctx, ctx->host.flags | DMLOG_FLAG_BUSY) )
     {
         TRACE_ERROR("Failed to send busy command to dmlog ring buffer\n");
         return false;
@@ -659,7 +1079,7 @@ bool monitor_send_busy_command(monitor_ctx_t *ctx)
 bool monitor_send_not_busy_command(monitor_ctx_t *ctx)
 {
     TRACE_INFO("Sending not busy command to dmlog ring buffer\n");
-    if(!monitor_write_flags(ctx, ctx->ring.flags & ~DMLOG_FLAG_BUSY) )
+    if(!monitor_write_flags(ctx, ctx->host.flags & ~DMLOG_FLAG_BUSY) )
     {
         TRACE_ERROR("Failed to send not busy command to dmlog ring buffer\n");
         return false;
@@ -690,7 +1110,7 @@ bool monitor_synchronize(monitor_ctx_t *ctx)
     TRACE_INFO("Searching for valid dmlog entry to synchronize tail offset\n");
     
     ctx->tail_offset    = ctx->ring.tail_offset;
-    return true;
+    return publish_tail(ctx);
 }
 
 /**
@@ -710,8 +1130,8 @@ bool monitor_send_input(monitor_ctx_t *ctx, const char* input, size_t length)
     }
 
     // Note: Do NOT wait for not-busy here! The firmware is intentionally
-    // holding the BUSY flag while waiting for input. We need to write
-    // directly to memory even while the firmware has the lock.
+    // holding the BUSY flag while waiting for input. The input buffer and
+    // the host control block are never written by the firmware.
 
     // Update ring to get current state
     if(!monitor_update_ring(ctx))
@@ -721,20 +1141,9 @@ bool monitor_send_input(monitor_ctx_t *ctx, const char* input, size_t length)
     }
 
     // Check available space in input buffer
-    dmlog_index_t input_head = ctx->ring.input_head_offset;
-    dmlog_index_t input_tail = ctx->ring.input_tail_offset;
+    dmlog_index_t input_head = ctx->host.input_head_offset;
     dmlog_index_t input_size = ctx->ring.input_buffer_size;
-    
-    dmlog_index_t free_space;
-    if(input_head >= input_tail)
-    {
-        free_space = input_size - (input_head - input_tail);
-    }
-    else
-    {
-        free_space = input_tail - input_head;
-    }
-    free_space = free_space > 0 ? free_space - 1 : 0; // Leave one byte empty
+    dmlog_index_t free_space = get_input_free_space(ctx);
     
     if(length > free_space)
     {
@@ -772,25 +1181,14 @@ bool monitor_send_input(monitor_ctx_t *ctx, const char* input, size_t length)
         input_head = remaining_bytes;  // New head position after wrap
     }
 
-    // Update input_head_offset in the ring structure
-    uint32_t head_offset_addr = ctx->ring_address + offsetof(dmlog_ring_t, input_head_offset);
-    if(backend_write_memory(ctx->backend_type, ctx->socket, head_offset_addr, &input_head, sizeof(dmlog_index_t)) < 0)
+    // Publish the input by moving the head after the data
+    ctx->host.input_head_offset = input_head;
+    if(!write_host_field(ctx, offsetof(dmlog_host_t, input_head_offset), sizeof(dmlog_index_t)))
     {
         TRACE_ERROR("Failed to update input_head_offset\n");
         return false;
     }
 
-    // Set INPUT_AVAILABLE flag (write directly without waiting for not-busy)
-    uint32_t new_flags = ctx->ring.flags | DMLOG_FLAG_INPUT_AVAILABLE;
-    if(backend_write_memory(ctx->backend_type, ctx->socket, ctx->ring_address + offsetof(dmlog_ring_t, flags), &new_flags, sizeof(uint32_t)) < 0)
-    {
-        TRACE_ERROR("Failed to set INPUT_AVAILABLE flag\n");
-        return false;
-    }
-
-    // Update local cache
-    ctx->ring.flags = new_flags;
-
     // For GDB backend, briefly resume target so firmware can process the input
     if(ctx->backend_type == BACKEND_TYPE_GDB)
     {
@@ -806,89 +1204,94 @@ bool monitor_send_input(monitor_ctx_t *ctx, const char* input, size_t length)
 }
 
 /**
- * @brief Check for input request from firmware and prompt user
+ * @brief Check if the input source has data that can be read without blocking
  * 
  * @param ctx Pointer to the monitor context
- * @return true if input was handled, false otherwise
+ * @return true if reading will not block, false otherwise
  */
-bool monitor_handle_input_request(monitor_ctx_t *ctx)
+static bool is_input_ready(monitor_ctx_t *ctx)
 {
-    // Check if firmware requested input
-    if(!(ctx->ring.flags & DMLOG_FLAG_INPUT_REQUESTED))
+    if(ctx->input_file)
     {
-        return false;
+        return true; // Regular files never block
     }
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLIN | POLLHUP)) != 0;
+}
 
-    // Read input from file or stdin (no prompt, firmware should print its own prompt)
-    char input_buffer[512];
-    bool echo_on = (ctx->ring.flags & DMLOG_FLAG_INPUT_ECHO_OFF) == 0;
-    bool line_mode = (ctx->ring.flags & DMLOG_FLAG_INPUT_LINE_MODE) != 0;
-    
-    // Configure terminal according to firmware's requested flags
-    configure_input_mode(echo_on, line_mode);
-    
-    // Read input, potentially switching from init script to stdin
-    while(true)
+/**
+ * @brief Read input from the input file or stdin into the pending input buffer
+ * 
+ * Switches from the init script to stdin when the script ends. When the input
+ * source ends or fails, ctx->input_eof is set.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @param blocking true to wait for input, false to only read input that is ready
+ * @return true if data was read, false otherwise
+ */
+static bool read_pending_input(monitor_ctx_t *ctx, bool blocking)
+{
+    while(!ctx->input_eof)
     {
-        FILE* input_source = ctx->input_file ? ctx->input_file : stdin;
-        if(line_mode || ctx->input_file)
+        size_t space = sizeof(ctx->pending_input) - ctx->pending_input_length;
+        if(space <= 1)
         {
-            if(fgets(input_buffer, sizeof(input_buffer), input_source) != NULL)
-            {
-                // Successfully read input
-                break;
-            }
+            return false; // Pending buffer is full
         }
-        else 
+        if(!blocking && !is_input_ready(ctx))
         {
-            while(fgets(input_buffer, sizeof(input_buffer), input_source) == NULL);
-            break;
+            return false;
         }
-        
+
+        FILE* input_source = ctx->input_file ? ctx->input_file : stdin;
+        char* destination = &ctx->pending_input[ctx->pending_input_length];
+        if(fgets(destination, space, input_source) != NULL)
+        {
+            ctx->pending_input_length += strlen(destination);
+            return true;
+        }
+
         // Failed to read - check why
         if(ctx->input_file)
         {
             // Reading from input file failed - check if EOF or error
-            if(feof(ctx->input_file))
+            if(feof(ctx->input_file) && ctx->init_script_mode)
             {
-                // Reached EOF on input file
-                if(ctx->init_script_mode)
-                {
-                    // Init script completed - switch to stdin
-                    TRACE_INFO("Init script completed, switching to stdin\n");
-                    if(fclose(ctx->input_file) != 0)
-                    {
-                        TRACE_WARN("Failed to close init script file\n");
-                    }
-                    ctx->input_file = NULL;
-                    // Loop will retry with stdin
-                    continue;
-                }
-                else
+                // Init script completed - switch to stdin
+                TRACE_INFO("Init script completed, switching to stdin\n");
+                if(fclose(ctx->input_file) != 0)
                 {
-                    // Normal input file mode - exit on EOF
-                    TRACE_ERROR("Input file ended\n");
-                    if(fclose(ctx->input_file) != 0)
-                    {
-                        TRACE_WARN("Failed to close input file\n");
-                    }
-                    ctx->input_file = NULL;
-                    configure_input_mode(true, true); // Restore terminal settings
-                    return false;
+                    TRACE_WARN("Failed to close init script file\n");
                 }
+                ctx->input_file = NULL;
+                // Loop will retry with stdin
+                continue;
+            }
+            if(feof(ctx->input_file))
+            {
+                // Normal input file mode - exit once the firmware asks for more
+                TRACE_INFO("Input file ended\n");
             }
             else
             {
-                // I/O error on input file
                 TRACE_ERROR("Failed to read from input file (I/O error)\n");
-                if(fclose(ctx->input_file) != 0)
-                {
-                    TRACE_WARN("Failed to close input file\n");
-                }
-                ctx->input_file = NULL;
-                configure_input_mode(true, true); // Restore terminal settings
+            }
+            if(fclose(ctx->input_file) != 0)
+            {
+                TRACE_WARN("Failed to close input file\n");
+            }
+            ctx->input_file = NULL;
+            ctx->input_eof = true;
+        }
+        else if(ferror(stdin) && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            // Character mode uses non-blocking stdin - nothing typed yet
+            clearerr(stdin);
+            if(!blocking)
+            {
                 return false;
             }
+            usleep(1000);
         }
         // Reading from stdin failed - check if error first, then EOF
         else if(ferror(stdin))
@@ -907,60 +1310,200 @@ bool monitor_handle_input_request(monitor_ctx_t *ctx)
                 TRACE_ERROR("  - stdin is NOT connected to a terminal (pipe/redirect?)\n");
             }
             perror("  - System error: ");
-            configure_input_mode(true, true); // Restore terminal settings
-            return false;
+            ctx->input_eof = true;
         }
         else if(feof(stdin))
         {
             // stdin reached EOF
             TRACE_INFO("stdin reached EOF (Ctrl+D or pipe closed)\n");
-            configure_input_mode(true, true); // Restore terminal settings
-            return false;
+            ctx->input_eof = true;
         }
         // Other error - this should not happen in normal blocking mode
         // Continue trying to read
     }
-    
-    // Send input to firmware
-    size_t input_len = strlen(input_buffer);
-    if(!monitor_send_input(ctx, input_buffer, input_len))
+    return false;
+}
+
+/**
+ * @brief Send pending input to the free space of the target input buffer
+ * 
+ * In line mode a line that can never be sent whole - one longer than the empty
+ * input buffer or the pending buffer, or the last line of the input without a
+ * newline - is sent as far as it fits.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @param line_mode true to send only complete lines
+ * @return true on success (also when nothing could be sent), false on failure
+ */
+static bool send_pending_input(monitor_ctx_t *ctx, bool line_mode)
+{
+    size_t length = ctx->pending_input_length;
+    dmlog_index_t free_space = get_input_free_space(ctx);
+    if(length > free_space)
+    {
+        length = free_space;
+    }
+    if(line_mode)
+    {
+        size_t fitting = length;
+        while(length > 0 && ctx->pending_input[length - 1] != '\n')
+        {
+            length--;
+        }
+        bool too_long = free_space + 1 >= ctx->ring.input_buffer_size && ctx->pending_input_length > free_space;
+        bool pending_full = ctx->pending_input_length + 1 >= sizeof(ctx->pending_input);
+        if(length == 0 && (too_long || pending_full || ctx->input_eof))
+        {
+            length = fitting;
+        }
+    }
+    if(length == 0)
+    {
+        return true;
+    }
+
+    if(!monitor_send_input(ctx, ctx->pending_input, length))
+    {
+        return false;
+    }
+
+    ctx->pending_input_length -= length;
+    memmove(ctx->pending_input, &ctx->pending_input[length], ctx->pending_input_length);
+    return true;
+}
+
+/**
+ * @brief Tell the firmware that its input request was serviced
+ * 
+ * The firmware clears INPUT_REQUESTED the next time it locks the ring.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return true on success, false on failure
+ */
+static bool clear_input_request(monitor_ctx_t *ctx)
+{
+    ctx->host.input_serviced = ctx->ring.input_request;
+    if(!write_host_field(ctx, offsetof(dmlog_host_t, input_serviced), sizeof(uint32_t)))
+    {
+        TRACE_ERROR("Failed to acknowledge the input request\n");
+        return false;
+    }
+
+    // Update local cache
+    ctx->ring.flags &= ~DMLOG_FLAG_INPUT_REQUESTED;
+    return true;
+}
+
+/**
+ * @brief Check for input request from firmware and prompt user
+ * 
+ * With input prefetch enabled, input typed ahead may already be waiting in the
+ * target input buffer - the request is then acknowledged without reading more.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return true if input was handled, false otherwise
+ */
+bool monitor_handle_input_request(monitor_ctx_t *ctx)
+{
+    // Check if firmware requested input
+    if(!is_input_requested(ctx))
+    {
+        return false;
+    }
+
+    // Read input from file or stdin (no prompt, firmware should print its own prompt)
+    bool echo_on = (ctx->ring.flags & DMLOG_FLAG_INPUT_ECHO_OFF) == 0;
+    bool line_mode = (ctx->ring.flags & DMLOG_FLAG_INPUT_LINE_MODE) != 0;
+
+    // Configure terminal according to firmware's requested flags
+    configure_input_mode(echo_on, line_mode);
+    ctx->input_mode_known = true;
+    ctx->input_line_mode = line_mode;
+
+    bool input_waiting = false;
+    if(ctx->prefetch_input)
+    {
+        if(!send_pending_input(ctx, line_mode))
+        {
+            TRACE_ERROR("Failed to send input to firmware\n");
+            configure_input_mode(true, true); // Restore terminal settings before error return
+            return false;
+        }
+        input_waiting = ctx->host.input_head_offset != ctx->ring.input_tail_offset;
+    }
+
+    if(!input_waiting)
+    {
+        // Nothing typed ahead - wait for the input
+        if(ctx->pending_input_length == 0 && !read_pending_input(ctx, true))
+        {
+            configure_input_mode(true, true); // Restore terminal settings
+            return false;
+        }
+
+        // Send input to firmware, as much as its input buffer takes
+        if(!send_pending_input(ctx, line_mode))
+        {
+            TRACE_ERROR("Failed to send input to firmware\n");
+            configure_input_mode(true, true); // Restore terminal settings before error return
+            return false;
+        }
+    }
+
+    if(!clear_input_request(ctx))
     {
-        TRACE_ERROR("Failed to send input to firmware\n");
         configure_input_mode(true, true); // Restore terminal settings before error return
         return false;
     }
 
-    // Clear the INPUT_REQUESTED flag (write directly without waiting for not-busy)
-    uint32_t new_flags = ctx->ring.flags & ~DMLOG_FLAG_INPUT_REQUESTED;
-    if(backend_write_memory(ctx->backend_type, ctx->socket, ctx->ring_address + offsetof(dmlog_ring_t, flags), &new_flags, sizeof(uint32_t)) < 0)
+    // Top up with input typed ahead, so the next request finds it waiting
+    if(!monitor_prefetch_input(ctx))
     {
-        TRACE_ERROR("Failed to clear INPUT_REQUESTED flag\n");
         configure_input_mode(true, true); // Restore terminal settings before error return
         return false;
     }
 
-    // Update local cache
-    ctx->ring.flags = new_flags;
-    
     // Note: Terminal settings are NOT restored here. They will be reconfigured on the next
     // input request based on the firmware's flags. This prevents a race condition where
     // terminal echo is enabled between character-by-character reads, causing duplicate echoing.
     // Terminal settings will be restored to normal (echo on, line mode on) when monitor exits
     // or when firmware requests input with echo enabled.
 
-    // Return true to continue monitoring, false to exit
-    // Exit conditions:
-    // 1. Using --input-file (not init-script) and file has ended
-    // 2. stdin EOF was handled above (returns false immediately)
-    // Continue monitoring in all other cases:
-    // - Using --init-script (ctx->input_file may be NULL after switching to stdin)
-    // - Reading from stdin directly (no input file specified)
-    if(ctx->input_file && !ctx->init_script_mode)
+    // Continue monitoring - the end of the input is reported when the firmware
+    // asks for more input than the source provided
+    return true;
+}
+
+/**
+ * @brief Push input typed ahead into the target input buffer
+ * 
+ * Reads the input that is available without blocking and writes it into the
+ * free space of the target input buffer, so the firmware finds it waiting when
+ * it asks for input instead of paying a full poll cycle per request. Nothing is
+ * sent before the firmware requested input for the first time, and in line
+ * mode only complete lines are sent.
+ * 
+ * @param ctx Pointer to the monitor context
+ * @return true on success, false on failure
+ */
+bool monitor_prefetch_input(monitor_ctx_t *ctx)
+{
+    if(!ctx->prefetch_input || !ctx->input_mode_known || ctx->ring.input_buffer_size == 0)
+    {
+        return true;
+    }
+
+    dmlog_index_t free_space = get_input_free_space(ctx);
+    while(ctx->pending_input_length < free_space && read_pending_input(ctx, false))
     {
-        // Using --input-file: exit if file has ended
-        return !feof(ctx->input_file);
+        // Keep reading until the input buffer would be full
+    }
+
+    if(!send_pending_input(ctx, ctx->input_line_mode))
+    {
+        TRACE_ERROR("Failed to prefetch input to firmware\n");
+        return false;
     }
-    // Continue monitoring
     return true;
 }
 
@@ -972,7 +1515,7 @@ bool monitor_handle_input_request(monitor_ctx_t *ctx)
  */
 bool monitor_handle_send_file_request(monitor_ctx_t *ctx)
 {
-    if(!(ctx->ring.flags &(DMLOG_FLAG_FILE_SEND_REQ)))
+    if(!is_file_requested(ctx, DMLOG_FLAG_FILE_SEND_REQ))
     {
         return true; // No file transfer requested
     }
@@ -985,6 +1528,14 @@ bool monitor_handle_send_file_request(monitor_ctx_t *ctx)
         TRACE_ERROR("Failed to read file transfer structure from target at address 0x%lX\n", file_transfer_addr);
         return false;
     }
+    if(file_transfer.flags & DMLOG_FILE_TRANSFER_FLAG_BATCH)
+    {
+        if(!batch_store_chunk(ctx->batch, file_transfer_addr, &file_transfer))
+        {
+            return monitor_send_file_transfer(ctx, &file_transfer, DMLOG_FLAG_FILE_SEND_REQ);
+        }
+        return monitor_clear_file_request(ctx, DMLOG_FLAG_FILE_SEND_REQ);
+    }
 
     if(file_transfer.total_size == 0 || file_transfer.chunk_size == 0 || file_transfer.buffer_address == 0)
     {
@@ -1002,14 +1553,15 @@ bool monitor_handle_send_file_request(monitor_ctx_t *ctx)
         return false;
     }
 
-    if(backend_read_memory(ctx->backend_type, ctx->socket, (uint32_t)file_transfer.buffer_address, file_data, file_transfer.chunk_size) < 0)
+    if(backend_read_memory(ctx->backend_type, ctx->socket, file_transfer.buffer_address, file_data, file_transfer.chunk_size) < 0)
     {
         TRACE_ERROR("Failed to read file data from target buffer\n");
         Dmod_Free(file_data);
         return false;
     }
 
-    const char* mode = file_transfer.offset == 0 ? "wb" : "wb+";
+    // Later chunks must not truncate the data of the earlier ones
+    const char* mode = file_transfer.offset == 0 ? "wb" : "r+b";
     void* file = Dmod_FileOpen(file_transfer.host_file_name, mode);
     if(file == NULL)
     {
@@ -1046,28 +1598,7 @@ bool monitor_handle_send_file_request(monitor_ctx_t *ctx)
         file_transfer.chunk_size,
         file_transfer.host_file_name,
         (unsigned long long)file_transfer.offset);
-    // Clear the FILE_SEND_REQ flag
-    uint32_t new_flags = ctx->ring.flags & ~DMLOG_FLAG_FILE_SEND_REQ;
-    if(backend_write_memory(ctx->backend_type, ctx->socket, ctx->ring_address + offsetof(dmlog_ring_t, flags), &new_flags, sizeof(uint32_t)) < 0)
-    {
-        TRACE_ERROR("Failed to clear FILE_SEND_REQ flag\n");
-        return false;
-    }
-
-    // Update local cache
-    ctx->ring.flags = new_flags;
-
-    // For GDB backend, briefly resume target so firmware can process the input
-    if(ctx->backend_type == BACKEND_TYPE_GDB)
-    {
-        if(gdb_resume_briefly(ctx->socket) < 0)
-        {
-            TRACE_WARN("Failed to resume target briefly, input may not be processed\n");
-            // Don't fail - the input is written, just might not be processed immediately
-        }
-    }
-
-    return true;
+    return monitor_clear_file_request(ctx, DMLOG_FLAG_FILE_SEND_REQ);
 }
 
 /**
@@ -1078,7 +1609,7 @@ bool monitor_handle_send_file_request(monitor_ctx_t *ctx)
  */
 bool monitor_handle_receive_file_request(monitor_ctx_t *ctx)
 {
-    if(!(ctx->ring.flags &(DMLOG_FLAG_FILE_RECV_REQ)))
+    if(!is_file_requested(ctx, DMLOG_FLAG_FILE_RECV_REQ))
     {
         return true; // No file transfer requested
     }
@@ -1091,6 +1622,11 @@ bool monitor_handle_receive_file_request(monitor_ctx_t *ctx)
         TRACE_ERROR("Failed to read file transfer structure from target\n");
         return false;
     }
+    if(file_transfer.flags & DMLOG_FILE_TRANSFER_FLAG_BATCH)
+    {
+        batch_fill_chunk(ctx->batch, file_transfer_addr, &file_transfer);
+        return monitor_send_file_transfer(ctx, &file_transfer, DMLOG_FLAG_FILE_RECV_REQ);
+    }
     TRACE_INFO("File Transfer Request: host_file_name='%s', offset=%llu, chunk_size=%u, buffer_address=0x%08X\n",
         file_transfer.host_file_name,
         (unsigned long long)file_transfer.offset,
@@ -1116,7 +1652,12 @@ bool monitor_handle_receive_file_request(monitor_ctx_t *ctx)
         file_transfer.host_file_name,
         (unsigned long long)file_transfer.total_size);
 
-    void* file_data = Dmod_Malloc(file_transfer.chunk_size);
+    // A compressed chunk is packed from the data following the part of the
+    // file that the firmware still has in its window
+    uint32_t window_size = ctx->compress_files ? file_transfer.window_size : 0;
+    size_t dictionary_size = (file_transfer.offset < window_size) ? file_transfer.offset : window_size;
+    size_t read_size = (window_size > 0) ? dictionary_size + (size_t)file_transfer.chunk_size * COMPRESSION_MAX_RATIO : file_transfer.chunk_size;
+    uint8_t* file_data = Dmod_Malloc(read_size + file_transfer.chunk_size);
     if(file_data == NULL)
     {
         TRACE_ERROR("Failed to allocate memory for file transfer chunk\n");
@@ -1134,7 +1675,7 @@ bool monitor_handle_receive_file_request(monitor_ctx_t *ctx)
     file_transfer.total_size = Dmod_FileSize(file);
     file_transfer.status = 0;
 
-    if(Dmod_FileSeek(file, file_transfer.offset, SEEK_SET) != 0)
+    if(Dmod_FileSeek(file, file_transfer.offset - dictionary_size, SEEK_SET) != 0)
     {
         TRACE_ERROR("Failed to seek to offset %llu in local file '%s'\n",
             (unsigned long long)file_transfer.offset,
@@ -1144,10 +1685,31 @@ bool monitor_handle_receive_file_request(monitor_ctx_t *ctx)
         return false;
     }
 
-    size_t read_bytes = Dmod_FileRead(file_data, 1, file_transfer.chunk_size, file);
-    file_transfer.chunk_size = (uint32_t)read_bytes;
-    file_transfer.status = 0;
+    size_t read_bytes = Dmod_FileRead(file_data, 1, read_size, file);
     Dmod_FileClose(file);
+    read_bytes = (read_bytes > dictionary_size) ? read_bytes - dictionary_size : 0;
+
+    // Sent raw unless compressing packs more of the file into the chunk
+    uint8_t* chunk = &file_data[dictionary_size];
+    size_t consumed = 0;
+    size_t packed_size = 0;
+    if(window_size > 0 && read_bytes > file_transfer.chunk_size)
+    {
+        packed_size = compression_encode(file_data, dictionary_size, dictionary_size + read_bytes,
+                                         &file_data[read_size], file_transfer.chunk_size, window_size, &consumed);
+    }
+    if(consumed > file_transfer.chunk_size)
+    {
+        TRACE_VERBOSE("Compressed %zu bytes of '%s' into %zu\n", consumed, file_transfer.host_file_name, packed_size);
+        chunk = &file_data[read_size];
+        file_transfer.chunk_size = (uint32_t)packed_size;
+        file_transfer.flags |= DMLOG_FILE_TRANSFER_FLAG_COMPRESSED;
+    }
+    else
+    {
+        file_transfer.chunk_size = (uint32_t)((read_bytes < file_transfer.chunk_size) ? read_bytes : file_transfer.chunk_size);
+        file_transfer.flags &= ~DMLOG_FILE_TRANSFER_FLAG_COMPRESSED;
+    }
 
     if(read_bytes == 0)
     {
@@ -1155,7 +1717,7 @@ bool monitor_handle_receive_file_request(monitor_ctx_t *ctx)
             file_transfer.host_file_name,
             (unsigned long long)file_transfer.offset);
     }
-    else if(backend_write_memory(ctx->backend_type, ctx->socket, (uint32_t)file_transfer.buffer_address, file_data, file_transfer.chunk_size) <= 0)
+    else if(backend_write_memory(ctx->backend_type, ctx->socket, file_transfer.buffer_address, chunk, file_transfer.chunk_size) < 0)
     {
         file_transfer.status = -EIO;
         TRACE_ERROR("Failed to write file data to target buffer\n");
@@ -1205,16 +1767,32 @@ bool monitor_send_file_transfer(monitor_ctx_t* ctx, const dmlog_file_transfer_t*
         return false;
     }
 
-    // Set the appropriate flag
-    uint32_t new_flags = ctx->ring.flags & ~(flags);
-    if(backend_write_memory(ctx->backend_type, ctx->socket, ctx->ring_address + offsetof(dmlog_ring_t, flags), &new_flags, sizeof(uint32_t)) < 0)
+    if(!monitor_clear_file_request(ctx, flags))
+    {
+        return false;
+    }
+    TRACE_INFO("File transfer request sent successfully\n");
+    return true;
+}
+
+/**
+ * @brief Tell the firmware that its file transfer request was serviced
+ * 
+ * @param ctx Pointer to the monitor context
+ * @param flags Request flags serviced
+ * @return true on success, false on failure
+ */
+bool monitor_clear_file_request(monitor_ctx_t* ctx, uint32_t flags)
+{
+    ctx->host.file_serviced = ctx->ring.file_request;
+    if(!write_host_field(ctx, offsetof(dmlog_host_t, file_serviced), sizeof(uint32_t)))
     {
-        TRACE_ERROR("Failed to set file transfer request flag\n");
+        TRACE_ERROR("Failed to acknowledge the file transfer request\n");
         return false;
     }
 
-    // Update local cache
-    ctx->ring.flags = new_flags;
+    // Update local cache - the firmware clears the flags the next time it locks the ring
+    ctx->ring.flags &= ~(flags);
 
     // For GDB backend, briefly resume target so firmware can process the input
     if(ctx->backend_type == BACKEND_TYPE_GDB)
@@ -1225,7 +1803,5 @@ bool monitor_send_file_transfer(monitor_ctx_t* ctx, const dmlog_file_transfer_t*
             // Don't fail - the input is written, just might not be processed immediately
         }
     }
-
-    TRACE_INFO("File transfer request sent successfully\n");
     return true;
 }
\ No newline at end of file
@@ -4,13 +4,32 @@
 #include <stdio.h>
 #include "dmlog.h"
 #include "backend.h"
+#include "archive.h"
+#include "records.h"
+#include "symbols.h"
+#include "heap.h"
+#include "watch.h"
+#include "overhead.h"
+#include "tags.h"
+#include "batch.h"
+
+#define MONITOR_PENDING_INPUT_SIZE  512
+#define MONITOR_WATCH_POLL_INTERVAL 5000    /* microseconds */
+#define MONITOR_MAX_SEGMENTS        64
 
 typedef struct 
 {
     dmlog_ring_t        ring;
+    dmlog_host_t        host;                           // Control block of the host, written only by the monitor
+    uint64_t            host_address;                   // Address the control block was read from
     int                 socket;
     uint32_t            ring_address;
     dmlog_index_t       tail_offset;
+    dmlog_segment_t     segments[MONITOR_MAX_SEGMENTS]; // Segments of a segmented output ring
+    uint32_t            segment_count;                  // 0 - the output ring is contiguous
+    uint64_t            segments_address;               // Address the segments were read from
+    bool                ring_watched;                   // Watched ranges were set up for the current ring
+    uint64_t            watched_buffer;                 // Output ring the watched ranges belong to
     char                entry_buffer[DMOD_LOG_MAX_ENTRY_SIZE];
     bool                owns_busy_flag;
     dmlog_ctx_t         dmlog_ctx;
@@ -20,6 +39,23 @@ typedef struct
     backend_type_t      backend_type;
     FILE*               input_file;  // Optional input file for automated testing
     bool                init_script_mode;  // If true, switch to stdin after input_file EOF
+    archive_t*          archive;     // Optional log archive with full-text index
+    bool                prefetch_input;    // Push type-ahead input before the firmware requests it
+    bool                input_mode_known;  // Set after the first input request from the firmware
+    bool                input_line_mode;   // Line mode of the last input request
+    bool                input_eof;         // Input source has ended (or failed)
+    char                pending_input[MONITOR_PENDING_INPUT_SIZE]; // Input read but not yet sent
+    size_t              pending_input_length;
+    symbols_t*          symbols;     // Optional firmware symbols (--elf)
+    records_decoder_t   records;     // Decoder of binary records in the log stream
+    heap_profile_t*     heap;        // Optional heap profile built from heap trace records
+    watch_t*            watch;       // Optional sampler of firmware variables (--watch)
+    overhead_report_t*  overhead;    // Optional report of the logging overhead per module (--overhead)
+    tag_dictionary_t*   tags;        // Tag sets of the firmware, read when a line refers to a new one
+    file_batch_t*       batch;       // Batch file transfer being serviced
+    bool                compress_files; // Compress the chunks of files received by the firmware
+    bool                flow_control;   // The firmware waits for the monitor instead of overwriting unread entries
+    bool                flow_control_lost; // The firmware timed out waiting, flow control is turned on again once it noticed
 } monitor_ctx_t;
 
 monitor_ctx_t* monitor_connect(backend_addr_t *addr, uint32_t ring_address, bool snapshot_mode);
@@ -36,11 +72,14 @@ bool monitor_send_clear_command(monitor_ctx_t *ctx);
 bool monitor_send_busy_command(monitor_ctx_t *ctx);
 bool monitor_send_not_busy_command(monitor_ctx_t *ctx);
 bool monitor_synchronize(monitor_ctx_t *ctx);
+bool monitor_set_flow_control(monitor_ctx_t *ctx, bool enable);
 bool monitor_send_input(monitor_ctx_t *ctx, const char* input, size_t length);
 bool monitor_handle_input_request(monitor_ctx_t *ctx);
+bool monitor_prefetch_input(monitor_ctx_t *ctx);
 bool monitor_handle_send_file_request(monitor_ctx_t *ctx);
 bool monitor_handle_receive_file_request(monitor_ctx_t *ctx);
 bool monitor_send_file_transfer(monitor_ctx_t* ctx, const dmlog_file_transfer_t* transfer, uint32_t flags);
+bool monitor_clear_file_request(monitor_ctx_t* ctx, uint32_t flags);
 void monitor_restore_terminal(void);
 
 #endif // MONITOR_H
\ No newline at end of file
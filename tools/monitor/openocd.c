@@ -224,53 +224,24 @@ static size_t read_line(int socket, char *buffer, size_t max_length)
  */
 int openocd_connect(const backend_addr_t *addr)
 {
-    struct addrinfo hints = {
-        .ai_family = AF_INET,
-        .ai_socktype = SOCK_STREAM,
-        .ai_protocol = IPPROTO_TCP
-    };
-    struct addrinfo *res = NULL;
-    struct addrinfo *rp = NULL;
-    char port_str[6];
-    snprintf(port_str, sizeof(port_str), "%d", addr->port);
-
-    if(getaddrinfo(addr->host, port_str, &hints, &res) != 0)
+    int sock = backend_socket_connect(addr);
+    if(sock < 0)
     {
-        fprintf(stderr, "getaddrinfo failed for %s:%s\n", addr->host, port_str);
         return -1;
     }
-
-    for(rp = res; rp != NULL; rp = rp->ai_next)
+    if(openocd_read_welcome(sock) < 0)
     {
-        int sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-        if(sock < 0)
-            continue;
-
-        if(connect(sock, rp->ai_addr, rp->ai_addrlen) == 0)
-        {
-            freeaddrinfo(res);
-            if(openocd_read_welcome(sock) < 0)
-            {
-                close(sock);
-                return -1;
-            }
-            TRACE_INFO("Connected to OpenOCD at %s:%d\n", addr->host, addr->port);
-
-            if(openocd_set_debug_level(sock, 0) < 0)
-            {
-                TRACE_WARN("Failed to set OpenOCD debug level\n");
-            }
-
-            return sock;
-        }
-
-        close(sock);
+        backend_socket_close(sock);
+        return -1;
     }
+    TRACE_INFO("Connected to OpenOCD at %s:%d\n", addr->host, addr->port);
 
-    freeaddrinfo(res);
-    TRACE_ERROR("Failed to connect to %s:%s\n", addr->host, port_str);
+    if(openocd_set_debug_level(sock, 0) < 0)
+    {
+        TRACE_WARN("Failed to set OpenOCD debug level\n");
+    }
 
-    return -1;
+    return sock;
 }
 
 /**
@@ -313,7 +284,7 @@ int openocd_read_welcome(int socket)
  */
 int openocd_disconnect(int socket)
 {
-    close(socket);
+    backend_socket_close(socket);
     return 0;
 }
 
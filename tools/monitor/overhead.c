@@ -0,0 +1,316 @@
+#include "overhead.h"
+#include "dmlog.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+/**
+ * @brief Counters of a single module read from the target
+ */
+typedef struct
+{
+    char            name[DMLOG_OVERHEAD_NAME_SIZE + 1];
+    uint64_t        cycles;
+    uint64_t        bytes;
+    uint64_t        calls;
+    uint64_t        flushes;
+    uint64_t        cycles_delta;   //!< Since the previous read
+    uint64_t        bytes_delta;
+} overhead_module_t;
+
+struct overhead_report
+{
+    char                report_path[1024];
+    uint64_t            table_address;      //!< Address of the table read last (0 - not enabled)
+    uint32_t            cycles_per_second;
+    uint32_t            capacity;
+    overhead_module_t*  modules;
+    size_t              module_count;
+    double              interval;           //!< Seconds between the last two reads (0 - first read)
+    struct timespec     last_read;
+    time_t              last_report;
+    bool                read_once;
+};
+
+/**
+ * @brief Get the seconds elapsed between two monotonic times
+ *
+ * @param from Earlier time
+ * @param to Later time
+ * @return double Elapsed seconds
+ */
+static double elapsed_seconds(const struct timespec* from, const struct timespec* to)
+{
+    return (double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief Find the previous counters of a module
+ *
+ * @param modules Previous modules
+ * @param count Number of previous modules
+ * @param name Module name
+ * @return const overhead_module_t* Previous counters, NULL if the module is new
+ */
+static const overhead_module_t* find_module(const overhead_module_t* modules, size_t count, const char* name)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        if(strcmp(modules[i].name, name) == 0)
+        {
+            return &modules[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Read the overhead table from the target
+ *
+ * @param report Overhead report
+ * @param backend_type Backend type
+ * @param socket Backend socket
+ * @param table_address Address of the table on the target
+ * @return true on success, false on failure
+ */
+static bool read_table(overhead_report_t* report, backend_type_t backend_type, int socket, uint64_t table_address)
+{
+    dmlog_overhead_t header;
+    if(backend_read_memory(backend_type, socket, table_address, &header, sizeof(header)) < 0)
+    {
+        TRACE_ERROR("Failed to read overhead table from target at 0x%08" PRIx64 "\n", table_address);
+        return false;
+    }
+    uint32_t capacity = header.capacity;
+    uint32_t count = header.count;
+    if(capacity == 0 || capacity > OVERHEAD_MAX_MODULES || count > capacity)
+    {
+        TRACE_ERROR("Invalid overhead table at 0x%08" PRIx64 " (capacity %u, count %u)\n", table_address, capacity, count);
+        return false;
+    }
+
+    dmlog_overhead_entry_t* entries = malloc((count ? count : 1) * sizeof(dmlog_overhead_entry_t));
+    overhead_module_t* modules = calloc(count ? count : 1, sizeof(overhead_module_t));
+    if(entries == NULL || modules == NULL)
+    {
+        TRACE_ERROR("Failed to allocate overhead table\n");
+        free(entries);
+        free(modules);
+        return false;
+    }
+    if(count > 0 && backend_read_memory(backend_type, socket, table_address + sizeof(header), entries, count * sizeof(dmlog_overhead_entry_t)) < 0)
+    {
+        TRACE_ERROR("Failed to read overhead table entries from target\n");
+        free(entries);
+        free(modules);
+        return false;
+    }
+
+    // A different table (e.g. after a reset of the target) starts from zero
+    bool same_table = report->read_once && table_address == report->table_address;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        overhead_module_t* module = &modules[i];
+        memcpy(module->name, entries[i].name, DMLOG_OVERHEAD_NAME_SIZE);
+        module->name[DMLOG_OVERHEAD_NAME_SIZE] = '\0';
+        module->cycles = entries[i].cycles;
+        module->bytes = entries[i].bytes;
+        module->calls = entries[i].calls;
+        module->flushes = entries[i].flushes;
+
+        const overhead_module_t* previous = same_table ? find_module(report->modules, report->module_count, module->name) : NULL;
+        module->cycles_delta = previous && module->cycles >= previous->cycles ? module->cycles - previous->cycles : 0;
+        module->bytes_delta = previous && module->bytes >= previous->bytes ? module->bytes - previous->bytes : 0;
+    }
+    free(entries);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    report->interval = same_table ? elapsed_seconds(&report->last_read, &now) : 0.0;
+    report->last_read = now;
+    report->table_address = table_address;
+    report->cycles_per_second = header.cycles_per_second;
+    report->capacity = capacity;
+    free(report->modules);
+    report->modules = modules;
+    report->module_count = count;
+    report->read_once = true;
+    return true;
+}
+
+/**
+ * @brief Create an overhead report
+ *
+ * @param report_path File to write the report to
+ * @return overhead_report_t* Overhead report, NULL on failure
+ */
+overhead_report_t* overhead_open(const char* report_path)
+{
+    overhead_report_t* report = calloc(1, sizeof(overhead_report_t));
+    if(report == NULL)
+    {
+        TRACE_ERROR("Failed to allocate overhead report\n");
+        return NULL;
+    }
+    if(strlen(report_path) >= sizeof(report->report_path))
+    {
+        TRACE_ERROR("Failed to create overhead report: %s\n", report_path);
+        free(report);
+        return NULL;
+    }
+    strcpy(report->report_path, report_path);
+    return report;
+}
+
+/**
+ * @brief Write the final report and free the overhead report
+ *
+ * The final report contains the counters of the last read.
+ *
+ * @param report Overhead report (may be NULL)
+ */
+void overhead_close(overhead_report_t* report)
+{
+    if(report)
+    {
+        overhead_checkpoint(report, BACKEND_TYPE__COUNT, -1, 0, true);
+        free(report->modules);
+        free(report);
+    }
+}
+
+static int compare_modules_by_cycles(const void* a, const void* b)
+{
+    const overhead_module_t* ma = a;
+    const overhead_module_t* mb = b;
+    if(ma->cycles != mb->cycles)
+    {
+        return ma->cycles < mb->cycles ? 1 : -1;
+    }
+    return ma->bytes < mb->bytes ? 1 : ma->bytes > mb->bytes ? -1 : 0;
+}
+
+/**
+ * @brief Write the report
+ *
+ * @param report Overhead report
+ * @param out Output stream
+ */
+void overhead_report(overhead_report_t* report, FILE* out)
+{
+    fprintf(out, "DMLoG logging overhead\n");
+    fprintf(out, "======================\n\n");
+    if(!report->read_once)
+    {
+        fprintf(out, "Overhead accounting is not enabled on the target (see dmlog_overhead_enable()).\n");
+        return;
+    }
+
+    qsort(report->modules, report->module_count, sizeof(overhead_module_t), compare_modules_by_cycles);
+    overhead_module_t total = { .name = "total" };
+    for(size_t i = 0; i < report->module_count; i++)
+    {
+        total.cycles += report->modules[i].cycles;
+        total.bytes += report->modules[i].bytes;
+        total.calls += report->modules[i].calls;
+        total.flushes += report->modules[i].flushes;
+        total.cycles_delta += report->modules[i].cycles_delta;
+        total.bytes_delta += report->modules[i].bytes_delta;
+    }
+
+    if(report->cycles_per_second)
+    {
+        fprintf(out, "Cycle counter:    %" PRIu32 " Hz\n", report->cycles_per_second);
+    }
+    else
+    {
+        fprintf(out, "Cycle counter:    unknown frequency\n");
+    }
+    fprintf(out, "Modules:          %zu of %" PRIu32 "\n", report->module_count, report->capacity);
+    if(report->interval > 0)
+    {
+        fprintf(out, "Rates over:       %.1f s\n", report->interval);
+    }
+    fprintf(out, "\n%-16s %10s %10s %12s %14s %10s %7s %7s %10s\n",
+        "module", "calls", "flushes", "bytes", "cycles", "cyc/call", "share", "cpu", "bytes/s");
+
+    for(size_t i = 0; i <= report->module_count; i++)
+    {
+        const overhead_module_t* module = i < report->module_count ? &report->modules[i] : &total;
+        if(module == &total)
+        {
+            fprintf(out, "\n");
+        }
+        fprintf(out, "%-16s %10" PRIu64 " %10" PRIu64 " %12" PRIu64 " %14" PRIu64 " %10.0f %6.1f%%",
+            module->name,
+            module->calls,
+            module->flushes,
+            module->bytes,
+            module->cycles,
+            module->calls ? (double)module->cycles / (double)module->calls : 0.0,
+            total.cycles ? 100.0 * (double)module->cycles / (double)total.cycles : 0.0);
+        if(report->interval > 0 && report->cycles_per_second)
+        {
+            fprintf(out, " %6.2f%%", 100.0 * (double)module->cycles_delta / (report->interval * report->cycles_per_second));
+        }
+        else
+        {
+            fprintf(out, " %7s", "-");
+        }
+        if(report->interval > 0)
+        {
+            fprintf(out, " %10.1f\n", (double)module->bytes_delta / report->interval);
+        }
+        else
+        {
+            fprintf(out, " %10s\n", "-");
+        }
+    }
+}
+
+/**
+ * @brief Read the overhead table and rewrite the report file
+ *
+ * @param report Overhead report (may be NULL)
+ * @param backend_type Backend type
+ * @param socket Backend socket
+ * @param table_address Address of the table on the target (0 - accounting disabled)
+ * @param force Write even if the report interval has not elapsed
+ * @return true on success, false on failure
+ */
+bool overhead_checkpoint(overhead_report_t* report, backend_type_t backend_type, int socket, uint64_t table_address, bool force)
+{
+    if(report == NULL)
+    {
+        return true;
+    }
+    time_t now = time(NULL);
+    if(!force && now - report->last_report < OVERHEAD_REPORT_INTERVAL)
+    {
+        return true;
+    }
+    report->last_report = now;
+    if(table_address != 0 && !read_table(report, backend_type, socket, table_address))
+    {
+        return false;
+    }
+
+    // Write a temporary file and rename it, so readers never see a partial report
+    char temp_path[sizeof(report->report_path) + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", report->report_path);
+    FILE* file = fopen(temp_path, "w");
+    if(file == NULL)
+    {
+        TRACE_ERROR("Failed to write overhead report: %s\n", temp_path);
+        return false;
+    }
+    overhead_report(report, file);
+    if(fclose(file) != 0 || rename(temp_path, report->report_path) != 0)
+    {
+        TRACE_ERROR("Failed to write overhead report: %s\n", report->report_path);
+        return false;
+    }
+    return true;
+}
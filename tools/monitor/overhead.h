@@ -0,0 +1,31 @@
+#ifndef OVERHEAD_H
+#define OVERHEAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "backend.h"
+
+/**
+ * @file overhead.h
+ * @brief Report of the logging overhead accounted by the firmware per module.
+ *
+ * The firmware publishes its overhead table (see dmlog_overhead_enable()) in
+ * the ring header. The table is read periodically and the report - cycles,
+ * calls and bytes of each module, with the CPU load and data rate since the
+ * previous read - is rewritten, so it can be watched while the target is
+ * running (e.g. `watch cat overhead.txt`).
+ */
+
+#define OVERHEAD_REPORT_INTERVAL    2       /* seconds */
+#define OVERHEAD_MAX_MODULES        256     /* sanity limit of the table capacity */
+
+typedef struct overhead_report overhead_report_t;
+
+overhead_report_t* overhead_open(const char* report_path);
+void overhead_close(overhead_report_t* report);
+bool overhead_checkpoint(overhead_report_t* report, backend_type_t backend_type, int socket, uint64_t table_address, bool force);
+void overhead_report(overhead_report_t* report, FILE* out);
+
+#endif // OVERHEAD_H
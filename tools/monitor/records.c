@@ -0,0 +1,290 @@
+#include "records.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+/* Maximum number of values in a record */
+#define RECORD_MAX_VALUES   (DMLOG_BACKTRACE_MAX_DEPTH + 1 > 4 ? DMLOG_BACKTRACE_MAX_DEPTH + 1 : 4)
+
+typedef enum
+{
+    RECORD_INCOMPLETE,
+    RECORD_COMPLETE,
+    RECORD_INVALID,
+} record_state_t;
+
+/**
+ * @brief Append text to the output of the decoder
+ *
+ * @param decoder Records decoder
+ * @param text Text to append
+ * @param length Length of the text
+ * @return true on success, false if memory could not be allocated
+ */
+static bool append(records_decoder_t* decoder, const char* text, size_t length)
+{
+    if(decoder->output_length + length + 1 > decoder->output_capacity)
+    {
+        size_t new_capacity = decoder->output_capacity ? decoder->output_capacity : DMOD_LOG_MAX_ENTRY_SIZE * 2;
+        while(new_capacity < decoder->output_length + length + 1)
+        {
+            new_capacity *= 2;
+        }
+        char* output = realloc(decoder->output, new_capacity);
+        if(output == NULL)
+        {
+            TRACE_ERROR("Failed to allocate record output buffer\n");
+            return false;
+        }
+        decoder->output = output;
+        decoder->output_capacity = new_capacity;
+    }
+    memcpy(&decoder->output[decoder->output_length], text, length);
+    decoder->output_length += length;
+    decoder->output[decoder->output_length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Parse the values of a (possibly incomplete) record
+ *
+ * @param record Record bytes starting with DMLOG_RECORD_MARKER
+ * @param length Number of bytes received so far
+ * @param values Array to store the values in (RECORD_MAX_VALUES entries)
+ * @param value_count Pointer to store the number of values
+ * @return record_state_t State of the record
+ */
+static record_state_t parse_record(const uint8_t* record, size_t length, uint64_t* values, size_t* value_count)
+{
+    if(length < 2)
+    {
+        return RECORD_INCOMPLETE;
+    }
+    size_t expected;
+    switch(record[1])
+    {
+        case DMLOG_RECORD_ADDRESS:      expected = 1; break;
+        case DMLOG_RECORD_BACKTRACE:    expected = 1; break; // + frame count
+        case DMLOG_RECORD_HEAP_ALLOC:   expected = 4; break;
+        case DMLOG_RECORD_HEAP_FREE:    expected = 3; break;
+        case DMLOG_RECORD_TAG_SET:      expected = 1; break;
+        default:                        return RECORD_INVALID;
+    }
+
+    size_t count = 0;
+    size_t offset = 2;
+    while(count < expected)
+    {
+        size_t used = dmlog_record_decode_value(&record[offset], length - offset, &values[count]);
+        if(used == 0)
+        {
+            // Continuation bytes only - the rest of the value has not arrived yet
+            for(size_t i = offset; i < length; i++)
+            {
+                if(record[i] < 0x80 || record[i] >= 0xC0)
+                {
+                    return RECORD_INVALID;
+                }
+            }
+            return length - offset < DMLOG_RECORD_MAX_VALUE_SIZE ? RECORD_INCOMPLETE : RECORD_INVALID;
+        }
+        offset += used;
+        if(count == 0 && record[1] == DMLOG_RECORD_BACKTRACE)
+        {
+            if(values[0] > DMLOG_BACKTRACE_MAX_DEPTH)
+            {
+                return RECORD_INVALID;
+            }
+            expected += values[0];
+        }
+        count++;
+    }
+    *value_count = count;
+    return RECORD_COMPLETE;
+}
+
+/**
+ * @brief Format a single address, symbolized if possible
+ *
+ * @param decoder Records decoder
+ * @param address Address to format
+ * @param return_address true if the address is a return address
+ * @return true on success, false on failure
+ */
+static bool append_address(records_decoder_t* decoder, uint64_t address, bool return_address)
+{
+    char text[SYMBOLS_MAX_TEXT_LENGTH + 32];
+    int length = snprintf(text, sizeof(text), address > 0xFFFFFFFFull ? "0x%016" PRIx64 : "0x%08" PRIx64, address);
+    const char* location = symbols_lookup(decoder->symbols, address, return_address);
+    if(location != NULL)
+    {
+        length += snprintf(&text[length], sizeof(text) - length, " %s", location);
+    }
+    return append(decoder, text, length < (int)sizeof(text) ? (size_t)length : sizeof(text) - 1);
+}
+
+/**
+ * @brief Format a complete record
+ *
+ * @param decoder Records decoder
+ * @param type Record type
+ * @param values Record values
+ * @param value_count Number of values
+ * @return true on success, false on failure
+ */
+static bool append_record(records_decoder_t* decoder, uint8_t type, const uint64_t* values, size_t value_count)
+{
+    if(type == DMLOG_RECORD_ADDRESS)
+    {
+        return append_address(decoder, values[0], false);
+    }
+    if(type == DMLOG_RECORD_HEAP_ALLOC)
+    {
+        if(decoder->heap)
+        {
+            heap_profile_alloc(decoder->heap, values[0], values[1], values[2], values[3]);
+        }
+        return true;
+    }
+    if(type == DMLOG_RECORD_HEAP_FREE)
+    {
+        if(decoder->heap)
+        {
+            // The caller of free() is not needed - the block is charged to its allocation site
+            heap_profile_free(decoder->heap, values[0], values[2]);
+        }
+        return true;
+    }
+    if(type == DMLOG_RECORD_TAG_SET)
+    {
+        const char* set = values[0] <= UINT32_MAX ? tags_lookup(decoder->tags, (uint32_t)values[0]) : NULL;
+        if(set != NULL)
+        {
+            return append(decoder, set, strlen(set));
+        }
+        char text[48];
+        int length = snprintf(text, sizeof(text), "[tag set %" PRIu64 "] ", values[0]);
+        return append(decoder, text, (size_t)length);
+    }
+
+    bool result = append(decoder, "Backtrace:\n", strlen("Backtrace:\n"));
+    uint64_t pc = 0;
+    for(size_t i = 1; i < value_count && result; i++)
+    {
+        if(i == 1)
+        {
+            pc = values[1];
+        }
+        else
+        {
+            // Zigzag encoded difference to the previous frame
+            pc += (values[i] >> 1) ^ (0 - (values[i] & 1));
+        }
+        char prefix[32];
+        int length = snprintf(prefix, sizeof(prefix), "    #%zu ", i - 1);
+        result = append(decoder, prefix, (size_t)length) &&
+                 append_address(decoder, pc, true) &&
+                 append(decoder, "\n", 1);
+    }
+    return result;
+}
+
+/**
+ * @brief Initialize the records decoder
+ *
+ * @param decoder Records decoder
+ * @param symbols Symbols of the firmware, or NULL to print plain addresses
+ */
+void records_init(records_decoder_t* decoder, symbols_t* symbols)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->symbols = symbols;
+}
+
+/**
+ * @brief Release the resources of the records decoder
+ *
+ * The symbols are not freed - they belong to the caller.
+ *
+ * @param decoder Records decoder
+ */
+void records_deinit(records_decoder_t* decoder)
+{
+    free(decoder->output);
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+/**
+ * @brief Replace the binary records in data received from the target with text
+ *
+ * @param decoder Records decoder
+ * @param data Data received from the target
+ * @param length Length of the data
+ * @return const char* Formatted text (valid until the next call), or data
+ *                     itself when it contains no records
+ */
+const char* records_format(records_decoder_t* decoder, const char* data, size_t length)
+{
+    if(decoder->pending_length == 0 && memchr(data, DMLOG_RECORD_MARKER, length) == NULL)
+    {
+        return data; // Fast path - plain text
+    }
+
+    decoder->output_length = 0;
+    if(!append(decoder, "", 0))
+    {
+        return data;
+    }
+    const uint8_t* bytes = (const uint8_t*)data;
+    size_t text_start = 0;
+    for(size_t i = 0; i < length; )
+    {
+        if(decoder->pending_length == 0)
+        {
+            if(bytes[i] == DMLOG_RECORD_MARKER)
+            {
+                append(decoder, &data[text_start], i - text_start);
+                decoder->pending[decoder->pending_length++] = bytes[i];
+                text_start = i + 1;
+            }
+            i++;
+            continue;
+        }
+
+        decoder->pending[decoder->pending_length++] = bytes[i];
+        uint64_t values[RECORD_MAX_VALUES];
+        size_t value_count = 0;
+        record_state_t state = parse_record(decoder->pending, decoder->pending_length, values, &value_count);
+        if(state == RECORD_INCOMPLETE && decoder->pending_length == sizeof(decoder->pending))
+        {
+            state = RECORD_INVALID;
+        }
+        if(state == RECORD_COMPLETE)
+        {
+            append_record(decoder, decoder->pending[1], values, value_count);
+            decoder->pending_length = 0;
+            i++;
+            text_start = i;
+        }
+        else if(state == RECORD_INVALID)
+        {
+            // Not a record after all - print it as text and look at the last byte again
+            TRACE_VERBOSE("Invalid binary record in the log stream\n");
+            append(decoder, (const char*)decoder->pending, decoder->pending_length - 1);
+            decoder->pending_length = 0;
+            text_start = i;
+        }
+        else
+        {
+            i++;
+            text_start = i;
+        }
+    }
+    if(decoder->pending_length == 0)
+    {
+        append(decoder, &data[text_start], length - text_start);
+    }
+    return decoder->output;
+}
@@ -0,0 +1,41 @@
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "dmlog.h"
+#include "symbols.h"
+#include "heap.h"
+#include "tags.h"
+
+/**
+ * @file records.h
+ * @brief Decoder of binary records (addresses, backtraces) in the log stream.
+ *
+ * The firmware logs raw addresses as compact binary records (see
+ * dmlog_put_address() and dmlog_backtrace()). The decoder replaces them in the
+ * text received from the target with formatted addresses, symbolized when an
+ * ELF file is available. Tag set records are replaced with the tags from the
+ * tag dictionary. Heap trace records are not printed - they are passed to the
+ * heap profile, if there is one. A record split between two reads is kept
+ * until the rest of it arrives.
+ */
+
+typedef struct
+{
+    symbols_t*      symbols;                            //!< Optional symbols for the firmware
+    heap_profile_t* heap;                               //!< Optional heap profile for heap trace records
+    tag_dictionary_t* tags;                             //!< Optional tag dictionary for tag set records
+    uint8_t         pending[DMLOG_RECORD_MAX_SIZE];     //!< Incomplete record
+    size_t          pending_length;
+    char*           output;                             //!< Formatted text
+    size_t          output_length;
+    size_t          output_capacity;
+} records_decoder_t;
+
+void records_init(records_decoder_t* decoder, symbols_t* symbols);
+void records_deinit(records_decoder_t* decoder);
+const char* records_format(records_decoder_t* decoder, const char* data, size_t length);
+
+#endif // RECORDS_H
@@ -0,0 +1,1540 @@
+#include "symbols.h"
+#include "trace.h"
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define SYMBOLS_CACHE_SIZE          1024    /* must be a power of 2 */
+
+/* DWARF constants used by the line table parser */
+#define DW_LNS_copy                 0x01
+#define DW_LNS_advance_pc           0x02
+#define DW_LNS_advance_line         0x03
+#define DW_LNS_set_file             0x04
+#define DW_LNS_const_add_pc         0x08
+#define DW_LNS_fixed_advance_pc     0x09
+#define DW_LNE_end_sequence         0x01
+#define DW_LNE_set_address          0x02
+#define DW_LNE_define_file          0x03
+#define DW_LNCT_path                0x01
+#define DW_FORM_block               0x09
+#define DW_FORM_data1               0x0b
+#define DW_FORM_data2               0x05
+#define DW_FORM_data4               0x06
+#define DW_FORM_data8               0x07
+#define DW_FORM_data16              0x1e
+#define DW_FORM_string              0x08
+#define DW_FORM_strp                0x0e
+#define DW_FORM_udata               0x0f
+#define DW_FORM_line_strp           0x1f
+#define DW_FORM_strx                0x1a
+#define DW_FORM_strx1               0x25
+#define DW_FORM_strx2               0x26
+#define DW_FORM_strx3               0x27
+#define DW_FORM_strx4               0x28
+
+/* DWARF constants used by the variable type parser */
+#define DW_UT_compile               0x01
+#define DW_UT_partial               0x03
+#define DW_TAG_enumeration_type     0x04
+#define DW_TAG_pointer_type         0x0f
+#define DW_TAG_typedef              0x16
+#define DW_TAG_base_type            0x24
+#define DW_TAG_const_type           0x26
+#define DW_TAG_variable             0x34
+#define DW_TAG_volatile_type        0x35
+#define DW_TAG_restrict_type        0x37
+#define DW_TAG_atomic_type          0x47
+#define DW_AT_name                  0x03
+#define DW_AT_byte_size             0x0b
+#define DW_AT_encoding              0x3e
+#define DW_AT_type                  0x49
+#define DW_ATE_boolean              0x02
+#define DW_ATE_float                0x04
+#define DW_ATE_signed               0x05
+#define DW_ATE_signed_char          0x06
+#define DW_ATE_unsigned             0x07
+#define DW_ATE_unsigned_char        0x08
+#define DW_ATE_UTF                  0x10
+#define DW_FORM_addr                0x01
+#define DW_FORM_block2              0x03
+#define DW_FORM_block4              0x04
+#define DW_FORM_block1              0x0a
+#define DW_FORM_flag                0x0c
+#define DW_FORM_sdata               0x0d
+#define DW_FORM_ref_addr            0x10
+#define DW_FORM_ref1                0x11
+#define DW_FORM_ref2                0x12
+#define DW_FORM_ref4                0x13
+#define DW_FORM_ref8                0x14
+#define DW_FORM_ref_udata           0x15
+#define DW_FORM_indirect            0x16
+#define DW_FORM_sec_offset          0x17
+#define DW_FORM_exprloc             0x18
+#define DW_FORM_flag_present        0x19
+#define DW_FORM_addrx               0x1b
+#define DW_FORM_ref_sup4            0x1c
+#define DW_FORM_strp_sup            0x1d
+#define DW_FORM_ref_sig8            0x20
+#define DW_FORM_implicit_const      0x21
+#define DW_FORM_loclistx            0x22
+#define DW_FORM_rnglistx            0x23
+#define DW_FORM_ref_sup8            0x24
+#define DW_FORM_addrx1              0x29
+#define DW_FORM_addrx2              0x2a
+#define DW_FORM_addrx3              0x2b
+#define DW_FORM_addrx4              0x2c
+#define DW_FORM_GNU_addr_index      0x1f01
+#define DW_FORM_GNU_str_index       0x1f02
+#define DW_FORM_GNU_ref_alt         0x1f20
+#define DW_FORM_GNU_strp_alt        0x1f21
+
+/* Maximum number of typedefs and qualifiers followed to the underlying type */
+#define SYMBOLS_MAX_TYPE_CHAIN      16
+
+/* Abbreviation codes above this are treated as corrupted data */
+#define SYMBOLS_MAX_ABBREV_CODE     (1u << 20)
+
+/**
+ * @brief Function symbol
+ */
+typedef struct
+{
+    uint64_t        address;        //!< Start address
+    uint64_t        size;           //!< Size (0 - up to the next symbol)
+    const char*     name;           //!< Name (points into the ELF data)
+} symbol_t;
+
+/**
+ * @brief Data object symbol
+ */
+typedef struct
+{
+    uint64_t        address;        //!< Start address
+    uint64_t        size;           //!< Size in bytes
+    const char*     name;           //!< Name (points into the ELF data)
+    bool            global;         //!< Global binding (preferred over local symbols)
+} object_t;
+
+/**
+ * @brief Row of the line table
+ */
+typedef struct
+{
+    uint64_t        address;        //!< First address of the row
+    uint32_t        file;           //!< Index in symbols->files
+    uint32_t        line;           //!< Source line, 0 marks the end of a sequence
+} line_row_t;
+
+/**
+ * @brief Formatted lookup result
+ */
+typedef struct
+{
+    uint64_t        address;
+    bool            return_address;
+    bool            valid;
+    bool            found;
+    char            text[SYMBOLS_MAX_TEXT_LENGTH];
+} cache_entry_t;
+
+/**
+ * @brief ELF section (class independent)
+ */
+typedef struct
+{
+    const char*     name;
+    uint32_t        name_offset;
+    uint32_t        type;
+    uint64_t        offset;
+    uint64_t        size;
+    uint32_t        link;
+    uint64_t        entsize;
+} section_t;
+
+/**
+ * @brief Bounds-checked reader of DWARF data
+ */
+typedef struct
+{
+    const uint8_t*  position;
+    const uint8_t*  end;
+    bool            error;
+} reader_t;
+
+/**
+ * @brief Unit of the .debug_info section with its abbreviation table
+ */
+typedef struct
+{
+    uint64_t        offset;         //!< Offset of the unit header in .debug_info
+    const uint8_t*  dies;           //!< First DIE (end if the unit is skipped)
+    const uint8_t*  end;            //!< End of the unit
+    uint64_t        abbrev_offset;  //!< Offset of the abbreviation table in .debug_abbrev
+    const uint8_t** abbrevs;        //!< Attribute specifications by abbreviation code
+    size_t          abbrev_count;
+    uint16_t        version;
+    uint8_t         address_size;
+    uint8_t         offset_size;
+} unit_t;
+
+/**
+ * @brief Attributes of a debugging information entry used by the type parser
+ */
+typedef struct
+{
+    uint64_t        tag;            //!< 0 for the null entry closing a list of children
+    bool            has_children;
+    const char*     name;
+    uint64_t        byte_size;
+    uint64_t        encoding;
+    uint64_t        type;           //!< Offset of the type entry in .debug_info, 0 if none
+} die_t;
+
+struct symbols
+{
+    uint8_t*        data;
+    size_t          size;
+    symbol_t*       functions;
+    size_t          function_count;
+    object_t*       objects;
+    size_t          object_count;
+    line_row_t*     rows;
+    size_t          row_count;
+    size_t          row_capacity;
+    const char**    files;
+    size_t          file_count;
+    size_t          file_capacity;
+    const uint8_t*  line_str;       //!< .debug_line_str section
+    size_t          line_str_size;
+    const uint8_t*  str;            //!< .debug_str section
+    size_t          str_size;
+    const uint8_t*  info;           //!< .debug_info section
+    size_t          info_size;
+    const uint8_t*  abbrev;         //!< .debug_abbrev section
+    size_t          abbrev_size;
+    cache_entry_t*  cache;
+};
+
+static uint64_t read_value(reader_t* reader, size_t size)
+{
+    if(reader->error || (size_t)(reader->end - reader->position) < size)
+    {
+        reader->error = true;
+        return 0;
+    }
+    uint64_t value = 0;
+    for(size_t i = 0; i < size; i++)
+    {
+        value |= (uint64_t)reader->position[i] << (8 * i);
+    }
+    reader->position += size;
+    return value;
+}
+
+static uint64_t read_uleb(reader_t* reader)
+{
+    uint64_t value = 0;
+    unsigned shift = 0;
+    while(!reader->error)
+    {
+        if(reader->position >= reader->end)
+        {
+            reader->error = true;
+            break;
+        }
+        uint8_t byte = *reader->position++;
+        if(shift < 64)
+        {
+            value |= (uint64_t)(byte & 0x7F) << shift;
+        }
+        shift += 7;
+        if((byte & 0x80) == 0)
+        {
+            break;
+        }
+    }
+    return value;
+}
+
+static int64_t read_sleb(reader_t* reader)
+{
+    int64_t value = 0;
+    unsigned shift = 0;
+    uint8_t byte = 0;
+    while(!reader->error)
+    {
+        if(reader->position >= reader->end)
+        {
+            reader->error = true;
+            return 0;
+        }
+        byte = *reader->position++;
+        if(shift < 64)
+        {
+            value |= (int64_t)((uint64_t)(byte & 0x7F) << shift);
+        }
+        shift += 7;
+        if((byte & 0x80) == 0)
+        {
+            break;
+        }
+    }
+    if(shift < 64 && (byte & 0x40) != 0)
+    {
+        value |= -(int64_t)((uint64_t)1 << shift);
+    }
+    return value;
+}
+
+static const char* read_string(reader_t* reader)
+{
+    if(reader->error)
+    {
+        return NULL;
+    }
+    const uint8_t* end = memchr(reader->position, '\0', reader->end - reader->position);
+    if(end == NULL)
+    {
+        reader->error = true;
+        return NULL;
+    }
+    const char* string = (const char*)reader->position;
+    reader->position = end + 1;
+    return string;
+}
+
+static void skip(reader_t* reader, uint64_t size)
+{
+    if(reader->error || (uint64_t)(reader->end - reader->position) < size)
+    {
+        reader->error = true;
+        return;
+    }
+    reader->position += size;
+}
+
+/**
+ * @brief Get a string from a string section
+ *
+ * @param section Section data
+ * @param size Section size
+ * @param offset Offset of the string
+ * @return const char* String or NULL if the offset is invalid
+ */
+static const char* section_string(const uint8_t* section, size_t size, uint64_t offset)
+{
+    if(section == NULL || offset >= size || memchr(&section[offset], '\0', size - offset) == NULL)
+    {
+        return NULL;
+    }
+    return (const char*)&section[offset];
+}
+
+static bool add_file(symbols_t* symbols, const char* name)
+{
+    if(symbols->file_count == symbols->file_capacity)
+    {
+        size_t new_capacity = symbols->file_capacity ? symbols->file_capacity * 2 : 64;
+        const char** files = realloc(symbols->files, new_capacity * sizeof(*files));
+        if(files == NULL)
+        {
+            return false;
+        }
+        symbols->files = files;
+        symbols->file_capacity = new_capacity;
+    }
+    symbols->files[symbols->file_count++] = name ? name : "??";
+    return true;
+}
+
+static bool add_row(symbols_t* symbols, uint64_t address, uint32_t file, uint32_t line)
+{
+    if(symbols->row_count == symbols->row_capacity)
+    {
+        size_t new_capacity = symbols->row_capacity ? symbols->row_capacity * 2 : 4096;
+        line_row_t* rows = realloc(symbols->rows, new_capacity * sizeof(*rows));
+        if(rows == NULL)
+        {
+            return false;
+        }
+        symbols->rows = rows;
+        symbols->row_capacity = new_capacity;
+    }
+    line_row_t* row = &symbols->rows[symbols->row_count++];
+    row->address = address;
+    row->file = file;
+    row->line = line;
+    return true;
+}
+
+/**
+ * @brief Read a DWARF 5 entry format list and the entries described by it
+ *
+ * Only DW_LNCT_path is kept, all other content is skipped.
+ *
+ * @param symbols Symbols being loaded
+ * @param reader Reader positioned at the entry format count
+ * @param offset_size Size of section offsets (4 or 8)
+ * @param add_files true to add the paths to the file list
+ * @return true on success, false on an unsupported form
+ */
+static bool read_entries_v5(symbols_t* symbols, reader_t* reader, size_t offset_size, bool add_files)
+{
+    uint64_t formats[16][2];
+    uint8_t format_count = (uint8_t)read_value(reader, 1);
+    if(format_count > 16)
+    {
+        return false;
+    }
+    for(uint8_t i = 0; i < format_count; i++)
+    {
+        formats[i][0] = read_uleb(reader);
+        formats[i][1] = read_uleb(reader);
+    }
+
+    uint64_t count = read_uleb(reader);
+    for(uint64_t entry = 0; entry < count && !reader->error; entry++)
+    {
+        const char* path = NULL;
+        for(uint8_t i = 0; i < format_count; i++)
+        {
+            const char* string = NULL;
+            switch(formats[i][1])
+            {
+                case DW_FORM_string:    string = read_string(reader); break;
+                case DW_FORM_line_strp: string = section_string(symbols->line_str, symbols->line_str_size, read_value(reader, offset_size)); break;
+                case DW_FORM_strp:      string = section_string(symbols->str, symbols->str_size, read_value(reader, offset_size)); break;
+                case DW_FORM_udata:     read_uleb(reader); break;
+                case DW_FORM_data1:     skip(reader, 1); break;
+                case DW_FORM_data2:     skip(reader, 2); break;
+                case DW_FORM_data4:     skip(reader, 4); break;
+                case DW_FORM_data8:     skip(reader, 8); break;
+                case DW_FORM_data16:    skip(reader, 16); break;
+                case DW_FORM_block:     skip(reader, read_uleb(reader)); break;
+                case DW_FORM_strx:      read_uleb(reader); break; // needs .debug_str_offsets - name stays unknown
+                case DW_FORM_strx1:     skip(reader, 1); break;
+                case DW_FORM_strx2:     skip(reader, 2); break;
+                case DW_FORM_strx3:     skip(reader, 3); break;
+                case DW_FORM_strx4:     skip(reader, 4); break;
+                default:
+                    TRACE_WARN("Unsupported DWARF form 0x%" PRIx64 " in line table header\n", formats[i][1]);
+                    return false;
+            }
+            if(formats[i][0] == DW_LNCT_path)
+            {
+                path = string;
+            }
+        }
+        if(add_files && !add_file(symbols, path))
+        {
+            return false;
+        }
+    }
+    return !reader->error;
+}
+
+/**
+ * @brief Parse a single line number program
+ *
+ * @param symbols Symbols being loaded
+ * @param reader Reader positioned at the unit length, moved past the unit
+ * @return true on success, false if the unit could not be parsed
+ */
+static bool parse_line_unit(symbols_t* symbols, reader_t* reader)
+{
+    size_t offset_size = 4;
+    uint64_t unit_length = read_value(reader, 4);
+    if(unit_length == 0xFFFFFFFF)
+    {
+        offset_size = 8;
+        unit_length = read_value(reader, 8);
+    }
+    if(reader->error || unit_length > (uint64_t)(reader->end - reader->position))
+    {
+        return false;
+    }
+    reader_t unit = { reader->position, reader->position + unit_length, false };
+    reader->position = unit.end;
+
+    uint16_t version = (uint16_t)read_value(&unit, 2);
+    if(version < 2 || version > 5)
+    {
+        TRACE_VERBOSE("Skipping line table version %u\n", version);
+        return true;
+    }
+    if(version >= 5)
+    {
+        read_value(&unit, 1); // address_size
+        read_value(&unit, 1); // segment_selector_size
+    }
+    uint64_t header_length = read_value(&unit, offset_size);
+    if(unit.error || header_length > (uint64_t)(unit.end - unit.position))
+    {
+        return false;
+    }
+    const uint8_t* program = unit.position + header_length;
+
+    uint8_t min_instruction_length = (uint8_t)read_value(&unit, 1);
+    if(version >= 4)
+    {
+        read_value(&unit, 1); // maximum_operations_per_instruction (VLIW only)
+    }
+    bool default_is_stmt = read_value(&unit, 1) != 0;
+    int8_t line_base = (int8_t)read_value(&unit, 1);
+    uint8_t line_range = (uint8_t)read_value(&unit, 1);
+    uint8_t opcode_base = (uint8_t)read_value(&unit, 1);
+    uint8_t opcode_lengths[256] = { 0 };
+    for(unsigned i = 1; i < opcode_base; i++)
+    {
+        opcode_lengths[i] = (uint8_t)read_value(&unit, 1);
+    }
+    (void)default_is_stmt;
+    if(unit.error || line_range == 0)
+    {
+        return false;
+    }
+
+    // File numbers are 1-based before DWARF 5 and 0-based since
+    size_t first_file = symbols->file_count;
+    if(version >= 5)
+    {
+        if(!read_entries_v5(symbols, &unit, offset_size, false) ||
+           !read_entries_v5(symbols, &unit, offset_size, true))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        while(!unit.error && unit.position < unit.end && *unit.position != '\0')
+        {
+            read_string(&unit); // include_directories
+        }
+        skip(&unit, 1);
+        if(!add_file(symbols, NULL)) // file 0 is not used
+        {
+            return false;
+        }
+        while(!unit.error && unit.position < unit.end && *unit.position != '\0')
+        {
+            const char* name = read_string(&unit);
+            read_uleb(&unit); // directory
+            read_uleb(&unit); // modification time
+            read_uleb(&unit); // length
+            if(!add_file(symbols, name))
+            {
+                return false;
+            }
+        }
+    }
+    if(unit.error)
+    {
+        return false;
+    }
+    size_t file_count = symbols->file_count - first_file;
+
+    unit.position = program;
+    uint64_t address = 0;
+    uint64_t file = version >= 5 ? 0 : 1;
+    int64_t line = 1;
+    while(!unit.error && unit.position < unit.end)
+    {
+        uint8_t opcode = (uint8_t)read_value(&unit, 1);
+        bool emit = false;
+        if(opcode >= opcode_base)
+        {
+            uint8_t adjusted = opcode - opcode_base;
+            address += (uint64_t)(adjusted / line_range) * min_instruction_length;
+            line += line_base + adjusted % line_range;
+            emit = true;
+        }
+        else if(opcode == 0)
+        {
+            uint64_t length = read_uleb(&unit);
+            if(unit.error || length == 0 || length > (uint64_t)(unit.end - unit.position))
+            {
+                return false;
+            }
+            const uint8_t* next = unit.position + length;
+            uint8_t sub_opcode = (uint8_t)read_value(&unit, 1);
+            if(sub_opcode == DW_LNE_end_sequence)
+            {
+                if(!add_row(symbols, address, 0, 0))
+                {
+                    return false;
+                }
+                address = 0;
+                file = version >= 5 ? 0 : 1;
+                line = 1;
+            }
+            else if(sub_opcode == DW_LNE_set_address)
+            {
+                address = read_value(&unit, length - 1 > 8 ? 8 : length - 1);
+            }
+            else if(sub_opcode == DW_LNE_define_file)
+            {
+                if(!add_file(symbols, read_string(&unit)))
+                {
+                    return false;
+                }
+                file_count++;
+            }
+            unit.position = next;
+        }
+        else
+        {
+            switch(opcode)
+            {
+                case DW_LNS_copy:
+                    emit = true;
+                    break;
+                case DW_LNS_advance_pc:
+                    address += read_uleb(&unit) * min_instruction_length;
+                    break;
+                case DW_LNS_advance_line:
+                    line += read_sleb(&unit);
+                    break;
+                case DW_LNS_set_file:
+                    file = read_uleb(&unit);
+                    break;
+                case DW_LNS_const_add_pc:
+                    address += (uint64_t)((255 - opcode_base) / line_range) * min_instruction_length;
+                    break;
+                case DW_LNS_fixed_advance_pc:
+                    address += read_value(&unit, 2);
+                    break;
+                default:
+                    // Skip the operands of opcodes that do not affect the address or line
+                    for(uint8_t i = 0; i < opcode_lengths[opcode]; i++)
+                    {
+                        read_uleb(&unit);
+                    }
+                    break;
+            }
+        }
+
+        if(emit && line > 0)
+        {
+            uint32_t file_index = file < file_count ? (uint32_t)(first_file + file) : 0;
+            if(!add_row(symbols, address, file_index, (uint32_t)line))
+            {
+                return false;
+            }
+        }
+    }
+    return !unit.error;
+}
+
+static int compare_rows(const void* a, const void* b)
+{
+    const line_row_t* row_a = a;
+    const line_row_t* row_b = b;
+    if(row_a->address != row_b->address)
+    {
+        return row_a->address < row_b->address ? -1 : 1;
+    }
+    // A sequence may start where the previous one ended - keep its end marker first
+    if((row_a->line == 0) != (row_b->line == 0))
+    {
+        return row_a->line == 0 ? -1 : 1;
+    }
+    return 0;
+}
+
+static int compare_functions(const void* a, const void* b)
+{
+    const symbol_t* symbol_a = a;
+    const symbol_t* symbol_b = b;
+    if(symbol_a->address != symbol_b->address)
+    {
+        return symbol_a->address < symbol_b->address ? -1 : 1;
+    }
+    // Prefer sized symbols for aliases
+    return (symbol_a->size == 0) - (symbol_b->size == 0);
+}
+
+/**
+ * @brief Read the section table of the ELF file
+ *
+ * @param symbols Symbols being loaded
+ * @param count Pointer to store the number of sections
+ * @return section_t* Allocated section table, NULL on failure
+ */
+static section_t* read_sections(symbols_t* symbols, size_t* count)
+{
+    bool is_64 = symbols->data[EI_CLASS] == ELFCLASS64;
+    uint64_t table_offset;
+    size_t entry_size;
+    size_t section_count;
+    size_t names_index;
+    if(is_64)
+    {
+        const Elf64_Ehdr* header = (const Elf64_Ehdr*)symbols->data;
+        table_offset = header->e_shoff;
+        entry_size = header->e_shentsize;
+        section_count = header->e_shnum;
+        names_index = header->e_shstrndx;
+    }
+    else
+    {
+        const Elf32_Ehdr* header = (const Elf32_Ehdr*)symbols->data;
+        table_offset = header->e_shoff;
+        entry_size = header->e_shentsize;
+        section_count = header->e_shnum;
+        names_index = header->e_shstrndx;
+    }
+    if(section_count == 0 || entry_size < (is_64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr)) ||
+       table_offset > symbols->size || (symbols->size - table_offset) / entry_size < section_count ||
+       names_index >= section_count)
+    {
+        TRACE_ERROR("Invalid ELF section table\n");
+        return NULL;
+    }
+
+    section_t* sections = calloc(section_count, sizeof(section_t));
+    if(sections == NULL)
+    {
+        TRACE_ERROR("Failed to allocate ELF section table\n");
+        return NULL;
+    }
+    for(size_t i = 0; i < section_count; i++)
+    {
+        const uint8_t* entry = &symbols->data[table_offset + i * entry_size];
+        if(is_64)
+        {
+            Elf64_Shdr header;
+            memcpy(&header, entry, sizeof(header));
+            sections[i].name_offset = header.sh_name;
+            sections[i].type = header.sh_type;
+            sections[i].offset = header.sh_offset;
+            sections[i].size = header.sh_size;
+            sections[i].link = header.sh_link;
+            sections[i].entsize = header.sh_entsize;
+        }
+        else
+        {
+            Elf32_Shdr header;
+            memcpy(&header, entry, sizeof(header));
+            sections[i].name_offset = header.sh_name;
+            sections[i].type = header.sh_type;
+            sections[i].offset = header.sh_offset;
+            sections[i].size = header.sh_size;
+            sections[i].link = header.sh_link;
+            sections[i].entsize = header.sh_entsize;
+        }
+        if(sections[i].type != SHT_NOBITS &&
+           (sections[i].offset > symbols->size || sections[i].size > symbols->size - sections[i].offset))
+        {
+            sections[i].type = SHT_NULL; // Truncated file - ignore the section
+            sections[i].size = 0;
+        }
+    }
+
+    const section_t* names = &sections[names_index];
+    for(size_t i = 0; i < section_count; i++)
+    {
+        const char* name = section_string(&symbols->data[names->offset], names->size, sections[i].name_offset);
+        sections[i].name = name ? name : "";
+    }
+    *count = section_count;
+    return sections;
+}
+
+/**
+ * @brief Load function and data object symbols from a symbol table section
+ *
+ * @param symbols Symbols being loaded
+ * @param sections Section table
+ * @param section_count Number of sections
+ * @param table Symbol table section
+ * @return true on success, false on failure
+ */
+static bool load_symbols(symbols_t* symbols, const section_t* sections, size_t section_count, const section_t* table)
+{
+    bool is_64 = symbols->data[EI_CLASS] == ELFCLASS64;
+    size_t entry_size = is_64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+    if(table->entsize < entry_size || table->link >= section_count)
+    {
+        return false;
+    }
+    const section_t* strings = &sections[table->link];
+    const uint8_t* string_data = &symbols->data[strings->offset];
+    uint16_t machine = ((const Elf32_Ehdr*)symbols->data)->e_machine;
+
+    size_t count = table->size / table->entsize;
+    symbols->functions = calloc(count ? count : 1, sizeof(symbol_t));
+    symbols->objects = calloc(count ? count : 1, sizeof(object_t));
+    if(symbols->functions == NULL || symbols->objects == NULL)
+    {
+        return false;
+    }
+    for(size_t i = 0; i < count; i++)
+    {
+        const uint8_t* entry = &symbols->data[table->offset + i * table->entsize];
+        uint64_t value, size;
+        uint32_t name;
+        uint8_t info;
+        uint16_t section;
+        if(is_64)
+        {
+            Elf64_Sym symbol;
+            memcpy(&symbol, entry, sizeof(symbol));
+            value = symbol.st_value; size = symbol.st_size; name = symbol.st_name;
+            info = symbol.st_info; section = symbol.st_shndx;
+        }
+        else
+        {
+            Elf32_Sym symbol;
+            memcpy(&symbol, entry, sizeof(symbol));
+            value = symbol.st_value; size = symbol.st_size; name = symbol.st_name;
+            info = symbol.st_info; section = symbol.st_shndx;
+        }
+        uint8_t type = ELF32_ST_TYPE(info);
+        if((type != STT_FUNC && type != STT_OBJECT) || section == SHN_UNDEF || value == 0)
+        {
+            continue;
+        }
+        const char* symbol_name = section_string(string_data, strings->size, name);
+        if(symbol_name == NULL || symbol_name[0] == '\0')
+        {
+            continue;
+        }
+        if(type == STT_OBJECT)
+        {
+            object_t* object = &symbols->objects[symbols->object_count++];
+            object->address = value;
+            object->size = size;
+            object->name = symbol_name;
+            object->global = ELF32_ST_BIND(info) != STB_LOCAL;
+            continue;
+        }
+        if(machine == EM_ARM)
+        {
+            value &= ~(uint64_t)1; // Thumb bit
+        }
+        symbol_t* function = &symbols->functions[symbols->function_count++];
+        function->address = value;
+        function->size = size;
+        function->name = symbol_name;
+    }
+    qsort(symbols->functions, symbols->function_count, sizeof(symbol_t), compare_functions);
+    return true;
+}
+
+/**
+ * @brief Read the header of a .debug_info unit
+ *
+ * Units other than compile and partial units (e.g. type units) are skipped -
+ * their DIE list is empty.
+ *
+ * @param symbols Loaded symbols
+ * @param offset Offset of the unit header in .debug_info
+ * @param unit Unit to fill
+ * @return true on success, false if there is no valid unit at the offset
+ */
+static bool read_unit_header(symbols_t* symbols, uint64_t offset, unit_t* unit)
+{
+    memset(unit, 0, sizeof(*unit));
+    if(offset >= symbols->info_size)
+    {
+        return false;
+    }
+    reader_t reader = { &symbols->info[offset], &symbols->info[symbols->info_size], false };
+    unit->offset = offset;
+    unit->offset_size = 4;
+    uint64_t unit_length = read_value(&reader, 4);
+    if(unit_length == 0xFFFFFFFF)
+    {
+        unit->offset_size = 8;
+        unit_length = read_value(&reader, 8);
+    }
+    if(reader.error || unit_length > (uint64_t)(reader.end - reader.position))
+    {
+        return false;
+    }
+    unit->end = reader.position + unit_length;
+    unit->dies = unit->end;
+    reader.end = unit->end;
+
+    unit->version = (uint16_t)read_value(&reader, 2);
+    if(unit->version == 5)
+    {
+        uint8_t unit_type = (uint8_t)read_value(&reader, 1);
+        unit->address_size = (uint8_t)read_value(&reader, 1);
+        unit->abbrev_offset = read_value(&reader, unit->offset_size);
+        if(unit_type != DW_UT_compile && unit_type != DW_UT_partial)
+        {
+            return !reader.error;
+        }
+    }
+    else if(unit->version >= 2 && unit->version <= 4)
+    {
+        unit->abbrev_offset = read_value(&reader, unit->offset_size);
+        unit->address_size = (uint8_t)read_value(&reader, 1);
+    }
+    else
+    {
+        return true; // Unsupported version - skipped
+    }
+    if(reader.error || unit->abbrev_offset >= symbols->abbrev_size)
+    {
+        return false;
+    }
+    unit->dies = reader.position;
+    return true;
+}
+
+/**
+ * @brief Release the abbreviation table of a unit
+ *
+ * @param unit Unit
+ */
+static void free_abbrevs(unit_t* unit)
+{
+    free(unit->abbrevs);
+    unit->abbrevs = NULL;
+    unit->abbrev_count = 0;
+}
+
+/**
+ * @brief Index the abbreviation table of a unit by code
+ *
+ * @param symbols Loaded symbols
+ * @param unit Unit read with read_unit_header() (release with free_abbrevs())
+ * @return true on success, false on failure
+ */
+static bool load_abbrevs(symbols_t* symbols, unit_t* unit)
+{
+    reader_t abbrevs = { &symbols->abbrev[unit->abbrev_offset], &symbols->abbrev[symbols->abbrev_size], false };
+    size_t capacity = 0;
+    for(;;)
+    {
+        uint64_t code = read_uleb(&abbrevs);
+        if(code == 0 || abbrevs.error)
+        {
+            break;
+        }
+        if(code >= capacity)
+        {
+            size_t new_capacity = capacity ? capacity : 64;
+            while(new_capacity <= code && new_capacity <= SYMBOLS_MAX_ABBREV_CODE)
+            {
+                new_capacity *= 2;
+            }
+            const uint8_t** table = new_capacity > SYMBOLS_MAX_ABBREV_CODE ? NULL :
+                                    realloc(unit->abbrevs, new_capacity * sizeof(*table));
+            if(table == NULL)
+            {
+                free_abbrevs(unit);
+                return false;
+            }
+            memset(&table[capacity], 0, (new_capacity - capacity) * sizeof(*table));
+            unit->abbrevs = table;
+            capacity = new_capacity;
+        }
+        unit->abbrevs[code] = abbrevs.position;
+        if(code >= unit->abbrev_count)
+        {
+            unit->abbrev_count = code + 1;
+        }
+        read_uleb(&abbrevs); // tag
+        skip(&abbrevs, 1);   // children
+        for(;;)
+        {
+            uint64_t name = read_uleb(&abbrevs);
+            uint64_t form = read_uleb(&abbrevs);
+            if(form == DW_FORM_implicit_const)
+            {
+                read_sleb(&abbrevs);
+            }
+            if((name == 0 && form == 0) || abbrevs.error)
+            {
+                break;
+            }
+        }
+    }
+    if(abbrevs.error)
+    {
+        free_abbrevs(unit);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Read an attribute value of a DIE
+ *
+ * @param symbols Loaded symbols
+ * @param unit Unit of the DIE
+ * @param reader Reader positioned at the value
+ * @param form Form of the value
+ * @param implicit_value Value of a DW_FORM_implicit_const attribute
+ * @param value Pointer to store constants and references (as .debug_info offsets)
+ * @param string Pointer to store strings
+ * @return true on success, false on an unsupported form
+ */
+static bool read_attribute(symbols_t* symbols, const unit_t* unit, reader_t* reader, uint64_t form,
+                           int64_t implicit_value, uint64_t* value, const char** string)
+{
+    *value = 0;
+    *string = NULL;
+    switch(form)
+    {
+        case DW_FORM_addr:          *value = read_value(reader, unit->address_size); break;
+        case DW_FORM_block1:        skip(reader, read_value(reader, 1)); break;
+        case DW_FORM_block2:        skip(reader, read_value(reader, 2)); break;
+        case DW_FORM_block4:        skip(reader, read_value(reader, 4)); break;
+        case DW_FORM_block:
+        case DW_FORM_exprloc:       skip(reader, read_uleb(reader)); break;
+        case DW_FORM_data1:
+        case DW_FORM_flag:
+        case DW_FORM_strx1:
+        case DW_FORM_addrx1:        *value = read_value(reader, 1); break;
+        case DW_FORM_data2:
+        case DW_FORM_strx2:
+        case DW_FORM_addrx2:        *value = read_value(reader, 2); break;
+        case DW_FORM_strx3:
+        case DW_FORM_addrx3:        *value = read_value(reader, 3); break;
+        case DW_FORM_data4:
+        case DW_FORM_ref_sup4:
+        case DW_FORM_strx4:
+        case DW_FORM_addrx4:        *value = read_value(reader, 4); break;
+        case DW_FORM_data8:
+        case DW_FORM_ref_sig8:
+        case DW_FORM_ref_sup8:      *value = read_value(reader, 8); break;
+        case DW_FORM_data16:        skip(reader, 16); break;
+        case DW_FORM_sdata:         *value = (uint64_t)read_sleb(reader); break;
+        case DW_FORM_udata:
+        case DW_FORM_strx:          // needs .debug_str_offsets - name stays unknown
+        case DW_FORM_addrx:
+        case DW_FORM_loclistx:
+        case DW_FORM_rnglistx:
+        case DW_FORM_GNU_addr_index:
+        case DW_FORM_GNU_str_index: *value = read_uleb(reader); break;
+        case DW_FORM_string:        *string = read_string(reader); break;
+        case DW_FORM_strp:          *string = section_string(symbols->str, symbols->str_size, read_value(reader, unit->offset_size)); break;
+        case DW_FORM_line_strp:     *string = section_string(symbols->line_str, symbols->line_str_size, read_value(reader, unit->offset_size)); break;
+        case DW_FORM_sec_offset:
+        case DW_FORM_strp_sup:
+        case DW_FORM_GNU_ref_alt:
+        case DW_FORM_GNU_strp_alt:  *value = read_value(reader, unit->offset_size); break;
+        case DW_FORM_ref_addr:      *value = read_value(reader, unit->version == 2 ? unit->address_size : unit->offset_size); break;
+        case DW_FORM_ref1:          *value = unit->offset + read_value(reader, 1); break;
+        case DW_FORM_ref2:          *value = unit->offset + read_value(reader, 2); break;
+        case DW_FORM_ref4:          *value = unit->offset + read_value(reader, 4); break;
+        case DW_FORM_ref8:          *value = unit->offset + read_value(reader, 8); break;
+        case DW_FORM_ref_udata:     *value = unit->offset + read_uleb(reader); break;
+        case DW_FORM_flag_present:  *value = 1; break;
+        case DW_FORM_implicit_const: *value = (uint64_t)implicit_value; break;
+        case DW_FORM_indirect:
+            return read_attribute(symbols, unit, reader, read_uleb(reader), implicit_value, value, string);
+        default:
+            TRACE_VERBOSE("Unsupported DWARF form 0x%" PRIx64 " in .debug_info\n", form);
+            return false;
+    }
+    return !reader->error;
+}
+
+/**
+ * @brief Read a debugging information entry
+ *
+ * @param symbols Loaded symbols
+ * @param unit Unit of the DIE
+ * @param reader Reader positioned at the DIE, moved past it
+ * @param die Pointer to store the attributes used by the type parser
+ * @return true on success, false if the DIE could not be parsed
+ */
+static bool read_die(symbols_t* symbols, const unit_t* unit, reader_t* reader, die_t* die)
+{
+    memset(die, 0, sizeof(*die));
+    uint64_t code = read_uleb(reader);
+    if(code == 0 || reader->error)
+    {
+        return !reader->error; // Null entry
+    }
+    if(code >= unit->abbrev_count || unit->abbrevs[code] == NULL)
+    {
+        return false;
+    }
+    reader_t abbrev = { unit->abbrevs[code], &symbols->abbrev[symbols->abbrev_size], false };
+    die->tag = read_uleb(&abbrev);
+    die->has_children = read_value(&abbrev, 1) != 0;
+    for(;;)
+    {
+        uint64_t name = read_uleb(&abbrev);
+        uint64_t form = read_uleb(&abbrev);
+        int64_t implicit_value = form == DW_FORM_implicit_const ? read_sleb(&abbrev) : 0;
+        if((name == 0 && form == 0) || abbrev.error)
+        {
+            break;
+        }
+        uint64_t value;
+        const char* string;
+        if(!read_attribute(symbols, unit, reader, form, implicit_value, &value, &string))
+        {
+            return false;
+        }
+        switch(name)
+        {
+            case DW_AT_name:        die->name = string; break;
+            case DW_AT_byte_size:   die->byte_size = value; break;
+            case DW_AT_encoding:    die->encoding = value; break;
+            case DW_AT_type:        die->type = value; break;
+            default:                break;
+        }
+    }
+    return !abbrev.error;
+}
+
+/**
+ * @brief Read the DIE at the given .debug_info offset
+ *
+ * @param symbols Loaded symbols
+ * @param offset Offset of the DIE
+ * @param die Pointer to store the DIE
+ * @param address_size Pointer to store the address size of its unit
+ * @return true on success, false if there is no valid DIE at the offset
+ */
+static bool read_die_at(symbols_t* symbols, uint64_t offset, die_t* die, uint8_t* address_size)
+{
+    unit_t unit;
+    uint64_t unit_offset = 0;
+    while(read_unit_header(symbols, unit_offset, &unit))
+    {
+        uint64_t end = (uint64_t)(unit.end - symbols->info);
+        if(offset < end)
+        {
+            bool result = false;
+            if(offset >= (uint64_t)(unit.dies - symbols->info) && load_abbrevs(symbols, &unit))
+            {
+                reader_t reader = { &symbols->info[offset], unit.end, false };
+                result = read_die(symbols, &unit, &reader, die);
+                *address_size = unit.address_size;
+                free_abbrevs(&unit);
+            }
+            return result;
+        }
+        unit_offset = end;
+    }
+    return false;
+}
+
+/**
+ * @brief Find the type of a global variable in the DWARF information
+ *
+ * @param symbols Loaded symbols
+ * @param name Variable name
+ * @return uint64_t Offset of the type DIE in .debug_info, 0 if not found
+ */
+static uint64_t find_variable_type(symbols_t* symbols, const char* name)
+{
+    unit_t unit;
+    uint64_t unit_offset = 0;
+    uint64_t type = 0;
+    while(type == 0 && read_unit_header(symbols, unit_offset, &unit))
+    {
+        unit_offset = (uint64_t)(unit.end - symbols->info);
+        if(unit.dies == unit.end || !load_abbrevs(symbols, &unit))
+        {
+            continue;
+        }
+        reader_t reader = { unit.dies, unit.end, false };
+        int depth = 0;
+        while(reader.position < reader.end)
+        {
+            die_t die;
+            if(!read_die(symbols, &unit, &reader, &die))
+            {
+                TRACE_VERBOSE("Failed to parse .debug_info unit at 0x%" PRIx64 "\n", unit.offset);
+                break;
+            }
+            if(die.tag == 0)
+            {
+                depth--;
+                continue;
+            }
+            // Only variables at the file scope - function statics have other symbol names
+            if(die.tag == DW_TAG_variable && depth == 1 && die.type != 0 &&
+               die.name != NULL && strcmp(die.name, name) == 0)
+            {
+                type = die.type;
+                break;
+            }
+            if(die.has_children)
+            {
+                depth++;
+            }
+        }
+        free_abbrevs(&unit);
+    }
+    return type;
+}
+
+/**
+ * @brief Classify a type from the DWARF information
+ *
+ * Typedefs and qualifiers are followed to the base, pointer or enumeration
+ * type. Other types (structures, arrays, ...) are left unknown.
+ *
+ * @param symbols Loaded symbols
+ * @param type Offset of the type DIE in .debug_info
+ * @param variable Variable to set the type and the type size of
+ */
+static void resolve_type(symbols_t* symbols, uint64_t type, symbols_variable_t* variable)
+{
+    for(int i = 0; i < SYMBOLS_MAX_TYPE_CHAIN && type != 0; i++)
+    {
+        die_t die;
+        uint8_t address_size = 0;
+        if(!read_die_at(symbols, type, &die, &address_size))
+        {
+            return;
+        }
+        switch(die.tag)
+        {
+            case DW_TAG_typedef:
+            case DW_TAG_const_type:
+            case DW_TAG_volatile_type:
+            case DW_TAG_restrict_type:
+            case DW_TAG_atomic_type:
+                type = die.type;
+                continue;
+            case DW_TAG_pointer_type:
+                variable->type = SYMBOLS_TYPE_POINTER;
+                variable->type_size = die.byte_size ? die.byte_size : address_size;
+                return;
+            case DW_TAG_enumeration_type:
+                variable->type = SYMBOLS_TYPE_SIGNED;
+                variable->type_size = die.byte_size;
+                return;
+            case DW_TAG_base_type:
+                switch(die.encoding)
+                {
+                    case DW_ATE_boolean:        variable->type = SYMBOLS_TYPE_BOOL; break;
+                    case DW_ATE_float:          variable->type = SYMBOLS_TYPE_FLOAT; break;
+                    case DW_ATE_signed:
+                    case DW_ATE_signed_char:    variable->type = SYMBOLS_TYPE_SIGNED; break;
+                    case DW_ATE_unsigned:
+                    case DW_ATE_unsigned_char:
+                    case DW_ATE_UTF:            variable->type = SYMBOLS_TYPE_UNSIGNED; break;
+                    default:                    variable->type = SYMBOLS_TYPE_UNKNOWN; break;
+                }
+                variable->type_size = die.byte_size;
+                return;
+            default:
+                return;
+        }
+    }
+}
+
+/**
+ * @brief Load symbols and line information from an ELF file
+ *
+ * @param path Path to the ELF file
+ * @return symbols_t* Loaded symbols, NULL on failure
+ */
+symbols_t* symbols_load(const char* path)
+{
+    symbols_t* symbols = calloc(1, sizeof(symbols_t));
+    if(symbols == NULL)
+    {
+        TRACE_ERROR("Failed to allocate symbols\n");
+        return NULL;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if(file == NULL)
+    {
+        TRACE_ERROR("Failed to open ELF file: %s\n", path);
+        free(symbols);
+        return NULL;
+    }
+    long size = -1;
+    if(fseek(file, 0, SEEK_END) == 0)
+    {
+        size = ftell(file);
+    }
+    if(size < (long)sizeof(Elf32_Ehdr) || fseek(file, 0, SEEK_SET) != 0 ||
+       (symbols->data = malloc((size_t)size)) == NULL ||
+       fread(symbols->data, 1, (size_t)size, file) != (size_t)size)
+    {
+        TRACE_ERROR("Failed to read ELF file: %s\n", path);
+        fclose(file);
+        symbols_free(symbols);
+        return NULL;
+    }
+    fclose(file);
+    symbols->size = (size_t)size;
+
+    const uint8_t* ident = symbols->data;
+    if(memcmp(ident, ELFMAG, SELFMAG) != 0 || ident[EI_DATA] != ELFDATA2LSB ||
+       (ident[EI_CLASS] != ELFCLASS32 && ident[EI_CLASS] != ELFCLASS64) ||
+       (ident[EI_CLASS] == ELFCLASS64 && symbols->size < sizeof(Elf64_Ehdr)))
+    {
+        TRACE_ERROR("Not a little-endian ELF file: %s\n", path);
+        symbols_free(symbols);
+        return NULL;
+    }
+
+    size_t section_count = 0;
+    section_t* sections = read_sections(symbols, &section_count);
+    if(sections == NULL)
+    {
+        symbols_free(symbols);
+        return NULL;
+    }
+
+    const section_t* symtab = NULL;
+    const section_t* debug_line = NULL;
+    for(size_t i = 0; i < section_count; i++)
+    {
+        const section_t* section = &sections[i];
+        if(section->type == SHT_SYMTAB || (section->type == SHT_DYNSYM && symtab == NULL))
+        {
+            symtab = section;
+        }
+        else if(strcmp(section->name, ".debug_line") == 0)
+        {
+            debug_line = section;
+        }
+        else if(strcmp(section->name, ".debug_line_str") == 0)
+        {
+            symbols->line_str = &symbols->data[section->offset];
+            symbols->line_str_size = section->size;
+        }
+        else if(strcmp(section->name, ".debug_str") == 0)
+        {
+            symbols->str = &symbols->data[section->offset];
+            symbols->str_size = section->size;
+        }
+        else if(strcmp(section->name, ".debug_info") == 0 && section->type != SHT_NOBITS)
+        {
+            symbols->info = &symbols->data[section->offset];
+            symbols->info_size = section->size;
+        }
+        else if(strcmp(section->name, ".debug_abbrev") == 0 && section->type != SHT_NOBITS)
+        {
+            symbols->abbrev = &symbols->data[section->offset];
+            symbols->abbrev_size = section->size;
+        }
+    }
+
+    if(symtab == NULL || !load_symbols(symbols, sections, section_count, symtab))
+    {
+        TRACE_WARN("No function symbols in %s\n", path);
+    }
+
+    if(debug_line != NULL && add_file(symbols, NULL)) // file 0 - unknown file
+    {
+        reader_t reader = { &symbols->data[debug_line->offset], &symbols->data[debug_line->offset + debug_line->size], false };
+        while(reader.position < reader.end)
+        {
+            if(!parse_line_unit(symbols, &reader))
+            {
+                TRACE_WARN("Failed to parse line table in %s - line information is incomplete\n", path);
+                break;
+            }
+        }
+        qsort(symbols->rows, symbols->row_count, sizeof(line_row_t), compare_rows);
+    }
+    else
+    {
+        TRACE_WARN("No line information in %s (build with -g)\n", path);
+    }
+    free(sections);
+
+    symbols->cache = calloc(SYMBOLS_CACHE_SIZE, sizeof(cache_entry_t));
+    if(symbols->cache == NULL)
+    {
+        TRACE_ERROR("Failed to allocate symbol cache\n");
+        symbols_free(symbols);
+        return NULL;
+    }
+
+    TRACE_INFO("Loaded %zu functions and %zu line table rows from %s\n",
+               symbols->function_count, symbols->row_count, path);
+    return symbols;
+}
+
+/**
+ * @brief Free the symbols
+ *
+ * @param symbols Symbols to free (may be NULL)
+ */
+void symbols_free(symbols_t* symbols)
+{
+    if(symbols)
+    {
+        free(symbols->cache);
+        free(symbols->files);
+        free(symbols->rows);
+        free(symbols->functions);
+        free(symbols->objects);
+        free(symbols->data);
+        free(symbols);
+    }
+}
+
+/**
+ * @brief Resolve an address to a function and a source line
+ *
+ * @param symbols Loaded symbols
+ * @param address Address to resolve
+ * @param return_address true if the address is a return address (the call
+ *                       instruction precedes it, so address - 1 is resolved)
+ * @param location Pointer to store the result
+ * @return true if the function or the line is known, false otherwise
+ */
+bool symbols_resolve(symbols_t* symbols, uint64_t address, bool return_address, symbols_location_t* location)
+{
+    memset(location, 0, sizeof(*location));
+    if(symbols == NULL)
+    {
+        return false;
+    }
+    uint64_t lookup = (return_address && address > 0) ? address - 1 : address;
+
+    // Last function starting at or before the address
+    size_t low = 0, high = symbols->function_count;
+    while(low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if(symbols->functions[middle].address <= lookup)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    if(low > 0)
+    {
+        // Unsized symbols extend up to the next function (never past the last one)
+        bool has_next = low < symbols->function_count;
+        const symbol_t* function = &symbols->functions[low - 1];
+        // Symbols with the same address are sorted with the sized ones first
+        while(low > 1 && symbols->functions[low - 2].address == function->address)
+        {
+            function = &symbols->functions[--low - 1];
+        }
+        if(function->size != 0 ? lookup < function->address + function->size : has_next)
+        {
+            location->function = function->name;
+            location->offset = address - function->address;
+        }
+    }
+
+    // Last line table row starting at or before the address
+    low = 0;
+    high = symbols->row_count;
+    while(low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if(symbols->rows[middle].address <= lookup)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    if(low > 0 && symbols->rows[low - 1].line != 0)
+    {
+        location->file = symbols->files[symbols->rows[low - 1].file];
+        location->line = symbols->rows[low - 1].line;
+    }
+    return location->function != NULL || location->file != NULL;
+}
+
+/**
+ * @brief Resolve an address to text such as "<main+0x1c> (main.c:42)"
+ *
+ * The result is cached, and stays valid until the cache slot is reused by
+ * another address - copy it if it has to be kept.
+ *
+ * @param symbols Loaded symbols
+ * @param address Address to resolve
+ * @param return_address true if the address is a return address
+ * @return const char* Formatted location, NULL if the address is unknown
+ */
+const char* symbols_lookup(symbols_t* symbols, uint64_t address, bool return_address)
+{
+    if(symbols == NULL)
+    {
+        return NULL;
+    }
+    uint64_t hash = (address >> 1) * 0x9E3779B97F4A7C15ull;
+    cache_entry_t* entry = &symbols->cache[(hash >> 32) & (SYMBOLS_CACHE_SIZE - 1)];
+    if(entry->valid && entry->address == address && entry->return_address == return_address)
+    {
+        return entry->found ? entry->text : NULL;
+    }
+
+    symbols_location_t location;
+    entry->valid = true;
+    entry->address = address;
+    entry->return_address = return_address;
+    entry->found = symbols_resolve(symbols, address, return_address, &location);
+    if(!entry->found)
+    {
+        return NULL;
+    }
+
+    size_t length = 0;
+    if(location.function)
+    {
+        length = snprintf(entry->text, sizeof(entry->text), "<%s+0x%" PRIx64 ">", location.function, location.offset);
+    }
+    if(location.file && length < sizeof(entry->text))
+    {
+        snprintf(&entry->text[length], sizeof(entry->text) - length, "%s(%s:%u)",
+                 length ? " " : "", location.file, location.line);
+    }
+    return entry->text;
+}
+
+/**
+ * @brief Find a global variable by name
+ *
+ * The address and the size are taken from the symbol table. The type comes
+ * from the DWARF information (.debug_info) when the ELF file has it; without
+ * it the type stays SYMBOLS_TYPE_UNKNOWN.
+ *
+ * @param symbols Loaded symbols
+ * @param name Variable name
+ * @param variable Pointer to store the variable
+ * @return true if the variable was found, false otherwise
+ */
+bool symbols_find_variable(symbols_t* symbols, const char* name, symbols_variable_t* variable)
+{
+    memset(variable, 0, sizeof(*variable));
+    if(symbols == NULL)
+    {
+        return false;
+    }
+    const object_t* found = NULL;
+    for(size_t i = 0; i < symbols->object_count; i++)
+    {
+        const object_t* object = &symbols->objects[i];
+        if(strcmp(object->name, name) == 0 && (found == NULL || (object->global && !found->global)))
+        {
+            found = object;
+        }
+    }
+    if(found == NULL)
+    {
+        return false;
+    }
+    variable->address = found->address;
+    variable->size = found->size;
+    if(symbols->info != NULL && symbols->abbrev != NULL)
+    {
+        resolve_type(symbols, find_variable_type(symbols, name), variable);
+    }
+    return true;
+}
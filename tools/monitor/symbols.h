@@ -0,0 +1,65 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @file symbols.h
+ * @brief Address to symbol resolution based on the firmware ELF file.
+ *
+ * Function symbols are taken from .symtab (or .dynsym) and source lines from
+ * the DWARF .debug_line section (versions 2 - 5). Both tables are sorted once
+ * when the ELF file is loaded, so resolving an address is a binary search.
+ * Formatted results are cached, because backtraces tend to repeat the same
+ * return addresses over and over. Global variables can be looked up by name,
+ * with their type taken from the DWARF .debug_info section.
+ */
+
+#define SYMBOLS_MAX_TEXT_LENGTH     256
+
+typedef struct symbols symbols_t;
+
+/**
+ * @brief Result of an address lookup
+ */
+typedef struct
+{
+    const char*     function;       //!< Function name, NULL if unknown
+    uint64_t        offset;         //!< Offset of the address in the function
+    const char*     file;           //!< Source file name, NULL if unknown
+    uint32_t        line;           //!< Source line, 0 if unknown
+} symbols_location_t;
+
+/**
+ * @brief Kind of a variable type
+ */
+typedef enum
+{
+    SYMBOLS_TYPE_UNKNOWN,           //!< No type information or an aggregate type
+    SYMBOLS_TYPE_SIGNED,            //!< Signed integer or enumeration
+    SYMBOLS_TYPE_UNSIGNED,          //!< Unsigned integer or character
+    SYMBOLS_TYPE_FLOAT,             //!< Floating point number
+    SYMBOLS_TYPE_BOOL,              //!< Boolean
+    SYMBOLS_TYPE_POINTER,           //!< Pointer
+} symbols_type_t;
+
+/**
+ * @brief Result of a variable lookup
+ */
+typedef struct
+{
+    uint64_t        address;        //!< Address of the variable
+    uint64_t        size;           //!< Size from the symbol table
+    symbols_type_t  type;           //!< Type from the DWARF information
+    uint64_t        type_size;      //!< Size of the type, 0 if unknown
+} symbols_variable_t;
+
+symbols_t* symbols_load(const char* path);
+void symbols_free(symbols_t* symbols);
+bool symbols_resolve(symbols_t* symbols, uint64_t address, bool return_address, symbols_location_t* location);
+const char* symbols_lookup(symbols_t* symbols, uint64_t address, bool return_address);
+bool symbols_find_variable(symbols_t* symbols, const char* name, symbols_variable_t* variable);
+
+#endif // SYMBOLS_H
@@ -0,0 +1,139 @@
+#include "tags.h"
+#include "dmlog.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+typedef char tag_set_t[DMLOG_TAG_SET_SIZE];
+
+struct tag_dictionary
+{
+    backend_type_t  backend_type;
+    int             socket;
+    uint64_t        table_address;  //!< Address of the dictionary on the target (0 - not enabled)
+    tag_set_t*      sets;           //!< Sets read so far
+    uint32_t        count;
+};
+
+/**
+ * @brief Read the sets added to the dictionary since the last read
+ *
+ * @param tags Tag dictionary
+ * @return true on success, false on failure
+ */
+static bool read_sets(tag_dictionary_t* tags)
+{
+    dmlog_tag_dictionary_t header;
+    if(backend_read_memory(tags->backend_type, tags->socket, tags->table_address, &header, sizeof(header)) < 0)
+    {
+        TRACE_ERROR("Failed to read tag dictionary from target at 0x%08" PRIx64 "\n", tags->table_address);
+        return false;
+    }
+    uint32_t capacity = header.capacity;
+    uint32_t count = header.count;
+    if(capacity == 0 || capacity > TAGS_MAX_SETS || count > capacity)
+    {
+        TRACE_ERROR("Invalid tag dictionary at 0x%08" PRIx64 " (capacity %u, count %u)\n", tags->table_address, capacity, count);
+        return false;
+    }
+    if(count < tags->count)
+    {
+        // The dictionary was enabled again - the old sets are gone
+        tags->count = 0;
+    }
+    if(count == tags->count)
+    {
+        return true;
+    }
+
+    tag_set_t* sets = realloc(tags->sets, count * sizeof(tag_set_t));
+    if(sets == NULL)
+    {
+        TRACE_ERROR("Failed to allocate tag dictionary\n");
+        return false;
+    }
+    tags->sets = sets;
+    uint64_t address = tags->table_address + sizeof(header) + (uint64_t)tags->count * sizeof(tag_set_t);
+    if(backend_read_memory(tags->backend_type, tags->socket, address, &sets[tags->count], (count - tags->count) * sizeof(tag_set_t)) < 0)
+    {
+        TRACE_ERROR("Failed to read tag sets from target\n");
+        return false;
+    }
+    for(uint32_t i = tags->count; i < count; i++)
+    {
+        sets[i][DMLOG_TAG_SET_SIZE - 1] = '\0';
+    }
+    TRACE_VERBOSE("Read %u new tag set(s) from the target\n", count - tags->count);
+    tags->count = count;
+    return true;
+}
+
+/**
+ * @brief Create an empty tag dictionary
+ *
+ * @param backend_type Backend type
+ * @param socket Backend socket
+ * @return tag_dictionary_t* Tag dictionary, NULL on failure
+ */
+tag_dictionary_t* tags_open(backend_type_t backend_type, int socket)
+{
+    tag_dictionary_t* tags = calloc(1, sizeof(tag_dictionary_t));
+    if(tags == NULL)
+    {
+        TRACE_ERROR("Failed to allocate tag dictionary\n");
+        return NULL;
+    }
+    tags->backend_type = backend_type;
+    tags->socket = socket;
+    return tags;
+}
+
+/**
+ * @brief Free the tag dictionary
+ *
+ * @param tags Tag dictionary (may be NULL)
+ */
+void tags_close(tag_dictionary_t* tags)
+{
+    if(tags)
+    {
+        free(tags->sets);
+        free(tags);
+    }
+}
+
+/**
+ * @brief Set the address of the dictionary published in the ring header
+ *
+ * @param tags Tag dictionary (may be NULL)
+ * @param table_address Address of the dictionary on the target (0 - not enabled)
+ */
+void tags_set_address(tag_dictionary_t* tags, uint64_t table_address)
+{
+    if(tags && table_address != tags->table_address)
+    {
+        tags->table_address = table_address;
+        tags->count = 0;
+    }
+}
+
+/**
+ * @brief Get the text of a tag set, reading new sets from the target if needed
+ *
+ * @param tags Tag dictionary (may be NULL)
+ * @param index Index of the set
+ * @return const char* Tag set, NULL if it is unknown
+ */
+const char* tags_lookup(tag_dictionary_t* tags, uint32_t index)
+{
+    if(tags == NULL || tags->table_address == 0)
+    {
+        return NULL;
+    }
+    if(index >= tags->count && !read_sets(tags))
+    {
+        return NULL;
+    }
+    return index < tags->count ? tags->sets[index] : NULL;
+}
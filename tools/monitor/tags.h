@@ -0,0 +1,28 @@
+#ifndef TAGS_H
+#define TAGS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "backend.h"
+
+/**
+ * @file tags.h
+ * @brief Host copy of the tag dictionary of the firmware.
+ *
+ * Lines logged with context tags start with the index of their tag set (see
+ * dmlog_tag_push()). When an unknown index arrives, the new sets are read
+ * from the dictionary the firmware publishes in the ring header. Sets never
+ * change once they are stored, so they are read only once.
+ */
+
+#define TAGS_MAX_SETS   65536   /* sanity limit of the dictionary capacity */
+
+typedef struct tag_dictionary tag_dictionary_t;
+
+tag_dictionary_t* tags_open(backend_type_t backend_type, int socket);
+void tags_close(tag_dictionary_t* tags);
+void tags_set_address(tag_dictionary_t* tags, uint64_t table_address);
+const char* tags_lookup(tag_dictionary_t* tags, uint32_t index);
+
+#endif // TAGS_H
@@ -0,0 +1,546 @@
+#include "watch.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define WATCH_MAX_NAME_LENGTH       64
+
+/**
+ * @brief Watched variable
+ */
+typedef struct
+{
+    char            name[WATCH_MAX_NAME_LENGTH];
+    uint64_t        address;
+    uint64_t        size;
+    symbols_type_t  type;
+    size_t          offset;         //!< Offset of the value in the sample buffer
+} watch_variable_t;
+
+/**
+ * @brief Single memory read covering one or more variables
+ */
+typedef struct
+{
+    uint64_t        address;
+    size_t          size;
+    size_t          offset;         //!< Offset of the data in the sample buffer
+} watch_read_t;
+
+/**
+ * @brief Type that can be given after the variable name
+ */
+typedef struct
+{
+    const char*     name;
+    symbols_type_t  type;
+    uint64_t        size;           //!< 0 - size of the symbol
+} watch_type_t;
+
+static const watch_type_t watch_types[] =
+{
+    { "i8",   SYMBOLS_TYPE_SIGNED,   1 },
+    { "u8",   SYMBOLS_TYPE_UNSIGNED, 1 },
+    { "i16",  SYMBOLS_TYPE_SIGNED,   2 },
+    { "u16",  SYMBOLS_TYPE_UNSIGNED, 2 },
+    { "i32",  SYMBOLS_TYPE_SIGNED,   4 },
+    { "u32",  SYMBOLS_TYPE_UNSIGNED, 4 },
+    { "i64",  SYMBOLS_TYPE_SIGNED,   8 },
+    { "u64",  SYMBOLS_TYPE_UNSIGNED, 8 },
+    { "f32",  SYMBOLS_TYPE_FLOAT,    4 },
+    { "f64",  SYMBOLS_TYPE_FLOAT,    8 },
+    { "bool", SYMBOLS_TYPE_BOOL,     1 },
+    { "hex",  SYMBOLS_TYPE_UNKNOWN,  0 },
+};
+
+struct watch
+{
+    FILE*               output;
+    bool                close_output;
+    watch_format_t      format;
+    uint64_t            interval_us;
+    uint64_t            next_sample_us;
+    watch_variable_t*   variables;
+    size_t              variable_count;
+    watch_read_t*       reads;
+    size_t              read_count;
+    uint8_t*            buffer;     //!< Data of all reads of a sample
+    size_t              buffer_size;
+};
+
+/**
+ * @brief Get the monotonic time in microseconds
+ *
+ * @return uint64_t Time in microseconds
+ */
+static uint64_t monotonic_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+/**
+ * @brief Check if a type can be shown as a value of the given size
+ *
+ * @param type Type
+ * @param size Size in bytes
+ * @return true if the size is supported for the type
+ */
+static bool is_value_size(symbols_type_t type, uint64_t size)
+{
+    switch(type)
+    {
+        case SYMBOLS_TYPE_FLOAT:    return size == 4 || size == 8;
+        case SYMBOLS_TYPE_UNKNOWN:  return size > 0;
+        default:                    return size == 1 || size == 2 || size == 4 || size == 8;
+    }
+}
+
+/**
+ * @brief Resolve a single entry of the variable list
+ *
+ * @param symbols Symbols of the firmware (may be NULL)
+ * @param spec Entry of the list: name[:type] or address:type
+ * @param variable Variable to fill
+ * @return true on success, false on failure
+ */
+static bool resolve_variable(symbols_t* symbols, char* spec, watch_variable_t* variable)
+{
+    const watch_type_t* type = NULL;
+    char* separator = strchr(spec, ':');
+    if(separator != NULL)
+    {
+        *separator = '\0';
+        for(size_t i = 0; i < sizeof(watch_types) / sizeof(watch_types[0]); i++)
+        {
+            if(strcmp(watch_types[i].name, separator + 1) == 0)
+            {
+                type = &watch_types[i];
+            }
+        }
+        if(type == NULL)
+        {
+            TRACE_ERROR("Unknown type '%s' of watched variable %s\n", separator + 1, spec);
+            return false;
+        }
+    }
+    if(spec[0] == '\0' || strlen(spec) >= sizeof(variable->name))
+    {
+        TRACE_ERROR("Invalid watched variable name: '%s'\n", spec);
+        return false;
+    }
+    strcpy(variable->name, spec);
+
+    if(spec[0] >= '0' && spec[0] <= '9')
+    {
+        char* end = NULL;
+        variable->address = strtoull(spec, &end, 0);
+        if(end == NULL || *end != '\0' || type == NULL || type->size == 0)
+        {
+            TRACE_ERROR("Watched address %s needs a type with a size (e.g. %s:u32)\n", spec, spec);
+            return false;
+        }
+        variable->type = type->type;
+        variable->size = type->size;
+        return true;
+    }
+
+    symbols_variable_t symbol;
+    if(!symbols_find_variable(symbols, spec, &symbol))
+    {
+        TRACE_ERROR("Watched variable %s not found%s\n", spec, symbols ? " in the ELF file" : " - no ELF file given (--elf)");
+        return false;
+    }
+    variable->address = symbol.address;
+    if(type != NULL)
+    {
+        variable->type = type->type;
+        variable->size = type->size ? type->size : symbol.size;
+    }
+    else
+    {
+        variable->type = symbol.type;
+        variable->size = symbol.type_size ? symbol.type_size : symbol.size;
+        if(symbol.type == SYMBOLS_TYPE_UNKNOWN)
+        {
+            TRACE_INFO("No scalar type for %s - shown as raw bytes (use %s:<type> to change)\n", spec, spec);
+        }
+    }
+    if(variable->size != 0 && !is_value_size(variable->type, variable->size))
+    {
+        TRACE_WARN("Unsupported size %" PRIu64 " of %s - shown as raw bytes\n", variable->size, spec);
+        variable->type = SYMBOLS_TYPE_UNKNOWN;
+    }
+    if(variable->size == 0)
+    {
+        TRACE_ERROR("Size of %s is unknown - give its type (e.g. %s:u32)\n", spec, spec);
+        return false;
+    }
+    if(variable->size > WATCH_MAX_HEX_SIZE)
+    {
+        TRACE_WARN("Only the first %d bytes of %s are sampled\n", WATCH_MAX_HEX_SIZE, spec);
+        variable->size = WATCH_MAX_HEX_SIZE;
+    }
+    return true;
+}
+
+static int compare_variables(const void* a, const void* b)
+{
+    const watch_variable_t* variable_a = *(watch_variable_t* const*)a;
+    const watch_variable_t* variable_b = *(watch_variable_t* const*)b;
+    if(variable_a->address != variable_b->address)
+    {
+        return variable_a->address < variable_b->address ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Group the variables into as few reads as possible
+ *
+ * Variables are sorted by address and merged into one read as long as the
+ * gap to the previous variable is small and the read does not get too big.
+ * Reads are word aligned for backends that read whole words.
+ *
+ * @param watch Watch with resolved variables
+ * @return true on success, false if memory could not be allocated
+ */
+static bool plan_reads(watch_t* watch)
+{
+    watch_variable_t** sorted = malloc(watch->variable_count * sizeof(*sorted));
+    watch->reads = calloc(watch->variable_count, sizeof(watch_read_t));
+    if(sorted == NULL || watch->reads == NULL)
+    {
+        free(sorted);
+        return false;
+    }
+    for(size_t i = 0; i < watch->variable_count; i++)
+    {
+        sorted[i] = &watch->variables[i];
+    }
+    qsort(sorted, watch->variable_count, sizeof(*sorted), compare_variables);
+
+    watch_read_t* read = NULL;
+    uint64_t read_end = 0;
+    for(size_t i = 0; i < watch->variable_count; i++)
+    {
+        watch_variable_t* variable = sorted[i];
+        uint64_t start = variable->address & ~(uint64_t)3;
+        uint64_t end = (variable->address + variable->size + 3) & ~(uint64_t)3;
+        if(read == NULL || start > read_end + WATCH_MAX_GAP ||
+           (end > read_end && end - read->address > WATCH_MAX_READ_SIZE))
+        {
+            read = &watch->reads[watch->read_count++];
+            read->address = start;
+            read_end = start;
+        }
+        if(end > read_end)
+        {
+            read_end = end;
+        }
+        read->size = (size_t)(read_end - read->address);
+    }
+    free(sorted);
+
+    for(size_t i = 0; i < watch->read_count; i++)
+    {
+        watch->reads[i].offset = watch->buffer_size;
+        watch->buffer_size += watch->reads[i].size;
+    }
+    for(size_t i = 0; i < watch->variable_count; i++)
+    {
+        watch_variable_t* variable = &watch->variables[i];
+        for(size_t j = 0; j < watch->read_count; j++)
+        {
+            const watch_read_t* candidate = &watch->reads[j];
+            if(variable->address >= candidate->address &&
+               variable->address + variable->size <= candidate->address + candidate->size)
+            {
+                variable->offset = candidate->offset + (size_t)(variable->address - candidate->address);
+                break;
+            }
+        }
+    }
+    watch->buffer = malloc(watch->buffer_size);
+    return watch->buffer != NULL;
+}
+
+/**
+ * @brief Format the value of a variable from the sample buffer
+ *
+ * @param watch Watch
+ * @param variable Variable
+ * @param text Buffer to store the text
+ * @param size Size of the buffer
+ */
+static void format_value(const watch_t* watch, const watch_variable_t* variable, char* text, size_t size)
+{
+    const uint8_t* data = &watch->buffer[variable->offset];
+    bool line_protocol = watch->format == WATCH_FORMAT_LINE;
+    uint64_t raw = 0;
+    for(size_t i = 0; i < variable->size && i < sizeof(raw); i++)
+    {
+        raw |= (uint64_t)data[i] << (8 * i);
+    }
+    switch(variable->type)
+    {
+        case SYMBOLS_TYPE_SIGNED:
+        {
+            int64_t value = (int64_t)raw;
+            if(variable->size < 8 && (raw >> (variable->size * 8 - 1)) & 1)
+            {
+                value = (int64_t)(raw | (~(uint64_t)0 << (variable->size * 8)));
+            }
+            snprintf(text, size, line_protocol ? "%" PRId64 "i" : "%" PRId64, value);
+            break;
+        }
+        case SYMBOLS_TYPE_UNSIGNED:
+            snprintf(text, size, !line_protocol ? "%" PRIu64 : raw <= INT64_MAX ? "%" PRIu64 "i" : "%" PRIu64 "u", raw);
+            break;
+        case SYMBOLS_TYPE_BOOL:
+            snprintf(text, size, "%s", line_protocol ? (raw ? "true" : "false") : (raw ? "1" : "0"));
+            break;
+        case SYMBOLS_TYPE_FLOAT:
+            if(variable->size == 4)
+            {
+                float value;
+                memcpy(&value, data, sizeof(value));
+                snprintf(text, size, "%.9g", value);
+            }
+            else
+            {
+                double value;
+                memcpy(&value, data, sizeof(value));
+                snprintf(text, size, "%.17g", value);
+            }
+            break;
+        case SYMBOLS_TYPE_POINTER:
+            snprintf(text, size, line_protocol ? "\"0x%0*" PRIx64 "\"" : "0x%0*" PRIx64, (int)variable->size * 2, raw);
+            break;
+        default:
+        {
+            // Raw bytes in memory order
+            size_t length = 0;
+            if(line_protocol && length + 1 < size)
+            {
+                text[length++] = '"';
+            }
+            for(size_t i = 0; i < variable->size && length + 3 < size; i++)
+            {
+                length += (size_t)snprintf(&text[length], size - length, "%02x", data[i]);
+            }
+            if(line_protocol && length + 1 < size)
+            {
+                text[length++] = '"';
+            }
+            text[length] = '\0';
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Start sampling variables
+ *
+ * @param variables Comma separated list of variables (see watch.h)
+ * @param symbols Symbols of the firmware, or NULL if only addresses are given
+ * @param output_path File to write the samples to, or NULL for stdout
+ * @param format Output format
+ * @param interval_ms Sampling interval in milliseconds (0 - default)
+ * @return watch_t* Watch, NULL on failure
+ */
+watch_t* watch_open(const char* variables, symbols_t* symbols, const char* output_path, watch_format_t format, uint32_t interval_ms)
+{
+    watch_t* watch = calloc(1, sizeof(watch_t));
+    char* list = strdup(variables);
+    size_t capacity = 1;
+    for(const char* c = variables; *c; c++)
+    {
+        capacity += *c == ',';
+    }
+    if(watch != NULL)
+    {
+        watch->variables = calloc(capacity, sizeof(watch_variable_t));
+    }
+    if(watch == NULL || list == NULL || watch->variables == NULL)
+    {
+        TRACE_ERROR("Failed to allocate watch\n");
+        free(list);
+        watch_close(watch);
+        return NULL;
+    }
+    watch->format = format;
+    watch->interval_us = (uint64_t)(interval_ms ? interval_ms : WATCH_DEFAULT_INTERVAL) * 1000u;
+
+    char* saveptr = NULL;
+    for(char* spec = strtok_r(list, ",", &saveptr); spec != NULL; spec = strtok_r(NULL, ",", &saveptr))
+    {
+        while(*spec == ' ')
+        {
+            spec++;
+        }
+        if(!resolve_variable(symbols, spec, &watch->variables[watch->variable_count]))
+        {
+            free(list);
+            watch_close(watch);
+            return NULL;
+        }
+        watch_variable_t* variable = &watch->variables[watch->variable_count++];
+        TRACE_VERBOSE("Watching %s at 0x%08" PRIx64 " (%" PRIu64 " bytes)\n", variable->name, variable->address, variable->size);
+    }
+    free(list);
+    if(watch->variable_count == 0 || !plan_reads(watch))
+    {
+        TRACE_ERROR("No variables to watch\n");
+        watch_close(watch);
+        return NULL;
+    }
+
+    watch->output = stdout;
+    if(output_path != NULL)
+    {
+        watch->output = fopen(output_path, "w");
+        watch->close_output = true;
+        if(watch->output == NULL)
+        {
+            TRACE_ERROR("Failed to open watch output file: %s\n", output_path);
+            watch_close(watch);
+            return NULL;
+        }
+    }
+    if(format == WATCH_FORMAT_CSV)
+    {
+        fprintf(watch->output, "time");
+        for(size_t i = 0; i < watch->variable_count; i++)
+        {
+            fprintf(watch->output, ",%s", watch->variables[i].name);
+        }
+        fprintf(watch->output, "\n");
+        fflush(watch->output);
+    }
+    TRACE_INFO("Watching %zu variables with %zu reads per sample\n", watch->variable_count, watch->read_count);
+    return watch;
+}
+
+/**
+ * @brief Stop sampling and close the output
+ *
+ * @param watch Watch (may be NULL)
+ */
+void watch_close(watch_t* watch)
+{
+    if(watch)
+    {
+        if(watch->close_output && watch->output != NULL)
+        {
+            fclose(watch->output);
+        }
+        free(watch->buffer);
+        free(watch->reads);
+        free(watch->variables);
+        free(watch);
+    }
+}
+
+/**
+ * @brief Read all variables from the target and write a sample
+ *
+ * @param watch Watch
+ * @param backend_type Backend to read with
+ * @param socket Socket of the backend
+ * @return true on success, false if the target could not be read
+ */
+bool watch_sample(watch_t* watch, backend_type_t backend_type, int socket)
+{
+    for(size_t i = 0; i < watch->read_count; i++)
+    {
+        const watch_read_t* read = &watch->reads[i];
+        if(backend_read_memory(backend_type, socket, read->address, &watch->buffer[read->offset], read->size) < 0)
+        {
+            TRACE_WARN("Failed to read watched variables at 0x%08" PRIx64 "\n", read->address);
+            return false;
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if(watch->format == WATCH_FORMAT_CSV)
+    {
+        fprintf(watch->output, "%lld.%06ld", (long long)now.tv_sec, now.tv_nsec / 1000);
+    }
+    else
+    {
+        fprintf(watch->output, "dmlog_watch ");
+    }
+    for(size_t i = 0; i < watch->variable_count; i++)
+    {
+        char text[WATCH_MAX_HEX_SIZE * 2 + 32];
+        format_value(watch, &watch->variables[i], text, sizeof(text));
+        if(watch->format == WATCH_FORMAT_CSV)
+        {
+            fprintf(watch->output, ",%s", text);
+        }
+        else
+        {
+            fprintf(watch->output, "%s%s=%s", i ? "," : "", watch->variables[i].name, text);
+        }
+    }
+    if(watch->format == WATCH_FORMAT_LINE)
+    {
+        fprintf(watch->output, " %lld%09ld", (long long)now.tv_sec, now.tv_nsec);
+    }
+    fprintf(watch->output, "\n");
+    fflush(watch->output);
+    return true;
+}
+
+/**
+ * @brief Write a sample if the sampling interval has elapsed
+ *
+ * @param watch Watch (may be NULL)
+ * @param backend_type Backend to read with
+ * @param socket Socket of the backend
+ * @return true on success or if no sample was due, false on failure
+ */
+bool watch_poll(watch_t* watch, backend_type_t backend_type, int socket)
+{
+    if(watch == NULL)
+    {
+        return true;
+    }
+    uint64_t now = monotonic_us();
+    if(now < watch->next_sample_us)
+    {
+        return true;
+    }
+    // Skip the missed samples instead of reading them in a burst
+    watch->next_sample_us = now - watch->next_sample_us < watch->interval_us ? watch->next_sample_us + watch->interval_us
+                                                                               : now + watch->interval_us;
+    return watch_sample(watch, backend_type, socket);
+}
+
+/**
+ * @brief Parse the name of an output format
+ *
+ * @param name Format name ("csv" or "line")
+ * @param format Pointer to store the format
+ * @return true if the name is valid
+ */
+bool watch_parse_format(const char* name, watch_format_t* format)
+{
+    if(strcmp(name, "csv") == 0)
+    {
+        *format = WATCH_FORMAT_CSV;
+        return true;
+    }
+    if(strcmp(name, "line") == 0)
+    {
+        *format = WATCH_FORMAT_LINE;
+        return true;
+    }
+    return false;
+}
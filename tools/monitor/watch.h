@@ -0,0 +1,44 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "backend.h"
+#include "symbols.h"
+
+/**
+ * @file watch.h
+ * @brief Sampler of firmware variables resolved from the ELF file.
+ *
+ * Variables are given by name (resolved from the symbol table, typed from the
+ * DWARF information) or as `address:type`. Variables close to each other in
+ * memory are read together, so a sample of variables from the same data
+ * section is a single probe round trip. Samples are written as CSV or as
+ * InfluxDB line protocol, to a file or to stdout.
+ *
+ * Variable list syntax: `name[:type],...` or `0xADDRESS:type,...`, where type
+ * is one of i8, u8, i16, u16, i32, u32, i64, u64, f32, f64, bool or hex (raw
+ * bytes of the symbol size).
+ */
+
+#define WATCH_DEFAULT_INTERVAL      100     /* milliseconds */
+#define WATCH_MAX_GAP               256     /* bytes read between variables instead of a new read */
+#define WATCH_MAX_READ_SIZE         4096    /* maximum size of a single read */
+#define WATCH_MAX_HEX_SIZE          64      /* maximum size of a variable shown as raw bytes */
+
+typedef enum
+{
+    WATCH_FORMAT_CSV,       //!< time,name1,name2,... with a header line
+    WATCH_FORMAT_LINE,      //!< InfluxDB line protocol, measurement "dmlog_watch"
+} watch_format_t;
+
+typedef struct watch watch_t;
+
+watch_t* watch_open(const char* variables, symbols_t* symbols, const char* output_path, watch_format_t format, uint32_t interval_ms);
+void watch_close(watch_t* watch);
+bool watch_sample(watch_t* watch, backend_type_t backend_type, int socket);
+bool watch_poll(watch_t* watch, backend_type_t backend_type, int socket);
+bool watch_parse_format(const char* name, watch_format_t* format);
+
+#endif // WATCH_H
@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+#include "query.h"
+#include "trace.h"
+
+#ifndef DMLOG_VERSION
+#   define DMLOG_VERSION "unknown"
+#endif
+
+void usage(const char *progname)
+{
+    printf("Usage: %s [options] --archive <dir> [term|\"phrase\"]...\n", progname);
+    printf("Search logs archived by dmlog_monitor --archive.\n");
+    printf("All terms must match; quoted text with several words is a phrase.\n");
+    printf("Options:\n");
+    printf("  --help          Show this help message\n");
+    printf("  --version       Show version information\n");
+    printf("  --archive       Archive directory written by dmlog_monitor\n");
+    printf("  --from          Start of time range (epoch seconds or 'YYYY-MM-DD[ HH:MM[:SS]]')\n");
+    printf("  --to            End of time range (same formats as --from)\n");
+    printf("  -A <n>          Print n lines of context after each match\n");
+    printf("  -B <n>          Print n lines of context before each match\n");
+    printf("  -C <n>          Print n lines of context around each match\n");
+    printf("  -c, --count     Only print the number of matching lines\n");
+    printf("  -n              Prefix lines with segment:line\n");
+    printf("  --time          Prefix lines with the time they were received\n");
+    printf("  --stats         Print query statistics to stderr\n");
+    printf("  --trace-level   Set trace level (error, warn, info, verbose)\n");
+}
+
+/**
+ * @brief Parse a time argument
+ *
+ * @param text Time as epoch seconds or a local date/time
+ * @param end_of_range Round incomplete dates up (for --to)
+ * @param out Parsed time in milliseconds since the epoch
+ * @return true on success, false on failure
+ */
+static bool parse_time(const char* text, bool end_of_range, int64_t* out)
+{
+    char* end = NULL;
+    long long seconds = strtoll(text, &end, 10);
+    if(end != text && *end == '\0')
+    {
+        *out = (int64_t)seconds * 1000 + (end_of_range ? 999 : 0);
+        return true;
+    }
+
+    static const struct
+    {
+        const char* format;
+        int         resolution; // seconds covered by the last parsed field
+    } formats[] = {
+        { "%Y-%m-%d %H:%M:%S", 1 },
+        { "%Y-%m-%dT%H:%M:%S", 1 },
+        { "%Y-%m-%d %H:%M",    60 },
+        { "%Y-%m-%d",          86400 },
+    };
+    for(size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        const char* rest = strptime(text, formats[i].format, &tm);
+        if(rest != NULL && *rest == '\0')
+        {
+            tm.tm_isdst = -1;
+            time_t t = mktime(&tm);
+            if(t == (time_t)-1)
+            {
+                return false;
+            }
+            *out = (int64_t)t * 1000 + (end_of_range ? (int64_t)formats[i].resolution * 1000 - 1 : 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    static query_t query;
+    query.from_ms = INT64_MIN;
+    query.to_ms = INT64_MAX;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--help") == 0)
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if(strcmp(argv[i], "--version") == 0)
+        {
+            printf("dmlog query version %s\n", DMLOG_VERSION);
+            return 0;
+        }
+        else if(strcmp(argv[i], "--archive") == 0 && i + 1 < argc)
+        {
+            query.directory = argv[++i];
+        }
+        else if((strcmp(argv[i], "--from") == 0 || strcmp(argv[i], "--to") == 0) && i + 1 < argc)
+        {
+            bool is_end = strcmp(argv[i], "--to") == 0;
+            const char* text = argv[++i];
+            if(!parse_time(text, is_end, is_end ? &query.to_ms : &query.from_ms))
+            {
+                TRACE_ERROR("Invalid time: %s\n", text);
+                return 2;
+            }
+        }
+        else if((strcmp(argv[i], "-A") == 0 || strcmp(argv[i], "-B") == 0 || strcmp(argv[i], "-C") == 0) && i + 1 < argc)
+        {
+            char option = argv[i][1];
+            unsigned lines = (unsigned)strtoul(argv[++i], NULL, 0);
+            if(option != 'A')
+            {
+                query.before = lines;
+            }
+            if(option != 'B')
+            {
+                query.after = lines;
+            }
+        }
+        else if(strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--count") == 0)
+        {
+            query.count_only = true;
+        }
+        else if(strcmp(argv[i], "-n") == 0)
+        {
+            query.show_location = true;
+        }
+        else if(strcmp(argv[i], "--time") == 0)
+        {
+            query.show_timestamps = true;
+        }
+        else if(strcmp(argv[i], "--stats") == 0)
+        {
+            query.show_stats = true;
+        }
+        else if(strcmp(argv[i], "--trace-level") == 0 && i + 1 < argc)
+        {
+            const char *level_str = argv[++i];
+            if(strcmp(level_str, "error") == 0)
+            {
+                current_trace_level = TRACE_LEVEL_ERROR;
+            }
+            else if(strcmp(level_str, "warn") == 0)
+            {
+                current_trace_level = TRACE_LEVEL_WARN;
+            }
+            else if(strcmp(level_str, "info") == 0)
+            {
+                current_trace_level = TRACE_LEVEL_INFO;
+            }
+            else if(strcmp(level_str, "verbose") == 0)
+            {
+                current_trace_level = TRACE_LEVEL_VERBOSE;
+            }
+            else
+            {
+                TRACE_ERROR("Unknown trace level: %s\n", level_str);
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        else if(argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            TRACE_ERROR("Unknown option: %s\n", argv[i]);
+            usage(argv[0]);
+            return 2;
+        }
+        else if(!query_add_term(&query, argv[i]))
+        {
+            return 2;
+        }
+    }
+
+    if(query.directory == NULL)
+    {
+        TRACE_ERROR("Missing --archive directory\n");
+        usage(argv[0]);
+        return 2;
+    }
+
+    return query_run(&query);
+}
@@ -0,0 +1,720 @@
+#define _GNU_SOURCE
+
+#include "query.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Memory-mapped file
+ */
+typedef struct
+{
+    const uint8_t*  data;
+    size_t          size;
+} mapped_file_t;
+
+/**
+ * @brief Open archive segment
+ */
+typedef struct
+{
+    uint32_t                        number;
+    mapped_file_t                   log;
+    mapped_file_t                   lines_file;
+    mapped_file_t                   index;
+    const archive_line_t*           lines;
+    uint32_t                        line_count;     //!< Lines in the line table
+    uint32_t                        indexed_lines;  //!< Lines covered by the index
+    const archive_index_header_t*   header;         //!< NULL if there is no index
+} segment_t;
+
+/**
+ * @brief Sorted list of line numbers
+ */
+typedef struct
+{
+    uint32_t*   lines;
+    size_t      count;
+} posting_list_t;
+
+/**
+ * @brief Query statistics
+ */
+typedef struct
+{
+    uint32_t    segments;
+    uint32_t    skipped_segments;
+    uint64_t    indexed_lines;
+    uint64_t    scanned_lines;
+    uint64_t    matches;
+} query_stats_t;
+
+/**
+ * @brief Output state shared between segments
+ */
+typedef struct
+{
+    const query_t*  query;
+    query_stats_t   stats;
+    bool            printed_any;
+} query_output_t;
+
+/**
+ * @brief Tokenizer state used to match the terms of a query against a line
+ *
+ * Only the last QUERY_MAX_PHRASE_TOKENS tokens are kept, which is enough to
+ * match the longest phrase, so lines of any length are matched completely.
+ */
+typedef struct
+{
+    const query_t*  query;
+    char            window[QUERY_MAX_PHRASE_TOKENS][ARCHIVE_MAX_TOKEN_LENGTH + 1];
+    size_t          count;                  //!< Tokens seen so far
+    bool            found[QUERY_MAX_TERMS];
+    size_t          found_count;
+} line_match_t;
+
+/**
+ * @brief Tokenizer callback storing tokens of a query term
+ */
+static bool collect_term_token(const char* token, size_t length, void* user_data)
+{
+    query_term_t* term = user_data;
+    if(term->token_count >= QUERY_MAX_PHRASE_TOKENS)
+    {
+        return false;
+    }
+    memcpy(term->tokens[term->token_count], token, length);
+    term->tokens[term->token_count][length] = '\0';
+    term->token_count++;
+    return true;
+}
+
+/**
+ * @brief Tokenizer callback matching the query terms that end at a token of a log line
+ */
+static bool match_line_token(const char* token, size_t length, void* user_data)
+{
+    line_match_t* line = user_data;
+    memcpy(line->window[line->count % QUERY_MAX_PHRASE_TOKENS], token, length);
+    line->window[line->count % QUERY_MAX_PHRASE_TOKENS][length] = '\0';
+    line->count++;
+
+    const query_t* query = line->query;
+    for(size_t t = 0; t < query->term_count; t++)
+    {
+        const query_term_t* term = &query->terms[t];
+        if(line->found[t] || term->token_count > line->count)
+        {
+            continue;
+        }
+        bool found = true;
+        size_t start = line->count - term->token_count;
+        for(size_t k = 0; found && k < term->token_count; k++)
+        {
+            found = strcmp(line->window[(start + k) % QUERY_MAX_PHRASE_TOKENS], term->tokens[k]) == 0;
+        }
+        if(found)
+        {
+            line->found[t] = true;
+            line->found_count++;
+        }
+    }
+    return line->found_count < query->term_count; // Stop when everything was found
+}
+
+/**
+ * @brief Add a term to the query
+ *
+ * Text containing several words becomes a phrase term.
+ *
+ * @param query Query
+ * @param text Term text
+ * @return true on success, false if the term is empty or there are too many terms
+ */
+bool query_add_term(query_t* query, const char* text)
+{
+    if(query->term_count >= QUERY_MAX_TERMS)
+    {
+        TRACE_ERROR("Too many query terms (max %d)\n", QUERY_MAX_TERMS);
+        return false;
+    }
+    query_term_t* term = &query->terms[query->term_count];
+    memset(term, 0, sizeof(*term));
+    archive_tokenize(text, strlen(text), collect_term_token, term);
+    if(term->token_count == 0)
+    {
+        TRACE_ERROR("Query term '%s' does not contain any searchable words\n", text);
+        return false;
+    }
+    query->term_count++;
+    return true;
+}
+
+/**
+ * @brief Map a file into memory (read-only)
+ */
+static bool map_file(const char* path, mapped_file_t* file)
+{
+    file->data = NULL;
+    file->size = 0;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    if(st.st_size > 0)
+    {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+        file->data = data;
+        file->size = st.st_size;
+    }
+    close(fd);
+    return true;
+}
+
+/**
+ * @brief Unmap a file mapped by map_file()
+ */
+static void unmap_file(mapped_file_t* file)
+{
+    if(file->data != NULL)
+    {
+        munmap((void*)file->data, file->size);
+    }
+    file->data = NULL;
+    file->size = 0;
+}
+
+/**
+ * @brief Open a segment for querying
+ */
+static bool open_segment(const char* directory, uint32_t number, segment_t* segment)
+{
+    char path[ARCHIVE_MAX_PATH_LENGTH];
+    memset(segment, 0, sizeof(*segment));
+    segment->number = number;
+
+    if(!archive_segment_path(path, sizeof(path), directory, number, "log") || !map_file(path, &segment->log))
+    {
+        TRACE_ERROR("Failed to open segment log '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    if(!archive_segment_path(path, sizeof(path), directory, number, "lines") || !map_file(path, &segment->lines_file))
+    {
+        TRACE_ERROR("Failed to open segment line table '%s': %s\n", path, strerror(errno));
+        unmap_file(&segment->log);
+        return false;
+    }
+    segment->lines = (const archive_line_t*)segment->lines_file.data;
+    segment->line_count = segment->lines_file.size / sizeof(archive_line_t);
+
+    // Lines may be written after the line table was read - never go past the log
+    while(segment->line_count > 0 && segment->lines[segment->line_count - 1].offset >= segment->log.size)
+    {
+        segment->line_count--;
+    }
+
+    bool indexed = archive_segment_path(path, sizeof(path), directory, number, "idx") && map_file(path, &segment->index);
+    if(indexed && segment->index.size >= sizeof(archive_index_header_t))
+    {
+        const archive_index_header_t* header = (const archive_index_header_t*)segment->index.data;
+        if(header->magic == ARCHIVE_INDEX_MAGIC && header->version == ARCHIVE_INDEX_VERSION &&
+           (uint64_t)header->offsets_position + (uint64_t)header->term_count * sizeof(uint32_t) <= segment->index.size)
+        {
+            segment->header = header;
+            segment->indexed_lines = header->line_count < segment->line_count ? header->line_count : segment->line_count;
+        }
+        else
+        {
+            TRACE_WARN("Ignoring invalid index of segment %u\n", number);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Release a segment opened by open_segment()
+ */
+static void close_segment(segment_t* segment)
+{
+    unmap_file(&segment->log);
+    unmap_file(&segment->lines_file);
+    unmap_file(&segment->index);
+}
+
+/**
+ * @brief Get the text of a line in a segment
+ */
+static const char* get_line(const segment_t* segment, uint32_t line, size_t* length)
+{
+    uint64_t start = segment->lines[line].offset;
+    uint64_t end = line + 1 < segment->line_count ? segment->lines[line + 1].offset : segment->log.size;
+    if(end > segment->log.size || start > end)
+    {
+        *length = 0;
+        return "";
+    }
+    *length = (size_t)(end - start);
+    return (const char*)segment->log.data + start;
+}
+
+/**
+ * @brief Find the posting list of a token in the segment index
+ *
+ * @return true if the token was found
+ */
+static bool find_postings(const segment_t* segment, const char* token, posting_list_t* list)
+{
+    const archive_index_header_t* header = segment->header;
+    const uint8_t* data = segment->index.data;
+    const uint8_t* end = data + segment->index.size;
+    const uint32_t* offsets = (const uint32_t*)(data + header->offsets_position);
+    size_t token_length = strlen(token);
+
+    size_t low = 0;
+    size_t high = header->term_count;
+    while(low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        const uint8_t* record = data + offsets[middle];
+        if(record >= end || record + 1 + record[0] > end)
+        {
+            return false;
+        }
+        size_t term_length = record[0];
+        int cmp = memcmp(record + 1, token, term_length < token_length ? term_length : token_length);
+        if(cmp == 0)
+        {
+            cmp = (term_length > token_length) - (term_length < token_length);
+        }
+        if(cmp < 0)
+        {
+            low = middle + 1;
+        }
+        else if(cmp > 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            const uint8_t* ptr = record + 1 + term_length;
+            uint64_t count = 0;
+            uint64_t size = 0;
+            size_t n = archive_varint_decode(ptr, end, &count);
+            ptr += n;
+            n = n ? archive_varint_decode(ptr, end, &size) : 0;
+            ptr += n;
+            if(n == 0 || ptr + size > end)
+            {
+                return false;
+            }
+            list->lines = malloc((count + 1) * sizeof(uint32_t));
+            list->count = 0;
+            if(list->lines == NULL)
+            {
+                return false;
+            }
+            const uint8_t* postings_end = ptr + size;
+            uint64_t line = 0;
+            while(ptr < postings_end && list->count < count)
+            {
+                uint64_t delta = 0;
+                n = archive_varint_decode(ptr, postings_end, &delta);
+                if(n == 0)
+                {
+                    break;
+                }
+                ptr += n;
+                line = list->count == 0 ? delta : line + delta;
+                list->lines[list->count++] = (uint32_t)line;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Intersect two sorted posting lists in place (result stored in a)
+ */
+static void intersect(posting_list_t* a, const posting_list_t* b)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+    while(i < a->count && j < b->count)
+    {
+        if(a->lines[i] < b->lines[j])
+        {
+            i++;
+        }
+        else if(a->lines[i] > b->lines[j])
+        {
+            j++;
+        }
+        else
+        {
+            a->lines[count++] = a->lines[i];
+            i++;
+            j++;
+        }
+    }
+    a->count = count;
+}
+
+/**
+ * @brief Check if a line matches all query terms
+ */
+static bool line_matches(const query_t* query, const char* text, size_t length)
+{
+    if(query->term_count == 0)
+    {
+        return true;
+    }
+    line_match_t line;
+    memset(line.found, 0, sizeof(line.found));
+    line.query = query;
+    line.count = 0;
+    line.found_count = 0;
+    archive_tokenize(text, length, match_line_token, &line);
+    return line.found_count == query->term_count;
+}
+
+/**
+ * @brief Check if a line is within the query time range
+ */
+static bool in_time_range(const query_t* query, const segment_t* segment, uint32_t line)
+{
+    int64_t timestamp = segment->lines[line].timestamp_ms;
+    return timestamp >= query->from_ms && timestamp <= query->to_ms;
+}
+
+/**
+ * @brief Print a single line with the requested prefixes
+ */
+static void print_line(const query_t* query, const segment_t* segment, uint32_t line, char separator)
+{
+    size_t length = 0;
+    const char* text = get_line(segment, line, &length);
+    if(query->show_location)
+    {
+        printf("%u:%u%c", segment->number, line + 1, separator);
+    }
+    if(query->show_timestamps)
+    {
+        int64_t timestamp = segment->lines[line].timestamp_ms;
+        time_t seconds = (time_t)(timestamp / 1000);
+        struct tm local_time;
+        localtime_r(&seconds, &local_time);
+        printf("[%04d-%02d-%02d %02d:%02d:%02d.%03d] ",
+            local_time.tm_year + 1900, local_time.tm_mon + 1, local_time.tm_mday,
+            local_time.tm_hour, local_time.tm_min, local_time.tm_sec,
+            (int)(timestamp % 1000));
+    }
+    fwrite(text, 1, length, stdout);
+    if(length == 0 || text[length - 1] != '\n')
+    {
+        putchar('\n');
+    }
+}
+
+/**
+ * @brief Print matches of a segment with the requested context
+ */
+static void print_matches(query_output_t* output, const segment_t* segment, const uint32_t* matches, size_t count)
+{
+    const query_t* query = output->query;
+    int64_t printed_until = -1;
+    for(size_t i = 0; i < count; i++)
+    {
+        uint32_t match = matches[i];
+        int64_t start = (int64_t)match - query->before;
+        int64_t end = (int64_t)match + query->after;
+        if(start <= printed_until)
+        {
+            start = printed_until + 1;
+        }
+        if(start < 0)
+        {
+            start = 0;
+        }
+        if(end >= segment->line_count)
+        {
+            end = (int64_t)segment->line_count - 1;
+        }
+        if((query->before || query->after) && output->printed_any && start > printed_until + 1)
+        {
+            printf("--\n");
+        }
+        for(int64_t line = start; line <= end; line++)
+        {
+            print_line(query, segment, (uint32_t)line, line == match ? ':' : '-');
+        }
+        if(end > printed_until)
+        {
+            printed_until = end;
+        }
+        output->printed_any = true;
+    }
+}
+
+/**
+ * @brief Run the query against a single segment
+ */
+static bool query_segment(query_output_t* output, const segment_t* segment)
+{
+    const query_t* query = output->query;
+    uint32_t* matches = malloc((segment->line_count + 1) * sizeof(uint32_t));
+    if(matches == NULL)
+    {
+        TRACE_ERROR("Failed to allocate match list\n");
+        return false;
+    }
+    size_t match_count = 0;
+
+    // Indexed part of the segment - posting list intersection
+    uint32_t indexed_lines = segment->header ? segment->indexed_lines : 0;
+    if(indexed_lines > 0 && query->term_count > 0)
+    {
+        posting_list_t result = { 0 };
+        bool any_missing = false;
+        bool needs_verification = false;
+        for(size_t t = 0; !any_missing && t < query->term_count; t++)
+        {
+            const query_term_t* term = &query->terms[t];
+            needs_verification |= term->token_count > 1;
+            for(size_t k = 0; !any_missing && k < term->token_count; k++)
+            {
+                posting_list_t list = { 0 };
+                if(!find_postings(segment, term->tokens[k], &list))
+                {
+                    any_missing = true;
+                }
+                else if(result.lines == NULL)
+                {
+                    result = list;
+                }
+                else
+                {
+                    intersect(&result, &list);
+                    free(list.lines);
+                }
+            }
+        }
+        for(size_t i = 0; !any_missing && i < result.count; i++)
+        {
+            uint32_t line = result.lines[i];
+            if(line >= indexed_lines || !in_time_range(query, segment, line))
+            {
+                continue;
+            }
+            if(needs_verification)
+            {
+                size_t length = 0;
+                const char* text = get_line(segment, line, &length);
+                if(!line_matches(query, text, length))
+                {
+                    continue;
+                }
+            }
+            matches[match_count++] = line;
+        }
+        free(result.lines);
+        output->stats.indexed_lines += indexed_lines;
+    }
+    else if(indexed_lines > 0)
+    {
+        // Time range only - line timestamps are in arrival order
+        size_t low = 0;
+        size_t high = indexed_lines;
+        while(low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            if(segment->lines[middle].timestamp_ms < query->from_ms)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        for(uint32_t line = (uint32_t)low; line < indexed_lines && segment->lines[line].timestamp_ms <= query->to_ms; line++)
+        {
+            matches[match_count++] = line;
+        }
+        output->stats.indexed_lines += indexed_lines;
+    }
+
+    // Tail written after the last index checkpoint - linear scan
+    for(uint32_t line = indexed_lines; line < segment->line_count; line++)
+    {
+        size_t length = 0;
+        const char* text = get_line(segment, line, &length);
+        if(in_time_range(query, segment, line) && line_matches(query, text, length))
+        {
+            matches[match_count++] = line;
+        }
+        output->stats.scanned_lines++;
+    }
+
+    output->stats.matches += match_count;
+    if(!query->count_only)
+    {
+        print_matches(output, segment, matches, match_count);
+    }
+    free(matches);
+    return true;
+}
+
+/**
+ * @brief Compare segment numbers for sorting
+ */
+static int compare_segments(const void* a, const void* b)
+{
+    uint32_t segment_a = *(const uint32_t*)a;
+    uint32_t segment_b = *(const uint32_t*)b;
+    return (segment_a > segment_b) - (segment_a < segment_b);
+}
+
+/**
+ * @brief List segments present in the archive directory, sorted by number
+ */
+static uint32_t* list_segments(const char* directory, size_t* count)
+{
+    *count = 0;
+    DIR* dir = opendir(directory);
+    if(dir == NULL)
+    {
+        TRACE_ERROR("Failed to open archive directory '%s': %s\n", directory, strerror(errno));
+        return NULL;
+    }
+    size_t capacity = 64;
+    uint32_t* segments = malloc(capacity * sizeof(uint32_t));
+    struct dirent* entry;
+    while(segments != NULL && (entry = readdir(dir)) != NULL)
+    {
+        unsigned segment = 0;
+        char extension[8];
+        if(sscanf(entry->d_name, "segment-%u.%7s", &segment, extension) != 2 || strcmp(extension, "log") != 0)
+        {
+            continue;
+        }
+        if(*count == capacity)
+        {
+            capacity *= 2;
+            uint32_t* grown = realloc(segments, capacity * sizeof(uint32_t));
+            if(grown == NULL)
+            {
+                free(segments);
+                segments = NULL;
+                break;
+            }
+            segments = grown;
+        }
+        segments[(*count)++] = segment;
+    }
+    closedir(dir);
+    if(segments != NULL)
+    {
+        qsort(segments, *count, sizeof(uint32_t), compare_segments);
+    }
+    return segments;
+}
+
+/**
+ * @brief Get monotonic time in microseconds
+ */
+static double get_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+}
+
+/**
+ * @brief Run a query against an archive
+ *
+ * @param query Query parameters
+ * @return int 0 if there were matches, 1 if there were none, 2 on error
+ *         (the same convention as grep)
+ */
+int query_run(const query_t* query)
+{
+    double start_time = get_time_us();
+    size_t segment_count = 0;
+    uint32_t* segments = list_segments(query->directory, &segment_count);
+    if(segments == NULL)
+    {
+        return 2;
+    }
+
+    query_output_t output = { .query = query };
+    bool result = true;
+    for(size_t i = 0; result && i < segment_count; i++)
+    {
+        segment_t segment;
+        if(!open_segment(query->directory, segments[i], &segment))
+        {
+            result = false;
+            break;
+        }
+        output.stats.segments++;
+        bool outside_range = segment.line_count == 0 ||
+                             segment.lines[0].timestamp_ms > query->to_ms ||
+                             segment.lines[segment.line_count - 1].timestamp_ms < query->from_ms;
+        if(outside_range)
+        {
+            output.stats.skipped_segments++;
+        }
+        else
+        {
+            result = query_segment(&output, &segment);
+        }
+        close_segment(&segment);
+    }
+    free(segments);
+
+    if(query->count_only)
+    {
+        printf("%llu\n", (unsigned long long)output.stats.matches);
+    }
+    fflush(stdout);
+
+    if(query->show_stats)
+    {
+        fprintf(stderr, "segments: %u (%u skipped by time range)\n", output.stats.segments, output.stats.skipped_segments);
+        fprintf(stderr, "indexed lines: %llu, scanned lines: %llu\n",
+            (unsigned long long)output.stats.indexed_lines,
+            (unsigned long long)output.stats.scanned_lines);
+        fprintf(stderr, "matches: %llu\n", (unsigned long long)output.stats.matches);
+        fprintf(stderr, "query time: %.3f ms\n", (get_time_us() - start_time) / 1000.0);
+    }
+
+    if(!result)
+    {
+        return 2;
+    }
+    return output.stats.matches > 0 ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "archive.h"
+
+#define QUERY_MAX_TERMS         16
+#define QUERY_MAX_PHRASE_TOKENS 16
+
+/**
+ * @brief Single query term - a word or a phrase of consecutive words
+ */
+typedef struct
+{
+    char    tokens[QUERY_MAX_PHRASE_TOKENS][ARCHIVE_MAX_TOKEN_LENGTH + 1];
+    size_t  token_count;
+} query_term_t;
+
+/**
+ * @brief Query parameters
+ *
+ * All terms must match a line (AND semantics). A line matches a phrase term
+ * when the phrase tokens appear consecutively in the line.
+ */
+typedef struct
+{
+    const char*     directory;          //!< Archive directory
+    query_term_t    terms[QUERY_MAX_TERMS];
+    size_t          term_count;
+    int64_t         from_ms;            //!< Start of time range (inclusive)
+    int64_t         to_ms;              //!< End of time range (inclusive)
+    unsigned        before;             //!< Lines of context before a match
+    unsigned        after;              //!< Lines of context after a match
+    bool            count_only;         //!< Only print the number of matches
+    bool            show_timestamps;    //!< Prefix lines with their timestamp
+    bool            show_location;      //!< Prefix lines with segment:line
+    bool            show_stats;         //!< Print query statistics to stderr
+} query_t;
+
+bool query_add_term(query_t* query, const char* text);
+int query_run(const query_t* query);
+
+#endif // QUERY_H